@@ -0,0 +1,770 @@
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "src/asset/blas_granularity.h"
+#include "src/asset/block_compression.h"
+#include "src/asset/chunked_file.h"
+#include "src/asset/image.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/asset/mesh_optimizer.h"
+#include "src/asset/mesh_simplifier.h"
+#include "src/asset/obj_parser.h"
+#include "src/asset/scene_cache.h"
+#include "src/asset/vertex_weld.h"
+#include "src/common.h"
+
+using namespace std;
+using namespace capsaicin;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr const char* kManifestFileName = "manifest.txt";
+constexpr const char* kTextureDir       = "textures";
+
+struct CookOptions
+{
+    fs::path input_dir;
+    fs::path output_dir;
+    uint32_t num_threads = 0;
+    // Store scene indices as varint deltas, see SceneCache::Write.
+    bool compress_indices = false;
+    // Write caches and textures as chunked files, see ChunkedFile.
+    bool chunked = false;
+    // Block compress textures, BC1 falls back to BC7 for textures with alpha. Textures whose
+    // dimensions aren't multiples of 4 stay RGBA8.
+    TextureFormat texture_format  = TextureFormat::kRGBA8;
+    BlockQuality  texture_quality = BlockQuality::kNormal;
+    // Time mip generation of the textures against the scalar reference instead of cooking.
+    bool benchmark_mips = false;
+    // Time block compression of the textures and measure its PSNR instead of cooking.
+    bool benchmark_compression = false;
+    // Time welding of the scenes against the std::map reference instead of cooking.
+    bool benchmark_weld = false;
+};
+
+// Cooked asset, one line of the manifest.
+struct CookedAsset
+{
+    std::string type;
+    std::string name;
+    std::string summary;
+    bool        failed = false;
+};
+
+const char* GetFormatName(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::kBC1:
+        return "bc1";
+    case TextureFormat::kBC7:
+        return "bc7";
+    default:
+        return "rgba8";
+    }
+}
+
+bool IsImageFile(const fs::path& path)
+{
+    static const char* kExtensions[] = {".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif"};
+
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+
+    return std::find(std::begin(kExtensions), std::end(kExtensions), extension) !=
+           std::end(kExtensions);
+}
+
+// Relative paths of files under the directory matching the predicate, sorted to keep
+// the output independent of directory enumeration order.
+template <typename F>
+std::vector<fs::path> FindFiles(const fs::path& dir, F&& predicate)
+{
+    std::vector<fs::path> files;
+
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec))
+    {
+        return files;
+    }
+
+    for (auto& entry : fs::recursive_directory_iterator(dir))
+    {
+        if (entry.is_regular_file() && predicate(entry.path()))
+        {
+            files.push_back(entry.path().lexically_relative(dir));
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+fs::path OutputPath(const CookOptions& options, const fs::path& relative_path)
+{
+    auto path = options.output_dir / relative_path;
+    fs::create_directories(path.parent_path());
+    return path;
+}
+
+// Parse, weld, instance, optimize and simplify the scene and write it to a scene cache, which
+// the runtime maps as is.
+void CookScene(const CookOptions& options,
+               const fs::path&    relative_path,
+               CookedAsset&       cooked,
+               tf::Subflow&       subflow)
+{
+    auto file_name = (options.input_dir / relative_path).string();
+
+    ObjData               obj_data;
+    std::vector<MeshData>     meshes;
+    std::vector<MeshInstance> instances;
+    MeshStats                 stats_before, stats_after;
+    GranularityStats          granularity;
+
+    // Exceptions can't leave worker threads, so they are rethrown after the join.
+    std::exception_ptr parse_error;
+
+    auto parse = subflow.emplace([&](tf::Subflow& sf) {
+        try
+        {
+            ParseObjFile(file_name, obj_data, sf);
+        }
+        catch (...)
+        {
+            parse_error = std::current_exception();
+        }
+    });
+    auto weld = subflow.emplace([&](tf::Subflow& sf) {
+        if (!parse_error)
+        {
+            WeldObjShapes(obj_data, meshes, false, sf);
+        }
+    });
+    // Instances take the material of their shape.
+    auto instancing = subflow.emplace([&](tf::Subflow& sf) {
+        if (!parse_error)
+        {
+            LoadObjMaterials(obj_data, (options.input_dir / "").string());
+            for (uint32_t i = 0; i < meshes.size(); ++i)
+            {
+                auto material_id = obj_data.shapes[i].material_id;
+                if (material_id != -1)
+                {
+                    auto& material         = obj_data.materials[static_cast<uint32_t>(material_id)];
+                    meshes[i].texture_name = material.diffuse_texname;
+                }
+            }
+
+            InstanceMeshes(meshes, instances, sf);
+        }
+    });
+    // Cooked caches get the BLAS layout of a runtime load.
+    auto regroup = subflow.emplace([&](tf::Subflow& sf) {
+        if (!parse_error)
+        {
+            OptimizeGranularity(meshes, instances, sf);
+            granularity = AnalyzeGranularity(meshes, instances);
+        }
+    });
+    auto optimize = subflow.emplace([&](tf::Subflow& sf) {
+        if (!parse_error)
+        {
+            OptimizeMeshes(meshes, stats_before, stats_after, sf);
+        }
+    });
+    auto simplify = subflow.emplace([&](tf::Subflow& sf) {
+        if (!parse_error)
+        {
+            GenerateMeshLods(meshes, sf);
+        }
+    });
+
+    parse.precede(weld);
+    weld.precede(instancing);
+    instancing.precede(regroup);
+    regroup.precede(optimize);
+    optimize.precede(simplify);
+    subflow.join();
+
+    if (parse_error)
+    {
+        std::rethrow_exception(parse_error);
+    }
+
+    uint64_t num_triangles = 0;
+    for (auto& instance : instances)
+    {
+        num_triangles += meshes[instance.mesh].indices.size() / 3;
+    }
+
+    // Modification times differ between machines, the runtime falls back to the hash and
+    // records the times of its sources on the first load.
+    auto source  = GetSourceInfo(file_name, true);
+    source.mtime = 0;
+
+    std::vector<SourceInfo> material_lib_sources;
+    for (auto& lib : obj_data.material_libs)
+    {
+        material_lib_sources.push_back(GetDependencyInfo((options.input_dir / lib).string()));
+        material_lib_sources.back().mtime = 0;
+    }
+
+    auto output_file_name = OutputPath(options, relative_path).string();
+    SceneCache::Write(output_file_name,
+                      source,
+                      meshes,
+                      instances,
+                      obj_data.material_libs,
+                      material_lib_sources,
+                      options.compress_indices);
+
+    if (options.chunked)
+    {
+        ChunkedFile::Compress(SceneCache::CacheFileName(output_file_name));
+    }
+
+    info("cook: {} ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}",
+         relative_path.generic_string(),
+         stats_before.acmr(),
+         stats_after.acmr(),
+         stats_before.atvr(),
+         stats_after.atvr(),
+         stats_before.overfetch(),
+         stats_after.overfetch());
+    info("cook: {} {} BLASes, triangles per BLAS {} / {} / {}, traversal cost {:.2f}",
+         relative_path.generic_string(),
+         granularity.blas_count,
+         granularity.min_triangles,
+         granularity.median_triangles,
+         granularity.max_triangles,
+         granularity.traversal_cost);
+
+    cooked.summary = fmt::format(
+        "{} {} {} {:016x}", meshes.size(), instances.size(), num_triangles, source.hash);
+}
+
+// Decode the image, build its mip chain, block compress it and write it as a cooked texture.
+void CookTexture(const CookOptions& options,
+                 const fs::path&    relative_path,
+                 CookedAsset&       cooked,
+                 tf::Subflow&       subflow)
+{
+    auto file_name = (options.input_dir / kTextureDir / relative_path).string();
+
+    ImageData image;
+    if (!LoadImageFile(file_name, image))
+    {
+        error("cook: Couldn't decode {}", file_name);
+        throw std::runtime_error("cook: Couldn't decode " + file_name);
+    }
+
+    GenerateMips(image);
+
+    if (options.texture_format != TextureFormat::kRGBA8)
+    {
+        auto format = options.texture_format == TextureFormat::kBC1 && !IsOpaque(image)
+                          ? TextureFormat::kBC7
+                          : options.texture_format;
+        if (!CompressImage(image, format, options.texture_quality, subflow))
+        {
+            warn("cook: {} is {}x{}, which isn't made of whole blocks, it stays RGBA8",
+                 relative_path.generic_string(),
+                 image.width,
+                 image.height);
+        }
+    }
+
+    // As for scenes, the runtime records the modification time of the source on the first load.
+    auto source  = GetSourceInfo(file_name, true);
+    source.mtime = 0;
+
+    auto output_file_name = OutputPath(options, fs::path(kTextureDir) / relative_path).string();
+    WriteCookedTexture(CookedTextureFileName(output_file_name), source, image);
+
+    if (options.chunked)
+    {
+        ChunkedFile::Compress(CookedTextureFileName(output_file_name));
+    }
+
+    cooked.summary = fmt::format("{} {} {} {} {:016x}",
+                                 image.width,
+                                 image.height,
+                                 image.mips.size(),
+                                 GetFormatName(image.format),
+                                 source.hash);
+}
+
+// Generate the mips of each texture with GenerateMips and GenerateMipsScalar, check both agree
+// and report the times. Textures are processed one at a time, so that timings don't interfere.
+bool BenchmarkMips(const CookOptions& options, const std::vector<fs::path>& textures)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Warm up the conversion tables, so that the first texture isn't charged for them.
+    ImageData warm_up;
+    warm_up.width  = 2;
+    warm_up.height = 2;
+    warm_up.mips   = {std::vector<uint8_t>(16, 0)};
+    GenerateMips(warm_up);
+
+    auto   matched      = true;
+    double scalar_total = 0.0;
+    double simd_total   = 0.0;
+    for (auto& path : textures)
+    {
+        auto      file_name = (options.input_dir / kTextureDir / path).string();
+        ImageData scalar;
+        if (!LoadImageFile(file_name, scalar))
+        {
+            warn("cook: Couldn't decode {}", file_name);
+            continue;
+        }
+        auto simd = scalar;
+
+        auto start = Clock::now();
+        GenerateMipsScalar(scalar);
+        auto scalar_done = Clock::now();
+        GenerateMips(simd);
+        auto simd_done = Clock::now();
+
+        auto scalar_ms = std::chrono::duration<double, std::milli>(scalar_done - start).count();
+        auto simd_ms   = std::chrono::duration<double, std::milli>(simd_done - scalar_done).count();
+        scalar_total += scalar_ms;
+        simd_total += simd_ms;
+
+        if (scalar.mips != simd.mips)
+        {
+            error("cook: {} mips differ from the scalar reference", path.generic_string());
+            matched = false;
+        }
+
+        info("cook: {} {}x{} mips in {:.2f} ms, scalar {:.2f} ms",
+             path.generic_string(),
+             scalar.width,
+             scalar.height,
+             simd_ms,
+             scalar_ms);
+    }
+
+    info("cook: {} textures, mips in {:.2f} ms, scalar {:.2f} ms, {:.2f}x",
+         textures.size(),
+         simd_total,
+         scalar_total,
+         simd_total > 0.0 ? scalar_total / simd_total : 0.0);
+    return matched;
+}
+
+// Block compress the mip chain of each texture to BC1 and BC7, with all threads on one texture
+// at a time, and report throughput and PSNR of mip 0 against the source.
+bool BenchmarkCompression(const CookOptions& options, const std::vector<fs::path>& textures)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    tf::Executor executor(options.num_threads);
+
+    TextureFormat formats[]        = {TextureFormat::kBC1, TextureFormat::kBC7};
+    double        total_seconds[2] = {};
+    double        total_psnr[2]    = {};
+    uint64_t      total_texels     = 0;
+    uint32_t      compressed_count = 0;
+    auto          decoded          = true;
+
+    for (auto& path : textures)
+    {
+        auto      file_name = (options.input_dir / kTextureDir / path).string();
+        ImageData source;
+        if (!LoadImageFile(file_name, source))
+        {
+            warn("cook: Couldn't decode {}", file_name);
+            continue;
+        }
+
+        GenerateMips(source);
+
+        uint64_t texels = 0;
+        for (uint32_t level = 0; level < source.mips.size(); ++level)
+        {
+            texels += source.mips[level].size() / 4;
+        }
+
+        double seconds[2] = {};
+        double psnr[2]    = {};
+        auto   skipped    = false;
+        for (uint32_t f = 0; f < 2; ++f)
+        {
+            auto image      = source;
+            auto compressed = false;
+
+            tf::Taskflow taskflow;
+            taskflow.emplace([&](tf::Subflow& subflow) {
+                compressed = CompressImage(image, formats[f], options.texture_quality, subflow);
+            });
+
+            auto start = Clock::now();
+            executor.run(taskflow).wait();
+            seconds[f] = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (!compressed)
+            {
+                skipped = true;
+                break;
+            }
+
+            if (!DecompressImage(image))
+            {
+                error("cook: {} doesn't decompress", path.generic_string());
+                decoded = false;
+            }
+            psnr[f] = ComputePsnr(source, image);
+        }
+
+        if (skipped)
+        {
+            warn("cook: {} isn't made of whole blocks, skipped", path.generic_string());
+            continue;
+        }
+
+        info("cook: {} {}x{} BC1 {:.1f} Mtexels/s {:.2f} dB, BC7 {:.1f} Mtexels/s {:.2f} dB",
+             path.generic_string(),
+             source.width,
+             source.height,
+             static_cast<double>(texels) / seconds[0] * 1e-6,
+             psnr[0],
+             static_cast<double>(texels) / seconds[1] * 1e-6,
+             psnr[1]);
+
+        for (uint32_t f = 0; f < 2; ++f)
+        {
+            total_seconds[f] += seconds[f];
+            total_psnr[f] += psnr[f];
+        }
+        total_texels += texels;
+        ++compressed_count;
+    }
+
+    if (compressed_count > 0)
+    {
+        info("cook: {} textures, BC1 {:.1f} Mtexels/s {:.2f} dB, BC7 {:.1f} Mtexels/s {:.2f} dB",
+             compressed_count,
+             static_cast<double>(total_texels) / total_seconds[0] * 1e-6,
+             total_psnr[0] / compressed_count,
+             static_cast<double>(total_texels) / total_seconds[1] * 1e-6,
+             total_psnr[1] / compressed_count);
+    }
+
+    return decoded;
+}
+
+// Weld the shapes of each scene with WeldObjShapes and WeldObjShapesReference, check both
+// produce the same meshes and report their throughput in corners per second.
+bool BenchmarkWeld(const CookOptions& options, const std::vector<fs::path>& scenes)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    tf::Executor executor(options.num_threads);
+
+    auto     matched         = true;
+    double   total_seconds   = 0.0;
+    double   total_reference = 0.0;
+    uint64_t total_corners   = 0;
+    for (auto& path : scenes)
+    {
+        auto    file_name = (options.input_dir / path).string();
+        ObjData obj_data;
+
+        tf::Taskflow parse;
+        parse.emplace([&](tf::Subflow& subflow) { ParseObjFile(file_name, obj_data, subflow); });
+        executor.run(parse).wait();
+
+        std::vector<MeshData> meshes;
+        tf::Taskflow          weld;
+        weld.emplace([&](tf::Subflow& subflow) {
+            WeldObjShapes(obj_data, meshes, false, subflow);
+        });
+
+        auto start = Clock::now();
+        executor.run(weld).wait();
+        auto weld_done = Clock::now();
+
+        std::vector<MeshData> reference;
+        WeldObjShapesReference(obj_data, reference);
+        auto reference_done = Clock::now();
+
+        auto seconds           = std::chrono::duration<double>(weld_done - start).count();
+        auto reference_seconds = std::chrono::duration<double>(reference_done - weld_done).count();
+        auto corners           = obj_data.indices.size();
+        total_seconds += seconds;
+        total_reference += reference_seconds;
+        total_corners += corners;
+
+        for (std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            if (meshes[i].indices != reference[i].indices ||
+                meshes[i].positions != reference[i].positions ||
+                meshes[i].normals != reference[i].normals ||
+                meshes[i].texcoords != reference[i].texcoords)
+            {
+                error("cook: {} shape {} differs from the std::map reference",
+                      path.generic_string(),
+                      i);
+                matched = false;
+                break;
+            }
+        }
+
+        info("cook: {} {} corners welded at {:.1f} Mcorners/s, std::map {:.1f} Mcorners/s",
+             path.generic_string(),
+             corners,
+             static_cast<double>(corners) / seconds * 1e-6,
+             static_cast<double>(corners) / reference_seconds * 1e-6);
+    }
+
+    if (total_seconds > 0.0)
+    {
+        info("cook: {} scenes, {:.1f} Mcorners/s, std::map {:.1f} Mcorners/s, {:.2f}x",
+             scenes.size(),
+             static_cast<double>(total_corners) / total_seconds * 1e-6,
+             static_cast<double>(total_corners) / total_reference * 1e-6,
+             total_reference / total_seconds);
+    }
+
+    return matched;
+}
+
+void WriteManifest(const CookOptions& options, const std::vector<CookedAsset>& assets)
+{
+    auto file_name = (options.output_dir / kManifestFileName).string();
+
+    std::ofstream out(file_name, std::ios::trunc);
+    out << "# capsaicin cooked assets v3\n";
+    out << "# scene <file> <meshes> <instances> <triangles> <source hash>\n";
+    out << "# texture <file> <width> <height> <mips> <format> <source hash>\n";
+
+    for (auto& asset : assets)
+    {
+        if (!asset.failed)
+        {
+            out << asset.type << ' ' << asset.name << ' ' << asset.summary << '\n';
+        }
+    }
+
+    if (!out)
+    {
+        error("cook: Couldn't write {}", file_name);
+        throw std::runtime_error("cook: Couldn't write " + file_name);
+    }
+}
+
+bool ParseOptions(int argc, char** argv, CookOptions& options)
+{
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-j" || arg == "--threads") && i + 1 < argc)
+        {
+            options.num_threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--compress-indices")
+        {
+            options.compress_indices = true;
+        }
+        else if (arg == "--chunked")
+        {
+            options.chunked = true;
+        }
+        else if (arg == "--compress" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "bc1")
+            {
+                options.texture_format = TextureFormat::kBC1;
+            }
+            else if (format == "bc7")
+            {
+                options.texture_format = TextureFormat::kBC7;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (arg == "--quality" && i + 1 < argc)
+        {
+            std::string quality = argv[++i];
+            if (quality == "fast")
+            {
+                options.texture_quality = BlockQuality::kFast;
+            }
+            else if (quality == "normal")
+            {
+                options.texture_quality = BlockQuality::kNormal;
+            }
+            else if (quality == "high")
+            {
+                options.texture_quality = BlockQuality::kHigh;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (arg == "--benchmark-mips")
+        {
+            options.benchmark_mips = true;
+        }
+        else if (arg == "--benchmark-compression")
+        {
+            options.benchmark_compression = true;
+        }
+        else if (arg == "--benchmark-weld")
+        {
+            options.benchmark_weld = true;
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    // Benchmarks write nothing, so they don't take an output directory.
+    auto benchmark =
+        options.benchmark_mips || options.benchmark_compression || options.benchmark_weld;
+    if (positional.size() != (benchmark ? 1 : 2))
+    {
+        return false;
+    }
+
+    options.input_dir = positional[0];
+    if (!benchmark)
+    {
+        options.output_dir = positional[1];
+    }
+    return true;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    CookOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: cook <input dir> <output dir> [-j <threads>] [--compress-indices]\n"
+                     "       [--chunked] [--compress bc1|bc7] [--quality fast|normal|high]\n"
+                     "       cook <input dir> --benchmark-mips\n"
+                     "       cook <input dir> --benchmark-compression [-j <threads>]\n"
+                     "       [--quality fast|normal|high]\n"
+                     "       cook <input dir> --benchmark-weld [-j <threads>]\n";
+        return 1;
+    }
+
+    if (options.num_threads == 0)
+    {
+        options.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    try
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        auto scenes = FindFiles(options.input_dir,
+                                [](const fs::path& path) { return path.extension() == ".obj"; });
+        auto textures = FindFiles(options.input_dir / kTextureDir, IsImageFile);
+
+        if (options.benchmark_mips)
+        {
+            return BenchmarkMips(options, textures) ? 0 : 1;
+        }
+
+        if (options.benchmark_compression)
+        {
+            return BenchmarkCompression(options, textures) ? 0 : 1;
+        }
+
+        if (options.benchmark_weld)
+        {
+            return BenchmarkWeld(options, scenes) ? 0 : 1;
+        }
+
+        info("cook: {} scenes, {} textures, {} threads",
+             scenes.size(),
+             textures.size(),
+             options.num_threads);
+
+        // Manifest order is scenes then textures, both sorted by path.
+        std::vector<CookedAsset> assets(scenes.size() + textures.size());
+
+        tf::Executor executor(options.num_threads);
+        tf::Taskflow taskflow;
+
+        for (uint32_t i = 0; i < scenes.size(); ++i)
+        {
+            auto& cooked = assets[i];
+            cooked.type  = "scene";
+            cooked.name  = scenes[i].generic_string();
+
+            taskflow.emplace([&options, &cooked, &path = scenes[i]](tf::Subflow& subflow) {
+                try
+                {
+                    info("cook: Cooking {}", cooked.name);
+                    CookScene(options, path, cooked, subflow);
+                }
+                catch (std::exception& e)
+                {
+                    error("cook: {} failed: {}", cooked.name, e.what());
+                    cooked.failed = true;
+                }
+            });
+        }
+
+        for (uint32_t i = 0; i < textures.size(); ++i)
+        {
+            auto& cooked = assets[scenes.size() + i];
+            cooked.type  = "texture";
+            cooked.name  = (fs::path(kTextureDir) / textures[i]).generic_string();
+
+            taskflow.emplace([&options, &cooked, &path = textures[i]](tf::Subflow& subflow) {
+                try
+                {
+                    CookTexture(options, path, cooked, subflow);
+                }
+                catch (std::exception& e)
+                {
+                    error("cook: {} failed: {}", cooked.name, e.what());
+                    cooked.failed = true;
+                }
+            });
+        }
+
+        executor.run(taskflow).wait();
+
+        fs::create_directories(options.output_dir);
+        WriteManifest(options, assets);
+
+        auto num_failed = std::count_if(
+            assets.cbegin(), assets.cend(), [](const CookedAsset& a) { return a.failed; });
+
+        info("cook: Done in {} s, {} failed",
+             std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start)
+                 .count(),
+             num_failed);
+
+        return num_failed == 0 ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        error("cook: {}", e.what());
+        return 1;
+    }
+}
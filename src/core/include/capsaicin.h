@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <future>
+#include <memory>
 #include <string>
 
 // Backend specific stuff
@@ -24,9 +27,37 @@ using std::uint32_t;
 
 namespace capsaicin
 {
+// Progress of a scene loading in the background, updated as its meshes become visible.
+struct LoadProgress
+{
+    // Instances in the scene, zero until the scene is parsed.
+    std::atomic<uint32_t> instance_count{0};
+    // Instances uploaded and rendered.
+    std::atomic<uint32_t> visible_count{0};
+
+    float fraction() const
+    {
+        auto count = instance_count.load();
+        return count == 0 ? 0.f : float(visible_count.load()) / count;
+    }
+};
+
+struct SceneLoad
+{
+    uint32_t                            id = 0;
+    std::shared_ptr<const LoadProgress> progress;
+    // Ready once the whole scene is visible, holds the exception if loading failed.
+    std::shared_future<void> completion;
+};
+
 void Init();
 void InitRenderSession(void* params);
-void LoadSceneFromOBJ(const std::string& file_name);
+// Start loading the scene in the background, it appears in batches over the next frames.
+// OBJ, glTF and GLB files are told apart by their extension.
+SceneLoad LoadScene(const std::string& file_name);
+SceneLoad LoadSceneFromOBJ(const std::string& file_name);
+// Remove the scene and free its geometry, a scene which is still loading fails to load.
+void UnloadScene(const SceneLoad& scene);
 void ProcessInput(void* input);
 void Update(float time_ms);
 void Render();
@@ -62,6 +62,12 @@ RayDesc CreatePrimaryRay(in uint2 xy, in uint2 dim)
     return my_ray;
 }
 
+// Angle between the rays of neighbouring pixels, the spread of ray cones from the camera.
+float PixelSpreadAngle(in uint2 dim)
+{
+    return atan(g_camera.sensor_size.y / (dim.y * g_camera.focal_length));
+}
+
 float3 ReconstructWorldPosition(in float2 uv, in float depth, in uint2 dims)
 {
     uint2 frame_buffer_size = dims;
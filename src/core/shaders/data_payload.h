@@ -4,6 +4,18 @@
 
 #define INVALID_ID ~0u
 
+// Virtual texture pages, see virtual_texture.h.
+#define PAGE_TEXELS 120
+#define PAGE_BORDER 4
+#define PAGE_SLOT_SIZE 128
+#define INVALID_PAGE ~0u
+#define UNMAPPED_ENTRY ~0u
+#define FEEDBACK_TILE_SIZE 4
+
+// Streamed texture feedback, see texture_residency.h.
+#define FEEDBACK_LOD_BIAS 32.f
+#define FEEDBACK_LOD_SCALE 256.f
+
 struct Camera
 {
     float3  position;
@@ -26,7 +38,24 @@ struct Mesh
 
     uint    index;
     uint    texture_index;
-    uint2   padding;
+
+    float3  bounds_min;
+    float3  bounds_max;
+
+    uint    index_stride;
+    uint    geometry;
+    float   bounds_radius;
+    uint    lod;
+
+    float4  transform[3];
+};
+
+struct VirtualTexture
+{
+    uint    width;
+    uint    height;
+    uint    mip_count;
+    uint    page_table_offset;
 };
 
 
@@ -17,10 +17,24 @@ RaytracingAccelerationStructure g_scene : register(t0);
 Texture2D<float4> g_blue_noise : register(t1);
 SamplerState g_sampler : register(s0);
 Texture2D<float4> g_textures[] : register(t2);
+#ifdef VIRTUAL_TEXTURES
+Texture2D<float4> g_page_atlas : register(t0, space1);
+StructuredBuffer<uint> g_page_table : register(t1, space1);
+StructuredBuffer<VirtualTexture> g_virtual_textures : register(t2, space1);
+#endif
+#if defined(VIRTUAL_TEXTURES) || defined(TEXTURE_STREAMING)
+RWBuffer<uint> g_page_feedback : register(u0, space1);
+#endif
 RWBuffer<uint> g_index_buffer : register(u0);
+#ifdef QUANTIZED_VERTICES
+RWBuffer<uint> g_vertex_buffer : register(u1);
+RWBuffer<uint> g_normal_buffer : register(u2);
+RWBuffer<uint> g_texcoord_buffer : register(u3);
+#else
 RWBuffer<float> g_vertex_buffer : register(u1);
 RWBuffer<float> g_normal_buffer : register(u2);
 RWBuffer<float2> g_texcoord_buffer : register(u3);
+#endif
 RWStructuredBuffer<Mesh> g_mesh_buffer : register(u4);
 RWTexture2D<float4> g_gbuffer_geo : register(u5);
 RWTexture2D<float4> g_output_direct : register(u6);
@@ -34,6 +48,23 @@ RWTexture2D<float4> g_output_normal_depth: register(u8);
 #include "scene.h"
 #include "shading.h"
 
+#if defined(VIRTUAL_TEXTURES) || defined(TEXTURE_STREAMING)
+// One pixel of each feedback tile records the page or LOD it samples, a different one each frame,
+// so that all pixels of a tile are covered every FEEDBACK_TILE_SIZE^2 frames.
+void WritePageFeedback(in uint2 xy, in uint2 dims, in uint page)
+{
+    uint k = (g_constants.frame_count * 7) % (FEEDBACK_TILE_SIZE * FEEDBACK_TILE_SIZE);
+    if (any(xy % FEEDBACK_TILE_SIZE != uint2(k % FEEDBACK_TILE_SIZE, k / FEEDBACK_TILE_SIZE)))
+    {
+        return;
+    }
+
+    uint2 tile = xy / FEEDBACK_TILE_SIZE;
+    uint tiles_x = (dims.x + FEEDBACK_TILE_SIZE - 1) / FEEDBACK_TILE_SIZE;
+    g_page_feedback[tile.y * tiles_x + tile.x] = page;
+}
+#endif
+
 [shader("raygeneration")]
 void CalculateDirectLighting()
 {
@@ -52,6 +83,9 @@ void CalculateDirectLighting()
     // If this is not a valid primary hit, output background color.
     if (instance_index == INVALID_ID)
     {
+#if defined(VIRTUAL_TEXTURES) || defined(TEXTURE_STREAMING)
+        WritePageFeedback(xy, dims, INVALID_PAGE);
+#endif
         g_output_direct[xy]         = float4(0.7f, 0.7f, 0.85f, 1.f);
         g_output_albedo[xy]         = 1.f;
         g_output_normal_depth[xy]   = 0.f;
@@ -61,9 +95,18 @@ void CalculateDirectLighting()
     // Otherwise reconstruct world space position, normal and texture coordinates.
     float3 p, n;
     float2 tx;
-    InterpolateAttributes(instance_index, prim_index, uv, p, n, tx);
+    float lod;
+    InterpolateAttributes(instance_index, prim_index, uv, p, n, tx, lod);
 
-    float3 kd = GetMaterial(instance_index, tx);
+    // The cone of the pixel widens with the distance from the camera.
+    float cone_width = length(p - primary_ray.Origin) * PixelSpreadAngle(dims);
+    float cone_lod = ConeLod(lod, cone_width, n, primary_ray.Direction);
+    float3 kd = GetMaterial(instance_index, tx, cone_lod);
+#ifdef VIRTUAL_TEXTURES
+    WritePageFeedback(xy, dims, GetFeedbackPage(instance_index, tx, cone_lod));
+#elif defined(TEXTURE_STREAMING)
+    WritePageFeedback(xy, dims, GetFeedbackLod(instance_index, cone_lod));
+#endif
 
     if (all(kd < 1e-5f))
     {
@@ -1,6 +1,9 @@
 // clang-format off
 #include "data_payload.h"
 
+// Spread angle of rays sampling a diffuse lobe, which blurs textures of indirect hits.
+#define DIFFUSE_CONE_SPREAD 0.1f
+
 typedef BuiltInTriangleIntersectionAttributes MyAttributes;
 
 struct Constants
@@ -25,10 +28,21 @@ RaytracingAccelerationStructure g_scene : register(t0);
 Texture2D<float4> g_blue_noise : register(t1);
 SamplerState g_sampler : register(s0);
 Texture2D<float4> g_textures[] : register(t2);
+#ifdef VIRTUAL_TEXTURES
+Texture2D<float4> g_page_atlas : register(t0, space1);
+StructuredBuffer<uint> g_page_table : register(t1, space1);
+StructuredBuffer<VirtualTexture> g_virtual_textures : register(t2, space1);
+#endif
 RWBuffer<uint> g_index_buffer : register(u0);
+#ifdef QUANTIZED_VERTICES
+RWBuffer<uint> g_vertex_buffer : register(u1);
+RWBuffer<uint> g_normal_buffer : register(u2);
+RWBuffer<uint> g_texcoord_buffer : register(u3);
+#else
 RWBuffer<float> g_vertex_buffer : register(u1);
 RWBuffer<float> g_normal_buffer : register(u2);
 RWBuffer<float2> g_texcoord_buffer : register(u3);
+#endif
 RWStructuredBuffer<Mesh> g_mesh_buffer : register(u4);
 RWTexture2D<float4> g_gbuffer_geo : register(u5);
 RWTexture2D<float4> g_color_history : register(u6);
@@ -88,6 +102,11 @@ void CalculateIndirectDiffuseLighting()
     payload.prim_index     = prim_index;
     payload.uv             = uv;
 
+    // Ray cone of the path, which starts with the spread of a pixel and widens to the one of
+    // diffuse lobes after the first bounce.
+    float cone_width = 0.f;
+    float cone_spread = PixelSpreadAngle(fullres_dims);
+
     for (uint bounce = 0; bounce <= g_constants.num_bounces; ++bounce)
     {
         // The ray missed geometry.
@@ -100,9 +119,13 @@ void CalculateIndirectDiffuseLighting()
 
         float3 p, n;
         float2 tx;
-        InterpolateAttributes(payload.instance_index, payload.prim_index, payload.uv, p, n, tx);
+        float lod;
+        InterpolateAttributes(payload.instance_index, payload.prim_index, payload.uv, p, n, tx, lod);
+
+        cone_width += length(p - ray.Origin) * cone_spread;
+        cone_spread = max(cone_spread, DIFFUSE_CONE_SPREAD);
 
-        float3 kd = GetMaterial(payload.instance_index, tx);
+        float3 kd = GetMaterial(payload.instance_index, tx, ConeLod(lod, cone_width, n, ray.Direction));
 
         // If no contribution possible, bail out.
         if (all(kd < 1e-5f))
@@ -2,60 +2,273 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+// Word addresses of vertex attributes. Interleaved vertices keep all attributes in
+// the records of the vertex buffer, see vertex_layout.h.
+#ifdef INTERLEAVED_VERTICES
+#define NORMAL_BUFFER g_vertex_buffer
+#define TEXCOORD_BUFFER g_vertex_buffer
+#ifdef QUANTIZED_VERTICES
+#define POSITION_WORD(v) (4 * (v))
+#define NORMAL_WORD(v) (4 * (v) + 2)
+#define TEXCOORD_WORD(v) (4 * (v) + 3)
+#else
+#define POSITION_WORD(v) (8 * (v))
+#define NORMAL_WORD(v) (8 * (v) + 3)
+#define TEXCOORD_WORD(v) (8 * (v) + 6)
+#endif
+#else
+#define NORMAL_BUFFER g_normal_buffer
+#define TEXCOORD_BUFFER g_texcoord_buffer
+#ifdef QUANTIZED_VERTICES
+#define POSITION_WORD(v) (2 * (v))
+#define NORMAL_WORD(v) (v)
+#define TEXCOORD_WORD(v) (v)
+#else
+#define POSITION_WORD(v) (3 * (v))
+#define NORMAL_WORD(v) (3 * (v))
+#endif
+#endif
+
+#ifdef QUANTIZED_VERTICES
+float DecodeSnorm16(in uint v)
+{
+    return max(float(int(v << 16) >> 16) / 32767.f, -1.f);
+}
+
+// Positions are snorm16 relative to the mesh bounds, normals are octahedral unorm16 and
+// texcoords are halves, see vertex_quantization.h.
+float3 FetchPosition(in Mesh mesh, in uint i)
+{
+    uint vo = POSITION_WORD(mesh.first_vertex_offset + i);
+    uint xy = g_vertex_buffer[vo];
+    uint zw = g_vertex_buffer[vo + 1];
+
+    float3 q = float3(DecodeSnorm16(xy), DecodeSnorm16(xy >> 16), DecodeSnorm16(zw));
+    float3 center = 0.5f * (mesh.bounds_min + mesh.bounds_max);
+    float3 half_extent = 0.5f * (mesh.bounds_max - mesh.bounds_min);
+    return center + q * half_extent;
+}
+
+float3 FetchNormal(in Mesh mesh, in uint i)
+{
+    uint n = NORMAL_BUFFER[NORMAL_WORD(mesh.first_vertex_offset + i)];
+    return OctDecode(float2(n & 0xffff, n >> 16) / 65535.f);
+}
+
+float2 FetchTexcoord(in Mesh mesh, in uint i)
+{
+    uint t = TEXCOORD_BUFFER[TEXCOORD_WORD(mesh.first_vertex_offset + i)];
+    return float2(f16tof32(t), f16tof32(t >> 16));
+}
+#else
+float3 FetchPosition(in Mesh mesh, in uint i)
+{
+    uint vo = POSITION_WORD(mesh.first_vertex_offset + i);
+    return float3(g_vertex_buffer[vo], g_vertex_buffer[vo + 1], g_vertex_buffer[vo + 2]);
+}
+
+float3 FetchNormal(in Mesh mesh, in uint i)
+{
+    uint vo = NORMAL_WORD(mesh.first_vertex_offset + i);
+    return float3(NORMAL_BUFFER[vo], NORMAL_BUFFER[vo + 1], NORMAL_BUFFER[vo + 2]);
+}
+
+float2 FetchTexcoord(in Mesh mesh, in uint i)
+{
+#ifdef INTERLEAVED_VERTICES
+    uint vo = TEXCOORD_WORD(mesh.first_vertex_offset + i);
+    return float2(g_vertex_buffer[vo], g_vertex_buffer[vo + 1]);
+#else
+    return g_texcoord_buffer[mesh.first_vertex_offset + i];
+#endif
+}
+#endif
+
+// 16-bit indices are packed in pairs, low half first.
+uint FetchIndex(in Mesh mesh, in uint i)
+{
+    if (mesh.index_stride == 2)
+    {
+        uint w = g_index_buffer[mesh.first_index_offset + (i >> 1)];
+        return (i & 1) ? (w >> 16) : (w & 0xffff);
+    }
+
+    return g_index_buffer[mesh.first_index_offset + i];
+}
+
+// The texture LOD is the texel to world space area ratio of the triangle, for a one texel
+// texture and a unit footprint, see ray cones in Ray Tracing Gems chapter 20.
 void InterpolateAttributes(in uint instance_index,
                            in uint prim_index,
                            in float2 uv,
                            out float3 p,
                            out float3 n,
-                           out float2 tx)
+                           out float2 tx,
+                           out float lod)
 {
     Mesh mesh = g_mesh_buffer[instance_index];
 
-    uint io = mesh.first_index_offset;
-    uint i0 = g_index_buffer[io + 3 * prim_index + 0];
-    uint i1 = g_index_buffer[io + 3 * prim_index + 1];
-    uint i2 = g_index_buffer[io + 3 * prim_index + 2];
-
-    uint vo = mesh.first_vertex_offset * 3;
-
-    float3 v0 = float3(g_vertex_buffer[vo + 3 * i0],
-                       g_vertex_buffer[vo + 3 * i0 + 1],
-                       g_vertex_buffer[vo + 3 * i0 + 2]);
-    float3 v1 = float3(g_vertex_buffer[vo + 3 * i1],
-                       g_vertex_buffer[vo + 3 * i1 + 1],
-                       g_vertex_buffer[vo + 3 * i1 + 2]);
-    float3 v2 = float3(g_vertex_buffer[vo + 3 * i2],
-                       g_vertex_buffer[vo + 3 * i2 + 1],
-                       g_vertex_buffer[vo + 3 * i2 + 2]);
-
-    float3 n0 = float3(g_normal_buffer[vo + 3 * i0],
-                       g_normal_buffer[vo + 3 * i0 + 1],
-                       g_normal_buffer[vo + 3 * i0 + 2]);
-    float3 n1 = float3(g_normal_buffer[vo + 3 * i1],
-                       g_normal_buffer[vo + 3 * i1 + 1],
-                       g_normal_buffer[vo + 3 * i1 + 2]);
-    float3 n2 = float3(g_normal_buffer[vo + 3 * i2],
-                       g_normal_buffer[vo + 3 * i2 + 1],
-                       g_normal_buffer[vo + 3 * i2 + 2]);
-
-    vo = mesh.first_vertex_offset;
-
-    float2 t0 = g_texcoord_buffer[vo + i0];
-    float2 t1 = g_texcoord_buffer[vo + i1];
-    float2 t2 = g_texcoord_buffer[vo + i2];
+    uint i0 = FetchIndex(mesh, 3 * prim_index + 0);
+    uint i1 = FetchIndex(mesh, 3 * prim_index + 1);
+    uint i2 = FetchIndex(mesh, 3 * prim_index + 2);
+
+    float3 v0 = FetchPosition(mesh, i0);
+    float3 v1 = FetchPosition(mesh, i1);
+    float3 v2 = FetchPosition(mesh, i2);
+
+    float3 n0 = FetchNormal(mesh, i0);
+    float3 n1 = FetchNormal(mesh, i1);
+    float3 n2 = FetchNormal(mesh, i2);
+
+    float2 t0 = FetchTexcoord(mesh, i0);
+    float2 t1 = FetchTexcoord(mesh, i1);
+    float2 t2 = FetchTexcoord(mesh, i2);
 
     n   = normalize(n0 * (1.f - uv.x - uv.y) + n1 * uv.x + n2 * uv.y);
     p   = v0 * (1.f - uv.x - uv.y) + v1 * uv.x + v2 * uv.y;
     tx  = t0 * (1.f - uv.x - uv.y) + t1 * uv.x + t2 * uv.y;
+
+    // Similarity transforms scale areas by the squared length of a row.
+    float texel_area = abs((t1.x - t0.x) * (t2.y - t0.y) - (t2.x - t0.x) * (t1.y - t0.y));
+    float scale2     = dot(mesh.transform[0].xyz, mesh.transform[0].xyz);
+    float world_area = length(cross(v1 - v0, v2 - v0)) * scale2;
+    lod = 0.5f * log2(max(texel_area, 1e-20f) / max(world_area, 1e-20f));
+
+    // Instance transforms are similarity transforms, so normals take the linear part.
+    p   = float3(dot(mesh.transform[0], float4(p, 1.f)),
+                 dot(mesh.transform[1], float4(p, 1.f)),
+                 dot(mesh.transform[2], float4(p, 1.f)));
+    n   = normalize(float3(dot(mesh.transform[0].xyz, n),
+                           dot(mesh.transform[1].xyz, n),
+                           dot(mesh.transform[2].xyz, n)));
+}
+
+// Texture LOD of a ray cone of the width at the hit, grazing hits cover more texels.
+float ConeLod(in float lod, in float cone_width, in float3 n, in float3 d)
+{
+    return lod + log2(max(cone_width, 1e-20f) / max(abs(dot(n, d)), 1e-3f));
+}
+
+#ifdef VIRTUAL_TEXTURES
+uint2 GetMipSize(in VirtualTexture texture, in uint mip)
+{
+    return max(uint2(texture.width, texture.height) >> mip, 1u);
+}
+
+uint2 GetPageCount(in uint2 size)
+{
+    return (size + PAGE_TEXELS - 1) / PAGE_TEXELS;
+}
+
+// Mip the LOD of a texture of one texel falls in, the last paged mip at most.
+uint GetPageMip(in VirtualTexture texture, in float lod)
+{
+    lod += 0.5f * log2(float(texture.width) * float(texture.height));
+    return min(uint(max(lod, 0.f)), texture.mip_count - 1);
+}
+
+// Page of the mip the texture coordinates fall in, textures wrap.
+uint2 GetPage(in VirtualTexture texture, in uint mip, in float2 tx)
+{
+    uint2 size = GetMipSize(texture, mip);
+    return min(uint2(frac(tx) * size) / PAGE_TEXELS, GetPageCount(size) - 1);
+}
+
+// Sample the page from the slot of its page table entry, which holds the page itself or its
+// nearest resident ancestor. Textures without a resident page sample as black.
+float3 SampleVirtualTexture(in uint texture_index, in float2 tx, in float lod)
+{
+    VirtualTexture texture = g_virtual_textures[texture_index];
+    if (texture.width == 0)
+    {
+        return 0.f;
+    }
+
+    uint mip    = GetPageMip(texture, lod);
+    uint offset = texture.page_table_offset;
+    for (uint m = 0; m < mip; ++m)
+    {
+        uint2 count = GetPageCount(GetMipSize(texture, m));
+        offset += count.x * count.y;
+    }
+
+    uint2 page  = GetPage(texture, mip, tx);
+    uint  entry = g_page_table[offset + page.y * GetPageCount(GetMipSize(texture, mip)).x + page.x];
+    if (entry == UNMAPPED_ENTRY)
+    {
+        return 0.f;
+    }
+
+    // Texel position within the page in the slot, at the mip of that page.
+    uint   slot_mip = entry >> 24;
+    uint   slot     = entry & 0xffffff;
+    float2 texel    = frac(tx) * GetMipSize(texture, slot_mip) -
+                      GetPage(texture, slot_mip, tx) * PAGE_TEXELS;
+
+    float width, height;
+    g_page_atlas.GetDimensions(width, height);
+    uint   slots_per_row = uint(width) / PAGE_SLOT_SIZE;
+    float2 origin        = float2(slot % slots_per_row, slot / slots_per_row) * PAGE_SLOT_SIZE;
+    origin += PAGE_BORDER;
+    return g_page_atlas.SampleLevel(g_sampler, (origin + texel) / float2(width, height), 0.f).xyz;
+}
+
+// Page the material of the hit samples, packed as in virtual_texture.h.
+uint GetFeedbackPage(in uint instance_index, in float2 tx, in float lod)
+{
+    Mesh mesh = g_mesh_buffer[instance_index];
+    if (mesh.texture_index == INVALID_ID)
+    {
+        return INVALID_PAGE;
+    }
+
+    VirtualTexture texture = g_virtual_textures[mesh.texture_index];
+    if (texture.width == 0)
+    {
+        return INVALID_PAGE;
+    }
+
+    tx.y = 1.f - tx.y;
+    uint  mip  = GetPageMip(texture, lod);
+    uint2 page = GetPage(texture, mip, tx);
+    return (mesh.texture_index << 20) | (mip << 16) | (page.y << 8) | page.x;
+}
+#endif
+
+#ifdef TEXTURE_STREAMING
+// LOD the material of the hit samples at, for a texture of one texel, which doesn't depend on
+// the mips resident. Packed with the texture as in texture_residency.h.
+uint GetFeedbackLod(in uint instance_index, in float lod)
+{
+    Mesh mesh = g_mesh_buffer[instance_index];
+    if (mesh.texture_index == INVALID_ID)
+    {
+        return INVALID_PAGE;
+    }
+
+    float biased = clamp(lod + FEEDBACK_LOD_BIAS, 0.f, 255.f);
+    return (mesh.texture_index << 20) | uint(biased * FEEDBACK_LOD_SCALE);
 }
+#endif
 
-float3 GetMaterial(in uint instance_index, in float2 tx)
+// The LOD is the one of InterpolateAttributes widened by ConeLod, the texture size is added
+// here, so that incoherent hits read mips which fit their footprint.
+float3 GetMaterial(in uint instance_index, in float2 tx, in float lod)
 {
     Mesh mesh = g_mesh_buffer[instance_index];
     tx.y = 1.f - tx.y;
-    float3 kd = (mesh.texture_index == INVALID_ID)
-                ? 0.75f
-                : g_textures[NonUniformResourceIndex(mesh.texture_index)].SampleLevel(g_sampler, tx, 0);
+    float3 kd = 0.75f;
+    if (mesh.texture_index != INVALID_ID)
+    {
+#ifdef VIRTUAL_TEXTURES
+        kd = SampleVirtualTexture(mesh.texture_index, tx, lod);
+#else
+        Texture2D<float4> albedo = g_textures[NonUniformResourceIndex(mesh.texture_index)];
+        float width, height;
+        albedo.GetDimensions(width, height);
+        kd = albedo.SampleLevel(g_sampler, tx, lod + 0.5f * log2(max(width * height, 1.f))).xyz;
+#endif
+    }
     kd = pow(kd, 2.2f);
     return kd;
 }
@@ -0,0 +1,694 @@
+#include "blas_granularity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+// Costs in BVH node visits. Entering an instance transforms the ray and restarts the
+// traversal in its BLAS, which costs about as much as a few nodes.
+constexpr double kNodeCost     = 1.0;
+constexpr double kInstanceCost = 4.0;
+// Split clusters have at least this many triangles, smaller meshes may be merged.
+constexpr uint32_t kMinClusterTriangles = 4096;
+// Larger clusters are split even if that doesn't lower the cost, which bounds the memory of
+// a BLAS build.
+constexpr uint32_t kMaxClusterTriangles = 1u << 20;
+// Merged meshes still fit 16-bit indices.
+constexpr uint32_t kMaxMergedVertices = 65536;
+constexpr uint32_t kSplitBins         = 16;
+constexpr uint32_t kMortonBits        = 10;
+
+struct Aabb
+{
+    float min[3] = {std::numeric_limits<float>::max(),
+                    std::numeric_limits<float>::max(),
+                    std::numeric_limits<float>::max()};
+    float max[3] = {std::numeric_limits<float>::lowest(),
+                    std::numeric_limits<float>::lowest(),
+                    std::numeric_limits<float>::lowest()};
+
+    void Grow(const float* point)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            min[c] = std::min(min[c], point[c]);
+            max[c] = std::max(max[c], point[c]);
+        }
+    }
+
+    void Grow(const Aabb& other)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            min[c] = std::min(min[c], other.min[c]);
+            max[c] = std::max(max[c], other.max[c]);
+        }
+    }
+
+    bool empty() const { return min[0] > max[0]; }
+
+    double SurfaceArea() const
+    {
+        if (empty())
+        {
+            return 0.0;
+        }
+
+        double x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+        return 2.0 * (x * y + y * z + z * x);
+    }
+};
+
+// Cost of a ray which entered the bounds of a BLAS, the cost of a BLAS in the scene is this
+// times the surface area of its bounds.
+double BlasCost(uint32_t triangle_count)
+{
+    return kInstanceCost + kNodeCost * std::log2(double(triangle_count) + 1.0);
+}
+
+uint32_t TriangleCount(const MeshData& mesh)
+{
+    return static_cast<uint32_t>(mesh.indices.size() / 3);
+}
+
+Aabb MeshBounds(const MeshData& mesh)
+{
+    Aabb bounds;
+    for (std::size_t v = 0; v < mesh.positions.size(); v += 3)
+    {
+        bounds.Grow(&mesh.positions[v]);
+    }
+    return bounds;
+}
+
+// Bounds of the transformed corners of the bounds.
+Aabb TransformBounds(const Aabb& bounds, const float* transform)
+{
+    Aabb result;
+    if (bounds.empty())
+    {
+        return result;
+    }
+
+    for (uint32_t corner = 0; corner < 8; ++corner)
+    {
+        float p[3] = {(corner & 1) ? bounds.max[0] : bounds.min[0],
+                      (corner & 2) ? bounds.max[1] : bounds.min[1],
+                      (corner & 4) ? bounds.max[2] : bounds.min[2]};
+        float q[3];
+        for (uint32_t r = 0; r < 3; ++r)
+        {
+            q[r] = transform[4 * r] * p[0] + transform[4 * r + 1] * p[1] +
+                   transform[4 * r + 2] * p[2] + transform[4 * r + 3];
+        }
+        result.Grow(q);
+    }
+    return result;
+}
+
+Aabb TriangleBounds(const MeshData& mesh, uint32_t triangle)
+{
+    Aabb bounds;
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        bounds.Grow(&mesh.positions[3 * std::size_t(mesh.indices[3 * triangle + k])]);
+    }
+    return bounds;
+}
+
+// Range of a permutation of the triangles of a mesh.
+struct Cluster
+{
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// Centroid bins along an axis of the centroid bounds of a cluster.
+struct Binning
+{
+    float origin[3] = {0.f, 0.f, 0.f};
+    float scale[3]  = {0.f, 0.f, 0.f};
+
+    uint32_t Bin(const Aabb& bounds, uint32_t axis) const
+    {
+        auto centroid = 0.5f * (bounds.min[axis] + bounds.max[axis]);
+        auto bin      = static_cast<int64_t>((centroid - origin[axis]) * scale[axis]);
+        return static_cast<uint32_t>(std::clamp<int64_t>(bin, 0, kSplitBins - 1));
+    }
+};
+
+// Split the cluster in two at the bin boundary with the lowest surface area heuristic cost
+// of a TLAS node over two BLASes, if that is lower than the cost of a single BLAS.
+bool SplitCluster(const MeshData&        mesh,
+                  std::vector<uint32_t>& order,
+                  const Cluster&         cluster,
+                  Cluster&               left,
+                  Cluster&               right)
+{
+    auto forced = cluster.count > kMaxClusterTriangles;
+    if (!forced && cluster.count < 2 * kMinClusterTriangles)
+    {
+        return false;
+    }
+
+    auto first = order.begin() + cluster.first;
+    auto last  = first + cluster.count;
+
+    Aabb bounds, centroids;
+    for (auto it = first; it != last; ++it)
+    {
+        auto triangle = TriangleBounds(mesh, *it);
+        bounds.Grow(triangle);
+
+        float centroid[3];
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            centroid[c] = 0.5f * (triangle.min[c] + triangle.max[c]);
+        }
+        centroids.Grow(centroid);
+    }
+
+    Binning binning;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        auto extent       = centroids.max[c] - centroids.min[c];
+        binning.origin[c] = centroids.min[c];
+        binning.scale[c]  = extent > 0.f ? kSplitBins / extent : 0.f;
+    }
+
+    Aabb     bin_bounds[3][kSplitBins];
+    uint32_t bin_counts[3][kSplitBins] = {};
+    for (auto it = first; it != last; ++it)
+    {
+        auto triangle = TriangleBounds(mesh, *it);
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            auto bin = binning.Bin(triangle, axis);
+            bin_bounds[axis][bin].Grow(triangle);
+            ++bin_counts[axis][bin];
+        }
+    }
+
+    // Forced splits only need non-empty sides.
+    auto min_count = forced ? 1u : kMinClusterTriangles;
+    auto best_cost = std::numeric_limits<double>::max();
+    auto best_axis = 0u;
+    auto best_bin  = kSplitBins;
+    auto node_cost = kNodeCost * bounds.SurfaceArea();
+    auto leaf_cost = BlasCost(cluster.count) * bounds.SurfaceArea();
+
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        if (binning.scale[axis] == 0.f)
+        {
+            continue;
+        }
+
+        // Cost of the bins right of each boundary, swept from the right.
+        double right_costs[kSplitBins] = {};
+        Aabb   right_bounds;
+        auto   right_count = 0u;
+        for (auto bin = kSplitBins - 1; bin > 0; --bin)
+        {
+            right_bounds.Grow(bin_bounds[axis][bin]);
+            right_count += bin_counts[axis][bin];
+            right_costs[bin] = right_bounds.SurfaceArea() * BlasCost(right_count);
+        }
+
+        Aabb left_bounds;
+        auto left_count = 0u;
+        for (uint32_t bin = 0; bin + 1 < kSplitBins; ++bin)
+        {
+            left_bounds.Grow(bin_bounds[axis][bin]);
+            left_count += bin_counts[axis][bin];
+
+            if (left_count < min_count || cluster.count - left_count < min_count)
+            {
+                continue;
+            }
+
+            auto cost =
+                node_cost + left_bounds.SurfaceArea() * BlasCost(left_count) + right_costs[bin + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin  = bin;
+            }
+        }
+    }
+
+    if (best_bin == kSplitBins || (!forced && best_cost >= leaf_cost))
+    {
+        return false;
+    }
+
+    auto middle = std::partition(first, last, [&](uint32_t t) {
+        return binning.Bin(TriangleBounds(mesh, t), best_axis) <= best_bin;
+    });
+
+    left  = {cluster.first, static_cast<uint32_t>(middle - first)};
+    right = {left.first + left.count, cluster.count - left.count};
+    return true;
+}
+
+// Mesh of the triangles of the cluster, in their original order. Remap holds ~0u for every
+// vertex of the mesh and is restored before returning.
+MeshData ExtractCluster(const MeshData&        mesh,
+                        uint32_t*              triangles,
+                        uint32_t               count,
+                        std::vector<uint32_t>& remap)
+{
+    std::sort(triangles, triangles + count);
+
+    MeshData cluster;
+    cluster.texture_name  = mesh.texture_name;
+    cluster.texture_index = mesh.texture_index;
+    cluster.indices.reserve(3 * std::size_t(count));
+
+    for (uint32_t t = 0; t < count; ++t)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            auto v = mesh.indices[3 * std::size_t(triangles[t]) + k];
+            if (remap[v] == ~0u)
+            {
+                remap[v] = static_cast<uint32_t>(cluster.positions.size() / 3);
+                cluster.positions.insert(cluster.positions.end(),
+                                         &mesh.positions[3 * std::size_t(v)],
+                                         &mesh.positions[3 * std::size_t(v)] + 3);
+                cluster.normals.insert(cluster.normals.end(),
+                                       &mesh.normals[3 * std::size_t(v)],
+                                       &mesh.normals[3 * std::size_t(v)] + 3);
+                cluster.texcoords.insert(cluster.texcoords.end(),
+                                         &mesh.texcoords[2 * std::size_t(v)],
+                                         &mesh.texcoords[2 * std::size_t(v)] + 2);
+            }
+            cluster.indices.push_back(remap[v]);
+        }
+    }
+
+    for (uint32_t t = 0; t < count; ++t)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            remap[mesh.indices[3 * std::size_t(triangles[t]) + k]] = ~0u;
+        }
+    }
+
+    return cluster;
+}
+
+// Clusters of the mesh, empty if it stays whole.
+std::vector<MeshData> SplitMesh(const MeshData& mesh)
+{
+    std::vector<uint32_t> order(TriangleCount(mesh));
+    std::iota(order.begin(), order.end(), 0u);
+
+    std::vector<Cluster> leaves;
+    std::vector<Cluster> stack = {{0, TriangleCount(mesh)}};
+    while (!stack.empty())
+    {
+        auto    cluster = stack.back();
+        Cluster left, right;
+        stack.pop_back();
+
+        if (SplitCluster(mesh, order, cluster, left, right))
+        {
+            stack.push_back(right);
+            stack.push_back(left);
+        }
+        else
+        {
+            leaves.push_back(cluster);
+        }
+    }
+
+    std::vector<MeshData> clusters;
+    if (leaves.size() < 2)
+    {
+        return clusters;
+    }
+
+    std::vector<uint32_t> remap(mesh.positions.size() / 3, ~0u);
+    for (auto& leaf : leaves)
+    {
+        clusters.push_back(ExtractCluster(mesh, order.data() + leaf.first, leaf.count, remap));
+    }
+    return clusters;
+}
+
+// Single instance mesh which may be merged with others.
+struct MergeCandidate
+{
+    uint32_t instance = 0;
+    Aabb     bounds;
+    uint32_t morton_code    = 0;
+    uint32_t triangle_count = 0;
+    uint32_t vertex_count   = 0;
+};
+
+uint32_t SpreadBits(uint32_t x)
+{
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+uint32_t MortonCode(const Aabb& bounds, const Aabb& scene_bounds)
+{
+    uint32_t code = 0;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        auto extent = scene_bounds.max[c] - scene_bounds.min[c];
+        auto center = 0.5f * (bounds.min[c] + bounds.max[c]);
+        auto cell   = extent > 0.f ? (center - scene_bounds.min[c]) / extent * (1 << kMortonBits)
+                                   : 0.f;
+        code |= SpreadBits(std::min(static_cast<uint32_t>(std::max(cell, 0.f)),
+                                    (1u << kMortonBits) - 1))
+                << c;
+    }
+    return code;
+}
+
+// Group candidates sharing a texture in Morton order of their centers, growing a group
+// while merging the next candidate costs less than a TLAS node over two BLASes.
+std::vector<std::vector<uint32_t>> FindMerges(std::vector<MergeCandidate>& candidates,
+                                              const std::vector<MeshInstance>& instances)
+{
+    Aabb scene_bounds;
+    for (auto& candidate : candidates)
+    {
+        scene_bounds.Grow(candidate.bounds);
+    }
+
+    for (auto& candidate : candidates)
+    {
+        candidate.morton_code = MortonCode(candidate.bounds, scene_bounds);
+    }
+
+    // Sorted by name, so that the result is deterministic.
+    std::map<std::string, std::vector<uint32_t>> groups;
+    for (uint32_t i = 0; i < candidates.size(); ++i)
+    {
+        groups[instances[candidates[i].instance].texture_name].push_back(i);
+    }
+
+    std::vector<std::vector<uint32_t>> merges;
+    for (auto& entry : groups)
+    {
+        auto& group = entry.second;
+        std::sort(group.begin(), group.end(), [&](uint32_t a, uint32_t b) {
+            return candidates[a].morton_code != candidates[b].morton_code
+                       ? candidates[a].morton_code < candidates[b].morton_code
+                       : candidates[a].instance < candidates[b].instance;
+        });
+
+        std::vector<uint32_t> members;
+        Aabb                  bounds;
+        uint32_t              triangle_count = 0, vertex_count = 0;
+
+        auto flush = [&]() {
+            if (members.size() > 1)
+            {
+                merges.push_back(members);
+            }
+            members.clear();
+        };
+
+        for (auto i : group)
+        {
+            auto& candidate = candidates[i];
+
+            if (!members.empty())
+            {
+                auto merged_bounds = bounds;
+                merged_bounds.Grow(candidate.bounds);
+
+                auto merged_count = triangle_count + candidate.triangle_count;
+                auto fits         = vertex_count + candidate.vertex_count <= kMaxMergedVertices;
+                auto merged       = merged_bounds.SurfaceArea() * BlasCost(merged_count);
+                auto separate =
+                    kNodeCost * merged_bounds.SurfaceArea() +
+                    bounds.SurfaceArea() * BlasCost(triangle_count) +
+                    candidate.bounds.SurfaceArea() * BlasCost(candidate.triangle_count);
+
+                if (merged < separate && fits)
+                {
+                    members.push_back(candidate.instance);
+                    bounds = merged_bounds;
+                    triangle_count += candidate.triangle_count;
+                    vertex_count += candidate.vertex_count;
+                    continue;
+                }
+
+                flush();
+            }
+
+            members.push_back(candidate.instance);
+            bounds         = candidate.bounds;
+            triangle_count = candidate.triangle_count;
+            vertex_count   = candidate.vertex_count;
+        }
+
+        flush();
+    }
+
+    return merges;
+}
+
+// Mesh of the instances with their transforms baked in, which are similarity transforms, so
+// normals only need to be renormalized.
+MeshData MergeInstances(const std::vector<MeshData>&     meshes,
+                        const std::vector<MeshInstance>& instances,
+                        const std::vector<uint32_t>&     members)
+{
+    MeshData merged;
+    merged.texture_name  = instances[members.front()].texture_name;
+    merged.texture_index = instances[members.front()].texture_index;
+
+    for (auto i : members)
+    {
+        auto& instance = instances[i];
+        auto& mesh     = meshes[instance.mesh];
+        auto  m        = instance.transform;
+        auto  base     = static_cast<uint32_t>(merged.positions.size() / 3);
+
+        for (std::size_t v = 0; v < mesh.positions.size(); v += 3)
+        {
+            auto p = &mesh.positions[v];
+            auto n = &mesh.normals[v];
+
+            float normal[3];
+            for (uint32_t r = 0; r < 3; ++r)
+            {
+                merged.positions.push_back(m[4 * r] * p[0] + m[4 * r + 1] * p[1] +
+                                           m[4 * r + 2] * p[2] + m[4 * r + 3]);
+                normal[r] = m[4 * r] * n[0] + m[4 * r + 1] * n[1] + m[4 * r + 2] * n[2];
+            }
+
+            auto length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                                    normal[2] * normal[2]);
+            for (uint32_t r = 0; r < 3; ++r)
+            {
+                merged.normals.push_back(length > 0.f ? normal[r] / length : 0.f);
+            }
+        }
+
+        merged.texcoords.insert(
+            merged.texcoords.end(), mesh.texcoords.begin(), mesh.texcoords.end());
+        for (auto index : mesh.indices)
+        {
+            merged.indices.push_back(base + index);
+        }
+    }
+
+    return merged;
+}
+}  // namespace
+
+GranularityStats AnalyzeGranularity(const std::vector<MeshData>&     meshes,
+                                    const std::vector<MeshInstance>& instances)
+{
+    GranularityStats stats;
+    stats.blas_count     = static_cast<uint32_t>(meshes.size());
+    stats.instance_count = static_cast<uint32_t>(instances.size());
+
+    if (meshes.empty())
+    {
+        return stats;
+    }
+
+    std::vector<uint32_t> triangle_counts;
+    std::vector<Aabb>     mesh_bounds;
+    for (auto& mesh : meshes)
+    {
+        triangle_counts.push_back(TriangleCount(mesh));
+        mesh_bounds.push_back(MeshBounds(mesh));
+    }
+
+    Aabb   scene_bounds;
+    double instance_cost = 0.0;
+    for (auto& instance : instances)
+    {
+        auto bounds = TransformBounds(mesh_bounds[instance.mesh], instance.transform);
+        scene_bounds.Grow(bounds);
+        instance_cost += bounds.SurfaceArea() * BlasCost(triangle_counts[instance.mesh]);
+    }
+
+    std::sort(triangle_counts.begin(), triangle_counts.end());
+    stats.min_triangles    = triangle_counts.front();
+    stats.median_triangles = triangle_counts[triangle_counts.size() / 2];
+    stats.max_triangles    = triangle_counts.back();
+
+    // The TLAS is about as deep as a balanced tree over the instances.
+    if (scene_bounds.SurfaceArea() > 0.0)
+    {
+        stats.traversal_cost =
+            static_cast<float>(kNodeCost * std::log2(double(instances.size()) + 1.0) +
+                               instance_cost / scene_bounds.SurfaceArea());
+    }
+
+    return stats;
+}
+
+void OptimizeGranularity(std::vector<MeshData>&     meshes,
+                         std::vector<MeshInstance>& instances,
+                         tf::Subflow&               subflow)
+{
+    std::vector<uint32_t> instance_counts(meshes.size(), 0);
+    for (auto& instance : instances)
+    {
+        ++instance_counts[instance.mesh];
+    }
+
+    // Small meshes of a single instance are merge candidates, large ones split candidates.
+    std::vector<MergeCandidate> candidates;
+    std::vector<uint32_t>       split_meshes;
+    for (uint32_t i = 0; i < instances.size(); ++i)
+    {
+        auto& mesh           = meshes[instances[i].mesh];
+        auto  triangle_count = TriangleCount(mesh);
+
+        if (instance_counts[instances[i].mesh] == 1 && triangle_count > 0 &&
+            triangle_count < kMinClusterTriangles &&
+            mesh.positions.size() / 3 <= kMaxMergedVertices)
+        {
+            MergeCandidate candidate;
+            candidate.instance       = i;
+            candidate.bounds         = TransformBounds(MeshBounds(mesh), instances[i].transform);
+            candidate.triangle_count = triangle_count;
+            candidate.vertex_count   = static_cast<uint32_t>(mesh.positions.size() / 3);
+            candidates.push_back(candidate);
+        }
+    }
+
+    for (uint32_t m = 0; m < meshes.size(); ++m)
+    {
+        if (TriangleCount(meshes[m]) >= 2 * kMinClusterTriangles)
+        {
+            split_meshes.push_back(m);
+        }
+    }
+
+    auto merges = FindMerges(candidates, instances);
+
+    // Splits and merges are independent, they share a single join of the subflow.
+    std::vector<std::vector<MeshData>> clusters(split_meshes.size());
+    std::vector<MeshData>              merged(merges.size());
+    ParallelFor(
+        subflow, static_cast<uint32_t>(split_meshes.size() + merges.size()), [&](uint32_t i) {
+            if (i < split_meshes.size())
+            {
+                clusters[i] = SplitMesh(meshes[split_meshes[i]]);
+            }
+            else
+            {
+                auto merge    = i - static_cast<uint32_t>(split_meshes.size());
+                merged[merge] = MergeInstances(meshes, instances, merges[merge]);
+            }
+        });
+
+    std::vector<uint32_t> merge_of_instance(instances.size(), ~0u);
+    std::vector<bool>     merged_mesh(meshes.size(), false);
+    for (uint32_t i = 0; i < merges.size(); ++i)
+    {
+        for (auto instance : merges[i])
+        {
+            merge_of_instance[instance]           = i;
+            merged_mesh[instances[instance].mesh] = true;
+        }
+    }
+
+    // Meshes keep their order, clusters take the place of their mesh and merged meshes
+    // follow.
+    std::vector<MeshData>              new_meshes;
+    std::vector<std::vector<uint32_t>> new_indices(meshes.size());
+    for (uint32_t m = 0, s = 0; m < meshes.size(); ++m)
+    {
+        auto split = s < split_meshes.size() && split_meshes[s] == m ? &clusters[s++] : nullptr;
+
+        if (merged_mesh[m])
+        {
+            continue;
+        }
+
+        if (split && !split->empty())
+        {
+            for (auto& cluster : *split)
+            {
+                new_indices[m].push_back(static_cast<uint32_t>(new_meshes.size()));
+                new_meshes.push_back(std::move(cluster));
+            }
+        }
+        else
+        {
+            new_indices[m].push_back(static_cast<uint32_t>(new_meshes.size()));
+            new_meshes.push_back(std::move(meshes[m]));
+        }
+    }
+
+    auto first_merged = static_cast<uint32_t>(new_meshes.size());
+    std::move(merged.begin(), merged.end(), std::back_inserter(new_meshes));
+
+    // A merged mesh is instanced where the first of its instances was.
+    std::vector<MeshInstance> new_instances;
+    std::vector<bool>         placed(merges.size(), false);
+    for (uint32_t i = 0; i < instances.size(); ++i)
+    {
+        auto merge = merge_of_instance[i];
+        if (merge != ~0u)
+        {
+            if (!placed[merge])
+            {
+                MeshInstance instance;
+                instance.mesh          = first_merged + merge;
+                instance.texture_name  = instances[i].texture_name;
+                instance.texture_index = instances[i].texture_index;
+                new_instances.push_back(std::move(instance));
+                placed[merge] = true;
+            }
+            continue;
+        }
+
+        for (auto mesh : new_indices[instances[i].mesh])
+        {
+            new_instances.push_back(instances[i]);
+            new_instances.back().mesh = mesh;
+        }
+    }
+
+    meshes    = std::move(new_meshes);
+    instances = std::move(new_instances);
+}
+}  // namespace capsaicin
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Acceleration structure layout of a scene with a BLAS per mesh and a TLAS instance per
+// mesh instance.
+struct GranularityStats
+{
+    uint32_t blas_count       = 0;
+    uint32_t instance_count   = 0;
+    uint32_t min_triangles    = 0;
+    uint32_t median_triangles = 0;
+    uint32_t max_triangles    = 0;
+    // Expected cost of a ray crossing the scene bounds in BVH node visits, with surface
+    // area heuristic probabilities of entering each instance.
+    float traversal_cost = 0.f;
+};
+
+GranularityStats AnalyzeGranularity(const std::vector<MeshData>&     meshes,
+                                    const std::vector<MeshInstance>& instances);
+
+// Choose the meshes BLASes are built for by a surface area heuristic over the TLAS and the
+// BLASes: meshes whose triangles form distant groups are split into compact clusters with
+// binned SAH splits, and small meshes with a single instance are merged with neighbours of
+// the same texture, baking their transforms. Instances of a split mesh become instances of
+// each of its clusters. Meshes must not have levels of detail yet, so this runs between
+// instancing and optimization. Joins the subflow.
+void OptimizeGranularity(std::vector<MeshData>&     meshes,
+                         std::vector<MeshInstance>& instances,
+                         tf::Subflow&               subflow);
+}  // namespace capsaicin
@@ -0,0 +1,707 @@
+#include "block_compression.h"
+
+#include <cmath>
+#include <limits>
+
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kBlockTexels = 16;
+// Mode 6 is the lowest set bit of the first 7 bits.
+constexpr uint32_t kBC7Mode6 = 1 << 6;
+
+// Weights of the second endpoint for BC1 indices.
+constexpr float kBC1Weights[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+// Weights of the second endpoint for BC7 4-bit indices, out of 64.
+constexpr uint32_t kBC7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Block
+{
+    float texels[kBlockTexels][4];
+};
+
+// Endpoints quantized for BC7 mode 6, with the nearest palette entry of each texel.
+struct BC7Fit
+{
+    uint32_t endpoints[2][4] = {};
+    uint32_t p_bits[2]       = {};
+    uint32_t indices[kBlockTexels];
+    float    error = std::numeric_limits<float>::max();
+};
+
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* data) : data_(data) {}
+
+    void Write(uint32_t value, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i, ++position_)
+        {
+            data_[position_ >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position_ & 7));
+        }
+    }
+
+private:
+    uint8_t* data_;
+    uint32_t position_ = 0;
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const uint8_t* data) : data_(data) {}
+
+    uint32_t Read(uint32_t count)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; ++i, ++position_)
+        {
+            value |= ((data_[position_ >> 3] >> (position_ & 7)) & 1u) << i;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* data_;
+    uint32_t       position_ = 0;
+};
+
+uint32_t GetRefinementCount(BlockQuality quality)
+{
+    switch (quality)
+    {
+    case BlockQuality::kFast:
+        return 0;
+    case BlockQuality::kNormal:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+float Clamp255(float value)
+{
+    return std::min(std::max(value, 0.f), 255.f);
+}
+
+Block LoadBlock(const uint8_t* texels)
+{
+    Block block;
+    for (uint32_t i = 0; i < kBlockTexels; ++i)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            block.texels[i][c] = texels[i * 4 + c];
+        }
+    }
+    return block;
+}
+
+// Endpoints spanning the first channel_count channels of the block along its principal axis,
+// or across its bounding box for fast compression.
+void FindEndpoints(const Block& block,
+                   uint32_t     channel_count,
+                   BlockQuality quality,
+                   float*       e0,
+                   float*       e1)
+{
+    float min[4], max[4], mean[4] = {};
+    for (uint32_t c = 0; c < channel_count; ++c)
+    {
+        min[c] = std::numeric_limits<float>::max();
+        max[c] = std::numeric_limits<float>::lowest();
+    }
+
+    for (auto& texel : block.texels)
+    {
+        for (uint32_t c = 0; c < channel_count; ++c)
+        {
+            min[c] = std::min(min[c], texel[c]);
+            max[c] = std::max(max[c], texel[c]);
+            mean[c] += texel[c] / kBlockTexels;
+        }
+    }
+
+    if (quality == BlockQuality::kFast)
+    {
+        std::copy(min, min + channel_count, e0);
+        std::copy(max, max + channel_count, e1);
+        return;
+    }
+
+    float covariance[4][4] = {};
+    for (auto& texel : block.texels)
+    {
+        for (uint32_t a = 0; a < channel_count; ++a)
+        {
+            for (uint32_t b = 0; b < channel_count; ++b)
+            {
+                covariance[a][b] += (texel[a] - mean[a]) * (texel[b] - mean[b]);
+            }
+        }
+    }
+
+    // The principal axis is the dominant eigenvector of the covariance, found by power
+    // iteration from the diagonal of the bounding box. Flat blocks keep a zero axis.
+    float axis[4] = {};
+    for (uint32_t c = 0; c < channel_count; ++c)
+    {
+        axis[c] = max[c] - min[c];
+    }
+
+    for (uint32_t iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length  = 0.f;
+        for (uint32_t a = 0; a < channel_count; ++a)
+        {
+            for (uint32_t b = 0; b < channel_count; ++b)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+
+        if (length < 1e-12f)
+        {
+            break;
+        }
+
+        length = std::sqrt(length);
+        for (uint32_t c = 0; c < channel_count; ++c)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    auto t_min = 0.f;
+    auto t_max = 0.f;
+    for (auto& texel : block.texels)
+    {
+        auto t = 0.f;
+        for (uint32_t c = 0; c < channel_count; ++c)
+        {
+            t += (texel[c] - mean[c]) * axis[c];
+        }
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+
+    for (uint32_t c = 0; c < channel_count; ++c)
+    {
+        e0[c] = Clamp255(mean[c] + axis[c] * t_min);
+        e1[c] = Clamp255(mean[c] + axis[c] * t_max);
+    }
+}
+
+// Endpoints minimizing the squared error of the texels interpolated at their weights of the
+// second endpoint, false if the weights can't separate the endpoints.
+bool RefineEndpoints(const Block& block,
+                     const float* weights,
+                     uint32_t     channel_count,
+                     float*       e0,
+                     float*       e1)
+{
+    float a = 0.f, b = 0.f, c = 0.f;
+    float x0[4] = {}, x1[4] = {};
+    for (uint32_t i = 0; i < kBlockTexels; ++i)
+    {
+        auto w = weights[i];
+        a += (1.f - w) * (1.f - w);
+        b += (1.f - w) * w;
+        c += w * w;
+
+        for (uint32_t ch = 0; ch < channel_count; ++ch)
+        {
+            x0[ch] += (1.f - w) * block.texels[i][ch];
+            x1[ch] += w * block.texels[i][ch];
+        }
+    }
+
+    auto determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f)
+    {
+        return false;
+    }
+
+    for (uint32_t ch = 0; ch < channel_count; ++ch)
+    {
+        e0[ch] = Clamp255((c * x0[ch] - b * x1[ch]) / determinant);
+        e1[ch] = Clamp255((a * x1[ch] - b * x0[ch]) / determinant);
+    }
+
+    return true;
+}
+
+uint32_t PackColor565(const float* color)
+{
+    auto r = static_cast<uint32_t>(std::lround(Clamp255(color[0]) * 31.f / 255.f));
+    auto g = static_cast<uint32_t>(std::lround(Clamp255(color[1]) * 63.f / 255.f));
+    auto b = static_cast<uint32_t>(std::lround(Clamp255(color[2]) * 31.f / 255.f));
+    return (r << 11) | (g << 5) | b;
+}
+
+void UnpackColor565(uint32_t color, int32_t* rgb)
+{
+    auto r = (color >> 11) & 31;
+    auto g = (color >> 5) & 63;
+    auto b = color & 31;
+    rgb[0] = static_cast<int32_t>((r << 3) | (r >> 2));
+    rgb[1] = static_cast<int32_t>((g << 2) | (g >> 4));
+    rgb[2] = static_cast<int32_t>((b << 3) | (b >> 2));
+}
+
+// Palette of a four colour block, color0 is larger than color1.
+void GetBC1Palette(uint32_t color0, uint32_t color1, int32_t (*palette)[3])
+{
+    UnpackColor565(color0, palette[0]);
+    UnpackColor565(color1, palette[1]);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+// Squared error of the first channel_count channels.
+template <typename T>
+float GetError(const float* texel, const T* value, uint32_t channel_count)
+{
+    auto error = 0.f;
+    for (uint32_t c = 0; c < channel_count; ++c)
+    {
+        auto d = texel[c] - static_cast<float>(value[c]);
+        error += d * d;
+    }
+    return error;
+}
+
+uint32_t QuantizeBC7(float value, uint32_t p_bit)
+{
+    auto q = std::lround((Clamp255(value) - static_cast<float>(p_bit)) / 2.f);
+    return static_cast<uint32_t>(std::min(std::max(q, 0l), 127l));
+}
+
+// P-bit which quantizes the endpoint with the least error.
+uint32_t GetBestPBit(const float* endpoint)
+{
+    float errors[2] = {};
+    for (uint32_t p = 0; p < 2; ++p)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            auto d = endpoint[c] - static_cast<float>((QuantizeBC7(endpoint[c], p) << 1) | p);
+            errors[p] += d * d;
+        }
+    }
+    return errors[1] < errors[0] ? 1 : 0;
+}
+
+void GetBC7Palette(const uint32_t (*endpoints)[4], const uint32_t* p_bits, int32_t (*palette)[4])
+{
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        auto e0 = static_cast<int32_t>((endpoints[0][c] << 1) | p_bits[0]);
+        auto e1 = static_cast<int32_t>((endpoints[1][c] << 1) | p_bits[1]);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            auto w        = static_cast<int32_t>(kBC7Weights[i]);
+            palette[i][c] = ((64 - w) * e0 + w * e1 + 32) >> 6;
+        }
+    }
+}
+
+// Quantize the endpoints with the p-bits and pick the nearest palette entry of each texel.
+BC7Fit FitBC7(const Block& block, const float* e0, const float* e1, uint32_t p0, uint32_t p1)
+{
+    BC7Fit fit;
+    fit.p_bits[0] = p0;
+    fit.p_bits[1] = p1;
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        fit.endpoints[0][c] = QuantizeBC7(e0[c], p0);
+        fit.endpoints[1][c] = QuantizeBC7(e1[c], p1);
+    }
+
+    int32_t palette[16][4];
+    GetBC7Palette(fit.endpoints, fit.p_bits, palette);
+
+    fit.error = 0.f;
+    for (uint32_t i = 0; i < kBlockTexels; ++i)
+    {
+        auto best = std::numeric_limits<float>::max();
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            auto error = GetError(block.texels[i], palette[p], 4);
+            if (error < best)
+            {
+                best           = error;
+                fit.indices[i] = p;
+            }
+        }
+        fit.error += best;
+    }
+
+    return fit;
+}
+}  // namespace
+
+void CompressBlockBC1(const uint8_t* texels, BlockQuality quality, uint8_t* block)
+{
+    auto  data = LoadBlock(texels);
+    float e0[4], e1[4];
+    FindEndpoints(data, 3, quality, e0, e1);
+
+    auto best_error  = std::numeric_limits<float>::max();
+    auto refinements = GetRefinementCount(quality);
+    for (uint32_t refinement = 0;; ++refinement)
+    {
+        // Four colour blocks have the larger colour first, swapping the colours swaps the
+        // endpoints they refine.
+        auto color0 = PackColor565(e0);
+        auto color1 = PackColor565(e1);
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            std::swap(e0, e1);
+        }
+
+        int32_t palette[4][3];
+        GetBC1Palette(color0, color1, palette);
+
+        // Equal colours make a three colour block, where only the first entry is the colour.
+        auto     palette_size = color0 == color1 ? 1u : 4u;
+        uint32_t indices      = 0;
+        float    weights[kBlockTexels];
+        auto     error = 0.f;
+        for (uint32_t i = 0; i < kBlockTexels; ++i)
+        {
+            auto best  = std::numeric_limits<float>::max();
+            auto index = 0u;
+            for (uint32_t p = 0; p < palette_size; ++p)
+            {
+                auto texel_error = GetError(data.texels[i], palette[p], 3);
+                if (texel_error < best)
+                {
+                    best  = texel_error;
+                    index = p;
+                }
+            }
+
+            indices |= index << (2 * i);
+            weights[i] = kBC1Weights[index];
+            error += best;
+        }
+
+        if (error < best_error)
+        {
+            best_error = error;
+            block[0]   = static_cast<uint8_t>(color0);
+            block[1]   = static_cast<uint8_t>(color0 >> 8);
+            block[2]   = static_cast<uint8_t>(color1);
+            block[3]   = static_cast<uint8_t>(color1 >> 8);
+            for (uint32_t b = 0; b < 4; ++b)
+            {
+                block[4 + b] = static_cast<uint8_t>(indices >> (8 * b));
+            }
+        }
+
+        if (refinement == refinements || palette_size == 1 ||
+            !RefineEndpoints(data, weights, 3, e0, e1))
+        {
+            break;
+        }
+    }
+}
+
+void CompressBlockBC7(const uint8_t* texels, BlockQuality quality, uint8_t* block)
+{
+    auto  data = LoadBlock(texels);
+    float e0[4], e1[4];
+    FindEndpoints(data, 4, quality, e0, e1);
+
+    BC7Fit best;
+    auto   refinements = GetRefinementCount(quality);
+    for (uint32_t refinement = 0;; ++refinement)
+    {
+        BC7Fit fit;
+        if (quality == BlockQuality::kHigh)
+        {
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                auto candidate = FitBC7(data, e0, e1, p & 1, p >> 1);
+                if (candidate.error < fit.error)
+                {
+                    fit = candidate;
+                }
+            }
+        }
+        else
+        {
+            fit = FitBC7(data, e0, e1, GetBestPBit(e0), GetBestPBit(e1));
+        }
+
+        if (fit.error < best.error)
+        {
+            best = fit;
+        }
+
+        float weights[kBlockTexels];
+        for (uint32_t i = 0; i < kBlockTexels; ++i)
+        {
+            weights[i] = static_cast<float>(kBC7Weights[fit.indices[i]]) / 64.f;
+        }
+
+        if (refinement == refinements || !RefineEndpoints(data, weights, 4, e0, e1))
+        {
+            break;
+        }
+    }
+
+    // The first index is stored without its top bit, which has to be zero.
+    if (best.indices[0] >= 8)
+    {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.p_bits[0], best.p_bits[1]);
+        for (auto& index : best.indices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    std::fill(block, block + 16, uint8_t(0));
+    BitWriter writer(block);
+    writer.Write(kBC7Mode6, 7);
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        writer.Write(best.endpoints[0][c], 7);
+        writer.Write(best.endpoints[1][c], 7);
+    }
+    writer.Write(best.p_bits[0], 1);
+    writer.Write(best.p_bits[1], 1);
+    writer.Write(best.indices[0], 3);
+    for (uint32_t i = 1; i < kBlockTexels; ++i)
+    {
+        writer.Write(best.indices[i], 4);
+    }
+}
+
+void DecompressBlockBC1(const uint8_t* block, uint8_t* texels)
+{
+    auto color0  = uint32_t(block[0]) | (uint32_t(block[1]) << 8);
+    auto color1  = uint32_t(block[2]) | (uint32_t(block[3]) << 8);
+    auto indices = uint32_t(block[4]) | (uint32_t(block[5]) << 8) | (uint32_t(block[6]) << 16) |
+                   (uint32_t(block[7]) << 24);
+
+    int32_t palette[4][3];
+    uint8_t alpha[4] = {255, 255, 255, 255};
+    GetBC1Palette(color0, color1, palette);
+
+    // Three colour blocks average the colours and end with transparent black.
+    if (color0 <= color1)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+        alpha[3] = 0;
+    }
+
+    for (uint32_t i = 0; i < kBlockTexels; ++i)
+    {
+        auto index = (indices >> (2 * i)) & 3;
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+        }
+        texels[i * 4 + 3] = alpha[index];
+    }
+}
+
+bool DecompressBlockBC7(const uint8_t* block, uint8_t* texels)
+{
+    BitReader reader(block);
+    if (reader.Read(7) != kBC7Mode6)
+    {
+        return false;
+    }
+
+    uint32_t endpoints[2][4];
+    uint32_t p_bits[2];
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        endpoints[0][c] = reader.Read(7);
+        endpoints[1][c] = reader.Read(7);
+    }
+    p_bits[0] = reader.Read(1);
+    p_bits[1] = reader.Read(1);
+
+    int32_t palette[16][4];
+    GetBC7Palette(endpoints, p_bits, palette);
+
+    for (uint32_t i = 0; i < kBlockTexels; ++i)
+    {
+        auto index = reader.Read(i == 0 ? 3 : 4);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+        }
+    }
+
+    return true;
+}
+
+bool IsOpaque(const ImageData& image)
+{
+    auto& texels = image.mips[0];
+    for (std::size_t i = 3; i < texels.size(); i += 4)
+    {
+        if (texels[i] != 255)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CompressImage(ImageData&    image,
+                   TextureFormat format,
+                   BlockQuality  quality,
+                   tf::Subflow&  subflow)
+{
+    if (image.format != TextureFormat::kRGBA8 || format == TextureFormat::kRGBA8 ||
+        image.width % 4 != 0 || image.height % 4 != 0)
+    {
+        return false;
+    }
+
+    auto compress   = format == TextureFormat::kBC1 ? CompressBlockBC1 : CompressBlockBC7;
+    auto block_size = MipSize(format, 4, 4, 0);
+
+    // Rows of blocks of all levels are compressed concurrently.
+    struct BlockRow
+    {
+        uint32_t level;
+        uint32_t row;
+    };
+
+    std::vector<BlockRow>             rows;
+    std::vector<std::vector<uint8_t>> mips(image.mips.size());
+    for (uint32_t level = 0; level < image.mips.size(); ++level)
+    {
+        mips[level].resize(MipSize(format, image.width, image.height, level));
+        for (uint32_t row = 0; row < (MipDimension(image.height, level) + 3) / 4; ++row)
+        {
+            rows.push_back({level, row});
+        }
+    }
+
+    ParallelFor(subflow, static_cast<uint32_t>(rows.size()), [&](uint32_t i) {
+        auto level   = rows[i].level;
+        auto row     = rows[i].row;
+        auto width   = MipDimension(image.width, level);
+        auto height  = MipDimension(image.height, level);
+        auto columns = (width + 3) / 4;
+        auto src     = image.mips[level].data();
+        auto dst     = mips[level].data() + std::size_t(row) * columns * block_size;
+
+        uint8_t texels[kBlockTexels * 4];
+        for (uint32_t column = 0; column < columns; ++column)
+        {
+            for (uint32_t y = 0; y < 4; ++y)
+            {
+                for (uint32_t x = 0; x < 4; ++x)
+                {
+                    auto sx = std::min(column * 4 + x, width - 1);
+                    auto sy = std::min(row * 4 + y, height - 1);
+                    std::memcpy(texels + (y * 4 + x) * 4, src + (sy * width + sx) * 4, 4);
+                }
+            }
+
+            compress(texels, quality, dst + column * block_size);
+        }
+    });
+
+    image.mips   = std::move(mips);
+    image.format = format;
+    return true;
+}
+
+bool DecompressImage(ImageData& image)
+{
+    if (image.format == TextureFormat::kRGBA8)
+    {
+        return true;
+    }
+
+    auto block_size = MipSize(image.format, 4, 4, 0);
+    for (uint32_t level = 0; level < image.mips.size(); ++level)
+    {
+        auto width   = MipDimension(image.width, level);
+        auto height  = MipDimension(image.height, level);
+        auto columns = (width + 3) / 4;
+        auto rows    = (height + 3) / 4;
+
+        std::vector<uint8_t> texels(std::size_t(width) * height * 4);
+        uint8_t              decoded[kBlockTexels * 4];
+        for (uint32_t row = 0; row < rows; ++row)
+        {
+            for (uint32_t column = 0; column < columns; ++column)
+            {
+                auto offset = (std::size_t(row) * columns + column) * block_size;
+                auto block  = image.mips[level].data() + offset;
+                if (image.format == TextureFormat::kBC1)
+                {
+                    DecompressBlockBC1(block, decoded);
+                }
+                else if (!DecompressBlockBC7(block, decoded))
+                {
+                    return false;
+                }
+
+                // Padding texels of small mips are dropped.
+                for (uint32_t y = 0; y < 4 && row * 4 + y < height; ++y)
+                {
+                    for (uint32_t x = 0; x < 4 && column * 4 + x < width; ++x)
+                    {
+                        std::memcpy(texels.data() +
+                                        ((row * 4 + y) * std::size_t(width) + column * 4 + x) * 4,
+                                    decoded + (y * 4 + x) * 4,
+                                    4);
+                    }
+                }
+            }
+        }
+
+        image.mips[level] = std::move(texels);
+    }
+
+    image.format = TextureFormat::kRGBA8;
+    return true;
+}
+
+double ComputePsnr(const ImageData& reference, const ImageData& image)
+{
+    auto& a = reference.mips[0];
+    auto& b = image.mips[0];
+
+    double squared_error = 0.0;
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        if (i % 4 != 3)
+        {
+            auto d = double(a[i]) - double(b[i]);
+            squared_error += d * d;
+        }
+    }
+
+    auto mse = squared_error / (double(a.size() / 4) * 3.0);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse)
+                     : std::numeric_limits<double>::infinity();
+}
+}  // namespace capsaicin
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "src/asset/image.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Presets trading encoding speed for quality.
+enum class BlockQuality : uint32_t
+{
+    // Endpoints span the bounding box of the block.
+    kFast,
+    // Endpoints span the block along its principal axis and are refined once by least squares.
+    kNormal,
+    // Endpoints are refined a few more times, BC7 also tries all pairs of p-bits.
+    kHigh
+};
+
+// Compress 16 RGBA8 texels of a 4x4 block, row by row, into a block. BC1 blocks use the
+// four colour mode and ignore alpha. BC7 blocks are mode 6 blocks, a single RGBA subset
+// with 4-bit indices.
+void CompressBlockBC1(const uint8_t* texels, BlockQuality quality, uint8_t* block);
+void CompressBlockBC7(const uint8_t* texels, BlockQuality quality, uint8_t* block);
+
+// Decompress a block into 16 RGBA8 texels. BC7 decodes the mode 6 blocks which the encoder
+// writes, false for other modes.
+void DecompressBlockBC1(const uint8_t* block, uint8_t* texels);
+bool DecompressBlockBC7(const uint8_t* block, uint8_t* texels);
+
+// True if all texels of the RGBA8 image are opaque, which BC1 keeps.
+bool IsOpaque(const ImageData& image);
+
+// Compress the RGBA8 mip chain of the image in place, rows of blocks are compressed
+// concurrently on the subflow, which is joined. Mip 0 dimensions have to be multiples of 4,
+// returns false and leaves the image as is otherwise. Smaller mips repeat their edge texels.
+bool CompressImage(ImageData&    image,
+                   TextureFormat format,
+                   BlockQuality  quality,
+                   tf::Subflow&  subflow);
+// Decompress the block compressed mip chain of the image in place, false if a block is
+// corrupt.
+bool DecompressImage(ImageData& image);
+
+// Peak signal to noise ratio in dB of the RGB channels of RGBA8 mip 0 of the images.
+double ComputePsnr(const ImageData& reference, const ImageData& image);
+}  // namespace capsaicin
@@ -0,0 +1,255 @@
+#include "chunked_file.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "src/asset/lz4_codec.h"
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kMagic = 0x4b484343;  // "CCHK"
+
+// The block is stored as is.
+constexpr uint32_t kStoredBlock = 1;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint64_t size;
+    uint64_t padding;
+};
+
+// Blocks follow the header and the block records, in order.
+struct BlockRecord
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t flags;
+};
+
+const Header& GetHeader(const MappedFile& file)
+{
+    return *reinterpret_cast<const Header*>(file.data());
+}
+
+const BlockRecord* GetRecords(const MappedFile& file)
+{
+    return reinterpret_cast<const BlockRecord*>(file.data() + sizeof(Header));
+}
+}  // namespace
+
+void ChunkedFile::Write(const std::string& file_name, const char* data, uint64_t size)
+{
+    Header header      = {};
+    header.magic       = kMagic;
+    header.version     = kVersion;
+    header.block_size  = kBlockSize;
+    header.block_count = static_cast<uint32_t>((size + kBlockSize - 1) / kBlockSize);
+    header.size        = size;
+
+    std::vector<BlockRecord> records(header.block_count);
+    std::vector<uint8_t>     blocks;
+    std::vector<uint8_t>     compressed(Lz4CompressBound(kBlockSize));
+
+    auto offset = sizeof(Header) + records.size() * sizeof(BlockRecord);
+    for (uint32_t b = 0; b < header.block_count; ++b)
+    {
+        auto block      = reinterpret_cast<const uint8_t*>(data) + uint64_t(b) * kBlockSize;
+        auto block_size = std::min<uint64_t>(size - uint64_t(b) * kBlockSize, kBlockSize);
+
+        auto compressed_size = Lz4Compress(block, block_size, compressed.data());
+
+        auto& record  = records[b];
+        record.offset = offset + blocks.size();
+        if (compressed_size < block_size)
+        {
+            record.size = static_cast<uint32_t>(compressed_size);
+            blocks.insert(blocks.end(), compressed.data(), compressed.data() + compressed_size);
+        }
+        else
+        {
+            record.size  = static_cast<uint32_t>(block_size);
+            record.flags = kStoredBlock;
+            blocks.insert(blocks.end(), block, block + block_size);
+        }
+    }
+
+    // Write to a temporary file first, so an interrupted write never leaves a valid header.
+    auto temp_file_name = file_name + ".tmp";
+
+    {
+        std::ofstream out(temp_file_name, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(BlockRecord)));
+        out.write(reinterpret_cast<const char*>(blocks.data()),
+                  static_cast<std::streamsize>(blocks.size()));
+
+        if (!out)
+        {
+            error("ChunkedFile: Couldn't write {}", file_name);
+            throw std::runtime_error("ChunkedFile: Couldn't write " + file_name);
+        }
+    }
+
+    std::filesystem::rename(temp_file_name, file_name);
+}
+
+void ChunkedFile::Compress(const std::string& file_name)
+{
+    auto chunked_file_name = file_name + ".chunked";
+
+    // The source is unmapped before it is replaced, which Windows requires.
+    {
+        MappedFile file(file_name);
+        Write(chunked_file_name, file.data(), file.size());
+    }
+
+    std::filesystem::rename(chunked_file_name, file_name);
+}
+
+std::unique_ptr<ChunkedFile> ChunkedFile::Open(const std::string& file_name)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(file_name, ec))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<ChunkedFile> file(new ChunkedFile(file_name));
+
+    if (file->file_.size() < sizeof(Header) || GetHeader(file->file_).magic != kMagic)
+    {
+        return nullptr;
+    }
+
+    if (!file->Validate())
+    {
+        warn("ChunkedFile: {} is corrupt or outdated", file_name);
+        return nullptr;
+    }
+
+    return file;
+}
+
+ChunkedFile::ChunkedFile(const std::string& file_name) : file_(file_name)
+{
+}
+
+bool ChunkedFile::Validate()
+{
+    auto& header = GetHeader(file_);
+    if (header.version != kVersion || header.block_size != kBlockSize ||
+        header.block_count != (header.size + kBlockSize - 1) / kBlockSize)
+    {
+        return false;
+    }
+
+    auto records_end = sizeof(Header) + uint64_t(header.block_count) * sizeof(BlockRecord);
+    if (records_end > file_.size())
+    {
+        return false;
+    }
+
+    size_        = header.size;
+    block_count_ = header.block_count;
+
+    auto records = GetRecords(file_);
+    for (uint32_t b = 0; b < block_count_; ++b)
+    {
+        auto& record = records[b];
+        if (record.offset < records_end || record.offset > file_.size() ||
+            record.size > file_.size() - record.offset || (record.flags & ~kStoredBlock) != 0 ||
+            ((record.flags & kStoredBlock) && record.size != BlockSize(b)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint64_t ChunkedFile::BlockSize(uint32_t block) const
+{
+    return std::min<uint64_t>(size_ - uint64_t(block) * kBlockSize, kBlockSize);
+}
+
+bool ChunkedFile::ReadBlock(uint32_t block, char* out) const
+{
+    auto& record = GetRecords(file_)[block];
+    auto  data   = file_.data() + record.offset;
+
+    if (record.flags & kStoredBlock)
+    {
+        std::memcpy(out, data, record.size);
+        return true;
+    }
+
+    return Lz4Decompress(reinterpret_cast<const uint8_t*>(data),
+                         record.size,
+                         reinterpret_cast<uint8_t*>(out),
+                         BlockSize(block));
+}
+
+bool ChunkedFile::Read(uint64_t offset, uint64_t size, void* out) const
+{
+    if (offset > size_ || size > size_ - offset)
+    {
+        return false;
+    }
+
+    // Partially read blocks are decompressed to a scratch block first.
+    std::vector<char> scratch;
+    auto              dst = static_cast<char*>(out);
+    while (size > 0)
+    {
+        auto block        = static_cast<uint32_t>(offset / kBlockSize);
+        auto block_offset = offset - uint64_t(block) * kBlockSize;
+        auto block_size   = BlockSize(block);
+        auto count        = std::min(size, block_size - block_offset);
+
+        if (count == block_size)
+        {
+            if (!ReadBlock(block, dst))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            scratch.resize(block_size);
+            if (!ReadBlock(block, scratch.data()))
+            {
+                return false;
+            }
+            std::memcpy(dst, scratch.data() + block_offset, count);
+        }
+
+        dst += count;
+        offset += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool ChunkedFile::Read(void* out, tf::Subflow& subflow) const
+{
+    std::atomic<bool> valid = true;
+    ParallelFor(subflow, block_count_, [&](uint32_t b) {
+        if (!ReadBlock(b, static_cast<char*>(out) + uint64_t(b) * kBlockSize))
+        {
+            valid = false;
+        }
+    });
+    return valid;
+}
+}  // namespace capsaicin
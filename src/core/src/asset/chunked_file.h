@@ -0,0 +1,47 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/utils/mapped_file.h"
+
+namespace capsaicin
+{
+// File split into blocks which are compressed independently with LZ4 and indexed, so that
+// any range can be read without decompressing the blocks before it and whole files can be
+// decompressed by many threads. Blocks which don't compress are stored as is. Scene caches
+// and cooked textures may be chunked files in place of their plain contents.
+class ChunkedFile
+{
+public:
+    static constexpr uint32_t kVersion   = 1;
+    static constexpr uint32_t kBlockSize = 256 << 10;
+
+    // Write the data to a chunked file.
+    static void Write(const std::string& file_name, const char* data, uint64_t size);
+    // Replace a plain file with a chunked file of its contents.
+    static void Compress(const std::string& file_name);
+
+    // Map the file if it is a chunked file, nullptr if it is a plain file or corrupt.
+    static std::unique_ptr<ChunkedFile> Open(const std::string& file_name);
+
+    // Size of the decompressed contents.
+    uint64_t size() const { return size_; }
+    uint32_t block_count() const { return block_count_; }
+
+    // Decompress the range of the contents into out, false if one of its blocks is corrupt.
+    bool Read(uint64_t offset, uint64_t size, void* out) const;
+    // Decompress all contents into out concurrently on the subflow, which is joined.
+    bool Read(void* out, tf::Subflow& subflow) const;
+
+private:
+    explicit ChunkedFile(const std::string& file_name);
+    // Check the header and that all blocks are inside of the file.
+    bool Validate();
+    // Decompress the block into out, which holds its size.
+    bool ReadBlock(uint32_t block, char* out) const;
+    uint64_t BlockSize(uint32_t block) const;
+
+    MappedFile file_;
+    uint64_t   size_        = 0;
+    uint32_t   block_count_ = 0;
+};
+}  // namespace capsaicin
@@ -0,0 +1,54 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace capsaicin
+{
+void FileWatcher::Watch(const std::string& file_name)
+{
+    if (files_.find(file_name) == files_.cend())
+    {
+        files_.emplace(file_name, GetState(file_name));
+    }
+}
+
+void FileWatcher::Unwatch(const std::string& file_name)
+{
+    files_.erase(file_name);
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+    std::vector<std::string> changed;
+
+    for (auto& file : files_)
+    {
+        auto  state    = GetState(file.first);
+        auto& previous = file.second;
+
+        if (state.exists &&
+            (!previous.exists || state.size != previous.size || state.mtime != previous.mtime))
+        {
+            changed.push_back(file.first);
+        }
+
+        previous = state;
+    }
+
+    std::sort(changed.begin(), changed.end());
+    return changed;
+}
+
+FileWatcher::FileState FileWatcher::GetState(const std::string& file_name)
+{
+    std::error_code ec;
+    FileState       state;
+
+    state.size   = std::filesystem::file_size(file_name, ec);
+    state.mtime  = std::filesystem::last_write_time(file_name, ec).time_since_epoch().count();
+    state.exists = !ec;
+
+    return state;
+}
+}  // namespace capsaicin
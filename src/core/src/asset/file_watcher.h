@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace capsaicin
+{
+// Detects changes of files by polling their size and modification time, which is portable
+// and cheap for the few hundred files of a scene. Editors may replace a file by deleting and
+// recreating it, so a file is reported once it exists again rather than when it goes missing.
+class FileWatcher
+{
+public:
+    // Start watching the file, its current state is the baseline. Watching a file again
+    // keeps its baseline.
+    void Watch(const std::string& file_name);
+    void Unwatch(const std::string& file_name);
+
+    // Files which changed since the last poll, sorted by name.
+    std::vector<std::string> Poll();
+
+private:
+    struct FileState
+    {
+        bool     exists = false;
+        uint64_t size   = 0;
+        int64_t  mtime  = 0;
+    };
+
+    static FileState GetState(const std::string& file_name);
+
+    std::unordered_map<std::string, FileState> files_;
+};
+}  // namespace capsaicin
@@ -0,0 +1,128 @@
+#include "geometry_residency.h"
+
+#include <numeric>
+
+namespace capsaicin
+{
+GeometryResidency::GeometryResidency(uint64_t budget, uint64_t max_load_per_update)
+    : budget_(budget), max_load_per_update_(max_load_per_update)
+{
+}
+
+uint32_t GeometryResidency::AddMesh(uint64_t size)
+{
+    Mesh mesh;
+    mesh.size = size;
+    meshes_.push_back(mesh);
+    return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+void GeometryResidency::AddInstance(uint32_t mesh, const BoundsComponent& bounds)
+{
+    instances_.push_back({mesh, bounds});
+}
+
+bool GeometryResidency::Update(const float* eye, ResidencyPool& pool)
+{
+    for (auto& mesh : meshes_)
+    {
+        mesh.priority = 0.f;
+    }
+
+    for (auto& instance : instances_)
+    {
+        auto& mesh    = meshes_[instance.mesh];
+        mesh.priority = std::max(mesh.priority, ProjectedSize(instance.bounds, eye));
+    }
+
+    // Ties keep mesh order, so that the working set is deterministic.
+    std::vector<uint32_t> order(meshes_.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return meshes_[a].priority > meshes_[b].priority;
+    });
+
+    // Meshes too large for the rest of the budget are skipped for smaller ones.
+    std::vector<bool> wanted(meshes_.size(), false);
+    uint64_t          working_set_size = 0;
+    for (auto m : order)
+    {
+        if (working_set_size + meshes_[m].size <= budget_)
+        {
+            wanted[m] = true;
+            working_set_size += meshes_[m].size;
+        }
+    }
+
+    // Lowest ranked first.
+    std::vector<uint32_t> evictable;
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        if (meshes_[*it].resident && !wanted[*it])
+        {
+            evictable.push_back(*it);
+        }
+    }
+
+    uint64_t    loaded_size    = 0;
+    std::size_t next_evictable = 0;
+    for (auto m : order)
+    {
+        auto& mesh = meshes_[m];
+        if (!wanted[m] || mesh.resident)
+        {
+            continue;
+        }
+
+        // A single mesh may exceed the limit, so that it gets loaded at all.
+        if (loaded_size > 0 && loaded_size + mesh.size > max_load_per_update_)
+        {
+            return false;
+        }
+
+        while (resident_size_ + mesh.size > budget_ && next_evictable < evictable.size())
+        {
+            Evict(evictable[next_evictable++], pool);
+        }
+
+        // The pool may be fragmented, evicting more meshes frees more space.
+        auto made_resident = pool.MakeResident(m);
+        while (!made_resident && next_evictable < evictable.size())
+        {
+            Evict(evictable[next_evictable++], pool);
+            made_resident = pool.MakeResident(m);
+        }
+
+        if (!made_resident)
+        {
+            return false;
+        }
+
+        mesh.resident = true;
+        resident_size_ += mesh.size;
+        loaded_size += mesh.size;
+        ++resident_count_;
+    }
+
+    return true;
+}
+
+void GeometryResidency::Clear(ResidencyPool& pool)
+{
+    for (uint32_t m = 0; m < meshes_.size(); ++m)
+    {
+        if (meshes_[m].resident)
+        {
+            Evict(m, pool);
+        }
+    }
+}
+
+void GeometryResidency::Evict(uint32_t mesh, ResidencyPool& pool)
+{
+    pool.Evict(mesh);
+    meshes_[mesh].resident = false;
+    resident_size_ -= meshes_[mesh].size;
+    --resident_count_;
+}
+}  // namespace capsaicin
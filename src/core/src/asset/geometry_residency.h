@@ -0,0 +1,69 @@
+#pragma once
+
+#include "src/asset/mesh_bounds.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Pool meshes are paged into, GPU pools in AssetLoadSystem.
+class ResidencyPool
+{
+public:
+    virtual ~ResidencyPool() = default;
+
+    // Upload the mesh and show its instances, false if the pool has no space for it.
+    virtual bool MakeResident(uint32_t mesh) = 0;
+    // Hide the instances of the mesh and free its space.
+    virtual void Evict(uint32_t mesh) = 0;
+};
+
+// Working set of the meshes of a scene in a memory budget. Meshes are ranked by the largest
+// projected size of their instances from the eye and the working set is the largest ranked
+// meshes which fit the budget together. Resident meshes which fall out of it stay until
+// their space is needed, so that the working set doesn't thrash at its boundary.
+class GeometryResidency
+{
+public:
+    // Sizes are in bytes, loads are spread over updates by their size.
+    GeometryResidency(uint64_t budget, uint64_t max_load_per_update);
+
+    // Mesh of the given size, meshes are numbered in order.
+    uint32_t AddMesh(uint64_t size);
+    void     AddInstance(uint32_t mesh, const BoundsComponent& bounds);
+
+    // Evict meshes which left the working set as far as needed to page in those which
+    // entered it. Returns whether the working set is resident.
+    bool Update(const float* eye, ResidencyPool& pool);
+    // Evict all resident meshes.
+    void Clear(ResidencyPool& pool);
+
+    bool     resident(uint32_t mesh) const { return meshes_[mesh].resident; }
+    uint32_t mesh_count() const { return static_cast<uint32_t>(meshes_.size()); }
+    uint32_t resident_count() const { return resident_count_; }
+    uint64_t resident_size() const { return resident_size_; }
+    uint64_t budget() const { return budget_; }
+
+private:
+    struct Mesh
+    {
+        uint64_t size     = 0;
+        float    priority = 0.f;
+        bool     resident = false;
+    };
+
+    struct Instance
+    {
+        uint32_t        mesh;
+        BoundsComponent bounds;
+    };
+
+    void Evict(uint32_t mesh, ResidencyPool& pool);
+
+    uint64_t              budget_              = 0;
+    uint64_t              max_load_per_update_ = 0;
+    std::vector<Mesh>     meshes_;
+    std::vector<Instance> instances_;
+    uint32_t              resident_count_ = 0;
+    uint64_t              resident_size_  = 0;
+};
+}  // namespace capsaicin
@@ -0,0 +1,939 @@
+#include "gltf_loader.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+
+#include "src/utils/json.h"
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kGlbMagic     = 0x46546c67;  // "glTF"
+constexpr uint32_t kGlbJsonChunk = 0x4e4f534a;  // "JSON"
+constexpr uint32_t kGlbBinChunk  = 0x004e4942;  // "BIN\0"
+
+constexpr uint32_t kByte          = 5120;
+constexpr uint32_t kUnsignedByte  = 5121;
+constexpr uint32_t kShort         = 5122;
+constexpr uint32_t kUnsignedShort = 5123;
+constexpr uint32_t kUnsignedInt   = 5125;
+constexpr uint32_t kFloat         = 5126;
+
+constexpr uint32_t    kTriangles     = 4;
+constexpr std::size_t kMaxByteStride = 252;
+constexpr uint32_t    kNone          = ~0u;
+
+// Instance transforms should be similarity transforms, normals take their linear part.
+constexpr double kSimilarityTolerance = 1e-3;
+
+// Column major 4x4 matrix, like glTF node matrices.
+using Matrix = std::array<double, 16>;
+
+struct Span
+{
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+struct BufferView
+{
+    Span        span;
+    std::size_t stride = 0;
+};
+
+// Accessor resolved against its buffer view. Accessors without a buffer view are all zeros
+// and have no data.
+struct Accessor
+{
+    const char* data            = nullptr;
+    uint32_t    count           = 0;
+    uint32_t    component_type  = kFloat;
+    uint32_t    component_count = 0;
+    uint32_t    component_size  = 0;
+    bool        normalized      = false;
+    std::size_t stride          = 0;
+};
+
+// Accessors of a primitive, missing attributes have zero accessors of the vertex count.
+struct PrimitiveSource
+{
+    Accessor positions;
+    Accessor normals;
+    Accessor texcoords;
+    Accessor indices;
+    bool     has_indices = false;
+};
+
+struct Document
+{
+    std::string             file_name;
+    JsonValue               json;
+    std::vector<Span>       buffers;
+    std::vector<BufferView> buffer_views;
+};
+
+[[noreturn]] void Fail(const Document& document, const std::string& what)
+{
+    error("GltfLoader: {} in {}", what, document.file_name);
+    throw std::runtime_error("GltfLoader: " + what);
+}
+
+uint32_t ReadU32(const char* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Elements of an array member, empty if it is missing.
+const std::vector<JsonValue>& GetArray(const JsonValue& object, const char* key)
+{
+    static const std::vector<JsonValue> kEmpty;
+    auto member = object.Find(key);
+    return member && member->is_array() ? member->array : kEmpty;
+}
+
+// Non-negative integer, the fallback if the value is missing.
+std::size_t ToSize(const Document&  document,
+                   const JsonValue* value,
+                   const char*      what,
+                   std::size_t      fallback)
+{
+    if (!value)
+    {
+        return fallback;
+    }
+
+    if (!value->is_number() || value->number < 0.0 || value->number > 9e15 ||
+        value->number != std::floor(value->number))
+    {
+        Fail(document, std::string("Invalid ") + what);
+    }
+
+    return static_cast<std::size_t>(value->number);
+}
+
+std::size_t GetSize(const Document&  document,
+                    const JsonValue& object,
+                    const char*      key,
+                    std::size_t      fallback)
+{
+    return ToSize(document, object.Find(key), key, fallback);
+}
+
+// Index into an array of count elements, kNone if the value is missing.
+uint32_t ToIndex(const Document&  document,
+                 const JsonValue* value,
+                 const char*      what,
+                 std::size_t      count)
+{
+    auto index = ToSize(document, value, what, kNone);
+    if (value && index >= count)
+    {
+        Fail(document, std::string("Out of range ") + what);
+    }
+    return static_cast<uint32_t>(index);
+}
+
+uint32_t GetIndex(const Document&  document,
+                  const JsonValue& object,
+                  const char*      key,
+                  std::size_t      count)
+{
+    return ToIndex(document, object.Find(key), key, count);
+}
+
+// URIs are percent-encoded.
+std::string DecodeUri(const std::string& uri)
+{
+    std::string decoded;
+    for (std::size_t i = 0; i < uri.size(); ++i)
+    {
+        uint32_t value = 0;
+        if (uri[i] == '%' && i + 2 < uri.size() &&
+            std::from_chars(&uri[i + 1], &uri[i + 3], value, 16).ptr == &uri[i + 3])
+        {
+            decoded.push_back(static_cast<char>(value));
+            i += 2;
+        }
+        else
+        {
+            decoded.push_back(uri[i]);
+        }
+    }
+    return decoded;
+}
+
+// Split a GLB file into its JSON and binary chunks, the binary chunk is optional.
+void ParseGlb(const Document& document, const MappedFile& file, Span& json, Span& bin)
+{
+    auto data    = file.data();
+    auto version = ReadU32(data + 4);
+    auto length  = std::size_t(ReadU32(data + 8));
+
+    if (version != 2)
+    {
+        Fail(document, "Unsupported GLB version " + std::to_string(version));
+    }
+
+    if (length > file.size())
+    {
+        Fail(document, "Truncated GLB file");
+    }
+
+    json = {};
+    for (std::size_t offset = 12; offset + 8 <= length;)
+    {
+        auto chunk_length = std::size_t(ReadU32(data + offset));
+        auto chunk_type   = ReadU32(data + offset + 4);
+        offset += 8;
+
+        if (chunk_length > length - offset)
+        {
+            Fail(document, "Truncated GLB chunk");
+        }
+
+        if (!json.data)
+        {
+            if (chunk_type != kGlbJsonChunk)
+            {
+                Fail(document, "GLB file doesn't start with a JSON chunk");
+            }
+            json = {data + offset, chunk_length};
+        }
+        else if (chunk_type == kGlbBinChunk && !bin.data)
+        {
+            bin = {data + offset, chunk_length};
+        }
+
+        // Chunks are padded to 4 bytes.
+        offset += (chunk_length + 3) & ~std::size_t(3);
+    }
+
+    if (!json.data)
+    {
+        Fail(document, "GLB file without JSON chunk");
+    }
+}
+
+uint32_t GetComponentSize(const Document& document, uint32_t component_type)
+{
+    switch (component_type)
+    {
+    case kByte:
+    case kUnsignedByte:
+        return 1;
+    case kShort:
+    case kUnsignedShort:
+        return 2;
+    case kUnsignedInt:
+    case kFloat:
+        return 4;
+    default:
+        Fail(document, "Invalid component type " + std::to_string(component_type));
+    }
+}
+
+uint32_t GetComponentCount(const Document& document, const std::string& type)
+{
+    if (type == "SCALAR")
+    {
+        return 1;
+    }
+    if (type.size() == 4 && type.compare(0, 3, "VEC") == 0 && type[3] >= '2' && type[3] <= '4')
+    {
+        return static_cast<uint32_t>(type[3] - '0');
+    }
+    Fail(document, "Unsupported accessor type " + type);
+}
+
+Accessor ReadAccessor(const Document& document, uint32_t index)
+{
+    auto& json = GetArray(document.json, "accessors")[index];
+
+    if (json.Find("sparse"))
+    {
+        Fail(document, "Sparse accessors are not supported");
+    }
+
+    Accessor accessor;
+    accessor.component_type  = static_cast<uint32_t>(GetSize(document, json, "componentType", 0));
+    accessor.component_size  = GetComponentSize(document, accessor.component_type);
+    accessor.component_count = GetComponentCount(document, json.GetString("type"));
+    accessor.normalized      = json.GetBool("normalized", false);
+
+    auto count = GetSize(document, json, "count", 0);
+    if (count >= kNone)
+    {
+        Fail(document, "Accessor too large");
+    }
+    accessor.count = static_cast<uint32_t>(count);
+
+    auto element_size = std::size_t(accessor.component_size) * accessor.component_count;
+    accessor.stride   = element_size;
+
+    auto view_index = GetIndex(document, json, "bufferView", document.buffer_views.size());
+    if (view_index == kNone)
+    {
+        return accessor;
+    }
+
+    auto& view   = document.buffer_views[view_index];
+    auto  offset = GetSize(document, json, "byteOffset", 0);
+
+    if (view.stride != 0)
+    {
+        if (view.stride < element_size)
+        {
+            Fail(document, "Buffer view stride smaller than its elements");
+        }
+        accessor.stride = view.stride;
+    }
+
+    if (count > 0 &&
+        (offset > view.span.size ||
+         accessor.stride * (count - 1) + element_size > view.span.size - offset))
+    {
+        Fail(document, "Accessor out of its buffer view");
+    }
+
+    accessor.data = view.span.data + offset;
+    return accessor;
+}
+
+float ReadComponent(const char* data, uint32_t component_type, bool normalized)
+{
+    switch (component_type)
+    {
+    case kByte: {
+        int8_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? std::max(value / 127.f, -1.f) : value;
+    }
+    case kUnsignedByte: {
+        uint8_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? value / 255.f : value;
+    }
+    case kShort: {
+        int16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? std::max(value / 32767.f, -1.f) : value;
+    }
+    case kUnsignedShort: {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? value / 65535.f : value;
+    }
+    case kUnsignedInt: {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return static_cast<float>(value);
+    }
+    default: {
+        float value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    }
+}
+
+// Whether the accessor is tightly packed in the given format, so it can be used in place.
+bool IsPacked(const Accessor& accessor, uint32_t component_type, uint32_t component_count)
+{
+    return accessor.data && accessor.component_type == component_type &&
+           accessor.component_count == component_count &&
+           accessor.stride == std::size_t(accessor.component_size) * component_count &&
+           reinterpret_cast<std::uintptr_t>(accessor.data) % accessor.component_size == 0;
+}
+
+// Accessor data as tightly packed floats, in place if possible. Extra components are dropped
+// and missing ones are zero.
+const float* GetFloats(const Accessor&     accessor,
+                       uint32_t            component_count,
+                       std::vector<float>& storage,
+                       uint32_t&           mapped_count)
+{
+    if (IsPacked(accessor, kFloat, component_count))
+    {
+        ++mapped_count;
+        return reinterpret_cast<const float*>(accessor.data);
+    }
+
+    storage.assign(std::size_t(accessor.count) * component_count, 0.f);
+    if (accessor.data)
+    {
+        auto n = std::min(component_count, accessor.component_count);
+        for (std::size_t v = 0; v < accessor.count; ++v)
+        {
+            auto element = accessor.data + v * accessor.stride;
+            for (uint32_t c = 0; c < n; ++c)
+            {
+                storage[v * component_count + c] =
+                    ReadComponent(element + c * accessor.component_size,
+                                  accessor.component_type,
+                                  accessor.normalized);
+            }
+        }
+    }
+
+    return storage.data();
+}
+
+// Indices as uint32, in place if possible. Primitives without indices get a list of
+// their vertices.
+const uint32_t* GetIndices(const PrimitiveSource& source,
+                           std::vector<uint32_t>& storage,
+                           uint32_t&              mapped_count)
+{
+    auto& accessor = source.indices;
+
+    if (!source.has_indices)
+    {
+        storage.resize(source.positions.count);
+        std::iota(storage.begin(), storage.end(), 0u);
+        return storage.data();
+    }
+
+    if (IsPacked(accessor, kUnsignedInt, 1))
+    {
+        ++mapped_count;
+        return reinterpret_cast<const uint32_t*>(accessor.data);
+    }
+
+    storage.assign(accessor.count, 0u);
+    if (accessor.data)
+    {
+        for (std::size_t i = 0; i < accessor.count; ++i)
+        {
+            auto element = accessor.data + i * accessor.stride;
+            if (accessor.component_type == kUnsignedByte)
+            {
+                storage[i] = static_cast<uint8_t>(*element);
+            }
+            else if (accessor.component_type == kUnsignedShort)
+            {
+                uint16_t value;
+                std::memcpy(&value, element, sizeof(value));
+                storage[i] = value;
+            }
+            else
+            {
+                std::memcpy(&storage[i], element, sizeof(uint32_t));
+            }
+        }
+    }
+
+    return storage.data();
+}
+
+Matrix Identity()
+{
+    return {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+}
+
+Matrix Multiply(const Matrix& a, const Matrix& b)
+{
+    Matrix m;
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            m[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] +
+                           a[12 + r] * b[c * 4 + 3];
+        }
+    }
+    return m;
+}
+
+void ReadNumbers(const Document&  document,
+                 const JsonValue& node,
+                 const char*      key,
+                 double*          values,
+                 uint32_t         count)
+{
+    auto member = node.Find(key);
+    if (!member)
+    {
+        return;
+    }
+
+    if (!member->is_array() || member->array.size() != count)
+    {
+        Fail(document, std::string("Invalid node ") + key);
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!member->array[i].is_number())
+        {
+            Fail(document, std::string("Invalid node ") + key);
+        }
+        values[i] = member->array[i].number;
+    }
+}
+
+// Local transform of the node, either its matrix or translation * rotation * scale.
+Matrix GetLocalTransform(const Document& document, const JsonValue& node)
+{
+    auto m = Identity();
+
+    if (node.Find("matrix"))
+    {
+        ReadNumbers(document, node, "matrix", m.data(), 16);
+        return m;
+    }
+
+    double t[3] = {0.0, 0.0, 0.0}, q[4] = {0.0, 0.0, 0.0, 1.0}, s[3] = {1.0, 1.0, 1.0};
+    ReadNumbers(document, node, "translation", t, 3);
+    ReadNumbers(document, node, "rotation", q, 4);
+    ReadNumbers(document, node, "scale", s, 3);
+
+    auto length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (length > 0.0)
+    {
+        for (auto& c : q)
+        {
+            c /= length;
+        }
+    }
+
+    auto x = q[0], y = q[1], z = q[2], w = q[3];
+
+    double r[3][3] = {{1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y)},
+                      {2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x)},
+                      {2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y)}};
+
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        for (uint32_t row = 0; row < 3; ++row)
+        {
+            m[c * 4 + row] = r[row][c] * s[c];
+        }
+        m[12 + c] = t[c];
+    }
+
+    return m;
+}
+
+// Whether the linear part has orthogonal columns of the same length.
+bool IsSimilarity(const Matrix& m)
+{
+    double lengths[3];
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        lengths[c] = std::sqrt(m[c * 4] * m[c * 4] + m[c * 4 + 1] * m[c * 4 + 1] +
+                               m[c * 4 + 2] * m[c * 4 + 2]);
+    }
+
+    auto scale = std::max({lengths[0], lengths[1], lengths[2]});
+    for (uint32_t a = 0; a < 3; ++a)
+    {
+        auto b   = (a + 1) % 3;
+        auto dot = m[a * 4] * m[b * 4] + m[a * 4 + 1] * m[b * 4 + 1] + m[a * 4 + 2] * m[b * 4 + 2];
+        if (std::abs(lengths[a] - lengths[b]) > kSimilarityTolerance * scale ||
+            std::abs(dot) > kSimilarityTolerance * scale * scale)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Base color texture names of the materials, empty for materials without one.
+std::vector<std::string> GetMaterialTextures(const Document& document)
+{
+    auto& textures = GetArray(document.json, "textures");
+    auto& images   = GetArray(document.json, "images");
+
+    std::vector<std::string> names;
+    uint32_t                 embedded_count = 0;
+
+    for (auto& material : GetArray(document.json, "materials"))
+    {
+        std::string name;
+
+        auto pbr        = material.Find("pbrMetallicRoughness");
+        auto base_color = pbr ? pbr->Find("baseColorTexture") : nullptr;
+        auto texture =
+            base_color ? GetIndex(document, *base_color, "index", textures.size()) : kNone;
+        auto image =
+            texture != kNone ? GetIndex(document, textures[texture], "source", images.size())
+                             : kNone;
+
+        if (image != kNone)
+        {
+            auto uri = images[image].GetString("uri");
+            if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+            {
+                ++embedded_count;
+            }
+            else
+            {
+                name = DecodeUri(uri);
+            }
+        }
+
+        names.push_back(std::move(name));
+    }
+
+    if (embedded_count > 0)
+    {
+        warn("GltfLoader: {} materials of {} use embedded images, which are not supported",
+             embedded_count,
+             document.file_name);
+    }
+
+    return names;
+}
+}  // namespace
+
+bool GltfScene::IsGltfFile(const std::string& file_name)
+{
+    auto extension = std::filesystem::path(file_name).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return extension == ".gltf" || extension == ".glb";
+}
+
+std::unique_ptr<GltfScene> GltfScene::Load(const std::string& file_name, tf::Subflow& subflow)
+{
+    std::unique_ptr<GltfScene> scene(new GltfScene());
+
+    Document document;
+    document.file_name = file_name;
+
+    scene->files_.push_back(std::make_unique<MappedFile>(file_name));
+    auto& file = *scene->files_.back();
+
+    Span json{file.data(), file.size()};
+    Span bin;
+    if (file.size() >= 12 && ReadU32(file.data()) == kGlbMagic)
+    {
+        ParseGlb(document, file, json, bin);
+    }
+
+    document.json = ParseJson(json.data, json.size);
+
+    auto asset   = document.json.Find("asset");
+    auto version = asset ? asset->GetString("version") : "";
+    if (version.compare(0, 2, "2.") != 0)
+    {
+        Fail(document, "Unsupported glTF version " + version);
+    }
+
+    for (auto& extension : GetArray(document.json, "extensionsRequired"))
+    {
+        Fail(document, "Required extension " + extension.string + " is not supported");
+    }
+
+    // Buffers without URI are the binary chunk of a GLB file, others are mapped.
+    auto directory = std::filesystem::path(file_name).parent_path();
+    for (auto& buffer : GetArray(document.json, "buffers"))
+    {
+        auto uri  = buffer.GetString("uri");
+        Span span = bin;
+
+        if (uri.compare(0, 5, "data:") == 0)
+        {
+            Fail(document, "Embedded buffers are not supported");
+        }
+
+        if (!uri.empty())
+        {
+            scene->buffer_files_.push_back((directory / DecodeUri(uri)).string());
+            scene->files_.push_back(std::make_unique<MappedFile>(scene->buffer_files_.back()));
+            span = {scene->files_.back()->data(), scene->files_.back()->size()};
+        }
+        else if (!document.buffers.empty() || !bin.data)
+        {
+            Fail(document, "Buffer without data");
+        }
+
+        auto byte_length = GetSize(document, buffer, "byteLength", 0);
+        if (byte_length > span.size)
+        {
+            Fail(document, "Buffer larger than its data");
+        }
+
+        document.buffers.push_back({span.data, byte_length});
+    }
+
+    for (auto& view : GetArray(document.json, "bufferViews"))
+    {
+        auto buffer = GetIndex(document, view, "buffer", document.buffers.size());
+        if (buffer == kNone)
+        {
+            Fail(document, "Buffer view without buffer");
+        }
+
+        auto  offset = GetSize(document, view, "byteOffset", 0);
+        auto  length = GetSize(document, view, "byteLength", 0);
+        auto  stride = GetSize(document, view, "byteStride", 0);
+        auto& span   = document.buffers[buffer];
+
+        if (offset > span.size || length > span.size - offset)
+        {
+            Fail(document, "Buffer view out of its buffer");
+        }
+
+        if (stride > kMaxByteStride)
+        {
+            Fail(document, "Invalid buffer view stride");
+        }
+
+        document.buffer_views.push_back({{span.data + offset, length}, stride});
+    }
+
+    auto  material_textures = GetMaterialTextures(document);
+    auto& accessors         = GetArray(document.json, "accessors");
+
+    // Primitives of each glTF mesh, instanced together by the nodes referencing it.
+    std::vector<std::vector<uint32_t>> mesh_primitives;
+    std::vector<PrimitiveSource>       sources;
+    uint32_t                           skipped_count = 0;
+
+    for (auto& mesh : GetArray(document.json, "meshes"))
+    {
+        mesh_primitives.emplace_back();
+
+        for (auto& primitive : GetArray(mesh, "primitives"))
+        {
+            auto attributes = primitive.Find("attributes");
+            auto position   = attributes && attributes->is_object()
+                                  ? GetIndex(document, *attributes, "POSITION", accessors.size())
+                                  : kNone;
+
+            if (GetSize(document, primitive, "mode", kTriangles) != kTriangles ||
+                position == kNone)
+            {
+                ++skipped_count;
+                continue;
+            }
+
+            auto normal   = GetIndex(document, *attributes, "NORMAL", accessors.size());
+            auto texcoord = GetIndex(document, *attributes, "TEXCOORD_0", accessors.size());
+            auto indices  = GetIndex(document, primitive, "indices", accessors.size());
+            auto material = GetIndex(document, primitive, "material", material_textures.size());
+
+            PrimitiveSource source;
+            source.positions = ReadAccessor(document, position);
+
+            auto vertex_count                = source.positions.count;
+            source.normals.count             = vertex_count;
+            source.normals.component_count   = 3;
+            source.texcoords.count           = vertex_count;
+            source.texcoords.component_count = 2;
+
+            if (normal != kNone)
+            {
+                source.normals = ReadAccessor(document, normal);
+            }
+
+            if (texcoord != kNone)
+            {
+                source.texcoords = ReadAccessor(document, texcoord);
+            }
+
+            if (indices != kNone)
+            {
+                source.indices     = ReadAccessor(document, indices);
+                source.has_indices = true;
+            }
+
+            if (source.positions.component_count != 3 || source.normals.component_count != 3 ||
+                source.texcoords.component_count != 2)
+            {
+                Fail(document, "Invalid vertex attribute type");
+            }
+
+            if (source.normals.count != vertex_count || source.texcoords.count != vertex_count)
+            {
+                Fail(document, "Vertex attributes with different counts");
+            }
+
+            auto& index_type = source.indices.component_type;
+            if (source.has_indices &&
+                (source.indices.component_count != 1 || index_type == kByte ||
+                 index_type == kShort || index_type == kFloat))
+            {
+                Fail(document, "Invalid index type");
+            }
+
+            auto index_count = source.has_indices ? source.indices.count : vertex_count;
+            if (index_count % 3 != 0)
+            {
+                Fail(document, "Primitive with partial triangles");
+            }
+
+            Primitive mesh_primitive;
+            if (material != kNone)
+            {
+                mesh_primitive.texture_name = material_textures[material];
+            }
+
+            mesh_primitives.back().push_back(static_cast<uint32_t>(scene->primitives_.size()));
+            scene->primitives_.push_back(std::move(mesh_primitive));
+            sources.push_back(source);
+        }
+    }
+
+    if (skipped_count > 0)
+    {
+        warn("GltfLoader: {} primitives of {} skipped, only triangles are supported",
+             skipped_count,
+             file_name);
+    }
+
+    // Streams are independent, so primitives are converted in parallel.
+    auto                  primitive_count = static_cast<uint32_t>(scene->primitives_.size());
+    std::vector<uint32_t> mapped_counts(primitive_count, 0);
+    std::vector<uint8_t>  valid(primitive_count, 0);
+
+    ParallelFor(subflow, primitive_count, [&](uint32_t i) {
+        auto& source    = sources[i];
+        auto& primitive = scene->primitives_[i];
+        auto& view      = primitive.view;
+        auto& mapped    = mapped_counts[i];
+
+        view.vertex_count = source.positions.count;
+        view.positions    = GetFloats(source.positions, 3, primitive.positions, mapped);
+        view.normals      = GetFloats(source.normals, 3, primitive.normals, mapped);
+        view.texcoords    = GetFloats(source.texcoords, 2, primitive.texcoords, mapped);
+        view.indices      = GetIndices(source, primitive.indices, mapped);
+        view.index_count  = source.has_indices ? source.indices.count : source.positions.count;
+
+        // Indices are read by shaders, so mapped ones are checked as well.
+        valid[i] = std::all_of(view.indices,
+                               view.indices + view.index_count,
+                               [&](uint32_t index) { return index < view.vertex_count; });
+    });
+
+    if (std::find(valid.cbegin(), valid.cend(), 0) != valid.cend())
+    {
+        Fail(document, "Index out of range");
+    }
+
+    for (auto count : mapped_counts)
+    {
+        scene->mapped_stream_count_ += count;
+        scene->converted_stream_count_ += 4 - count;
+    }
+
+    // Instance the primitives of every node with a mesh, in document order.
+    auto& nodes  = GetArray(document.json, "nodes");
+    auto& scenes = GetArray(document.json, "scenes");
+
+    std::vector<uint32_t> roots;
+    if (!scenes.empty())
+    {
+        auto scene_index = GetIndex(document, document.json, "scene", scenes.size());
+        for (auto& node : GetArray(scenes[scene_index == kNone ? 0 : scene_index], "nodes"))
+        {
+            roots.push_back(ToIndex(document, &node, "scene node", nodes.size()));
+        }
+    }
+    else
+    {
+        // Without scenes, all nodes without a parent are shown.
+        std::vector<uint8_t> has_parent(nodes.size(), 0);
+        for (auto& node : nodes)
+        {
+            for (auto& child : GetArray(node, "children"))
+            {
+                has_parent[ToIndex(document, &child, "child node", nodes.size())] = 1;
+            }
+        }
+
+        for (uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            if (!has_parent[i])
+            {
+                roots.push_back(i);
+            }
+        }
+    }
+
+    std::vector<std::pair<uint32_t, Matrix>> stack;
+    std::vector<uint8_t>                     visited(nodes.size(), 0);
+    uint32_t                                 non_similar_count = 0;
+
+    for (auto root = roots.crbegin(); root != roots.crend(); ++root)
+    {
+        stack.emplace_back(*root, Identity());
+    }
+
+    while (!stack.empty())
+    {
+        auto node_index = stack.back().first;
+        auto parent     = stack.back().second;
+        stack.pop_back();
+
+        if (visited[node_index])
+        {
+            Fail(document, "Node hierarchy is not a tree");
+        }
+        visited[node_index] = 1;
+
+        auto& node      = nodes[node_index];
+        auto  transform = Multiply(parent, GetLocalTransform(document, node));
+        auto  mesh      = GetIndex(document, node, "mesh", mesh_primitives.size());
+
+        if (mesh != kNone)
+        {
+            for (auto primitive : mesh_primitives[mesh])
+            {
+                MeshInstance instance;
+                instance.mesh         = primitive;
+                instance.texture_name = scene->primitives_[primitive].texture_name;
+
+                for (uint32_t r = 0; r < 3; ++r)
+                {
+                    for (uint32_t c = 0; c < 4; ++c)
+                    {
+                        instance.transform[4 * r + c] = static_cast<float>(transform[c * 4 + r]);
+                    }
+                }
+
+                scene->instances_.push_back(std::move(instance));
+            }
+
+            if (!mesh_primitives[mesh].empty() && !IsSimilarity(transform))
+            {
+                ++non_similar_count;
+            }
+        }
+
+        auto& children = GetArray(node, "children");
+        for (auto child = children.crbegin(); child != children.crend(); ++child)
+        {
+            stack.emplace_back(ToIndex(document, &*child, "child node", nodes.size()), transform);
+        }
+    }
+
+    if (non_similar_count > 0)
+    {
+        warn("GltfLoader: {} nodes of {} have non-uniform scale, their normals are approximate",
+             non_similar_count,
+             file_name);
+    }
+
+    info("GltfLoader: {} primitives with {} instances, {} streams used in place, {} converted",
+         scene->primitives_.size(),
+         scene->instances_.size(),
+         scene->mapped_stream_count_,
+         scene->converted_stream_count_);
+
+    return scene;
+}
+}  // namespace capsaicin
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/common.h"
+#include "src/utils/mapped_file.h"
+
+namespace capsaicin
+{
+// glTF 2.0 scene from a .glb file or a .gltf file with external buffers, which stay
+// memory-mapped. Streams whose accessors already have the source layout of GeometryStorage
+// (tightly packed float positions, normals and texcoords and uint32 indices) point into the
+// mapping, others are converted once at load. Every triangle primitive becomes a mesh and
+// every node with a glTF mesh an instance of its primitives, so mesh reuse carries over to
+// shared BLASes. Texture names are image URIs, resolved like OBJ texture names.
+class GltfScene
+{
+public:
+    // Whether the file name has a .gltf or .glb extension.
+    static bool IsGltfFile(const std::string& file_name);
+
+    // Map the file and its buffers and convert streams which can't be used in place on the
+    // subflow, throws if the file is malformed or requires an unsupported extension. Joins
+    // the subflow.
+    static std::unique_ptr<GltfScene> Load(const std::string& file_name, tf::Subflow& subflow);
+
+    uint32_t mesh_count() const { return static_cast<uint32_t>(primitives_.size()); }
+    uint32_t instance_count() const { return static_cast<uint32_t>(instances_.size()); }
+    // Mesh streams pointing into the mapped buffers or converted copies.
+    MeshView mesh(uint32_t index) const { return primitives_[index].view; }
+    // Instance with its base color texture name, texture_index is left unresolved.
+    MeshInstance instance(uint32_t index) const { return instances_[index]; }
+
+    // External buffer files the scene was loaded from.
+    const std::vector<std::string>& buffer_files() const { return buffer_files_; }
+
+    // Streams used in place and converted, for statistics.
+    uint32_t mapped_stream_count() const { return mapped_stream_count_; }
+    uint32_t converted_stream_count() const { return converted_stream_count_; }
+
+private:
+    // Triangle primitive, converted streams are owned by it.
+    struct Primitive
+    {
+        MeshView              view;
+        std::string           texture_name;
+        std::vector<float>    positions;
+        std::vector<float>    normals;
+        std::vector<float>    texcoords;
+        std::vector<uint32_t> indices;
+    };
+
+    GltfScene() = default;
+
+    std::vector<std::unique_ptr<MappedFile>> files_;
+    std::vector<Primitive>                   primitives_;
+    std::vector<MeshInstance>                instances_;
+    std::vector<std::string>                 buffer_files_;
+    uint32_t                                 mapped_stream_count_    = 0;
+    uint32_t                                 converted_stream_count_ = 0;
+};
+}  // namespace capsaicin
@@ -0,0 +1,443 @@
+#include "image.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAPSAICIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "src/asset/chunked_file.h"
+#include "src/utils/mapped_file.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "src/utils/stb_image.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kMagic   = 0x58455443;  // "CTEX"
+constexpr uint32_t kVersion = 4;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint32_t format;
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;
+};
+
+// Linear values are quantized to 16 bits for encoding, which is finer than sRGB steps.
+constexpr uint32_t kEncodeTableSize = 1 << 16;
+constexpr float    kEncodeScale     = kEncodeTableSize - 1;
+constexpr float    kAlphaScale      = 255.f;
+
+// sRGB bytes to linear values.
+const float* GetDecodeTable()
+{
+    static const auto table = [] {
+        std::array<float, 256> values;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            auto c    = static_cast<float>(i) / 255.f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Quantized linear values to sRGB bytes.
+const uint8_t* GetEncodeTable()
+{
+    static const auto table = [] {
+        std::vector<uint8_t> bytes(kEncodeTableSize);
+        for (uint32_t i = 0; i < kEncodeTableSize; ++i)
+        {
+            auto l   = static_cast<float>(i) / kEncodeScale;
+            auto c   = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+            bytes[i] = static_cast<uint8_t>(c * 255.f + 0.5f);
+        }
+        return bytes;
+    }();
+    return table.data();
+}
+
+// Average the 2x2 texels in linear space. Color is sRGB encoded and alpha is linear. The
+// scalar path follows the SIMD one operation by operation, so both produce identical bits.
+void FilterTexel(const uint8_t* const* texels,
+                 const float*          decode_table,
+                 const uint8_t*        encode_table,
+                 uint8_t*              out)
+{
+    int32_t quantized[4];
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        float values[4];
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            values[i] = c < 3 ? decode_table[texels[i][c]] : texels[i][c] * (1.f / kAlphaScale);
+        }
+
+        auto average = ((values[0] + values[1]) + (values[2] + values[3])) * 0.25f;
+        average      = std::min(std::max(average, 0.f), 1.f);
+        quantized[c] = static_cast<int32_t>(average * (c < 3 ? kEncodeScale : kAlphaScale) + 0.5f);
+    }
+
+    out[0] = encode_table[quantized[0]];
+    out[1] = encode_table[quantized[1]];
+    out[2] = encode_table[quantized[2]];
+    out[3] = static_cast<uint8_t>(quantized[3]);
+}
+
+#ifdef CAPSAICIN_SSE2
+// RGBA texel to linear values in a vector.
+__m128 DecodeTexel(const uint8_t* texel, const float* decode_table)
+{
+    return _mm_set_ps(texel[3] * (1.f / kAlphaScale),
+                      decode_table[texel[2]],
+                      decode_table[texel[1]],
+                      decode_table[texel[0]]);
+}
+
+void FilterTexelSse2(const uint8_t* const* texels,
+                     const float*          decode_table,
+                     const uint8_t*        encode_table,
+                     uint8_t*              out)
+{
+    auto a = DecodeTexel(texels[0], decode_table);
+    auto b = DecodeTexel(texels[1], decode_table);
+    auto c = DecodeTexel(texels[2], decode_table);
+    auto d = DecodeTexel(texels[3], decode_table);
+
+    auto average = _mm_mul_ps(_mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)), _mm_set1_ps(0.25f));
+    average      = _mm_min_ps(_mm_max_ps(average, _mm_setzero_ps()), _mm_set1_ps(1.f));
+
+    auto scale     = _mm_set_ps(kAlphaScale, kEncodeScale, kEncodeScale, kEncodeScale);
+    auto quantized = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(average, scale), _mm_set1_ps(0.5f)));
+
+    alignas(16) int32_t values[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(values), quantized);
+
+    out[0] = encode_table[values[0]];
+    out[1] = encode_table[values[1]];
+    out[2] = encode_table[values[2]];
+    out[3] = static_cast<uint8_t>(values[3]);
+}
+#endif
+
+// Filter the level above into the level, odd dimensions clamp the second tap to the edge.
+template <typename F>
+void FilterLevel(const std::vector<uint8_t>& src,
+                 uint32_t                    src_width,
+                 uint32_t                    src_height,
+                 uint32_t                    width,
+                 uint32_t                    height,
+                 uint8_t*                    dst,
+                 F&&                         filter)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        auto row0 = src.data() + std::min(2 * y, src_height - 1) * src_width * 4;
+        auto row1 = src.data() + std::min(2 * y + 1, src_height - 1) * src_width * 4;
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            auto x0 = std::min(2 * x, src_width - 1) * 4;
+            auto x1 = std::min(2 * x + 1, src_width - 1) * 4;
+
+            const uint8_t* texels[4] = {row0 + x0, row0 + x1, row1 + x0, row1 + x1};
+            filter(texels, dst + (y * width + x) * 4);
+        }
+    }
+}
+
+void GenerateMips(ImageData& image, bool simd)
+{
+    image.mips.resize(1);
+
+    auto mip_count = 1u;
+    while (std::max(image.width, image.height) >> mip_count)
+    {
+        ++mip_count;
+    }
+
+    auto decode_table = GetDecodeTable();
+    auto encode_table = GetEncodeTable();
+
+    for (uint32_t level = 1; level < mip_count; ++level)
+    {
+        auto src_width  = MipDimension(image.width, level - 1);
+        auto src_height = MipDimension(image.height, level - 1);
+        auto width      = MipDimension(image.width, level);
+        auto height     = MipDimension(image.height, level);
+
+        auto& src = image.mips[level - 1];
+        auto  dst = std::vector<uint8_t>(width * height * 4);
+
+#ifdef CAPSAICIN_SSE2
+        if (simd)
+        {
+            FilterLevel(src,
+                        src_width,
+                        src_height,
+                        width,
+                        height,
+                        dst.data(),
+                        [=](const uint8_t* const* texels, uint8_t* out) {
+                            FilterTexelSse2(texels, decode_table, encode_table, out);
+                        });
+        }
+        else
+#endif
+        {
+            FilterLevel(src,
+                        src_width,
+                        src_height,
+                        width,
+                        height,
+                        dst.data(),
+                        [=](const uint8_t* const* texels, uint8_t* out) {
+                            FilterTexel(texels, decode_table, encode_table, out);
+                        });
+        }
+
+        image.mips.push_back(std::move(dst));
+    }
+}
+}  // namespace
+
+bool LoadImageFile(const std::string& file_name, ImageData& image)
+{
+    int  res_x, res_y;
+    int  channels;
+    auto data = stbi_load(file_name.c_str(), &res_x, &res_y, &channels, 4);
+
+    if (!data)
+    {
+        return false;
+    }
+
+    image.width  = static_cast<uint32_t>(res_x);
+    image.height = static_cast<uint32_t>(res_y);
+    image.format = TextureFormat::kRGBA8;
+    image.mips.resize(1);
+    image.mips[0].assign(data, data + res_x * res_y * 4);
+
+    stbi_image_free(data);
+    return true;
+}
+
+void GenerateMips(ImageData& image)
+{
+    GenerateMips(image, true);
+}
+
+void GenerateMipsScalar(ImageData& image)
+{
+    GenerateMips(image, false);
+}
+
+std::size_t MipSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t level)
+{
+    auto level_width  = std::size_t(MipDimension(width, level));
+    auto level_height = std::size_t(MipDimension(height, level));
+
+    switch (format)
+    {
+    case TextureFormat::kBC1:
+        return ((level_width + 3) / 4) * ((level_height + 3) / 4) * 8;
+    case TextureFormat::kBC7:
+        return ((level_width + 3) / 4) * ((level_height + 3) / 4) * 16;
+    default:
+        return level_width * level_height * 4;
+    }
+}
+
+std::string CookedTextureFileName(const std::string& file_name)
+{
+    return file_name + ".ctex";
+}
+
+void WriteCookedTexture(const std::string& file_name,
+                        const SourceInfo&  source,
+                        const ImageData&   image)
+{
+    Header header       = {};
+    header.magic        = kMagic;
+    header.version      = kVersion;
+    header.width        = image.width;
+    header.height       = image.height;
+    header.mip_count    = static_cast<uint32_t>(image.mips.size());
+    header.format       = static_cast<uint32_t>(image.format);
+    header.source_size  = source.size;
+    header.source_mtime = source.mtime;
+    header.source_hash  = source.hash;
+
+    auto temp_file_name = file_name + ".tmp";
+
+    {
+        std::ofstream out(temp_file_name, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        for (auto& mip : image.mips)
+        {
+            out.write(reinterpret_cast<const char*>(mip.data()),
+                      static_cast<std::streamsize>(mip.size()));
+        }
+
+        if (!out)
+        {
+            error("CookedTexture: Couldn't write {}", file_name);
+            throw std::runtime_error("CookedTexture: Couldn't write " + file_name);
+        }
+    }
+
+    std::filesystem::rename(temp_file_name, file_name);
+}
+
+bool LoadCookedTexture(const std::string& file_name,
+                       const std::string& source_file_name,
+                       ImageData&         image)
+{
+    return LoadCookedTextureMips(file_name, source_file_name, 0, ~0u, image);
+}
+
+bool LoadCookedTextureMips(const std::string& file_name,
+                           const std::string& source_file_name,
+                           uint32_t           first_mip,
+                           uint32_t           last_mip,
+                           ImageData&         image)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(file_name, ec))
+    {
+        return false;
+    }
+
+    // Chunked textures decompress only the blocks of the mips read. Plain ones are mapped
+    // once their header is read, so that the modification time of the source can be updated.
+    auto     chunked   = ChunkedFile::Open(file_name);
+    uint64_t file_size = chunked ? chunked->size() : std::filesystem::file_size(file_name, ec);
+    if (ec || file_size < sizeof(Header))
+    {
+        return false;
+    }
+
+    Header header;
+    if (chunked)
+    {
+        if (!chunked->Read(0, sizeof(Header), &header))
+        {
+            warn("CookedTexture: {} is corrupt or outdated", file_name);
+            return false;
+        }
+    }
+    else
+    {
+        std::ifstream in(file_name, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(Header)))
+        {
+            warn("CookedTexture: {} is corrupt or outdated", file_name);
+            return false;
+        }
+    }
+
+    if (header.magic != kMagic || header.version != kVersion || header.mip_count == 0 ||
+        header.mip_count > 32 || header.format > static_cast<uint32_t>(TextureFormat::kBC7))
+    {
+        warn("CookedTexture: {} is corrupt or outdated", file_name);
+        return false;
+    }
+
+    // Textures without a source next to them are used as is. Sources touched without being
+    // changed aren't hashed again by the next load, chunked textures keep hashing them.
+    if (!source_file_name.empty() && std::filesystem::exists(source_file_name, ec))
+    {
+        SourceInfo source;
+        source.size  = header.source_size;
+        source.mtime = header.source_mtime;
+        source.hash  = header.source_hash;
+
+        auto touched = false;
+        if (!IsSourceUnchanged(source_file_name, source, touched))
+        {
+            info("CookedTexture: {} is stale", file_name);
+            return false;
+        }
+
+        if (touched && !chunked)
+        {
+            header.source_mtime = source.mtime;
+
+            std::fstream out(file_name, std::ios::binary | std::ios::in | std::ios::out);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        }
+    }
+
+    std::unique_ptr<MappedFile> file;
+    if (!chunked)
+    {
+        file = std::make_unique<MappedFile>(file_name);
+        if (file->size() != file_size)
+        {
+            warn("CookedTexture: {} is corrupt or outdated", file_name);
+            return false;
+        }
+    }
+
+    auto read = [&chunked, &file](uint64_t offset, uint64_t size, void* out) {
+        if (chunked)
+        {
+            return chunked->Read(offset, size, out);
+        }
+
+        std::memcpy(out, file->data() + offset, size);
+        return true;
+    };
+
+    // Check the whole chain fits before copying anything.
+    auto        format = static_cast<TextureFormat>(header.format);
+    std::size_t size   = sizeof(Header);
+    for (uint32_t level = 0; level < header.mip_count; ++level)
+    {
+        size += MipSize(format, header.width, header.height, level);
+    }
+
+    if (size != file_size)
+    {
+        warn("CookedTexture: {} is corrupt or outdated", file_name);
+        return false;
+    }
+
+    image.width  = header.width;
+    image.height = header.height;
+    image.format = format;
+    image.mips.assign(header.mip_count, std::vector<uint8_t>());
+
+    uint64_t offset = sizeof(Header);
+    for (uint32_t level = 0; level < header.mip_count; ++level)
+    {
+        auto mip_size = MipSize(format, header.width, header.height, level);
+        if (level >= first_mip && level <= last_mip)
+        {
+            image.mips[level].resize(mip_size);
+            if (!read(offset, mip_size, image.mips[level].data()))
+            {
+                warn("CookedTexture: {} is corrupt or outdated", file_name);
+                return false;
+            }
+        }
+        offset += mip_size;
+    }
+
+    return true;
+}
+}  // namespace capsaicin
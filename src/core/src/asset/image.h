@@ -0,0 +1,63 @@
+#pragma once
+
+#include "src/asset/source_info.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Texel formats of images, block compressed formats store 4x4 texel blocks row by row.
+enum class TextureFormat : uint32_t
+{
+    kRGBA8,
+    // 8 byte blocks of opaque colour.
+    kBC1,
+    // 16 byte blocks of colour and alpha.
+    kBC7
+};
+
+// Image with its mip chain, mip 0 first, 8-bit RGBA unless it is block compressed.
+struct ImageData
+{
+    uint32_t                          width  = 0;
+    uint32_t                          height = 0;
+    TextureFormat                     format = TextureFormat::kRGBA8;
+    std::vector<std::vector<uint8_t>> mips;
+};
+
+inline uint32_t MipDimension(uint32_t dimension, uint32_t level)
+{
+    return std::max(dimension >> level, 1u);
+}
+
+// Bytes of the mip level, block compressed levels are padded to whole blocks.
+std::size_t MipSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t level);
+
+// Decode an image file into mip 0, returns false if the file is missing or can't be decoded.
+bool LoadImageFile(const std::string& file_name, ImageData& image);
+
+// Box filter RGBA8 mip 0 down to 1x1 in linear space, replacing any existing mips. Color is sRGB
+// encoded and alpha is linear. Texels are filtered with SSE2 where it is available.
+void GenerateMips(ImageData& image);
+// Scalar GenerateMips, which produces identical mips, as a reference for benchmarks.
+void GenerateMipsScalar(ImageData& image);
+
+// Cooked texture file name for the source image.
+std::string CookedTextureFileName(const std::string& file_name);
+
+// Cooked textures are RGBA8 or block compressed mip chains ready to be copied to the GPU,
+// loaded from plain or chunked files. They record the source image they were cooked from and
+// fail to load once it changed, unless source_file_name is empty or the source is missing.
+void WriteCookedTexture(const std::string& file_name,
+                        const SourceInfo&  source,
+                        const ImageData&   image);
+bool LoadCookedTexture(const std::string& file_name,
+                       const std::string& source_file_name,
+                       ImageData&         image);
+// Load the mips from first_mip to last_mip and read only their bytes, the other mips of the
+// image are left empty. A first mip past the last one reads the size and format alone.
+bool LoadCookedTextureMips(const std::string& file_name,
+                           const std::string& source_file_name,
+                           uint32_t           first_mip,
+                           uint32_t           last_mip,
+                           ImageData&         image);
+}  // namespace capsaicin
@@ -0,0 +1,67 @@
+#include "index_codec.h"
+
+namespace capsaicin
+{
+void NarrowIndices(const uint32_t* indices, uint32_t count, uint16_t* out)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        out[i] = static_cast<uint16_t>(indices[i]);
+    }
+
+    if (count & 1)
+    {
+        out[count] = 0;
+    }
+}
+
+void EncodeIndices(const uint32_t* indices, uint32_t count, std::vector<uint8_t>& out)
+{
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // Wrapping difference, zigzag maps small negative deltas to small codes.
+        auto delta = static_cast<int32_t>(indices[i] - prev);
+        auto code  = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+        prev       = indices[i];
+
+        while (code >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(code | 0x80));
+            code >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(code));
+    }
+}
+
+bool DecodeIndices(const uint8_t* data, std::size_t size, uint32_t count, uint32_t* out)
+{
+    auto end = data + size;
+
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t code = 0;
+        for (uint32_t shift = 0;; shift += 7)
+        {
+            if (data == end || shift > 28)
+            {
+                return false;
+            }
+
+            auto byte = *data++;
+            code |= static_cast<uint32_t>(byte & 0x7f) << shift;
+
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+
+        prev += (code >> 1) ^ (0u - (code & 1));
+        out[i] = prev;
+    }
+
+    return data == end;
+}
+}  // namespace capsaicin
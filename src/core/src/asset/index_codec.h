@@ -0,0 +1,32 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Meshes with at most this many vertices are stored with 16-bit indices.
+constexpr uint32_t kMaxIndex16VertexCount = 1u << 16;
+
+inline bool FitsIndex16(uint32_t vertex_count)
+{
+    return vertex_count <= kMaxIndex16VertexCount;
+}
+
+// Number of 32-bit words taken by count indices of the given width, 16-bit index ranges
+// are padded to a whole word so that every mesh starts word aligned.
+inline uint32_t IndexWordCount(uint32_t count, uint32_t index_stride)
+{
+    return index_stride == sizeof(uint16_t) ? (count + 1) / 2 : count;
+}
+
+// Narrow indices to 16 bits, out holds IndexWordCount(count, 2) words and the padding
+// half of an odd count is zeroed.
+void NarrowIndices(const uint32_t* indices, uint32_t count, uint16_t* out);
+
+// Compress indices as zigzag encoded deltas to the previous index, LEB128 varints.
+// Indices in vertex first use order mostly take a single byte.
+void EncodeIndices(const uint32_t* indices, uint32_t count, std::vector<uint8_t>& out);
+
+// Decode count indices, returns false if the data is truncated or has trailing bytes.
+bool DecodeIndices(const uint8_t* data, std::size_t size, uint32_t count, uint32_t* out);
+}  // namespace capsaicin
@@ -0,0 +1,230 @@
+#include "lz4_codec.h"
+
+#include <cstring>
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kMinMatch = 4;
+// The last match starts at least 12 bytes before the end and the block ends with at least
+// 5 literals, so that decoders may copy in wide words.
+constexpr std::size_t kMatchStartLimit = 12;
+constexpr std::size_t kLastLiterals    = 5;
+constexpr std::size_t kMaxOffset       = 65535;
+constexpr uint32_t    kHashBits        = 14;
+// Positions are stored one based, 0 is an empty hash table slot.
+constexpr uint32_t kNoPosition = 0;
+
+uint32_t Read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// Lengths from 15 on continue in bytes of 255, ending with a byte below 255.
+uint8_t* WriteLength(uint8_t* op, std::size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        *op++ = 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+uint8_t* WriteSequence(uint8_t*       op,
+                       const uint8_t* literals,
+                       std::size_t    literal_count,
+                       std::size_t    offset,
+                       std::size_t    match_length)
+{
+    auto token = op++;
+    *token     = static_cast<uint8_t>(std::min<std::size_t>(literal_count, 15) << 4);
+    if (literal_count >= 15)
+    {
+        op = WriteLength(op, literal_count - 15);
+    }
+
+    if (literal_count > 0)
+    {
+        std::memcpy(op, literals, literal_count);
+        op += literal_count;
+    }
+
+    // The last sequence only has literals.
+    if (match_length == 0)
+    {
+        return op;
+    }
+
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+
+    auto length = match_length - kMinMatch;
+    *token |= static_cast<uint8_t>(std::min<std::size_t>(length, 15));
+    if (length >= 15)
+    {
+        op = WriteLength(op, length - 15);
+    }
+
+    return op;
+}
+
+// Add the continuation bytes of a length, false if they run past the end.
+bool ReadLength(const uint8_t*& ip, const uint8_t* end, std::size_t& length)
+{
+    uint8_t byte;
+    do
+    {
+        if (ip == end)
+        {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+}  // namespace
+
+std::size_t Lz4Compress(const uint8_t* data, std::size_t size, uint8_t* out)
+{
+    auto op     = out;
+    auto anchor = std::size_t(0);
+
+    if (size > kMatchStartLimit)
+    {
+        std::vector<uint32_t> table(std::size_t(1) << kHashBits, kNoPosition);
+
+        auto match_start_limit = size - kMatchStartLimit;
+        auto match_end_limit   = size - kLastLiterals;
+
+        std::size_t ip = 0;
+        while (ip < match_start_limit)
+        {
+            auto  sequence  = Read32(data + ip);
+            auto& slot      = table[Hash(sequence)];
+            auto  candidate = slot;
+            slot            = static_cast<uint32_t>(ip + 1);
+
+            if (candidate == kNoPosition || ip + 1 - candidate > kMaxOffset ||
+                Read32(data + candidate - 1) != sequence)
+            {
+                // Skip faster through data which doesn't match, like the reference encoder.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            auto match = std::size_t(candidate - 1);
+
+            // Extend the match backwards over the pending literals and forwards.
+            while (ip > anchor && match > 0 && data[ip - 1] == data[match - 1])
+            {
+                --ip;
+                --match;
+            }
+
+            auto length = std::size_t(kMinMatch);
+            while (ip + length < match_end_limit && data[ip + length] == data[match + length])
+            {
+                ++length;
+            }
+
+            op = WriteSequence(op, data + anchor, ip - anchor, ip - match, length);
+            ip += length;
+            anchor = ip;
+
+            // Index a position inside the match, so that the next one can start right there.
+            if (ip - 2 < match_start_limit)
+            {
+                table[Hash(Read32(data + ip - 2))] = static_cast<uint32_t>(ip - 1);
+            }
+        }
+    }
+
+    op = WriteSequence(op, data + anchor, size - anchor, 0, 0);
+    return static_cast<std::size_t>(op - out);
+}
+
+bool Lz4Decompress(const uint8_t* data, std::size_t size, uint8_t* out, std::size_t out_size)
+{
+    auto ip      = data;
+    auto end     = data + size;
+    auto op      = out;
+    auto out_end = out + out_size;
+
+    for (;;)
+    {
+        if (ip == end)
+        {
+            return false;
+        }
+
+        auto token         = *ip++;
+        auto literal_count = std::size_t(token >> 4);
+        if (literal_count == 15 && !ReadLength(ip, end, literal_count))
+        {
+            return false;
+        }
+
+        if (literal_count > std::size_t(end - ip) || literal_count > std::size_t(out_end - op))
+        {
+            return false;
+        }
+
+        if (literal_count > 0)
+        {
+            std::memcpy(op, ip, literal_count);
+            ip += literal_count;
+            op += literal_count;
+        }
+
+        if (ip == end)
+        {
+            return op == out_end;
+        }
+
+        if (end - ip < 2)
+        {
+            return false;
+        }
+
+        auto offset = std::size_t(ip[0]) | (std::size_t(ip[1]) << 8);
+        ip += 2;
+
+        auto length = std::size_t(token & 15);
+        if (length == 15 && !ReadLength(ip, end, length))
+        {
+            return false;
+        }
+        length += kMinMatch;
+
+        if (offset == 0 || offset > std::size_t(op - out) || length > std::size_t(out_end - op))
+        {
+            return false;
+        }
+
+        // Matches may overlap their own output, which repeats the offset bytes.
+        auto match = op - offset;
+        if (offset >= length)
+        {
+            std::memcpy(op, match, length);
+            op += length;
+        }
+        else
+        {
+            for (std::size_t i = 0; i < length; ++i)
+            {
+                *op++ = match[i];
+            }
+        }
+    }
+}
+}  // namespace capsaicin
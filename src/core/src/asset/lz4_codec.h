@@ -0,0 +1,21 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Largest compressed size of size bytes, incompressible data grows slightly.
+inline std::size_t Lz4CompressBound(std::size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Compress the data as an LZ4 block, out holds Lz4CompressBound(size) bytes. Returns the
+// compressed size. Matches are found greedily through a hash table of 4 byte sequences,
+// which favours decompression speed over ratio like the reference fast mode.
+std::size_t Lz4Compress(const uint8_t* data, std::size_t size, uint8_t* out);
+
+// Decompress an LZ4 block of exactly out_size bytes, returns false if the block is corrupt,
+// truncated or decompresses to a different size. Never reads or writes out of bounds.
+bool Lz4Decompress(const uint8_t* data, std::size_t size, uint8_t* out, std::size_t out_size);
+}  // namespace capsaicin
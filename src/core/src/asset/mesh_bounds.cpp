@@ -0,0 +1,149 @@
+#include "mesh_bounds.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace capsaicin
+{
+BoundsComponent TransformBounds(const Bounds& bounds, float radius, const float* transform)
+{
+    BoundsComponent result;
+
+    float center[3], half_extent[3];
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        center[c]      = 0.5f * (bounds.min[c] + bounds.max[c]);
+        half_extent[c] = 0.5f * (bounds.max[c] - bounds.min[c]);
+    }
+
+    // Extents of the transformed box are the absolute transform of the extents.
+    auto scale = 0.f;
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+        auto row    = transform + 4 * r;
+        auto extent = 0.f;
+
+        result.center[r] = row[3];
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            result.center[r] += row[c] * center[c];
+            extent += std::abs(row[c]) * half_extent[c];
+        }
+
+        result.box.min[r] = result.center[r] - extent;
+        result.box.max[r] = result.center[r] + extent;
+
+        scale = std::max(scale, std::sqrt(row[0] * row[0] + row[1] * row[1] + row[2] * row[2]));
+    }
+
+    result.radius = radius * scale;
+    return result;
+}
+
+Bounds UnionBounds(const std::vector<BoundsComponent>& bounds)
+{
+    Bounds result;
+    if (bounds.empty())
+    {
+        return result;
+    }
+
+    result = bounds.front().box;
+    for (auto& b : bounds)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            result.min[c] = std::min(result.min[c], b.box.min[c]);
+            result.max[c] = std::max(result.max[c], b.box.max[c]);
+        }
+    }
+    return result;
+}
+
+float SquaredDistance(const Bounds& box, const float* point)
+{
+    auto distance2 = 0.f;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        auto d = std::max({box.min[c] - point[c], 0.f, point[c] - box.max[c]});
+        distance2 += d * d;
+    }
+    return distance2;
+}
+
+bool Overlaps(const Bounds& a, const Bounds& b)
+{
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        if (a.max[c] < b.min[c] || b.max[c] < a.min[c])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+float ProjectedSize(const BoundsComponent& bounds, const float* eye)
+{
+    auto distance2 = 0.f;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        auto d = bounds.center[c] - eye[c];
+        distance2 += d * d;
+    }
+
+    if (distance2 <= bounds.radius * bounds.radius)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    return bounds.radius / std::sqrt(distance2);
+}
+
+std::vector<uint32_t> QueryBox(const std::vector<BoundsComponent>& bounds, const Bounds& box)
+{
+    std::vector<uint32_t> result;
+    for (uint32_t i = 0; i < bounds.size(); ++i)
+    {
+        if (Overlaps(bounds[i].box, box))
+        {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::vector<uint32_t> QuerySphere(const std::vector<BoundsComponent>& bounds,
+                                  const float*                        center,
+                                  float                               radius)
+{
+    std::vector<uint32_t> result;
+    for (uint32_t i = 0; i < bounds.size(); ++i)
+    {
+        if (SquaredDistance(bounds[i].box, center) <= radius * radius)
+        {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::vector<uint32_t> SortByDistance(const std::vector<BoundsComponent>& bounds,
+                                     const float*                        point)
+{
+    std::vector<float> distances2(bounds.size());
+    for (uint32_t i = 0; i < bounds.size(); ++i)
+    {
+        distances2[i] = SquaredDistance(bounds[i].box, point);
+    }
+
+    // Ties keep their order, so that the result is deterministic.
+    std::vector<uint32_t> order(bounds.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return distances2[a] < distances2[b];
+    });
+    return order;
+}
+}  // namespace capsaicin
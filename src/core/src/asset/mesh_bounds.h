@@ -0,0 +1,41 @@
+#pragma once
+
+#include "src/asset/vertex_quantization.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// World space bounds of a mesh instance, computed at load from the object space bounds of
+// its mesh, so that systems can cull, sort and pick levels of detail per instance without
+// reading vertices.
+struct BoundsComponent
+{
+    Bounds box;
+    // Sphere around the transformed center of the object space box.
+    float center[3] = {0.f, 0.f, 0.f};
+    float radius    = 0.f;
+};
+
+// World space bounds of the object space box and the radius of the sphere around its center,
+// for a row major 3x4 transform. The box is the tight box of the transformed box.
+BoundsComponent TransformBounds(const Bounds& bounds, float radius, const float* transform);
+
+// Box around all bounds, empty bounds at the origin if there are none.
+Bounds UnionBounds(const std::vector<BoundsComponent>& bounds);
+// Squared distance from the point to the box, 0 inside of it.
+float SquaredDistance(const Bounds& box, const float* point);
+bool  Overlaps(const Bounds& a, const Bounds& b);
+// Radius of the sphere over its distance from the eye, proportional to its projected size,
+// or infinity if the eye is inside of it.
+float ProjectedSize(const BoundsComponent& bounds, const float* eye);
+
+// Indices of bounds whose boxes overlap the box, in order.
+std::vector<uint32_t> QueryBox(const std::vector<BoundsComponent>& bounds, const Bounds& box);
+// Indices of bounds whose boxes are within the radius of the point, in order.
+std::vector<uint32_t> QuerySphere(const std::vector<BoundsComponent>& bounds,
+                                  const float*                        center,
+                                  float                               radius);
+// Indices of all bounds sorted front to back by the distance of their boxes from the point.
+std::vector<uint32_t> SortByDistance(const std::vector<BoundsComponent>& bounds,
+                                     const float*                        point);
+}  // namespace capsaicin
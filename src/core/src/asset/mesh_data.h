@@ -0,0 +1,72 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Simplified levels of detail per mesh, not counting the full resolution mesh.
+constexpr uint32_t kMaxMeshLods = 4;
+
+// Simplified index set over the vertices of its mesh.
+struct MeshLod
+{
+    std::vector<uint32_t> indices;
+    // Object space distance the simplified surface may deviate from the original one.
+    float error = 0.f;
+};
+
+// Indexed mesh with separate position / normal / texcoord streams.
+struct MeshData
+{
+    std::vector<float>    positions;
+    std::vector<float>    normals;
+    std::vector<float>    texcoords;
+    std::vector<uint32_t> indices;
+    // Coarser levels of detail, each one about half of the triangles of the previous one.
+    std::vector<MeshLod>  lods;
+    std::string           texture_name;
+    uint32_t              texture_index = ~0u;
+};
+
+struct MeshLodView
+{
+    const uint32_t* indices     = nullptr;
+    uint32_t        index_count = 0;
+    float           error       = 0.f;
+};
+
+// Non-owning view of mesh streams, either in MeshData or in a memory-mapped scene cache.
+struct MeshView
+{
+    const float*    positions     = nullptr;
+    const float*    normals       = nullptr;
+    const float*    texcoords     = nullptr;
+    const uint32_t* indices       = nullptr;
+    uint32_t        vertex_count  = 0;
+    uint32_t        index_count   = 0;
+    uint32_t        texture_index = ~0u;
+    MeshLodView     lods[kMaxMeshLods];
+    uint32_t        lod_count     = 0;
+};
+
+inline MeshView MakeMeshView(const MeshData& mesh_data)
+{
+    MeshView view;
+    view.positions     = mesh_data.positions.data();
+    view.normals       = mesh_data.normals.data();
+    view.texcoords     = mesh_data.texcoords.data();
+    view.indices       = mesh_data.indices.data();
+    view.vertex_count  = static_cast<uint32_t>(mesh_data.positions.size() / 3);
+    view.index_count   = static_cast<uint32_t>(mesh_data.indices.size());
+    view.texture_index = mesh_data.texture_index;
+    view.lod_count     = static_cast<uint32_t>(mesh_data.lods.size());
+
+    for (uint32_t i = 0; i < view.lod_count; ++i)
+    {
+        view.lods[i].indices     = mesh_data.lods[i].indices.data();
+        view.lods[i].index_count = static_cast<uint32_t>(mesh_data.lods[i].indices.size());
+        view.lods[i].error       = mesh_data.lods[i].error;
+    }
+    return view;
+}
+}  // namespace capsaicin
@@ -0,0 +1,323 @@
+#include "mesh_instancing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "src/utils/hash.h"
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+// Fitted positions may be off by this fraction of the mesh size and distance from the origin,
+// which covers rounding of coordinates written as text.
+constexpr double kPositionTolerance = 1e-5;
+// Minimum cosine between fitted and actual normals.
+constexpr double kNormalTolerance = 0.99;
+constexpr int    kMaxJacobiSweeps = 32;
+
+// Transform invariant hash of a mesh and its centered moments.
+struct MeshSignature
+{
+    uint64_t key         = 0;
+    double   centroid[3] = {0.0, 0.0, 0.0};
+    // Root mean square distance of the vertices to the centroid.
+    double radius = 0.0;
+};
+
+MeshSignature ComputeSignature(const MeshData& mesh)
+{
+    MeshSignature signature;
+
+    auto vertex_count = mesh.positions.size() / 3;
+    signature.key =
+        HashBytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), vertex_count);
+    signature.key =
+        HashBytes(mesh.texcoords.data(), mesh.texcoords.size() * sizeof(float), signature.key);
+
+    if (vertex_count == 0)
+    {
+        return signature;
+    }
+
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            signature.centroid[c] += static_cast<double>(mesh.positions[3 * v + c]);
+        }
+    }
+
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        signature.centroid[c] /= static_cast<double>(vertex_count);
+    }
+
+    double sum = 0.0;
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            auto d = static_cast<double>(mesh.positions[3 * v + c]) - signature.centroid[c];
+            sum += d * d;
+        }
+    }
+
+    signature.radius = std::sqrt(sum / static_cast<double>(vertex_count));
+    return signature;
+}
+
+// Eigenvector of the largest eigenvalue of a symmetric 4x4 matrix with cyclic Jacobi
+// rotations, the matrix is destroyed.
+void LargestEigenvector(double a[4][4], double v[4])
+{
+    double e[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+
+    for (int sweep = 0; sweep < kMaxJacobiSweeps; ++sweep)
+    {
+        double off = 0.0, diagonal = 0.0;
+        for (int p = 0; p < 4; ++p)
+        {
+            diagonal += a[p][p] * a[p][p];
+            for (int q = p + 1; q < 4; ++q)
+            {
+                off += a[p][q] * a[p][q];
+            }
+        }
+
+        if (off <= 1e-24 * diagonal)
+        {
+            break;
+        }
+
+        for (int p = 0; p < 4; ++p)
+        {
+            for (int q = p + 1; q < 4; ++q)
+            {
+                if (a[p][q] == 0.0)
+                {
+                    continue;
+                }
+
+                auto theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                auto t     = (theta >= 0.0 ? 1.0 : -1.0) /
+                         (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                auto c = 1.0 / std::sqrt(t * t + 1.0);
+                auto s = t * c;
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    auto kp = a[k][p], kq = a[k][q];
+                    a[k][p] = c * kp - s * kq;
+                    a[k][q] = s * kp + c * kq;
+                }
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    auto pk = a[p][k], qk = a[q][k];
+                    a[p][k] = c * pk - s * qk;
+                    a[q][k] = s * pk + c * qk;
+                }
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    auto kp = e[k][p], kq = e[k][q];
+                    e[k][p] = c * kp - s * kq;
+                    e[k][q] = s * kp + c * kq;
+                }
+            }
+        }
+    }
+
+    int best = 0;
+    for (int i = 1; i < 4; ++i)
+    {
+        if (a[i][i] > a[best][best])
+        {
+            best = i;
+        }
+    }
+
+    for (int k = 0; k < 4; ++k)
+    {
+        v[k] = e[k][best];
+    }
+}
+
+// Fit a similarity transform mapping the prototype onto the mesh with Horn's quaternion
+// method (Horn 1987), vertices correspond by index. Returns false if the fit doesn't
+// reproduce the mesh.
+bool FitTransform(const MeshData&      prototype,
+                  const MeshSignature& prototype_signature,
+                  const MeshData&      mesh,
+                  const MeshSignature& mesh_signature,
+                  float*               transform)
+{
+    // Guard against hash collisions.
+    if (prototype.positions.size() != mesh.positions.size() ||
+        prototype.indices != mesh.indices || prototype.texcoords != mesh.texcoords)
+    {
+        return false;
+    }
+
+    if (prototype_signature.radius == 0.0 || mesh_signature.radius == 0.0)
+    {
+        return false;
+    }
+
+    auto  vertex_count = mesh.positions.size() / 3;
+    auto& ca           = prototype_signature.centroid;
+    auto& cb           = mesh_signature.centroid;
+
+    // Cross covariance of the centered point sets.
+    double s[3][3] = {};
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            auto a = static_cast<double>(prototype.positions[3 * v + i]) - ca[i];
+            for (uint32_t j = 0; j < 3; ++j)
+            {
+                s[i][j] += a * (static_cast<double>(mesh.positions[3 * v + j]) - cb[j]);
+            }
+        }
+    }
+
+    double n[4][4] = {
+        {s[0][0] + s[1][1] + s[2][2], s[1][2] - s[2][1], s[2][0] - s[0][2], s[0][1] - s[1][0]},
+        {s[1][2] - s[2][1], s[0][0] - s[1][1] - s[2][2], s[0][1] + s[1][0], s[2][0] + s[0][2]},
+        {s[2][0] - s[0][2], s[0][1] + s[1][0], -s[0][0] + s[1][1] - s[2][2], s[1][2] + s[2][1]},
+        {s[0][1] - s[1][0], s[2][0] + s[0][2], s[1][2] + s[2][1], -s[0][0] - s[1][1] + s[2][2]}};
+
+    double q[4];
+    LargestEigenvector(n, q);
+
+    auto length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    auto w = q[0] / length, x = q[1] / length, y = q[2] / length, z = q[3] / length;
+
+    double r[3][3] = {{1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y)},
+                      {2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x)},
+                      {2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y)}};
+
+    auto   scale = mesh_signature.radius / prototype_signature.radius;
+    double t[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        t[i] = cb[i] - scale * (r[i][0] * ca[0] + r[i][1] * ca[1] + r[i][2] * ca[2]);
+    }
+
+    auto tolerance =
+        kPositionTolerance *
+        (mesh_signature.radius + std::sqrt(cb[0] * cb[0] + cb[1] * cb[1] + cb[2] * cb[2]));
+
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        double a[3], b[3];
+        std::copy_n(&prototype.positions[3 * v], 3, a);
+        std::copy_n(&mesh.positions[3 * v], 3, b);
+
+        auto error = 0.0;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            auto d = scale * (r[i][0] * a[0] + r[i][1] * a[1] + r[i][2] * a[2]) + t[i] - b[i];
+            error += d * d;
+        }
+
+        if (error > tolerance * tolerance)
+        {
+            return false;
+        }
+    }
+
+    // Vertices without normals are zero in both meshes and pass.
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        double a[3], b[3];
+        std::copy_n(&prototype.normals[3 * v], 3, a);
+        std::copy_n(&mesh.normals[3 * v], 3, b);
+
+        double dot = 0.0, aa = 0.0, bb = 0.0;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            dot += (r[i][0] * a[0] + r[i][1] * a[1] + r[i][2] * a[2]) * b[i];
+            aa += a[i] * a[i];
+            bb += b[i] * b[i];
+        }
+
+        if (dot < kNormalTolerance * std::sqrt(aa * bb))
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            transform[4 * i + j] = static_cast<float>(scale * r[i][j]);
+        }
+        transform[4 * i + 3] = static_cast<float>(t[i]);
+    }
+
+    return true;
+}
+}  // namespace
+
+void InstanceMeshes(std::vector<MeshData>&     meshes,
+                    std::vector<MeshInstance>& instances,
+                    tf::Subflow&               subflow)
+{
+    std::vector<MeshSignature> signatures(meshes.size());
+    ParallelFor(subflow, static_cast<uint32_t>(meshes.size()), [&](uint32_t i) {
+        signatures[i] = ComputeSignature(meshes[i]);
+    });
+
+    // Unique meshes with the same key and their indices after compaction.
+    std::unordered_map<uint64_t, std::vector<uint32_t>> prototypes;
+    std::vector<uint32_t>                               unique_index(meshes.size(), ~0u);
+    uint32_t                                            unique_count = 0;
+
+    for (uint32_t i = 0; i < meshes.size(); ++i)
+    {
+        MeshInstance instance;
+        instance.texture_name  = meshes[i].texture_name;
+        instance.texture_index = meshes[i].texture_index;
+
+        auto& group = prototypes[signatures[i].key];
+        auto  it    = std::find_if(group.cbegin(), group.cend(), [&](uint32_t p) {
+            return FitTransform(
+                meshes[p], signatures[p], meshes[i], signatures[i], instance.transform);
+        });
+
+        if (it != group.cend())
+        {
+            instance.mesh = unique_index[*it];
+        }
+        else
+        {
+            group.push_back(i);
+            unique_index[i] = unique_count++;
+            instance.mesh   = unique_index[i];
+        }
+
+        instances.push_back(std::move(instance));
+    }
+
+    // Drop instanced meshes, keeping the order of the unique ones.
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < meshes.size(); ++i)
+    {
+        if (unique_index[i] != ~0u)
+        {
+            if (count != i)
+            {
+                meshes[count] = std::move(meshes[i]);
+            }
+            ++count;
+        }
+    }
+    meshes.resize(count);
+}
+}  // namespace capsaicin
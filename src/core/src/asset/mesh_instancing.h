@@ -0,0 +1,26 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Placement of a mesh in the scene, with its own material.
+struct MeshInstance
+{
+    uint32_t mesh = 0;
+    // Row major 3x4 transform from mesh to scene space, a similarity transform.
+    float       transform[12] = {1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f};
+    std::string texture_name;
+    uint32_t    texture_index = ~0u;
+};
+
+// Find meshes which are a rotated, uniformly scaled and translated copy of an earlier mesh
+// and replace them with instances of it. Candidates are grouped by a hash of the transform
+// invariant part of the mesh (topology and texcoords), and the transform is fitted with
+// Horn's closed form solution and verified on all vertices and normals. Every input mesh
+// becomes an instance, in input order, and meshes keeps the unique ones.
+void InstanceMeshes(std::vector<MeshData>&     meshes,
+                    std::vector<MeshInstance>& instances,
+                    tf::Subflow&               subflow);
+}  // namespace capsaicin
@@ -0,0 +1,264 @@
+#include "mesh_optimizer.h"
+
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kCacheLineSize  = 64;
+constexpr uint32_t kFetchCacheSize = 32;
+constexpr uint32_t kInvalidIndex   = ~0u;
+
+// Triangles using each of the vertices, in compressed row form.
+struct VertexAdjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    VertexAdjacency(const std::vector<uint32_t>& indices, uint32_t vertex_count)
+        : offsets(vertex_count + 1, 0), triangles(indices.size())
+    {
+        for (auto index : indices)
+        {
+            ++offsets[index + 1];
+        }
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+
+        auto fill = offsets;
+        for (uint32_t i = 0; i < indices.size(); ++i)
+        {
+            triangles[fill[indices[i]]++] = i / 3;
+        }
+    }
+};
+}  // namespace
+
+MeshStats& MeshStats::operator+=(const MeshStats& other)
+{
+    triangle_count += other.triangle_count;
+    vertex_count += other.vertex_count;
+    transformed_vertices += other.transformed_vertices;
+    fetched_bytes += other.fetched_bytes;
+    return *this;
+}
+
+MeshStats AnalyzeMesh(const MeshData& mesh, uint32_t cache_size)
+{
+    MeshStats stats;
+    stats.triangle_count = mesh.indices.size() / 3;
+    stats.vertex_count   = mesh.positions.size() / 3;
+
+    constexpr uint32_t kStride   = 3 * sizeof(float);
+    auto               num_lines = ceil_divide(stats.vertex_count * kStride, kCacheLineSize);
+
+    // FIFO caches are emulated with insertion timestamps: an entry is cached while
+    // fewer than cache size entries have been inserted after it.
+    std::vector<uint64_t> vertex_time(stats.vertex_count, 0);
+    std::vector<uint64_t> line_time(num_lines, 0);
+    uint64_t              vertex_clock = cache_size + 1;
+    uint64_t              line_clock   = kFetchCacheSize + 1;
+
+    for (auto index : mesh.indices)
+    {
+        if (vertex_clock - vertex_time[index] <= cache_size)
+        {
+            continue;
+        }
+
+        vertex_time[index] = vertex_clock++;
+        ++stats.transformed_vertices;
+
+        auto first_line = index * kStride / kCacheLineSize;
+        auto last_line  = (index * kStride + kStride - 1) / kCacheLineSize;
+        for (auto line = first_line; line <= last_line; ++line)
+        {
+            if (line_clock - line_time[line] > kFetchCacheSize)
+            {
+                line_time[line] = line_clock++;
+                stats.fetched_bytes += kCacheLineSize;
+            }
+        }
+    }
+
+    return stats;
+}
+
+void OptimizeTriangleOrder(std::vector<uint32_t>& indices,
+                           uint32_t               vertex_count,
+                           uint32_t               cache_size)
+{
+    auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+    if (triangle_count == 0)
+    {
+        return;
+    }
+
+    VertexAdjacency adjacency(indices, vertex_count);
+
+    // Number of not yet emitted triangles using the vertex.
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        live_triangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+
+    std::vector<uint64_t> cache_time(vertex_count, 0);
+    std::vector<bool>     emitted(triangle_count, false);
+    std::vector<uint32_t> dead_end_stack;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> ordered;
+    ordered.reserve(indices.size());
+
+    uint64_t time   = cache_size + 1;
+    uint32_t cursor = 0;
+    uint32_t fan    = 0;
+
+    while (fan != kInvalidIndex)
+    {
+        // Emit all remaining triangles around the fanning vertex.
+        candidates.clear();
+        for (auto i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1]; ++i)
+        {
+            auto triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                auto v = indices[3 * triangle + k];
+                ordered.push_back(v);
+                dead_end_stack.push_back(v);
+                candidates.push_back(v);
+                --live_triangles[v];
+
+                if (time - cache_time[v] > cache_size)
+                {
+                    cache_time[v] = time++;
+                }
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Prefer the oldest candidate which will still be in the cache after its
+        // remaining triangles are emitted.
+        fan                   = kInvalidIndex;
+        int64_t best_priority = -1;
+        for (auto v : candidates)
+        {
+            if (live_triangles[v] == 0)
+            {
+                continue;
+            }
+
+            int64_t priority = 0;
+            if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size)
+            {
+                priority = static_cast<int64_t>(time - cache_time[v]);
+            }
+
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                fan           = v;
+            }
+        }
+
+        // Dead end, try recently used vertices first, then the next vertex in input order.
+        while (fan == kInvalidIndex && !dead_end_stack.empty())
+        {
+            auto v = dead_end_stack.back();
+            dead_end_stack.pop_back();
+            if (live_triangles[v] > 0)
+            {
+                fan = v;
+            }
+        }
+
+        while (fan == kInvalidIndex && cursor < vertex_count)
+        {
+            if (live_triangles[cursor] > 0)
+            {
+                fan = cursor;
+            }
+            ++cursor;
+        }
+    }
+
+    indices = std::move(ordered);
+}
+
+void OptimizeTriangleOrder(MeshData& mesh, uint32_t cache_size)
+{
+    OptimizeTriangleOrder(
+        mesh.indices, static_cast<uint32_t>(mesh.positions.size() / 3), cache_size);
+}
+
+void OptimizeVertexOrder(MeshData& mesh)
+{
+    auto vertex_count = static_cast<uint32_t>(mesh.positions.size() / 3);
+
+    std::vector<uint32_t> remap(vertex_count, kInvalidIndex);
+    uint32_t              next_vertex = 0;
+
+    for (auto& index : mesh.indices)
+    {
+        if (remap[index] == kInvalidIndex)
+        {
+            remap[index] = next_vertex++;
+        }
+        index = remap[index];
+    }
+
+    std::vector<float> positions(next_vertex * 3);
+    std::vector<float> normals(next_vertex * 3);
+    std::vector<float> texcoords(next_vertex * 2);
+
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        auto new_v = remap[v];
+        if (new_v == kInvalidIndex)
+        {
+            continue;
+        }
+
+        std::copy_n(&mesh.positions[3 * v], 3, &positions[3 * new_v]);
+        std::copy_n(&mesh.normals[3 * v], 3, &normals[3 * new_v]);
+        std::copy_n(&mesh.texcoords[2 * v], 2, &texcoords[2 * new_v]);
+    }
+
+    mesh.positions = std::move(positions);
+    mesh.normals   = std::move(normals);
+    mesh.texcoords = std::move(texcoords);
+}
+
+void OptimizeMeshes(std::vector<MeshData>& meshes,
+                    MeshStats&             before,
+                    MeshStats&             after,
+                    tf::Subflow&           subflow)
+{
+    std::vector<MeshStats> mesh_before(meshes.size());
+    std::vector<MeshStats> mesh_after(meshes.size());
+
+    ParallelFor(subflow, static_cast<uint32_t>(meshes.size()), [&](uint32_t i) {
+        mesh_before[i] = AnalyzeMesh(meshes[i]);
+        OptimizeTriangleOrder(meshes[i]);
+        OptimizeVertexOrder(meshes[i]);
+        mesh_after[i] = AnalyzeMesh(meshes[i]);
+    });
+
+    for (uint32_t i = 0; i < meshes.size(); ++i)
+    {
+        before += mesh_before[i];
+        after += mesh_after[i];
+    }
+}
+}  // namespace capsaicin
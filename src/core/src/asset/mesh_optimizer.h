@@ -0,0 +1,61 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Simulated post-transform cache and vertex fetch counters, summable over meshes.
+struct MeshStats
+{
+    uint64_t triangle_count       = 0;
+    uint64_t vertex_count         = 0;
+    uint64_t transformed_vertices = 0;
+    uint64_t fetched_bytes        = 0;
+
+    // Average cache miss ratio, transformed vertices per triangle (0.5 .. 3).
+    float acmr() const
+    {
+        return triangle_count ? static_cast<float>(transformed_vertices) /
+                                    static_cast<float>(triangle_count)
+                              : 0.f;
+    }
+    // Average transform to vertex ratio (1 is optimal).
+    float atvr() const
+    {
+        return vertex_count ? static_cast<float>(transformed_vertices) /
+                                  static_cast<float>(vertex_count)
+                            : 0.f;
+    }
+    // Fetched position bytes over position data size (1 is optimal).
+    float overfetch() const
+    {
+        return vertex_count ? static_cast<float>(fetched_bytes) /
+                                  static_cast<float>(vertex_count * 3 * sizeof(float))
+                            : 0.f;
+    }
+
+    MeshStats& operator+=(const MeshStats& other);
+};
+
+// Simulate a FIFO vertex cache of the given size and a small cache of 64-byte lines
+// over the position stream.
+MeshStats AnalyzeMesh(const MeshData& mesh, uint32_t cache_size = 16);
+
+// Reorder triangles for the post-transform cache with Tipsify (Sander et al. 2007).
+void OptimizeTriangleOrder(std::vector<uint32_t>& indices,
+                           uint32_t               vertex_count,
+                           uint32_t               cache_size = 16);
+void OptimizeTriangleOrder(MeshData& mesh, uint32_t cache_size = 16);
+
+// Renumber vertices in first use order and reorder vertex streams to match, so that
+// consecutive triangles fetch neighbouring vertices. Unreferenced vertices are dropped.
+void OptimizeVertexOrder(MeshData& mesh);
+
+// Optimize all meshes concurrently on the subflow, accumulating statistics before and
+// after. Joins the subflow.
+void OptimizeMeshes(std::vector<MeshData>& meshes,
+                    MeshStats&             before,
+                    MeshStats&             after,
+                    tf::Subflow&           subflow);
+}  // namespace capsaicin
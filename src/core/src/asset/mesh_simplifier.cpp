@@ -0,0 +1,461 @@
+#include "mesh_simplifier.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "src/asset/mesh_optimizer.h"
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kInvalidIndex = ~0u;
+// Coarser levels are not worth an index set of their own.
+constexpr uint32_t kMinLodTriangleCount = 32;
+// Each level has to drop at least a quarter of the triangles of the previous one.
+constexpr float kMinLodReduction = 0.75f;
+
+// Symmetric 4x4 matrix summing squared distances to a set of planes.
+struct Quadric
+{
+    double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+    double yy = 0.0, yz = 0.0, yw = 0.0;
+    double zz = 0.0, zw = 0.0;
+    double ww = 0.0;
+
+    // Plane ax + by + cz + d = 0 with a unit normal.
+    void AddPlane(double a, double b, double c, double d)
+    {
+        xx += a * a;
+        xy += a * b;
+        xz += a * c;
+        xw += a * d;
+        yy += b * b;
+        yz += b * c;
+        yw += b * d;
+        zz += c * c;
+        zw += c * d;
+        ww += d * d;
+    }
+
+    Quadric& operator+=(const Quadric& q)
+    {
+        xx += q.xx;
+        xy += q.xy;
+        xz += q.xz;
+        xw += q.xw;
+        yy += q.yy;
+        yz += q.yz;
+        yw += q.yw;
+        zz += q.zz;
+        zw += q.zw;
+        ww += q.ww;
+        return *this;
+    }
+
+    double Evaluate(const float* p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        double e = x * x * xx + y * y * yy + z * z * zz + ww +
+                   2.0 * (x * y * xy + x * z * xz + y * z * yz + x * xw + y * yw + z * zw);
+        // Rounding can make the error of an exact fit slightly negative.
+        return std::max(e, 0.0);
+    }
+};
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double   cost;
+};
+
+// Sort key of a collapse, costs are non-negative so their float bits order like the
+// costs, and ties resolve in candidate order.
+uint64_t CollapseKey(double cost, uint32_t index)
+{
+    auto     value = static_cast<float>(cost);
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (uint64_t(bits) << 32) | index;
+}
+
+using PositionKey = std::array<uint32_t, 3>;
+
+struct PositionKeyHash
+{
+    std::size_t operator()(const PositionKey& key) const
+    {
+        auto h = key[0] * 0x9e3779b97f4a7c15ull ^ key[1] * 0xc2b2ae3d27d4eb4full ^
+                 key[2] * 0x165667b19e3779f9ull;
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
+};
+
+// Unnormalized normal of the triangle.
+std::array<double, 3> TriangleNormal(const float* p0, const float* p1, const float* p2)
+{
+    double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    return {e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0]};
+}
+
+double Dot(const std::array<double, 3>& a, const std::array<double, 3>& b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Triangles using each of the vertices, in compressed row form.
+void BuildAdjacency(const std::vector<uint32_t>& indices,
+                    uint32_t                     vertex_count,
+                    std::vector<uint32_t>&       offsets,
+                    std::vector<uint32_t>&       triangles)
+{
+    offsets.assign(vertex_count + 1, 0);
+    triangles.resize(indices.size());
+
+    for (auto index : indices)
+    {
+        ++offsets[index + 1];
+    }
+
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+
+    auto fill = offsets;
+    for (uint32_t i = 0; i < indices.size(); ++i)
+    {
+        triangles[fill[indices[i]]++] = i / 3;
+    }
+}
+}  // namespace
+
+float SimplifyMesh(const float*           positions,
+                   uint32_t               vertex_count,
+                   const uint32_t*        indices,
+                   uint32_t               index_count,
+                   uint32_t               target_index_count,
+                   std::vector<uint32_t>& result)
+{
+    result.assign(indices, indices + index_count);
+
+    if (index_count <= target_index_count)
+    {
+        return 0.f;
+    }
+
+    auto position = [positions](uint32_t v) { return positions + 3 * v; };
+
+    // Vertices split on normals or texcoords share a position, remap points at the
+    // first vertex with the same position.
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint32_t> wedge_count(vertex_count, 0);
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> first_vertex;
+        first_vertex.reserve(vertex_count);
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            PositionKey key;
+            std::memcpy(key.data(), position(v), sizeof(key));
+            remap[v] = first_vertex.emplace(key, v).first->second;
+            ++wedge_count[remap[v]];
+        }
+    }
+
+    // Lock seams and open borders, a border half edge has no opposite half edge.
+    std::vector<bool> locked(vertex_count, false);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        locked[remap[v]] = locked[remap[v]] || wedge_count[remap[v]] > 1;
+    }
+
+    std::vector<uint32_t> offsets, adjacent_triangles;
+    {
+        std::vector<uint32_t> corners(index_count);
+        for (uint32_t i = 0; i < index_count; ++i)
+        {
+            corners[i] = remap[result[i]];
+        }
+
+        BuildAdjacency(corners, vertex_count, offsets, adjacent_triangles);
+
+        auto has_half_edge = [&](uint32_t a, uint32_t b) {
+            for (auto j = offsets[a]; j < offsets[a + 1]; ++j)
+            {
+                auto triangle = &corners[3 * adjacent_triangles[j]];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    if (triangle[k] == a && triangle[(k + 1) % 3] == b)
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        };
+
+        for (uint32_t i = 0; i < index_count; i += 3)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                auto a = corners[i + k], b = corners[i + (k + 1) % 3];
+                if (!has_half_edge(b, a))
+                {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+    }
+
+    // Plane quadrics accumulated on the first vertex of each position.
+    std::vector<Quadric> quadrics(vertex_count);
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        auto p0     = position(result[i]);
+        auto normal = TriangleNormal(p0, position(result[i + 1]), position(result[i + 2]));
+        auto length = std::sqrt(Dot(normal, normal));
+
+        if (length == 0.0)
+        {
+            continue;
+        }
+
+        Quadric q;
+        double  a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+        q.AddPlane(a,
+                   b,
+                   c,
+                   -(a * static_cast<double>(p0[0]) + b * static_cast<double>(p0[1]) +
+                     c * static_cast<double>(p0[2])));
+
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            quadrics[remap[result[i + k]]] += q;
+        }
+    }
+
+    std::vector<uint32_t> collapse(vertex_count, kInvalidIndex);
+    std::vector<bool>     touched(vertex_count);
+    std::vector<Collapse> candidates;
+    std::vector<uint64_t> order;
+
+    double max_error             = 0.0;
+    auto   target_triangle_count = target_index_count / 3;
+
+    // Collapse the cheapest edges in passes, each vertex takes part in at most one collapse
+    // per pass so that costs and flip checks don't go stale.
+    while (result.size() > target_index_count)
+    {
+        BuildAdjacency(result, vertex_count, offsets, adjacent_triangles);
+
+        // Interior edges have a half edge in each direction, so collapsing along half edges
+        // covers both directions once. Unlocked vertices don't share their position, so
+        // they are their own remap.
+        candidates.clear();
+        for (uint32_t i = 0; i < result.size(); i += 3)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                auto from = result[i + k], to = result[i + (k + 1) % 3];
+                if (locked[remap[from]] || remap[from] == remap[to])
+                {
+                    continue;
+                }
+
+                auto q = quadrics[from];
+                q += quadrics[remap[to]];
+                candidates.push_back({from, to, q.Evaluate(position(to))});
+            }
+        }
+
+        order.resize(candidates.size());
+        for (uint32_t i = 0; i < candidates.size(); ++i)
+        {
+            order[i] = CollapseKey(candidates[i].cost, i);
+        }
+        std::sort(order.begin(), order.end());
+
+        auto     triangle_count = static_cast<uint32_t>(result.size() / 3);
+        uint32_t removed        = 0;
+        uint32_t num_collapses  = 0;
+        std::fill(touched.begin(), touched.end(), false);
+
+        for (auto key : order)
+        {
+            auto& candidate = candidates[static_cast<uint32_t>(key)];
+
+            if (triangle_count - removed <= target_triangle_count)
+            {
+                break;
+            }
+
+            auto from = candidate.from, to = remap[candidate.to];
+            if (touched[from] || touched[to])
+            {
+                continue;
+            }
+
+            // Triangles around the vertex either degenerate or keep their orientation.
+            uint32_t degenerate = 0;
+            bool     flips      = false;
+            for (auto j = offsets[from]; j < offsets[from + 1] && !flips; ++j)
+            {
+                auto triangle = &result[3 * adjacent_triangles[j]];
+                if (remap[triangle[0]] == to || remap[triangle[1]] == to ||
+                    remap[triangle[2]] == to)
+                {
+                    ++degenerate;
+                    continue;
+                }
+
+                const float* p[3];
+                const float* moved[3];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    p[k]     = position(triangle[k]);
+                    moved[k] = triangle[k] == from ? position(candidate.to) : p[k];
+                }
+
+                auto n0 = TriangleNormal(p[0], p[1], p[2]);
+                auto n1 = TriangleNormal(moved[0], moved[1], moved[2]);
+                flips   = Dot(n0, n1) <= 0.5 * std::sqrt(Dot(n0, n0) * Dot(n1, n1));
+            }
+
+            if (flips)
+            {
+                continue;
+            }
+
+            collapse[from] = candidate.to;
+            quadrics[to] += quadrics[from];
+            max_error = std::max(max_error, candidate.cost);
+            removed += degenerate;
+            ++num_collapses;
+
+            for (auto j = offsets[from]; j < offsets[from + 1]; ++j)
+            {
+                auto triangle = &result[3 * adjacent_triangles[j]];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    touched[remap[triangle[k]]] = true;
+                }
+            }
+        }
+
+        if (num_collapses == 0)
+        {
+            break;
+        }
+
+        // Apply collapses and drop degenerate triangles.
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t triangle[3];
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                auto v      = result[i + k];
+                triangle[k] = collapse[v] != kInvalidIndex ? collapse[v] : v;
+            }
+
+            if (remap[triangle[0]] != remap[triangle[1]] &&
+                remap[triangle[1]] != remap[triangle[2]] &&
+                remap[triangle[2]] != remap[triangle[0]])
+            {
+                std::copy_n(triangle, 3, &result[count]);
+                count += 3;
+            }
+        }
+        result.resize(count);
+
+        for (auto& candidate : candidates)
+        {
+            collapse[candidate.from] = kInvalidIndex;
+        }
+    }
+
+    return static_cast<float>(std::sqrt(max_error));
+}
+
+void GenerateMeshLods(MeshData& mesh)
+{
+    auto vertex_count = static_cast<uint32_t>(mesh.positions.size() / 3);
+
+    mesh.lods.clear();
+    mesh.lods.reserve(kMaxMeshLods);
+
+    // Each level simplifies the previous one, so their errors add up.
+    const std::vector<uint32_t>* source = &mesh.indices;
+    float                        error  = 0.f;
+
+    for (uint32_t level = 0; level < kMaxMeshLods; ++level)
+    {
+        auto triangle_count = static_cast<uint32_t>(source->size() / 3);
+        if (triangle_count / 2 < kMinLodTriangleCount)
+        {
+            break;
+        }
+
+        MeshLod lod;
+        error += SimplifyMesh(mesh.positions.data(),
+                              vertex_count,
+                              source->data(),
+                              static_cast<uint32_t>(source->size()),
+                              triangle_count / 2 * 3,
+                              lod.indices);
+
+        if (static_cast<float>(lod.indices.size()) >
+            static_cast<float>(source->size()) * kMinLodReduction)
+        {
+            break;
+        }
+
+        lod.error = error;
+        OptimizeTriangleOrder(lod.indices, vertex_count);
+
+        mesh.lods.push_back(std::move(lod));
+        source = &mesh.lods.back().indices;
+    }
+}
+
+void GenerateMeshLods(std::vector<MeshData>& meshes, tf::Subflow& subflow)
+{
+    ParallelFor(subflow, static_cast<uint32_t>(meshes.size()), [&meshes](uint32_t i) {
+        GenerateMeshLods(meshes[i]);
+    });
+}
+
+uint32_t SelectMeshLod(const float* errors,
+                       uint32_t     lod_count,
+                       float        bounds_radius,
+                       float        projected_size,
+                       float        max_error)
+{
+    if (bounds_radius <= 0.f)
+    {
+        return 0;
+    }
+
+    // Object space errors scale with the radius, so they project by the same ratio. An eye
+    // inside the sphere projects any error to infinity.
+    auto scale = projected_size / bounds_radius;
+    for (auto lod = lod_count; lod > 0; --lod)
+    {
+        if (errors[lod - 1] * scale <= max_error)
+        {
+            return lod;
+        }
+    }
+
+    return 0;
+}
+}  // namespace capsaicin
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Simplify a triangle list to about target_index_count indices by collapsing edges onto
+// one of their endpoints in quadric error order (Garland and Heckbert 1997), so that the
+// result indexes the original vertices. Vertices on open borders and attribute seams
+// never move. Returns the largest collapse error as an object space distance.
+float SimplifyMesh(const float*           positions,
+                   uint32_t               vertex_count,
+                   const uint32_t*        indices,
+                   uint32_t               index_count,
+                   uint32_t               target_index_count,
+                   std::vector<uint32_t>& result);
+
+// Build up to kMaxMeshLods levels of detail, halving the triangle count per level, and
+// stop early when a level doesn't get much smaller than the previous one.
+void GenerateMeshLods(MeshData& mesh);
+
+// Generate levels of detail of all meshes concurrently on the subflow. Joins the subflow.
+void GenerateMeshLods(std::vector<MeshData>& meshes, tf::Subflow& subflow);
+
+// Coarsest level of detail whose error, projected from the eye like the bounding sphere of
+// radius bounds_radius is by ProjectedSize, is within max_error. 0 is the full resolution
+// mesh and lod l + 1 the level with errors[l], errors grow with the level.
+uint32_t SelectMeshLod(const float* errors,
+                       uint32_t     lod_count,
+                       float        bounds_radius,
+                       float        projected_size,
+                       float        max_error);
+}  // namespace capsaicin
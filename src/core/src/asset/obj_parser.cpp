@@ -0,0 +1,543 @@
+#include "obj_parser.h"
+
+#include <charconv>
+#include <fstream>
+#include <unordered_map>
+
+#include "src/utils/mapped_file.h"
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+// Target size of a parsing chunk, chunks are extended to the end of the line.
+constexpr std::size_t kChunkSize = 4 * 1024 * 1024;
+
+enum class ObjEventType
+{
+    kGroup,
+    kMaterial,
+    kMaterialLib
+};
+
+// Group or material change, positioned in the chunk's list of corners.
+struct ObjEvent
+{
+    ObjEventType type;
+    uint32_t     index;
+    std::string  name;
+};
+
+// Part of the file parsed by a single task.
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    std::vector<float>    vertices;
+    std::vector<float>    normals;
+    std::vector<float>    texcoords;
+    std::vector<ObjIndex> indices;
+    std::vector<ObjEvent> events;
+
+    // Attribute slots (3 * corner + attribute) holding relative (negative) obj indices.
+    // Until the merge these are stored relative to the first attribute of the chunk.
+    std::vector<uint32_t> relative_slots;
+
+    // Scratch storage for the polygon being triangulated.
+    std::vector<ObjIndex> face_corners;
+    std::vector<uint32_t> face_relative;
+
+    // Offsets of the chunk data in the merged arrays.
+    uint32_t first_vertex   = 0;
+    uint32_t first_normal   = 0;
+    uint32_t first_texcoord = 0;
+    uint32_t first_index    = 0;
+
+    std::string error;
+};
+
+bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+const char* SkipSpaces(const char* p, const char* end)
+{
+    while (p < end && IsSpace(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+const char* SkipToken(const char* p, const char* end)
+{
+    while (p < end && !IsSpace(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// Check if the line starts with a keyword followed by a space or line end.
+bool IsKeyword(const char* p, const char* end, const char* keyword)
+{
+    while (*keyword)
+    {
+        if (p == end || *p != *keyword)
+        {
+            return false;
+        }
+        ++p;
+        ++keyword;
+    }
+    return p == end || IsSpace(*p);
+}
+
+// Rest of the line with surrounding whitespace stripped.
+std::string ParseName(const char* p, const char* end)
+{
+    p = SkipSpaces(p, end);
+    while (end > p && IsSpace(*(end - 1)))
+    {
+        --end;
+    }
+    return std::string(p, end);
+}
+
+const char* ParseFloat(const char* p, const char* end, float& value)
+{
+    p = SkipSpaces(p, end);
+    if (p < end && *p == '+')
+    {
+        ++p;
+    }
+
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+    {
+        value = 0.f;
+        return SkipToken(p, end);
+    }
+    return result.ptr;
+}
+
+const char* ParseInt(const char* p, const char* end, int32_t& value)
+{
+    if (p < end && *p == '+')
+    {
+        ++p;
+    }
+
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+    {
+        value = 0;
+    }
+    return result.ptr;
+}
+
+// Parse 'v', 'v/t', 'v//n' or 'v/t/n' corner, missing indices are returned as 0.
+const char* ParseCorner(const char* p, const char* end, int32_t& v, int32_t& t, int32_t& n)
+{
+    v = t = n = 0;
+
+    p = ParseInt(p, end, v);
+    if (p < end && *p == '/')
+    {
+        ++p;
+        if (p < end && *p != '/')
+        {
+            p = ParseInt(p, end, t);
+        }
+        if (p < end && *p == '/')
+        {
+            p = ParseInt(p + 1, end, n);
+        }
+    }
+    return SkipToken(p, end);
+}
+
+// Convert 1-based (or negative relative) obj index to 0-based one. Relative indices
+// are resolved against the chunk-local attribute count and fixed up during the merge.
+int32_t ConvertIndex(int32_t index, std::size_t local_count, bool& relative)
+{
+    relative = index < 0;
+    return index > 0 ? index - 1 : index < 0 ? static_cast<int32_t>(local_count) + index : -1;
+}
+
+void ParseFace(const char* p, const char* end, ObjChunk& chunk)
+{
+    auto& face_corners  = chunk.face_corners;
+    auto& face_relative = chunk.face_relative;
+    face_corners.clear();
+    face_relative.clear();
+
+    p = SkipSpaces(p, end);
+    while (p < end)
+    {
+        int32_t v, t, n;
+        p = SkipSpaces(ParseCorner(p, end, v, t, n), end);
+
+        if (v == 0)
+        {
+            chunk.error = "invalid face index";
+            return;
+        }
+
+        bool     relative = false;
+        uint32_t mask     = 0;
+        ObjIndex corner;
+
+        corner.vertex_index = ConvertIndex(v, chunk.vertices.size() / 3, relative);
+        mask |= relative ? 1u : 0u;
+        corner.normal_index = ConvertIndex(n, chunk.normals.size() / 3, relative);
+        mask |= relative ? 2u : 0u;
+        corner.texcoord_index = ConvertIndex(t, chunk.texcoords.size() / 2, relative);
+        mask |= relative ? 4u : 0u;
+
+        face_corners.push_back(corner);
+        face_relative.push_back(mask);
+    }
+
+    // Triangulate as a fan: (0, k - 1, k).
+    for (uint32_t k = 2; k < face_corners.size(); ++k)
+    {
+        for (auto c : {0u, k - 1, k})
+        {
+            auto slot = static_cast<uint32_t>(chunk.indices.size()) * 3;
+            for (uint32_t a = 0; a < 3; ++a)
+            {
+                if (face_relative[c] & (1u << a))
+                {
+                    chunk.relative_slots.push_back(slot + a);
+                }
+            }
+            chunk.indices.push_back(face_corners[c]);
+        }
+    }
+}
+
+void ParseLine(const char* p, const char* end, ObjChunk& chunk)
+{
+    p = SkipSpaces(p, end);
+
+    if (p == end || *p == '#')
+    {
+        return;
+    }
+
+    if (IsKeyword(p, end, "v"))
+    {
+        float x, y, z;
+        p = ParseFloat(p + 1, end, x);
+        p = ParseFloat(p, end, y);
+        p = ParseFloat(p, end, z);
+        chunk.vertices.insert(chunk.vertices.end(), {x, y, z});
+    }
+    else if (IsKeyword(p, end, "vn"))
+    {
+        float x, y, z;
+        p = ParseFloat(p + 2, end, x);
+        p = ParseFloat(p, end, y);
+        p = ParseFloat(p, end, z);
+        chunk.normals.insert(chunk.normals.end(), {x, y, z});
+    }
+    else if (IsKeyword(p, end, "vt"))
+    {
+        float u, v;
+        p = ParseFloat(p + 2, end, u);
+        p = ParseFloat(p, end, v);
+        chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+    }
+    else if (IsKeyword(p, end, "f"))
+    {
+        ParseFace(p + 1, end, chunk);
+    }
+    else if (IsKeyword(p, end, "o") || IsKeyword(p, end, "g"))
+    {
+        chunk.events.push_back({ObjEventType::kGroup,
+                                static_cast<uint32_t>(chunk.indices.size()),
+                                ParseName(p + 1, end)});
+    }
+    else if (IsKeyword(p, end, "usemtl"))
+    {
+        chunk.events.push_back({ObjEventType::kMaterial,
+                                static_cast<uint32_t>(chunk.indices.size()),
+                                ParseName(p + 6, end)});
+    }
+    else if (IsKeyword(p, end, "mtllib"))
+    {
+        p = SkipSpaces(p + 6, end);
+        while (p < end)
+        {
+            auto name_end = SkipToken(p, end);
+            chunk.events.push_back({ObjEventType::kMaterialLib, 0, std::string(p, name_end)});
+            p = SkipSpaces(name_end, end);
+        }
+    }
+}
+
+void ParseChunk(ObjChunk& chunk)
+{
+    auto p = chunk.begin;
+    while (p < chunk.end && chunk.error.empty())
+    {
+        auto line_end = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<std::size_t>(chunk.end - p)));
+        if (!line_end)
+        {
+            line_end = chunk.end;
+        }
+
+        auto content_end = line_end;
+        if (content_end > p && *(content_end - 1) == '\r')
+        {
+            --content_end;
+        }
+
+        ParseLine(p, content_end, chunk);
+        p = line_end + 1;
+    }
+}
+
+// Split the file into chunks of roughly kChunkSize, each ending on a line boundary.
+std::vector<ObjChunk> SplitIntoChunks(const char* data, std::size_t size)
+{
+    auto num_chunks = std::max<std::size_t>(1, ceil_divide(size, kChunkSize));
+
+    std::vector<ObjChunk> chunks(num_chunks);
+
+    const char* begin = data;
+    const char* end   = data + size;
+    for (std::size_t i = 0; i < num_chunks; ++i)
+    {
+        auto chunk_end = (i + 1 == num_chunks) ? end : std::max(begin, data + (i + 1) * kChunkSize);
+        if (chunk_end < end)
+        {
+            auto line_end = static_cast<const char*>(
+                std::memchr(chunk_end, '\n', static_cast<std::size_t>(end - chunk_end)));
+            chunk_end     = line_end ? line_end + 1 : end;
+        }
+
+        chunks[i].begin = begin;
+        chunks[i].end   = chunk_end;
+        begin           = chunk_end;
+    }
+
+    return chunks;
+}
+
+// Build shapes by walking group / material events of all chunks in the file order.
+// Mirrors tinyobj: a group without faces only renames the current shape and the shape
+// uses the material active at its first face.
+void BuildShapes(std::vector<ObjChunk>& chunks, ObjData& obj_data)
+{
+    ObjShape    shape;
+    std::string material_name;
+
+    auto flush = [&obj_data, &shape](uint32_t index) {
+        if (index > shape.first_index)
+        {
+            shape.index_count = index - shape.first_index;
+            obj_data.shapes.push_back(shape);
+        }
+    };
+
+    for (auto& chunk : chunks)
+    {
+        for (auto& event : chunk.events)
+        {
+            auto index = chunk.first_index + event.index;
+            switch (event.type)
+            {
+            case ObjEventType::kGroup:
+                if (index > shape.first_index)
+                {
+                    flush(index);
+                    shape.first_index   = index;
+                    shape.material_name = material_name;
+                }
+                shape.name = event.name;
+                break;
+            case ObjEventType::kMaterial:
+                material_name = event.name;
+                if (index == shape.first_index)
+                {
+                    shape.material_name = material_name;
+                }
+                break;
+            case ObjEventType::kMaterialLib:
+                obj_data.material_libs.push_back(event.name);
+                break;
+            }
+        }
+    }
+
+    flush(static_cast<uint32_t>(obj_data.indices.size()));
+}
+
+// Absolute index in range, or -1 for an attribute omitted from the face.
+bool ValidIndex(int32_t index, std::size_t count)
+{
+    return index >= -1 && index < static_cast<int32_t>(count);
+}
+
+void MergeChunks(std::vector<ObjChunk>& chunks, ObjData& obj_data, tf::Subflow& subflow)
+{
+    // Calculate chunk offsets in the merged arrays.
+    uint32_t num_vertices = 0, num_normals = 0, num_texcoords = 0, num_indices = 0;
+    for (auto& chunk : chunks)
+    {
+        chunk.first_vertex   = num_vertices;
+        chunk.first_normal   = num_normals;
+        chunk.first_texcoord = num_texcoords;
+        chunk.first_index    = num_indices;
+
+        num_vertices += static_cast<uint32_t>(chunk.vertices.size() / 3);
+        num_normals += static_cast<uint32_t>(chunk.normals.size() / 3);
+        num_texcoords += static_cast<uint32_t>(chunk.texcoords.size() / 2);
+        num_indices += static_cast<uint32_t>(chunk.indices.size());
+    }
+
+    obj_data.vertices.resize(num_vertices * 3);
+    obj_data.normals.resize(num_normals * 3);
+    obj_data.texcoords.resize(num_texcoords * 2);
+    obj_data.indices.resize(num_indices);
+
+    BuildShapes(chunks, obj_data);
+
+    ParallelFor(subflow, static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+        auto& chunk = chunks[i];
+
+        std::copy(chunk.vertices.cbegin(),
+                  chunk.vertices.cend(),
+                  obj_data.vertices.begin() + chunk.first_vertex * 3);
+        std::copy(chunk.normals.cbegin(),
+                  chunk.normals.cend(),
+                  obj_data.normals.begin() + chunk.first_normal * 3);
+        std::copy(chunk.texcoords.cbegin(),
+                  chunk.texcoords.cend(),
+                  obj_data.texcoords.begin() + chunk.first_texcoord * 2);
+
+        // Resolve relative indices against the chunk offsets.
+        int32_t attribute_offsets[] = {static_cast<int32_t>(chunk.first_vertex),
+                                       static_cast<int32_t>(chunk.first_normal),
+                                       static_cast<int32_t>(chunk.first_texcoord)};
+        for (auto slot : chunk.relative_slots)
+        {
+            auto& index = chunk.indices[slot / 3];
+            auto  a     = slot % 3;
+            auto& value = a == 0 ? index.vertex_index : a == 1 ? index.normal_index
+                                                               : index.texcoord_index;
+            value += attribute_offsets[a];
+
+            // -1 only marks attributes omitted from the face, not relative indices before the
+            // first attribute.
+            if (value < 0)
+            {
+                chunk.error = "face index out of range";
+            }
+        }
+
+        for (auto& index : chunk.indices)
+        {
+            if (index.vertex_index < 0 || !ValidIndex(index.vertex_index, num_vertices) ||
+                !ValidIndex(index.normal_index, num_normals) ||
+                !ValidIndex(index.texcoord_index, num_texcoords))
+            {
+                chunk.error = "face index out of range";
+                break;
+            }
+        }
+
+        std::copy(chunk.indices.cbegin(),
+                  chunk.indices.cend(),
+                  obj_data.indices.begin() + chunk.first_index);
+    });
+}
+}  // namespace
+
+void ParseObjFile(const std::string& file_name, ObjData& obj_data, tf::Subflow& subflow)
+{
+    MappedFile file(file_name);
+
+    auto chunks = SplitIntoChunks(file.data(), file.size());
+
+    auto parse = subflow.emplace([&chunks](tf::Subflow& sf) {
+        ParallelFor(sf, static_cast<uint32_t>(chunks.size()), [&chunks](uint32_t i) {
+            ParseChunk(chunks[i]);
+        });
+    });
+
+    auto merge =
+        subflow.emplace([&chunks, &obj_data](tf::Subflow& sf) { MergeChunks(chunks, obj_data, sf); });
+
+    parse.precede(merge);
+    subflow.join();
+
+    for (auto& chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            error("ObjParser: {} in {}", chunk.error, file_name);
+            throw std::runtime_error("ObjParser: " + chunk.error + " in " + file_name);
+        }
+    }
+
+    obj_data.num_chunks = static_cast<uint32_t>(chunks.size());
+}
+
+void LoadObjMaterials(ObjData& obj_data, const std::string& material_base_dir)
+{
+    std::unordered_map<std::string, int32_t> material_map;
+
+    for (auto& lib : obj_data.material_libs)
+    {
+        std::ifstream in(material_base_dir + lib);
+
+        if (!in)
+        {
+            warn("ObjParser: Material library {} not found", material_base_dir + lib);
+            continue;
+        }
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            const char* p   = line.data();
+            const char* end = line.data() + line.size();
+
+            if (end > p && *(end - 1) == '\r')
+            {
+                --end;
+            }
+
+            p = SkipSpaces(p, end);
+
+            if (IsKeyword(p, end, "newmtl"))
+            {
+                obj_data.materials.push_back(ObjMaterial{ParseName(p + 6, end), ""});
+                material_map[obj_data.materials.back().name] =
+                    static_cast<int32_t>(obj_data.materials.size() - 1);
+            }
+            else if (IsKeyword(p, end, "map_Kd") && !obj_data.materials.empty())
+            {
+                // Texture options might precede the file name, which is the last token.
+                auto name                                  = ParseName(p + 6, end);
+                auto separator                             = name.find_last_of(" \t");
+                obj_data.materials.back().diffuse_texname =
+                    separator == std::string::npos ? name : name.substr(separator + 1);
+            }
+        }
+    }
+
+    for (auto& shape : obj_data.shapes)
+    {
+        auto it           = material_map.find(shape.material_name);
+        shape.material_id = it == material_map.cend() ? -1 : it->second;
+    }
+}
+}  // namespace capsaicin
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Attribute indices of a single face corner, -1 if the attribute is missing.
+struct ObjIndex
+{
+    int32_t vertex_index   = -1;
+    int32_t normal_index   = -1;
+    int32_t texcoord_index = -1;
+};
+
+// Range of triangulated face corners belonging to a single 'o' / 'g' group.
+struct ObjShape
+{
+    std::string name;
+    std::string material_name;
+    uint32_t    first_index = 0;
+    uint32_t    index_count = 0;
+    // Index into ObjData::materials, set by LoadObjMaterials.
+    int32_t material_id = -1;
+};
+
+struct ObjMaterial
+{
+    std::string name;
+    std::string diffuse_texname;
+};
+
+// Raw obj contents with absolute attribute indices (same layout as tinyobj attrib_t).
+struct ObjData
+{
+    std::vector<float>       vertices;
+    std::vector<float>       normals;
+    std::vector<float>       texcoords;
+    std::vector<ObjIndex>    indices;
+    std::vector<ObjShape>    shapes;
+    std::vector<std::string> material_libs;
+    std::vector<ObjMaterial> materials;
+    uint32_t                 num_chunks = 0;
+};
+
+// Memory map the file, split it into line-aligned chunks and parse them in parallel
+// on the subflow. Polygons are triangulated as fans. Joins the subflow.
+void ParseObjFile(const std::string& file_name, ObjData& obj_data, tf::Subflow& subflow);
+
+// Parse the material libraries referenced by the file and assign material ids to shapes.
+void LoadObjMaterials(ObjData& obj_data, const std::string& material_base_dir);
+}  // namespace capsaicin
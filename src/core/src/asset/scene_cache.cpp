@@ -0,0 +1,646 @@
+#include "scene_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include "src/asset/chunked_file.h"
+#include "src/asset/index_codec.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kMagic            = 0x4e435343;  // "CSCN"
+constexpr uint32_t kSectionAlignment = 16;
+
+// Indices are stored as per mesh varint streams, see EncodeIndices.
+constexpr uint32_t kCompressedIndices = 1;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;
+
+    uint32_t mesh_count;
+    uint32_t texture_count;
+    uint32_t flags;
+    uint32_t instance_count;
+    uint64_t vertex_count;
+    uint64_t index_count;
+
+    // Section offsets from the beginning of the file.
+    uint64_t positions_offset;
+    uint64_t normals_offset;
+    uint64_t texcoords_offset;
+    uint64_t indices_offset;
+    uint64_t indices_size;
+    uint64_t meshes_offset;
+    uint64_t lods_offset;
+    uint64_t instances_offset;
+    // Texture names followed by material library names.
+    uint64_t textures_offset;
+    uint64_t textures_size;
+    // SourceInfo of each material library.
+    uint64_t dependencies_offset;
+    uint32_t material_lib_count;
+    uint32_t padding;
+};
+
+// Mesh ranges in the cache pools.
+struct MeshRecord
+{
+    uint32_t vertex_count;
+    uint32_t first_vertex;
+    uint32_t index_count;
+    uint32_t first_index;
+    uint32_t padding;
+    // Byte range of the mesh in the indices section, compressed indices only.
+    uint32_t first_byte;
+    uint32_t byte_count;
+    uint32_t lod_count;
+};
+
+// Placement and material of a mesh.
+struct InstanceRecord
+{
+    uint32_t mesh;
+    uint32_t texture_id;
+    float    transform[12];
+};
+
+// Levels of detail follow the indices of their mesh in the indices section.
+struct LodRecord
+{
+    uint32_t index_count;
+    float    error;
+};
+
+// Number of full resolution and level of detail indices of the mesh.
+uint64_t TotalIndexCount(const MeshRecord& record, const LodRecord* lods)
+{
+    uint64_t count = record.index_count;
+    for (uint32_t l = 0; l < record.lod_count; ++l)
+    {
+        count += lods[l].index_count;
+    }
+    return count;
+}
+
+// Full resolution and level of detail indices of the mesh, back to back.
+std::vector<uint32_t> GatherIndices(const MeshData& mesh)
+{
+    auto indices = mesh.indices;
+    for (auto& lod : mesh.lods)
+    {
+        indices.insert(indices.end(), lod.indices.cbegin(), lod.indices.cend());
+    }
+    return indices;
+}
+
+// Pad a section of the given size up to the section alignment.
+void WritePadding(std::ofstream& out, uint64_t size)
+{
+    static const char kZeros[kSectionAlignment] = {};
+    out.write(kZeros, static_cast<std::streamsize>(align(size, kSectionAlignment) - size));
+}
+
+void WritePadded(std::ofstream& out, const void* data, uint64_t size)
+{
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    WritePadding(out, size);
+}
+
+// Parse count length-prefixed names.
+bool ParseNames(const char* p, uint64_t size, uint64_t count, std::vector<std::string>& names)
+{
+    auto end = p + size;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint32_t length = 0;
+        if (end - p < static_cast<std::ptrdiff_t>(sizeof(length)))
+        {
+            return false;
+        }
+        std::memcpy(&length, p, sizeof(length));
+        p += sizeof(length);
+
+        if (end - p < static_cast<std::ptrdiff_t>(length))
+        {
+            return false;
+        }
+        names.emplace_back(p, length);
+        p += length;
+    }
+
+    return true;
+}
+}  // namespace
+
+std::string SceneCache::CacheFileName(const std::string& file_name)
+{
+    return file_name + ".cache";
+}
+
+void SceneCache::Write(const std::string&               file_name,
+                       const SourceInfo&                source,
+                       const std::vector<MeshData>&     meshes,
+                       const std::vector<MeshInstance>& instances,
+                       const std::vector<std::string>&  material_libs,
+                       const std::vector<SourceInfo>&   material_lib_sources,
+                       bool                             compress_indices)
+{
+    Header header       = {};
+    header.magic        = kMagic;
+    header.version      = kVersion;
+    header.source_size  = source.size;
+    header.source_mtime = source.mtime;
+    header.source_hash  = source.hash;
+    header.mesh_count     = static_cast<uint32_t>(meshes.size());
+    header.instance_count = static_cast<uint32_t>(instances.size());
+    header.flags          = compress_indices ? kCompressedIndices : 0;
+
+    // Build mesh and instance tables and deduplicate texture names.
+    std::vector<MeshRecord>                   records(meshes.size());
+    std::vector<LodRecord>                    lods(meshes.size() * kMaxMeshLods, LodRecord{});
+    std::vector<InstanceRecord>               instance_records(instances.size());
+    std::vector<std::string>                  texture_names;
+    std::unordered_map<std::string, uint32_t> texture_ids;
+
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        auto& record        = records[i];
+        record              = {};
+        record.vertex_count = static_cast<uint32_t>(meshes[i].positions.size() / 3);
+        record.first_vertex = static_cast<uint32_t>(header.vertex_count);
+        record.index_count  = static_cast<uint32_t>(meshes[i].indices.size());
+        record.first_index  = static_cast<uint32_t>(header.index_count);
+        record.lod_count    = static_cast<uint32_t>(meshes[i].lods.size());
+
+        for (uint32_t l = 0; l < record.lod_count; ++l)
+        {
+            auto& lod       = lods[i * kMaxMeshLods + l];
+            lod.index_count = static_cast<uint32_t>(meshes[i].lods[l].indices.size());
+            lod.error       = meshes[i].lods[l].error;
+        }
+
+        header.vertex_count += record.vertex_count;
+        header.index_count += TotalIndexCount(record, &lods[i * kMaxMeshLods]);
+    }
+
+    for (std::size_t i = 0; i < instances.size(); ++i)
+    {
+        auto& record      = instance_records[i];
+        record.mesh       = instances[i].mesh;
+        record.texture_id = ~0u;
+        std::copy_n(instances[i].transform, 12, record.transform);
+
+        if (!instances[i].texture_name.empty())
+        {
+            auto it = texture_ids.emplace(instances[i].texture_name,
+                                          static_cast<uint32_t>(texture_names.size()));
+            if (it.second)
+            {
+                texture_names.push_back(instances[i].texture_name);
+            }
+            record.texture_id = it.first->second;
+        }
+    }
+
+    // Names are stored as length-prefixed strings.
+    texture_names.insert(texture_names.end(), material_libs.cbegin(), material_libs.cend());
+
+    std::vector<char> textures;
+    for (auto& name : texture_names)
+    {
+        auto length = static_cast<uint32_t>(name.size());
+        textures.insert(textures.end(),
+                        reinterpret_cast<const char*>(&length),
+                        reinterpret_cast<const char*>(&length) + sizeof(length));
+        textures.insert(textures.end(), name.cbegin(), name.cend());
+    }
+
+    // Compressed index streams of all meshes.
+    std::vector<uint8_t> compressed_indices;
+    if (compress_indices)
+    {
+        for (std::size_t i = 0; i < meshes.size(); ++i)
+        {
+            auto indices          = GatherIndices(meshes[i]);
+            records[i].first_byte = static_cast<uint32_t>(compressed_indices.size());
+            EncodeIndices(
+                indices.data(), static_cast<uint32_t>(indices.size()), compressed_indices);
+            records[i].byte_count =
+                static_cast<uint32_t>(compressed_indices.size()) - records[i].first_byte;
+        }
+    }
+
+    header.indices_size  = compress_indices ? compressed_indices.size()
+                                            : header.index_count * sizeof(uint32_t);
+    header.material_lib_count = static_cast<uint32_t>(material_libs.size());
+    header.texture_count      = static_cast<uint32_t>(texture_names.size() - material_libs.size());
+    header.textures_size      = textures.size();
+
+    auto offset = align(sizeof(Header), kSectionAlignment);
+
+    auto section = [&offset](uint64_t size) {
+        auto section_offset = offset;
+        offset += align(size, kSectionAlignment);
+        return section_offset;
+    };
+
+    header.positions_offset = section(header.vertex_count * 3 * sizeof(float));
+    header.normals_offset   = section(header.vertex_count * 3 * sizeof(float));
+    header.texcoords_offset = section(header.vertex_count * 2 * sizeof(float));
+    header.indices_offset   = section(header.indices_size);
+    header.meshes_offset    = section(records.size() * sizeof(MeshRecord));
+    header.lods_offset      = section(lods.size() * sizeof(LodRecord));
+    header.instances_offset = section(instance_records.size() * sizeof(InstanceRecord));
+    header.textures_offset  = section(textures.size());
+
+    header.dependencies_offset = section(material_lib_sources.size() * sizeof(SourceInfo));
+
+    // Write to a temporary file first, so an interrupted write never leaves a valid header.
+    auto cache_file_name = CacheFileName(file_name);
+    auto temp_file_name  = cache_file_name + ".tmp";
+
+    {
+        std::ofstream out(temp_file_name, std::ios::binary | std::ios::trunc);
+
+        if (!out)
+        {
+            warn("SceneCache: Couldn't write {}", cache_file_name);
+            return;
+        }
+
+        WritePadded(out, &header, sizeof(Header));
+
+        for (auto& mesh : meshes)
+        {
+            out.write(reinterpret_cast<const char*>(mesh.positions.data()),
+                      static_cast<std::streamsize>(mesh.positions.size() * sizeof(float)));
+        }
+        WritePadding(out, header.vertex_count * 3 * sizeof(float));
+
+        for (auto& mesh : meshes)
+        {
+            out.write(reinterpret_cast<const char*>(mesh.normals.data()),
+                      static_cast<std::streamsize>(mesh.normals.size() * sizeof(float)));
+        }
+        WritePadding(out, header.vertex_count * 3 * sizeof(float));
+
+        for (auto& mesh : meshes)
+        {
+            out.write(reinterpret_cast<const char*>(mesh.texcoords.data()),
+                      static_cast<std::streamsize>(mesh.texcoords.size() * sizeof(float)));
+        }
+        WritePadding(out, header.vertex_count * 2 * sizeof(float));
+
+        if (compress_indices)
+        {
+            WritePadded(out, compressed_indices.data(), compressed_indices.size());
+        }
+        else
+        {
+            for (auto& mesh : meshes)
+            {
+                auto indices = GatherIndices(mesh);
+                out.write(reinterpret_cast<const char*>(indices.data()),
+                          static_cast<std::streamsize>(indices.size() * sizeof(uint32_t)));
+            }
+            WritePadding(out, header.indices_size);
+        }
+
+        WritePadded(out, records.data(), records.size() * sizeof(MeshRecord));
+        WritePadded(out, lods.data(), lods.size() * sizeof(LodRecord));
+        WritePadded(
+            out, instance_records.data(), instance_records.size() * sizeof(InstanceRecord));
+        WritePadded(out, textures.data(), textures.size());
+        WritePadded(out,
+                    material_lib_sources.data(),
+                    material_lib_sources.size() * sizeof(SourceInfo));
+    }
+
+    std::error_code ec;
+    if (std::filesystem::file_size(temp_file_name, ec) != offset)
+    {
+        warn("SceneCache: Couldn't write {}", cache_file_name);
+        std::filesystem::remove(temp_file_name, ec);
+        return;
+    }
+
+    std::filesystem::rename(temp_file_name, cache_file_name, ec);
+
+    if (ec)
+    {
+        warn("SceneCache: Couldn't write {}", cache_file_name);
+        std::filesystem::remove(temp_file_name, ec);
+    }
+}
+
+std::unique_ptr<SceneCache> SceneCache::Open(const std::string& file_name,
+                                             const std::string& material_base_dir,
+                                             tf::Subflow&       subflow)
+{
+    auto cache_file_name = CacheFileName(file_name);
+
+    std::error_code ec;
+    if (!std::filesystem::exists(cache_file_name, ec))
+    {
+        return nullptr;
+    }
+
+    // The header, names and dependencies are read before plain caches are mapped, so that
+    // modification times can be updated in place. Chunked caches are decompressed into memory
+    // once they are known to be fresh.
+    auto          chunked   = ChunkedFile::Open(cache_file_name);
+    uint64_t      file_size = chunked ? chunked->size() : 0;
+    std::ifstream in;
+    if (!chunked)
+    {
+        in.open(cache_file_name, std::ios::binary);
+        file_size = std::filesystem::file_size(cache_file_name, ec);
+    }
+
+    auto read = [&](uint64_t offset, uint64_t size, void* data) {
+        if (offset > file_size || size > file_size - offset)
+        {
+            return false;
+        }
+        if (chunked)
+        {
+            return chunked->Read(offset, size, data);
+        }
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+        return static_cast<bool>(in);
+    };
+
+    Header                   header = {};
+    std::vector<char>        textures;
+    std::vector<std::string> names;
+    std::vector<SourceInfo>  dependencies;
+    if (!read(0, sizeof(Header), &header) || header.magic != kMagic ||
+        header.version != kVersion || header.textures_size > file_size ||
+        header.material_lib_count > file_size / sizeof(SourceInfo))
+    {
+        warn("SceneCache: {} is corrupt or outdated", cache_file_name);
+        return nullptr;
+    }
+
+    textures.resize(header.textures_size);
+    dependencies.resize(header.material_lib_count);
+    if (!read(header.textures_offset, textures.size(), textures.data()) ||
+        !ParseNames(textures.data(),
+                    textures.size(),
+                    uint64_t(header.texture_count) + header.material_lib_count,
+                    names) ||
+        !read(header.dependencies_offset,
+              dependencies.size() * sizeof(SourceInfo),
+              dependencies.data()))
+    {
+        warn("SceneCache: {} is corrupt or outdated", cache_file_name);
+        return nullptr;
+    }
+    in.close();
+
+    // Caches without a source next to them are used as is, with their material libraries.
+    if (std::filesystem::exists(file_name, ec))
+    {
+        SourceInfo source;
+        source.size  = header.source_size;
+        source.mtime = header.source_mtime;
+        source.hash  = header.source_hash;
+
+        auto touched = false;
+        auto fresh   = IsSourceUnchanged(file_name, source, touched);
+        for (uint32_t i = 0; fresh && i < header.material_lib_count; ++i)
+        {
+            fresh = IsSourceUnchanged(
+                material_base_dir + names[header.texture_count + i], dependencies[i], touched);
+        }
+
+        if (!fresh)
+        {
+            info("SceneCache: {} is stale", cache_file_name);
+            return nullptr;
+        }
+
+        // Sources touched without being changed aren't hashed again by the next load, which
+        // also covers cooked caches, written with no modification times. Failing to update a
+        // read-only cache is harmless, and chunked caches can't be, so they keep hashing.
+        if (touched && !chunked)
+        {
+            header.source_mtime = source.mtime;
+
+            std::fstream out(cache_file_name, std::ios::binary | std::ios::in | std::ios::out);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            out.seekp(static_cast<std::streamoff>(header.dependencies_offset));
+            out.write(reinterpret_cast<const char*>(dependencies.data()),
+                      static_cast<std::streamsize>(dependencies.size() * sizeof(SourceInfo)));
+        }
+    }
+
+    std::unique_ptr<SceneCache> cache(new SceneCache());
+    if (chunked)
+    {
+        cache->contents_.resize(chunked->size());
+        cache->data_ = cache->contents_.data();
+        cache->size_ = cache->contents_.size();
+
+        if (!chunked->Read(cache->contents_.data(), subflow))
+        {
+            warn("SceneCache: {} is corrupt or outdated", cache_file_name);
+            return nullptr;
+        }
+    }
+    else
+    {
+        cache->file_ = std::make_unique<MappedFile>(cache_file_name);
+        cache->data_ = cache->file_->data();
+        cache->size_ = cache->file_->size();
+    }
+
+    if (!cache->Validate())
+    {
+        warn("SceneCache: {} is corrupt or outdated", cache_file_name);
+        return nullptr;
+    }
+
+    return cache;
+}
+
+bool SceneCache::Validate()
+{
+    if (size_ < sizeof(Header))
+    {
+        return false;
+    }
+
+    auto& header = *reinterpret_cast<const Header*>(data_);
+
+    if (header.magic != kMagic || header.version != kVersion ||
+        (header.flags & ~kCompressedIndices) != 0)
+    {
+        return false;
+    }
+
+    bool compressed = (header.flags & kCompressedIndices) != 0;
+    if (!compressed && header.indices_size != header.index_count * sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    auto inside = [this](uint64_t offset, uint64_t size) {
+        return offset <= size_ && size <= size_ - offset;
+    };
+
+    if (!inside(header.positions_offset, header.vertex_count * 3 * sizeof(float)) ||
+        !inside(header.normals_offset, header.vertex_count * 3 * sizeof(float)) ||
+        !inside(header.texcoords_offset, header.vertex_count * 2 * sizeof(float)) ||
+        !inside(header.indices_offset, header.indices_size) ||
+        !inside(header.meshes_offset, header.mesh_count * sizeof(MeshRecord)) ||
+        !inside(header.lods_offset, header.mesh_count * kMaxMeshLods * sizeof(LodRecord)) ||
+        !inside(header.instances_offset, header.instance_count * sizeof(InstanceRecord)) ||
+        !inside(header.textures_offset, header.textures_size) ||
+        !inside(header.dependencies_offset, header.material_lib_count * sizeof(SourceInfo)))
+    {
+        return false;
+    }
+
+    // Texture names are followed by material library names.
+    if (!ParseNames(data_ + header.textures_offset,
+                    header.textures_size,
+                    uint64_t(header.texture_count) + header.material_lib_count,
+                    texture_names_))
+    {
+        return false;
+    }
+    material_libs_.assign(texture_names_.begin() + header.texture_count, texture_names_.end());
+    texture_names_.resize(header.texture_count);
+
+    // Check mesh ranges.
+    auto records = reinterpret_cast<const MeshRecord*>(data_ + header.meshes_offset);
+    auto lods    = reinterpret_cast<const LodRecord*>(data_ + header.lods_offset);
+    for (uint32_t i = 0; i < header.mesh_count; ++i)
+    {
+        auto& record = records[i];
+        if (record.lod_count > kMaxMeshLods ||
+            uint64_t(record.first_vertex) + record.vertex_count > header.vertex_count ||
+            record.first_index + TotalIndexCount(record, &lods[i * kMaxMeshLods]) >
+                header.index_count)
+        {
+            return false;
+        }
+    }
+
+    auto instances =
+        reinterpret_cast<const InstanceRecord*>(data_ + header.instances_offset);
+    for (uint32_t i = 0; i < header.instance_count; ++i)
+    {
+        if (instances[i].mesh >= header.mesh_count ||
+            (instances[i].texture_id != ~0u && instances[i].texture_id >= header.texture_count))
+        {
+            return false;
+        }
+    }
+
+    // Compressed indices are decoded once, the rest of the file stays mapped.
+    if (compressed)
+    {
+        indices_.resize(header.index_count);
+
+        auto data = reinterpret_cast<const uint8_t*>(data_ + header.indices_offset);
+        for (uint32_t i = 0; i < header.mesh_count; ++i)
+        {
+            auto& record = records[i];
+            if (uint64_t(record.first_byte) + record.byte_count > header.indices_size ||
+                !DecodeIndices(
+                    data + record.first_byte,
+                    record.byte_count,
+                    static_cast<uint32_t>(TotalIndexCount(record, &lods[i * kMaxMeshLods])),
+                    indices_.data() + record.first_index))
+            {
+                return false;
+            }
+        }
+    }
+
+    // Indices are read by shaders, so mapped ones are checked as well.
+    auto indices = compressed ? indices_.data()
+                              : reinterpret_cast<const uint32_t*>(data_ + header.indices_offset);
+    for (uint32_t i = 0; i < header.mesh_count; ++i)
+    {
+        auto& record = records[i];
+        auto  first  = indices + record.first_index;
+        if (!std::all_of(first,
+                         first + TotalIndexCount(record, &lods[i * kMaxMeshLods]),
+                         [&](uint32_t index) { return index < record.vertex_count; }))
+        {
+            return false;
+        }
+    }
+
+    mesh_count_     = header.mesh_count;
+    instance_count_ = header.instance_count;
+    return true;
+}
+
+MeshView SceneCache::mesh(uint32_t index) const
+{
+    auto& header = *reinterpret_cast<const Header*>(data_);
+    auto& record =
+        reinterpret_cast<const MeshRecord*>(data_ + header.meshes_offset)[index];
+
+    // Compressed indices are served from the decoded copy.
+    auto indices = indices_.empty()
+                       ? reinterpret_cast<const uint32_t*>(data_ + header.indices_offset)
+                       : indices_.data();
+
+    MeshView view;
+    view.positions = reinterpret_cast<const float*>(data_ + header.positions_offset) +
+                     record.first_vertex * 3;
+    view.normals = reinterpret_cast<const float*>(data_ + header.normals_offset) +
+                   record.first_vertex * 3;
+    view.texcoords = reinterpret_cast<const float*>(data_ + header.texcoords_offset) +
+                     record.first_vertex * 2;
+    view.indices      = indices + record.first_index;
+    view.vertex_count = record.vertex_count;
+    view.index_count  = record.index_count;
+    view.lod_count    = record.lod_count;
+
+    auto lods  = reinterpret_cast<const LodRecord*>(data_ + header.lods_offset) +
+                index * kMaxMeshLods;
+    auto first = view.indices + view.index_count;
+    for (uint32_t l = 0; l < record.lod_count; ++l)
+    {
+        view.lods[l].indices     = first;
+        view.lods[l].index_count = lods[l].index_count;
+        view.lods[l].error       = lods[l].error;
+        first += lods[l].index_count;
+    }
+    return view;
+}
+
+MeshInstance SceneCache::instance(uint32_t index) const
+{
+    auto& header = *reinterpret_cast<const Header*>(data_);
+    auto& record =
+        reinterpret_cast<const InstanceRecord*>(data_ + header.instances_offset)[index];
+
+    MeshInstance instance;
+    instance.mesh = record.mesh;
+    std::copy_n(record.transform, 12, instance.transform);
+
+    if (record.texture_id != ~0u)
+    {
+        instance.texture_name = texture_names_[record.texture_id];
+    }
+    return instance;
+}
+}  // namespace capsaicin
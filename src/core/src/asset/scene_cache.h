@@ -0,0 +1,69 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/asset/source_info.h"
+#include "src/common.h"
+#include "src/utils/mapped_file.h"
+
+namespace capsaicin
+{
+// Versioned binary cache of scene geometry stored next to the source asset. Attribute
+// and index pools have GeometryStorage layout, so a warm load is a mapping and a copy.
+class SceneCache
+{
+public:
+    static constexpr uint32_t kVersion = 8;
+
+    // Cache file name for the source asset.
+    static std::string CacheFileName(const std::string& file_name);
+
+    // Write meshes and their instances to the cache of the source asset, with the names of
+    // the material libraries they were built with and their GetDependencyInfo. Compressed
+    // indices take about a quarter of the space, but are decoded into memory instead of being
+    // mapped.
+    static void Write(const std::string&               file_name,
+                      const SourceInfo&                source,
+                      const std::vector<MeshData>&     meshes,
+                      const std::vector<MeshInstance>& instances,
+                      const std::vector<std::string>&  material_libs,
+                      const std::vector<SourceInfo>&   material_lib_sources,
+                      bool                             compress_indices = false);
+
+    // Map the cache of the source asset if it exists and is still valid, nullptr otherwise.
+    // The cache is stale if the source or any of its material libraries, named relative to
+    // material_base_dir, changed. Caches may be chunked files, which are decompressed on the
+    // subflow, joining it.
+    static std::unique_ptr<SceneCache> Open(const std::string& file_name,
+                                            const std::string& material_base_dir,
+                                            tf::Subflow&       subflow);
+
+    uint32_t mesh_count() const { return mesh_count_; }
+    uint32_t instance_count() const { return instance_count_; }
+    // Mesh streams pointing into the cache, materials belong to the instances.
+    MeshView mesh(uint32_t index) const;
+    // Instance with its diffuse texture name, texture_index is left unresolved.
+    MeshInstance instance(uint32_t index) const;
+    // Material libraries as named by the source, so they can be watched for changes.
+    const std::vector<std::string>& material_libs() const { return material_libs_; }
+
+private:
+    SceneCache() = default;
+    // Check the header, that all sections and mesh ranges are inside of the file and that
+    // indices are inside of their meshes.
+    bool Validate();
+
+    // Plain caches are mapped, chunked ones decompressed into contents.
+    std::unique_ptr<MappedFile> file_;
+    std::vector<char>           contents_;
+    const char*                 data_ = nullptr;
+    std::size_t                 size_ = 0;
+
+    uint32_t                 mesh_count_     = 0;
+    uint32_t                 instance_count_ = 0;
+    std::vector<std::string> texture_names_;
+    std::vector<std::string> material_libs_;
+    // Decoded indices of a cache with compressed indices.
+    std::vector<uint32_t> indices_;
+};
+}  // namespace capsaicin
@@ -0,0 +1,51 @@
+#include "source_info.h"
+
+#include <filesystem>
+
+#include "src/utils/hash.h"
+#include "src/utils/mapped_file.h"
+
+namespace capsaicin
+{
+SourceInfo GetSourceInfo(const std::string& file_name, bool hash_contents)
+{
+    SourceInfo source;
+    source.size  = std::filesystem::file_size(file_name);
+    source.mtime = std::filesystem::last_write_time(file_name).time_since_epoch().count();
+
+    if (hash_contents)
+    {
+        MappedFile file(file_name);
+        source.hash = HashBytes(file.data(), file.size());
+    }
+
+    return source;
+}
+
+SourceInfo GetDependencyInfo(const std::string& file_name)
+{
+    std::error_code ec;
+    return std::filesystem::exists(file_name, ec) ? GetSourceInfo(file_name, true) : SourceInfo();
+}
+
+bool IsSourceUnchanged(const std::string& file_name, SourceInfo& recorded, bool& touched)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(file_name, ec))
+    {
+        return recorded.size == 0 && recorded.hash == 0;
+    }
+
+    auto source = GetSourceInfo(file_name, false);
+    if (source.size != recorded.size ||
+        (source.mtime != recorded.mtime &&
+         GetSourceInfo(file_name, true).hash != recorded.hash))
+    {
+        return false;
+    }
+
+    touched        = touched || source.mtime != recorded.mtime;
+    recorded.mtime = source.mtime;
+    return true;
+}
+}  // namespace capsaicin
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Identity of a source asset, used to invalidate derived data.
+struct SourceInfo
+{
+    uint64_t size  = 0;
+    int64_t  mtime = 0;
+    uint64_t hash  = 0;
+};
+
+// Read size and modification time of the file and optionally hash its contents.
+SourceInfo GetSourceInfo(const std::string& file_name, bool hash_contents);
+// Hashed source info of a file an asset depends on, empty if it doesn't exist.
+SourceInfo GetDependencyInfo(const std::string& file_name);
+
+// Check that a source is unchanged since its info was recorded, missing sources have an
+// empty info. Contents are only hashed if the file was touched since, in which case the
+// recorded modification time is updated and touched set, so that derived data can record it.
+bool IsSourceUnchanged(const std::string& file_name, SourceInfo& recorded, bool& touched);
+}  // namespace capsaicin
@@ -0,0 +1,255 @@
+#include "texture_residency.h"
+
+#include <cmath>
+#include <numeric>
+
+namespace capsaicin
+{
+uint32_t FeedbackMip(uint32_t feedback, uint32_t width, uint32_t height, uint32_t mip_count)
+{
+    auto lod   = float(feedback & 0xfffff) / kFeedbackLodScale - kFeedbackLodBias;
+    auto level = lod + 0.5f * std::log2(float(width) * float(height));
+    return std::min(static_cast<uint32_t>(std::max(level, 0.f)), mip_count - 1);
+}
+
+uint32_t GetTailMip(const ImageData& image, uint32_t tail_size)
+{
+    auto mip_count = static_cast<uint32_t>(image.mips.size());
+    auto tail_mip  = 0u;
+    while (tail_mip + 1 < mip_count && (MipDimension(image.width, tail_mip) > tail_size ||
+                                        MipDimension(image.height, tail_mip) > tail_size))
+    {
+        ++tail_mip;
+    }
+
+    if (image.format == TextureFormat::kRGBA8)
+    {
+        return tail_mip;
+    }
+
+    for (uint32_t mip = 1; mip <= tail_mip; ++mip)
+    {
+        if (MipDimension(image.width, mip) % 4 != 0 || MipDimension(image.height, mip) % 4 != 0)
+        {
+            return mip - 1;
+        }
+    }
+
+    return tail_mip;
+}
+
+TextureResidency::TextureResidency(uint64_t budget, uint32_t max_reads)
+    : budget_(budget), max_reads_(max_reads)
+{
+}
+
+void TextureResidency::SetTexture(uint32_t                     texture,
+                                  const std::vector<uint64_t>& mip_sizes,
+                                  uint32_t                     tail_mip)
+{
+    if (texture >= textures_.size())
+    {
+        textures_.resize(texture + 1);
+    }
+
+    auto& t = textures_[texture];
+    if (streamed(texture))
+    {
+        resident_size_ -= std::accumulate(
+            t.mip_sizes.begin() + t.first_mip, t.mip_sizes.end(), uint64_t(0));
+        if (t.read_mip != kNoMip)
+        {
+            read_size_ -= t.mip_sizes[t.read_mip];
+            --read_count_;
+        }
+    }
+
+    auto mip_count = static_cast<uint32_t>(mip_sizes.size());
+    t              = Texture();
+    t.mip_sizes    = mip_sizes;
+    t.last_used.assign(mip_count, 0);
+    t.tail_mip   = std::min(tail_mip, mip_count - 1);
+    t.first_mip  = t.tail_mip;
+    t.wanted_mip = mip_count;
+
+    resident_size_ +=
+        std::accumulate(t.mip_sizes.begin() + t.first_mip, t.mip_sizes.end(), uint64_t(0));
+}
+
+void TextureResidency::Update(const std::vector<MipRequest>& requests,
+                              TextureStreamingBackend&       backend)
+{
+    ++update_;
+    started_read_count_ = 0;
+    eviction_count_     = 0;
+
+    for (auto& t : textures_)
+    {
+        t.wanted_mip = static_cast<uint32_t>(t.mip_sizes.size());
+        t.requests   = 0;
+    }
+
+    for (auto& request : requests)
+    {
+        if (!streamed(request.texture))
+        {
+            continue;
+        }
+
+        auto& t      = textures_[request.texture];
+        auto  mip    = std::min(request.mip, static_cast<uint32_t>(t.mip_sizes.size() - 1));
+        t.wanted_mip = std::min(t.wanted_mip, mip);
+        t.requests += request.count;
+    }
+
+    // Coarser mips are used by the same hits, so they are never evicted before finer ones.
+    std::vector<uint32_t> reads;
+    for (uint32_t texture = 0; texture < textures_.size(); ++texture)
+    {
+        auto& t = textures_[texture];
+        for (auto mip = t.wanted_mip; mip < t.mip_sizes.size(); ++mip)
+        {
+            t.last_used[mip] = update_;
+        }
+
+        if (!t.failed && t.read_mip == kNoMip && t.wanted_mip < t.first_mip)
+        {
+            reads.push_back(texture);
+        }
+    }
+
+    std::sort(reads.begin(), reads.end(), [this](uint32_t a, uint32_t b) {
+        auto& ta = textures_[a];
+        auto& tb = textures_[b];
+        if (ta.first_mip - ta.wanted_mip != tb.first_mip - tb.wanted_mip)
+        {
+            return ta.first_mip - ta.wanted_mip > tb.first_mip - tb.wanted_mip;
+        }
+        if (ta.requests != tb.requests)
+        {
+            return ta.requests > tb.requests;
+        }
+        return a < b;
+    });
+
+    // Reads stop at the first one which doesn't fit, so that smaller reads of lower priority
+    // don't take the room it waits for.
+    for (auto texture : reads)
+    {
+        if (read_count_ == max_reads_)
+        {
+            break;
+        }
+
+        auto& t    = textures_[texture];
+        auto  mip  = t.first_mip - 1;
+        auto  size = t.mip_sizes[mip];
+        if (resident_size_ + read_size_ + size > budget_ + EvictableSize())
+        {
+            break;
+        }
+
+        while (resident_size_ + read_size_ + size > budget_)
+        {
+            Evict(FindEvictable(), backend);
+        }
+
+        t.read_mip = mip;
+        read_size_ += size;
+        ++read_count_;
+        ++started_read_count_;
+        backend.ReadMip(texture, mip);
+    }
+}
+
+void TextureResidency::MipRead(uint32_t                 texture,
+                               uint32_t                 mip,
+                               bool                     read,
+                               TextureStreamingBackend& backend)
+{
+    if (!streamed(texture) || textures_[texture].read_mip != mip)
+    {
+        return;
+    }
+
+    auto& t    = textures_[texture];
+    t.read_mip = kNoMip;
+    read_size_ -= t.mip_sizes[mip];
+    --read_count_;
+
+    if (!read)
+    {
+        t.failed = true;
+        return;
+    }
+
+    // Mips are read while no finer mip is evicted, so the mip is next to the resident ones.
+    t.first_mip      = mip;
+    t.last_used[mip] = update_;
+    resident_size_ += t.mip_sizes[mip];
+    backend.SetFirstMip(texture, mip);
+}
+
+bool TextureResidency::streamed(uint32_t texture) const
+{
+    return texture < textures_.size() && !textures_[texture].mip_sizes.empty();
+}
+
+uint64_t TextureResidency::EvictableSize() const
+{
+    uint64_t size = 0;
+    for (auto& t : textures_)
+    {
+        if (t.read_mip != kNoMip)
+        {
+            continue;
+        }
+
+        for (auto mip = t.first_mip; mip < t.tail_mip && t.last_used[mip] < update_; ++mip)
+        {
+            size += t.mip_sizes[mip];
+        }
+    }
+
+    return size;
+}
+
+uint32_t TextureResidency::FindEvictable() const
+{
+    auto victim = kNoMip;
+    for (uint32_t texture = 0; texture < textures_.size(); ++texture)
+    {
+        auto& t = textures_[texture];
+        if (t.first_mip >= t.tail_mip || t.read_mip != kNoMip ||
+            t.last_used[t.first_mip] >= update_)
+        {
+            continue;
+        }
+
+        if (victim == kNoMip)
+        {
+            victim = texture;
+            continue;
+        }
+
+        auto& v = textures_[victim];
+        if (t.last_used[t.first_mip] < v.last_used[v.first_mip] ||
+            (t.last_used[t.first_mip] == v.last_used[v.first_mip] &&
+             t.mip_sizes[t.first_mip] > v.mip_sizes[v.first_mip]))
+        {
+            victim = texture;
+        }
+    }
+
+    return victim;
+}
+
+void TextureResidency::Evict(uint32_t texture, TextureStreamingBackend& backend)
+{
+    auto& t = textures_[texture];
+    resident_size_ -= t.mip_sizes[t.first_mip];
+    ++t.first_mip;
+    ++eviction_count_;
+    backend.SetFirstMip(texture, t.first_mip);
+}
+}  // namespace capsaicin
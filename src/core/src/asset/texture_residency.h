@@ -0,0 +1,118 @@
+#pragma once
+
+#include "src/asset/image.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Streamed textures report the LOD their hits sample at, for a texture of one texel, in place
+// of a page: texture in the top 12 bits as in PackPage and the LOD in fixed point below.
+constexpr float kFeedbackLodBias  = 32.f;
+constexpr float kFeedbackLodScale = 256.f;
+
+inline uint32_t FeedbackTexture(uint32_t feedback)
+{
+    return feedback >> 20;
+}
+
+// Mip of the texture hits sample, as picked by GetMaterial.
+uint32_t FeedbackMip(uint32_t feedback, uint32_t width, uint32_t height, uint32_t mip_count);
+
+// First mip of the tail of a texture which stays resident, the first one with neither side
+// over tail_size. Block compressed textures stream only mips which are whole blocks, since
+// the first mip of their resources has to be.
+uint32_t GetTailMip(const ImageData& image, uint32_t tail_size);
+
+// Mip of a streamed texture hit by feedback, with the number of feedback entries which hit it.
+struct MipRequest
+{
+    uint32_t texture;
+    uint32_t mip;
+    uint32_t count;
+};
+
+// Reads mips of streamed textures and makes them resident, TextureSystem.
+class TextureStreamingBackend
+{
+public:
+    virtual ~TextureStreamingBackend() = default;
+
+    // Start reading the mip in the background, TextureResidency::MipRead is called once it's
+    // read.
+    virtual void ReadMip(uint32_t texture, uint32_t mip) = 0;
+    // Make the mips of the texture from first_mip on resident and drop finer ones. A finer
+    // first mip is the last one read.
+    virtual void SetFirstMip(uint32_t texture, uint32_t first_mip) = 0;
+};
+
+// Mips of streamed textures resident in a byte budget. Textures start with their tail
+// resident, finer mips are read one at a time per texture down to the mip feedback requests,
+// and the least recently requested mips are evicted to make room for them. Textures furthest
+// from the mip they are requested at are read first, then the most requested ones.
+class TextureResidency
+{
+public:
+    static constexpr uint32_t kNoMip = 0xffffffff;
+
+    // Residency of a streamed texture, resident mips are first_mip to the last one.
+    struct Texture
+    {
+        std::vector<uint64_t> mip_sizes;
+        // Update each mip was last requested by.
+        std::vector<uint64_t> last_used;
+        uint32_t              tail_mip  = 0;
+        uint32_t              first_mip = 0;
+        // Finest mip requested by the last update, the mip count if none was.
+        uint32_t wanted_mip = 0;
+        uint32_t requests   = 0;
+        uint32_t read_mip   = kNoMip;
+        // Reads failed, the texture stays at its resident mips.
+        bool failed = false;
+    };
+
+    // Sizes are in bytes, at most max_reads reads are in flight.
+    TextureResidency(uint64_t budget, uint32_t max_reads);
+
+    // Set the mips of the texture with its tail resident, replacing them if it was set
+    // before. A read in flight for the previous mips is forgotten, the backend drops it.
+    void SetTexture(uint32_t texture, const std::vector<uint64_t>& mip_sizes, uint32_t tail_mip);
+
+    // Touch the requested mips and the coarser ones, and read the next finer mip of textures
+    // requested finer than their resident mips, evicting mips not requested by this update
+    // while the budget is exceeded. Requests of unknown textures are ignored.
+    void Update(const std::vector<MipRequest>& requests, TextureStreamingBackend& backend);
+    // Make the mip read by the backend resident, or stop streaming the texture if the read
+    // failed.
+    void MipRead(uint32_t texture, uint32_t mip, bool read, TextureStreamingBackend& backend);
+
+    bool           streamed(uint32_t texture) const;
+    const Texture& texture(uint32_t texture) const { return textures_[texture]; }
+    uint32_t       texture_count() const { return static_cast<uint32_t>(textures_.size()); }
+    uint64_t       budget() const { return budget_; }
+    uint64_t       resident_size() const { return resident_size_; }
+    // Bytes of the mips being read, which count against the budget.
+    uint64_t read_size() const { return read_size_; }
+    uint32_t read_count() const { return read_count_; }
+    // Mips read and evicted by the last update.
+    uint32_t started_read_count() const { return started_read_count_; }
+    uint32_t eviction_count() const { return eviction_count_; }
+
+private:
+    // Finest resident mip of a texture without a read in flight, which was last requested the
+    // longest ago before this update. Ties evict the largest mip, then the first texture.
+    uint32_t FindEvictable() const;
+    // Bytes evicting mips with FindEvictable frees at most.
+    uint64_t EvictableSize() const;
+    void     Evict(uint32_t texture, TextureStreamingBackend& backend);
+
+    uint64_t             budget_    = 0;
+    uint32_t             max_reads_ = 0;
+    uint64_t             update_    = 0;
+    std::vector<Texture> textures_;
+    uint64_t             resident_size_      = 0;
+    uint64_t             read_size_          = 0;
+    uint32_t             read_count_         = 0;
+    uint32_t             started_read_count_ = 0;
+    uint32_t             eviction_count_     = 0;
+};
+}  // namespace capsaicin
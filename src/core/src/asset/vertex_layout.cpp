@@ -0,0 +1,148 @@
+#include "vertex_layout.h"
+
+namespace capsaicin
+{
+namespace
+{
+constexpr uint32_t kCacheLineSize = 64;
+
+bool Overlap(const VertexAttribute& a, const VertexAttribute& b)
+{
+    return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+template <uint32_t kPositionSize, uint32_t kNormalSize, uint32_t kTexcoordSize, uint32_t kStride>
+void Interleave(const uint8_t* positions,
+                const uint8_t* normals,
+                const uint8_t* texcoords,
+                uint32_t       count,
+                uint8_t*       out)
+{
+    static_assert(kPositionSize + kNormalSize + kTexcoordSize <= kStride, "Invalid layout");
+    constexpr uint32_t kPadding = kStride - kPositionSize - kNormalSize - kTexcoordSize;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::memcpy(out, positions + i * kPositionSize, kPositionSize);
+        out += kPositionSize;
+        std::memcpy(out, normals + i * kNormalSize, kNormalSize);
+        out += kNormalSize;
+        std::memcpy(out, texcoords + i * kTexcoordSize, kTexcoordSize);
+        out += kTexcoordSize;
+
+        if constexpr (kPadding > 0)
+        {
+            std::memset(out, 0, kPadding);
+            out += kPadding;
+        }
+    }
+}
+}  // namespace
+
+VertexLayout MakeInterleavedLayout(uint32_t position_size,
+                                   uint32_t normal_size,
+                                   uint32_t texcoord_size)
+{
+    VertexLayout layout;
+    layout.position = {0, position_size};
+    layout.normal   = {position_size, normal_size};
+    layout.texcoord = {position_size + normal_size, texcoord_size};
+
+    layout.stride = 4;
+    while (layout.stride < position_size + normal_size + texcoord_size)
+    {
+        layout.stride <<= 1;
+    }
+
+    return layout;
+}
+
+bool ValidateVertexLayout(const VertexLayout& layout)
+{
+    const std::pair<const char*, const VertexAttribute*> attributes[] = {
+        {"position", &layout.position}, {"normal", &layout.normal}, {"texcoord", &layout.texcoord}};
+
+    if (layout.stride == 0 || layout.stride % 4 != 0)
+    {
+        error("VertexLayout: Stride {} is not a multiple of 4", layout.stride);
+        return false;
+    }
+
+    for (auto& [name, attribute] : attributes)
+    {
+        if (attribute->size == 0 || attribute->offset % 4 != 0 || attribute->size % 4 != 0)
+        {
+            error("VertexLayout: Attribute {} is empty or not word aligned", name);
+            return false;
+        }
+
+        if (attribute->offset + attribute->size > layout.stride)
+        {
+            error("VertexLayout: Attribute {} is outside of the {} byte record",
+                  name,
+                  layout.stride);
+            return false;
+        }
+    }
+
+    if (Overlap(layout.position, layout.normal) || Overlap(layout.position, layout.texcoord) ||
+        Overlap(layout.normal, layout.texcoord))
+    {
+        error("VertexLayout: Attributes overlap");
+        return false;
+    }
+
+    if (kCacheLineSize % layout.stride != 0)
+    {
+        error("VertexLayout: {} byte records straddle cache lines", layout.stride);
+        return false;
+    }
+
+    return true;
+}
+
+void InterleaveVertices(const VertexLayout& layout,
+                        const void*         positions,
+                        const void*         normals,
+                        const void*         texcoords,
+                        uint32_t            count,
+                        void*               out)
+{
+    auto p = static_cast<const uint8_t*>(positions);
+    auto n = static_cast<const uint8_t*>(normals);
+    auto t = static_cast<const uint8_t*>(texcoords);
+    auto o = static_cast<uint8_t*>(out);
+
+    // Fixed size copies for the layouts shaders support.
+    auto packed = layout.position.offset == 0 &&
+                  layout.normal.offset == layout.position.size &&
+                  layout.texcoord.offset == layout.position.size + layout.normal.size;
+
+    if (packed && layout.stride == 32 && layout.position.size == 12 &&
+        layout.normal.size == 12 && layout.texcoord.size == 8)
+    {
+        Interleave<12, 12, 8, 32>(p, n, t, count, o);
+        return;
+    }
+
+    if (packed && layout.stride == 16 && layout.position.size == 8 && layout.normal.size == 4 &&
+        layout.texcoord.size == 4)
+    {
+        Interleave<8, 4, 4, 16>(p, n, t, count, o);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto record = o + i * layout.stride;
+        std::memset(record, 0, layout.stride);
+        std::memcpy(record + layout.position.offset,
+                    p + i * layout.position.size,
+                    layout.position.size);
+        std::memcpy(record + layout.normal.offset, n + i * layout.normal.size, layout.normal.size);
+        std::memcpy(record + layout.texcoord.offset,
+                    t + i * layout.texcoord.size,
+                    layout.texcoord.size);
+    }
+}
+}  // namespace capsaicin
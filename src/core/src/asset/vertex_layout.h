@@ -0,0 +1,41 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Placement of an attribute inside a vertex record, in bytes.
+struct VertexAttribute
+{
+    uint32_t offset = 0;
+    uint32_t size   = 0;
+};
+
+// Interleaved vertex record, position, normal and texcoord in this order.
+struct VertexLayout
+{
+    VertexAttribute position;
+    VertexAttribute normal;
+    VertexAttribute texcoord;
+    uint32_t        stride = 0;
+};
+
+// Pack attributes of the given sizes back to back and pad the record to a power of two,
+// so that records never straddle 64-byte cache lines. Float attributes make a 32-byte
+// record, quantized ones a 16-byte record; shaders hardcode both of them.
+VertexLayout MakeInterleavedLayout(uint32_t position_size,
+                                   uint32_t normal_size,
+                                   uint32_t texcoord_size);
+
+// Check that attributes are word aligned, inside the record and don't overlap, and that
+// the record doesn't straddle cache lines. Logs the reason and returns false otherwise.
+bool ValidateVertexLayout(const VertexLayout& layout);
+
+// Interleave attribute streams of count vertices into records, padding is zeroed.
+void InterleaveVertices(const VertexLayout& layout,
+                        const void*         positions,
+                        const void*         normals,
+                        const void*         texcoords,
+                        uint32_t            count,
+                        void*               out);
+}  // namespace capsaicin
@@ -0,0 +1,494 @@
+#include "vertex_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAPSAICIN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace capsaicin
+{
+namespace
+{
+// Scalar paths follow the SIMD ones operation by operation, so both produce identical bits.
+constexpr float kSnorm16Max  = 32767.f;
+constexpr float kUnorm16Max  = 65535.f;
+constexpr float kMinL1Length = std::numeric_limits<float>::min();
+
+struct PositionTransform
+{
+    float center[3];
+    float half_extent[3];
+    float scale[3];
+};
+
+PositionTransform GetPositionTransform(const Bounds& bounds)
+{
+    PositionTransform transform;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        transform.center[c]      = 0.5f * (bounds.min[c] + bounds.max[c]);
+        transform.half_extent[c] = 0.5f * (bounds.max[c] - bounds.min[c]);
+        transform.scale[c] = transform.half_extent[c] > 0.f ? 1.f / transform.half_extent[c] : 0.f;
+    }
+    return transform;
+}
+
+uint32_t FloatBits(float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+float BitsFloat(uint32_t u)
+{
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// Round to nearest float to half conversion, see
+// https://gist.github.com/rygorous/2156668 (float_to_half_fast3).
+uint32_t FloatToHalf(float value)
+{
+    constexpr uint32_t kF32Infinity = 255 << 23;
+    constexpr uint32_t kF16Infinity = 31 << 23;
+    constexpr uint32_t kRoundMask   = ~0xfffu;
+
+    auto f    = FloatBits(value);
+    auto sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint32_t h = 0;
+    if (f >= kF32Infinity)
+    {
+        h = f > kF32Infinity ? 0x7e00 : 0x7c00;
+    }
+    else
+    {
+        f = FloatBits(BitsFloat(f & kRoundMask) * BitsFloat(15 << 23)) - kRoundMask;
+        h = std::min(f, kF16Infinity) >> 13;
+    }
+
+    return h | (sign >> 16);
+}
+
+float HalfToFloat(uint32_t half)
+{
+    constexpr uint32_t kShiftedExponent = 0x7c00 << 13;
+
+    auto f        = (half & 0x7fff) << 13;
+    auto exponent = f & kShiftedExponent;
+    f += (127 - 15) << 23;
+
+    if (exponent == kShiftedExponent)
+    {
+        f += (128 - 16) << 23;
+    }
+    else if (exponent == 0)
+    {
+        f += 1 << 23;
+        f = FloatBits(BitsFloat(f) - BitsFloat(113 << 23));
+    }
+
+    return BitsFloat(f | ((half & 0x8000) << 16));
+}
+
+uint32_t EncodeNormal(const float* n)
+{
+    auto length = std::max(std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]), kMinL1Length);
+    auto x      = n[0] / length;
+    auto y      = n[1] / length;
+
+    if (n[2] / length < 0.f)
+    {
+        auto wrapped_x = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        auto wrapped_y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x              = wrapped_x;
+        y              = wrapped_y;
+    }
+
+    x = std::clamp(x * 0.5f + 0.5f, 0.f, 1.f);
+    y = std::clamp(y * 0.5f + 0.5f, 0.f, 1.f);
+
+    return static_cast<uint32_t>(std::nearbyint(x * kUnorm16Max)) |
+           (static_cast<uint32_t>(std::nearbyint(y * kUnorm16Max)) << 16);
+}
+
+void DecodeNormal(uint32_t encoded, float* n)
+{
+    auto x = static_cast<float>(encoded & 0xffff) / kUnorm16Max * 2.f - 1.f;
+    auto y = static_cast<float>(encoded >> 16) / kUnorm16Max * 2.f - 1.f;
+    auto z = 1.f - std::abs(x) - std::abs(y);
+    auto t = std::max(-z, 0.f);
+    x += x >= 0.f ? -t : t;
+    y += y >= 0.f ? -t : t;
+
+    auto length = std::sqrt(x * x + y * y + z * z);
+    n[0]        = x / length;
+    n[1]        = y / length;
+    n[2]        = z / length;
+}
+
+#ifdef CAPSAICIN_SSE2
+__m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__m128 Abs(__m128 v)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+}
+
+__m128 SignNotZero(__m128 v)
+{
+    return Select(_mm_cmpge_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f), _mm_set1_ps(-1.f));
+}
+
+__m128 Clamp01(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+}
+
+// Load four xyz positions, which are three vectors of xyzx, yzxy and zxyz, as x, y and z
+// vectors.
+void LoadPositions(const float* positions, __m128& x, __m128& y, __m128& z)
+{
+    auto a = _mm_loadu_ps(positions);
+    auto b = _mm_loadu_ps(positions + 4);
+    auto c = _mm_loadu_ps(positions + 8);
+
+    auto b2c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2));
+    auto a1b0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1));
+    auto b3c2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3));
+    auto a2b1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2));
+    auto c0c3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 0, 0));
+
+    x = _mm_shuffle_ps(a, b2c1, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(a1b0, b3c2, _MM_SHUFFLE(2, 0, 2, 0));
+    z = _mm_shuffle_ps(a2b1, c0c3, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+float HorizontalMin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+float HorizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+// 4-wide version of FloatToHalf, https://gist.github.com/rygorous/2156668.
+__m128i FloatToHalf(__m128 f)
+{
+    auto round_mask = _mm_castsi128_ps(_mm_set1_epi32(~0xfff));
+    auto magic      = _mm_castsi128_ps(_mm_set1_epi32(15 << 23));
+    auto clamp      = _mm_castsi128_ps(_mm_set1_epi32((31 << 23) - 0x1000));
+    auto infinity   = _mm_set1_epi32(255 << 23);
+
+    auto sign      = _mm_and_ps(f, _mm_set1_ps(-0.f));
+    auto abs       = _mm_xor_ps(f, sign);
+    auto is_nan    = _mm_cmpgt_epi32(_mm_castps_si128(abs), infinity);
+    auto is_finite = _mm_cmpgt_epi32(infinity, _mm_castps_si128(abs));
+    auto inf_or_nan =
+        _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+    auto scaled  = _mm_mul_ps(_mm_and_ps(abs, round_mask), magic);
+    auto clamped = _mm_min_ps(scaled, clamp);
+    auto biased  = _mm_sub_epi32(_mm_castps_si128(clamped), _mm_castps_si128(round_mask));
+    auto finite  = _mm_and_si128(_mm_srli_epi32(biased, 13), is_finite);
+    auto special = _mm_andnot_si128(is_finite, inf_or_nan);
+
+    return _mm_or_si128(_mm_or_si128(finite, special),
+                        _mm_srli_epi32(_mm_castps_si128(sign), 16));
+}
+
+// 4-wide version of HalfToFloat, halves are in the low bits of each lane.
+__m128 HalfToFloat(__m128i h)
+{
+    auto magic    = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    auto infinity = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+    auto exponent_mantissa = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+    auto sign              = _mm_slli_epi32(_mm_xor_si128(h, exponent_mantissa), 16);
+    auto scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponent_mantissa, 13)), magic);
+    auto is_inf_or_nan = _mm_cmpgt_epi32(exponent_mantissa, _mm_set1_epi32(0x7bff));
+    auto special       = _mm_and_ps(_mm_castsi128_ps(is_inf_or_nan), infinity);
+
+    return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), special));
+}
+#endif
+}  // namespace
+
+Bounds ComputeBounds(const float* positions, uint32_t count)
+{
+    Bounds bounds;
+    if (count == 0)
+    {
+        return bounds;
+    }
+
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        bounds.min[c] = bounds.max[c] = positions[c];
+    }
+
+    uint32_t i = 1;
+
+#ifdef CAPSAICIN_SSE2
+    if (count >= 4)
+    {
+        __m128 low[3], high[3];
+        LoadPositions(positions, low[0], low[1], low[2]);
+        std::copy_n(low, 3, high);
+
+        for (i = 4; i + 4 <= count; i += 4)
+        {
+            __m128 p[3];
+            LoadPositions(positions + 3 * i, p[0], p[1], p[2]);
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                low[c]  = _mm_min_ps(low[c], p[c]);
+                high[c] = _mm_max_ps(high[c], p[c]);
+            }
+        }
+
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            bounds.min[c] = HorizontalMin(low[c]);
+            bounds.max[c] = HorizontalMax(high[c]);
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            bounds.min[c] = std::min(bounds.min[c], positions[3 * i + c]);
+            bounds.max[c] = std::max(bounds.max[c], positions[3 * i + c]);
+        }
+    }
+
+    return bounds;
+}
+
+float ComputeBoundingRadius(const float* positions, uint32_t count, const Bounds& bounds)
+{
+    float center[3];
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        center[c] = 0.5f * (bounds.min[c] + bounds.max[c]);
+    }
+
+    auto     max_distance2 = 0.f;
+    uint32_t i             = 0;
+
+#ifdef CAPSAICIN_SSE2
+    auto distances2 = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 p[3];
+        LoadPositions(positions + 3 * i, p[0], p[1], p[2]);
+
+        auto x = _mm_sub_ps(p[0], _mm_set1_ps(center[0]));
+        auto y = _mm_sub_ps(p[1], _mm_set1_ps(center[1]));
+        auto z = _mm_sub_ps(p[2], _mm_set1_ps(center[2]));
+        auto d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+
+        distances2 = _mm_max_ps(distances2, d);
+    }
+    max_distance2 = HorizontalMax(distances2);
+#endif
+
+    for (; i < count; ++i)
+    {
+        auto x        = positions[3 * i] - center[0];
+        auto y        = positions[3 * i + 1] - center[1];
+        auto z        = positions[3 * i + 2] - center[2];
+        max_distance2 = std::max(max_distance2, x * x + y * y + z * z);
+    }
+
+    return std::sqrt(max_distance2);
+}
+
+void QuantizePositions(const float* positions, uint32_t count, const Bounds& bounds, int16_t* out)
+{
+    auto transform = GetPositionTransform(bounds);
+
+#ifdef CAPSAICIN_SSE2
+    auto center = _mm_setr_ps(transform.center[0], transform.center[1], transform.center[2], 0.f);
+    auto scale  = _mm_setr_ps(transform.scale[0], transform.scale[1], transform.scale[2], 0.f);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto p = _mm_setr_ps(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2], 0.f);
+        auto v = _mm_mul_ps(_mm_sub_ps(p, center), scale);
+        v      = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+
+        auto q = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(kSnorm16Max)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * i), _mm_packs_epi32(q, q));
+    }
+#else
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            auto v = (positions[3 * i + c] - transform.center[c]) * transform.scale[c];
+            v      = std::min(std::max(v, -1.f), 1.f);
+            out[4 * i + c] = static_cast<int16_t>(std::nearbyint(v * kSnorm16Max));
+        }
+        out[4 * i + 3] = 0;
+    }
+#endif
+}
+
+void DequantizePositions(const int16_t* quantized,
+                         uint32_t       count,
+                         const Bounds&  bounds,
+                         float*         out)
+{
+    auto transform = GetPositionTransform(bounds);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            auto v         = std::max(quantized[4 * i + c] / kSnorm16Max, -1.f);
+            out[3 * i + c] = transform.center[c] + v * transform.half_extent[c];
+        }
+    }
+}
+
+void EncodeNormals(const float* normals, uint32_t count, uint32_t* out)
+{
+    uint32_t i = 0;
+
+#ifdef CAPSAICIN_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        auto n  = normals + 3 * i;
+        auto nx = _mm_setr_ps(n[0], n[3], n[6], n[9]);
+        auto ny = _mm_setr_ps(n[1], n[4], n[7], n[10]);
+        auto nz = _mm_setr_ps(n[2], n[5], n[8], n[11]);
+
+        auto length = _mm_max_ps(_mm_add_ps(_mm_add_ps(Abs(nx), Abs(ny)), Abs(nz)),
+                                 _mm_set1_ps(kMinL1Length));
+        auto x      = _mm_div_ps(nx, length);
+        auto y      = _mm_div_ps(ny, length);
+
+        auto lower     = _mm_cmplt_ps(_mm_div_ps(nz, length), _mm_setzero_ps());
+        auto wrapped_x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.f), Abs(y)), SignNotZero(x));
+        auto wrapped_y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.f), Abs(x)), SignNotZero(y));
+        x              = Select(lower, wrapped_x, x);
+        y              = Select(lower, wrapped_y, y);
+
+        x = Clamp01(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f)));
+        y = Clamp01(_mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f)));
+
+        auto qx = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kUnorm16Max)));
+        auto qy = _mm_cvtps_epi32(_mm_mul_ps(y, _mm_set1_ps(kUnorm16Max)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_or_si128(qx, _mm_slli_epi32(qy, 16)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        out[i] = EncodeNormal(normals + 3 * i);
+    }
+}
+
+void DecodeNormals(const uint32_t* encoded, uint32_t count, float* out)
+{
+    uint32_t i = 0;
+
+#ifdef CAPSAICIN_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        auto e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(encoded + i));
+        auto x = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(e, _mm_set1_epi32(0xffff))),
+                            _mm_set1_ps(kUnorm16Max));
+        auto y = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(e, 16)), _mm_set1_ps(kUnorm16Max));
+        x      = _mm_sub_ps(_mm_mul_ps(x, _mm_set1_ps(2.f)), _mm_set1_ps(1.f));
+        y      = _mm_sub_ps(_mm_mul_ps(y, _mm_set1_ps(2.f)), _mm_set1_ps(1.f));
+
+        auto z     = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.f), Abs(x)), Abs(y));
+        auto t     = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+        auto neg_t = _mm_sub_ps(_mm_setzero_ps(), t);
+        x          = _mm_add_ps(x, Select(_mm_cmpge_ps(x, _mm_setzero_ps()), neg_t, t));
+        y          = _mm_add_ps(y, Select(_mm_cmpge_ps(y, _mm_setzero_ps()), neg_t, t));
+
+        auto length = _mm_sqrt_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+
+        alignas(16) float xs[4], ys[4], zs[4];
+        _mm_store_ps(xs, _mm_div_ps(x, length));
+        _mm_store_ps(ys, _mm_div_ps(y, length));
+        _mm_store_ps(zs, _mm_div_ps(z, length));
+
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            out[3 * (i + k) + 0] = xs[k];
+            out[3 * (i + k) + 1] = ys[k];
+            out[3 * (i + k) + 2] = zs[k];
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        DecodeNormal(encoded[i], out + 3 * i);
+    }
+}
+
+void EncodeTexcoords(const float* texcoords, uint32_t count, uint32_t* out)
+{
+    uint32_t i = 0;
+
+#ifdef CAPSAICIN_SSE2
+    for (; i + 2 <= count; i += 2)
+    {
+        // Lanes are u0 v0 u1 v1, merge each pair of halves into the low word of its qword.
+        auto h = FloatToHalf(_mm_loadu_ps(texcoords + 2 * i));
+        h      = _mm_or_si128(h, _mm_srli_epi64(h, 16));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+                         _mm_shuffle_epi32(h, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        out[i] = FloatToHalf(texcoords[2 * i]) | (FloatToHalf(texcoords[2 * i + 1]) << 16);
+    }
+}
+
+void DecodeTexcoords(const uint32_t* encoded, uint32_t count, float* out)
+{
+    uint32_t i = 0;
+
+#ifdef CAPSAICIN_SSE2
+    for (; i + 2 <= count; i += 2)
+    {
+        auto e = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(encoded + i));
+        _mm_storeu_ps(out + 2 * i, HalfToFloat(_mm_unpacklo_epi16(e, _mm_setzero_si128())));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        out[2 * i]     = HalfToFloat(encoded[i] & 0xffff);
+        out[2 * i + 1] = HalfToFloat(encoded[i] >> 16);
+    }
+}
+}  // namespace capsaicin
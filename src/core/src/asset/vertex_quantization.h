@@ -0,0 +1,36 @@
+#pragma once
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Axis aligned bounding box of a position stream.
+struct Bounds
+{
+    float min[3] = {0.f, 0.f, 0.f};
+    float max[3] = {0.f, 0.f, 0.f};
+};
+
+Bounds ComputeBounds(const float* positions, uint32_t count);
+// Radius of the sphere around the center of the bounds which contains all positions, so that
+// the box and the sphere share a center.
+float ComputeBoundingRadius(const float* positions, uint32_t count, const Bounds& bounds);
+
+// Positions are snorm16 xyz (plus zero w) relative to the bounds, so that
+// p = center + q * half_extent. Error per axis is at most half_extent / 32767.
+void QuantizePositions(const float* positions, uint32_t count, const Bounds& bounds, int16_t* out);
+void DequantizePositions(const int16_t* quantized,
+                         uint32_t       count,
+                         const Bounds&  bounds,
+                         float*         out);
+
+// Normals are octahedral encoded with unorm16 components packed into a word, x in the
+// low half. Angular error is below 1e-4 radians for unit normals.
+void EncodeNormals(const float* normals, uint32_t count, uint32_t* out);
+void DecodeNormals(const uint32_t* encoded, uint32_t count, float* out);
+
+// Texcoords are half floats packed into a word, u in the low half. Rounding is to
+// nearest, so relative error is at most 2^-11 within the half range.
+void EncodeTexcoords(const float* texcoords, uint32_t count, uint32_t* out);
+void DecodeTexcoords(const uint32_t* encoded, uint32_t count, float* out);
+}  // namespace capsaicin
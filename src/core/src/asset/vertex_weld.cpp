@@ -0,0 +1,211 @@
+#include "vertex_weld.h"
+
+#include <map>
+#include <tuple>
+
+#include "src/utils/parallel_for.h"
+
+namespace capsaicin
+{
+namespace
+{
+// Open addressing hash map from packed corner keys to welded vertex indices.
+class CornerMap
+{
+public:
+    explicit CornerMap(std::size_t max_count)
+    {
+        std::size_t capacity = 16;
+        while (capacity < 2 * max_count)
+        {
+            capacity <<= 1;
+        }
+
+        slots_.resize(capacity);
+        mask_ = capacity - 1;
+    }
+
+    // Return the index of the corner, inserting new_index if the corner is not present.
+    uint32_t FindOrInsert(const ObjIndex& corner, uint32_t new_index)
+    {
+        // Missing attributes are -1, shift them to pack normal and texcoord into one word.
+        auto vertex = static_cast<uint32_t>(corner.vertex_index);
+        auto attributes =
+            (static_cast<uint64_t>(static_cast<uint32_t>(corner.normal_index + 1)) << 32) |
+            static_cast<uint32_t>(corner.texcoord_index + 1);
+
+        for (auto i = Hash(vertex, attributes) & mask_;; i = (i + 1) & mask_)
+        {
+            auto& slot = slots_[i];
+
+            if (slot.value == kEmpty)
+            {
+                slot.attributes = attributes;
+                slot.vertex     = vertex;
+                slot.value      = new_index;
+                return new_index;
+            }
+
+            if (slot.vertex == vertex && slot.attributes == attributes)
+            {
+                return slot.value;
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t kEmpty = ~0u;
+
+    struct Slot
+    {
+        uint64_t attributes = 0;
+        uint32_t vertex     = 0;
+        uint32_t value      = kEmpty;
+    };
+
+    static std::size_t Hash(uint32_t vertex, uint64_t attributes)
+    {
+        auto h = vertex * 0x9e3779b97f4a7c15ull ^ attributes * 0xc2b2ae3d27d4eb4full;
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
+
+    std::vector<Slot> slots_;
+    std::size_t       mask_ = 0;
+};
+
+// Write the attributes of the first corner of each welded vertex.
+void WriteVertices(const ObjData&               obj_data,
+                   const std::vector<uint32_t>& unique_corners,
+                   MeshData&                    mesh)
+{
+    auto vertex_count = unique_corners.size();
+    mesh.positions.resize(vertex_count * 3);
+    mesh.normals.resize(vertex_count * 3);
+    mesh.texcoords.resize(vertex_count * 2);
+
+    auto positions = mesh.positions.data();
+    auto normals   = mesh.normals.data();
+    auto texcoords = mesh.texcoords.data();
+
+    for (auto corner : unique_corners)
+    {
+        auto& index = obj_data.indices[corner];
+
+        auto position = &obj_data.vertices[3 * static_cast<std::size_t>(index.vertex_index)];
+        *positions++  = position[0];
+        *positions++  = position[1];
+        *positions++  = position[2];
+
+        if (index.normal_index != -1)
+        {
+            auto normal = &obj_data.normals[3 * static_cast<std::size_t>(index.normal_index)];
+            *normals++  = normal[0];
+            *normals++  = normal[1];
+            *normals++  = normal[2];
+        }
+        else
+        {
+            *normals++ = 0.f;
+            *normals++ = 0.f;
+            *normals++ = 0.f;
+        }
+
+        if (index.texcoord_index != -1)
+        {
+            auto texcoord = &obj_data.texcoords[2 * static_cast<std::size_t>(index.texcoord_index)];
+            *texcoords++  = texcoord[0];
+            *texcoords++  = texcoord[1];
+        }
+        else
+        {
+            *texcoords++ = 0.f;
+            *texcoords++ = 0.f;
+        }
+    }
+}
+
+// Weld a range of corners into an indexed mesh.
+void WeldCorners(const ObjData& obj_data,
+                 uint32_t       first_index,
+                 uint32_t       index_count,
+                 MeshData&      mesh)
+{
+    CornerMap map(index_count);
+
+    // First corner referencing each of the welded vertices.
+    std::vector<uint32_t> unique_corners;
+
+    mesh.indices.resize(index_count);
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        auto new_index = static_cast<uint32_t>(unique_corners.size());
+        auto index     = map.FindOrInsert(obj_data.indices[first_index + i], new_index);
+
+        if (index == new_index)
+        {
+            unique_corners.push_back(first_index + i);
+        }
+
+        mesh.indices[i] = index;
+    }
+
+    WriteVertices(obj_data, unique_corners, mesh);
+}
+}  // namespace
+
+void WeldObjShapes(const ObjData&         obj_data,
+                   std::vector<MeshData>& meshes,
+                   bool                   force_single_mesh,
+                   tf::Subflow&           subflow)
+{
+    auto first_mesh = meshes.size();
+    auto num_meshes = force_single_mesh ? 1u : static_cast<uint32_t>(obj_data.shapes.size());
+
+    meshes.resize(first_mesh + num_meshes);
+
+    ParallelFor(subflow, num_meshes, [&](uint32_t i) {
+        auto& mesh = meshes[first_mesh + i];
+
+        if (force_single_mesh)
+        {
+            WeldCorners(obj_data, 0, static_cast<uint32_t>(obj_data.indices.size()), mesh);
+        }
+        else
+        {
+            auto& shape = obj_data.shapes[i];
+            WeldCorners(obj_data, shape.first_index, shape.index_count, mesh);
+        }
+    });
+}
+
+void WeldObjShapesReference(const ObjData& obj_data, std::vector<MeshData>& meshes)
+{
+    meshes.resize(obj_data.shapes.size());
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        auto& shape = obj_data.shapes[i];
+        auto& mesh  = meshes[i];
+
+        std::map<std::tuple<int, int, int>, uint32_t> map;
+        std::vector<uint32_t>                         unique_corners;
+
+        mesh.indices.resize(shape.index_count);
+        for (uint32_t j = 0; j < shape.index_count; ++j)
+        {
+            auto& corner = obj_data.indices[shape.first_index + j];
+            auto  key =
+                std::make_tuple(corner.vertex_index, corner.normal_index, corner.texcoord_index);
+            auto it = map.emplace(key, static_cast<uint32_t>(unique_corners.size())).first;
+
+            if (it->second == unique_corners.size())
+            {
+                unique_corners.push_back(shape.first_index + j);
+            }
+
+            mesh.indices[j] = it->second;
+        }
+
+        WriteVertices(obj_data, unique_corners, mesh);
+    }
+}
+}  // namespace capsaicin
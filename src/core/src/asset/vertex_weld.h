@@ -0,0 +1,20 @@
+#pragma once
+
+#include "src/asset/mesh_data.h"
+#include "src/asset/obj_parser.h"
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Deduplicate (vertex, normal, texcoord) corners of every obj shape and write indexed
+// meshes, one per shape or a single one if force_single_mesh is set. Shapes are welded
+// concurrently on the subflow. Joins the subflow.
+void WeldObjShapes(const ObjData&         obj_data,
+                   std::vector<MeshData>& meshes,
+                   bool                   force_single_mesh,
+                   tf::Subflow&           subflow);
+
+// Weld every obj shape into its own mesh with a std::map from corners to welded vertices on
+// the calling thread, the reference WeldObjShapes is benchmarked against.
+void WeldObjShapesReference(const ObjData& obj_data, std::vector<MeshData>& meshes);
+}  // namespace capsaicin
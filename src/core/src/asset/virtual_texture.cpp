@@ -0,0 +1,448 @@
+#include "virtual_texture.h"
+
+#include "src/asset/image.h"
+
+namespace capsaicin
+{
+void ReducePageFeedback(const uint32_t*           feedback,
+                        std::size_t               count,
+                        std::vector<PageRequest>& requests)
+{
+    requests.clear();
+
+    // Neighbouring entries mostly hit the same page, so runs are collapsed before sorting.
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (feedback[i] == kInvalidPage)
+        {
+            continue;
+        }
+
+        if (!requests.empty() && requests.back().page == feedback[i])
+        {
+            ++requests.back().count;
+        }
+        else
+        {
+            requests.push_back({feedback[i], 1});
+        }
+    }
+
+    std::sort(requests.begin(), requests.end(), [](const PageRequest& a, const PageRequest& b) {
+        return a.page < b.page;
+    });
+
+    std::size_t merged = 0;
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        if (merged > 0 && requests[merged - 1].page == requests[i].page)
+        {
+            requests[merged - 1].count += requests[i].count;
+        }
+        else
+        {
+            requests[merged++] = requests[i];
+        }
+    }
+
+    requests.resize(merged);
+}
+
+VirtualTextureManager::VirtualTextureManager(uint32_t slot_count, uint32_t max_uploads_per_update)
+    : max_uploads_per_update_(max_uploads_per_update), slots_(slot_count)
+{
+    // Slots are handed out from the front.
+    for (uint32_t slot = slot_count; slot > 0; --slot)
+    {
+        free_slots_.push_back(slot - 1);
+    }
+}
+
+bool VirtualTextureManager::SetTexture(uint32_t   texture,
+                                       uint32_t   width,
+                                       uint32_t   height,
+                                       PageCache& cache)
+{
+    if (texture >= kMaxVirtualTextures || width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    if (texture >= textures_.size())
+    {
+        textures_.resize(texture + 1);
+        layouts_.resize(texture + 1);
+    }
+
+    // Pages of the previous size are dropped, pinned ones included.
+    if (textures_[texture].width > 0)
+    {
+        for (uint32_t slot = 0; slot < slots_.size(); ++slot)
+        {
+            if (slots_[slot].page != kInvalidPage && PageTexture(slots_[slot].page) == texture)
+            {
+                Evict(slot);
+                free_slots_.push_back(slot);
+            }
+        }
+    }
+
+    TextureLayout layout;
+    uint32_t      mip_count = 0;
+    while (mip_count < kMaxPageMips)
+    {
+        auto mip_width  = MipDimension(width, mip_count);
+        auto mip_height = MipDimension(height, mip_count);
+
+        auto pages_x    = (mip_width + kPageTexels - 1) / kPageTexels;
+        auto pages_y    = (mip_height + kPageTexels - 1) / kPageTexels;
+        if (pages_x > kMaxPagesAxis || pages_y > kMaxPagesAxis)
+        {
+            // The texture is unmapped, but keeps its page table entries for a later size.
+            auto& desc             = textures_[texture];
+            auto  offset           = desc.page_table_offset;
+            desc                   = VirtualTextureDesc();
+            desc.page_table_offset = offset;
+            MarkTextureDirty(texture);
+            return false;
+        }
+
+        layout.pages_x[mip_count]    = pages_x;
+        layout.pages_y[mip_count]    = pages_y;
+        layout.mip_offset[mip_count] = layout.page_count;
+        layout.page_count += pages_x * pages_y;
+        ++mip_count;
+
+        if (pages_x == 1 && pages_y == 1)
+        {
+            break;
+        }
+    }
+
+    // Reloads keep the entries of the previous size if they have room, and get new ones
+    // otherwise. Textures which failed to fit keep their entries as well.
+    auto& desc   = textures_[texture];
+    auto  reuse  = layouts_[texture].page_count > 0 &&
+                  layout.page_count <= layouts_[texture].page_count;
+    auto  offset = reuse ? desc.page_table_offset : static_cast<uint32_t>(page_table_.size());
+    if (!reuse)
+    {
+        page_table_.resize(page_table_.size() + layout.page_count);
+    }
+    else
+    {
+        layout.page_count = layouts_[texture].page_count;
+    }
+
+    desc.width             = width;
+    desc.height            = height;
+    desc.mip_count         = mip_count;
+    desc.page_table_offset = offset;
+    layouts_[texture]      = layout;
+    MarkTextureDirty(texture);
+
+    for (uint32_t i = offset; i < offset + layout.page_count; ++i)
+    {
+        SetEntry(i, kUnmappedEntry);
+    }
+
+    // Any unpinned page makes room for the last mip.
+    auto slot = AllocateSlot(update_ + 1);
+    if (slot == kNoSlot)
+    {
+        return false;
+    }
+
+    Upload(PackPage(texture, mip_count - 1, 0, 0), slot, true, cache);
+    return true;
+}
+
+void VirtualTextureManager::Update(const std::vector<PageRequest>& requests, PageCache& cache)
+{
+    ++update_;
+    upload_count_   = 0;
+    eviction_count_ = 0;
+
+    // Ancestors of a page are requested with it, so that they are loaded first and aren't
+    // evicted while it is in use.
+    std::unordered_map<uint32_t, uint32_t> counts;
+    for (auto& request : requests)
+    {
+        if (!IsValid(request.page))
+        {
+            continue;
+        }
+
+        for (auto page = request.page; page != kInvalidPage; page = Parent(page))
+        {
+            counts[page] += request.count;
+        }
+    }
+
+    std::vector<PageRequest> missing;
+    for (auto& count : counts)
+    {
+        auto it = resident_.find(count.first);
+        if (it != resident_.end())
+        {
+            Touch(it->second);
+        }
+        else
+        {
+            missing.push_back({count.first, count.second});
+        }
+    }
+
+    // Coarse mips first, then the most requested pages. Ties keep page order, so that
+    // updates are deterministic.
+    std::sort(missing.begin(), missing.end(), [](const PageRequest& a, const PageRequest& b) {
+        if (PageMip(a.page) != PageMip(b.page))
+        {
+            return PageMip(a.page) > PageMip(b.page);
+        }
+        if (a.count != b.count)
+        {
+            return a.count > b.count;
+        }
+        return a.page < b.page;
+    });
+
+    for (auto& request : missing)
+    {
+        if (upload_count_ == max_uploads_per_update_)
+        {
+            break;
+        }
+
+        auto slot = AllocateSlot(update_);
+        if (slot == kNoSlot)
+        {
+            break;
+        }
+
+        Upload(request.page, slot, false, cache);
+    }
+}
+
+void VirtualTextureManager::TakeDirtyPageTable(uint32_t& begin, uint32_t& end)
+{
+    begin             = dirty_entries_[0];
+    end               = dirty_entries_[1];
+    dirty_entries_[0] = ~0u;
+    dirty_entries_[1] = 0;
+}
+
+void VirtualTextureManager::TakeDirtyTextures(uint32_t& begin, uint32_t& end)
+{
+    begin              = dirty_textures_[0];
+    end                = dirty_textures_[1];
+    dirty_textures_[0] = ~0u;
+    dirty_textures_[1] = 0;
+}
+
+bool VirtualTextureManager::IsValid(uint32_t page) const
+{
+    auto texture = PageTexture(page);
+    auto mip     = PageMip(page);
+    if (page == kInvalidPage || texture >= textures_.size() ||
+        mip >= textures_[texture].mip_count)
+    {
+        return false;
+    }
+
+    auto& layout = layouts_[texture];
+    return PageX(page) < layout.pages_x[mip] && PageY(page) < layout.pages_y[mip];
+}
+
+uint32_t VirtualTextureManager::EntryIndex(uint32_t texture,
+                                           uint32_t mip,
+                                           uint32_t x,
+                                           uint32_t y) const
+{
+    auto& layout = layouts_[texture];
+    return textures_[texture].page_table_offset + layout.mip_offset[mip] +
+           y * layout.pages_x[mip] + x;
+}
+
+uint32_t VirtualTextureManager::Parent(uint32_t page) const
+{
+    auto texture = PageTexture(page);
+    auto mip     = PageMip(page) + 1;
+    if (mip >= textures_[texture].mip_count)
+    {
+        return kInvalidPage;
+    }
+
+    // Odd sizes round mips down, so the last pages of a mip may fall past its parent mip.
+    auto& layout = layouts_[texture];
+    return PackPage(texture,
+                    mip,
+                    std::min(PageX(page) >> 1, layout.pages_x[mip] - 1),
+                    std::min(PageY(page) >> 1, layout.pages_y[mip] - 1));
+}
+
+void VirtualTextureManager::UpdatePageTable(uint32_t page)
+{
+    auto  texture = PageTexture(page);
+    auto  mip     = PageMip(page);
+    auto& layout  = layouts_[texture];
+
+    // Coarse mips first, so that entries which fall back to their parent read its new entry.
+    for (auto level = mip + 1; level-- > 0;)
+    {
+        auto shift = mip - level;
+        auto x0    = PageX(page) << shift;
+        auto y0    = PageY(page) << shift;
+        auto x1    = PageX(page) + 1 == layout.pages_x[mip]
+                         ? layout.pages_x[level]
+                         : std::min((PageX(page) + 1) << shift, layout.pages_x[level]);
+        auto y1    = PageY(page) + 1 == layout.pages_y[mip]
+                         ? layout.pages_y[level]
+                         : std::min((PageY(page) + 1) << shift, layout.pages_y[level]);
+
+        for (auto y = y0; y < y1; ++y)
+        {
+            for (auto x = x0; x < x1; ++x)
+            {
+                auto child  = PackPage(texture, level, x, y);
+                auto it     = resident_.find(child);
+                auto parent = Parent(child);
+
+                uint32_t entry = kUnmappedEntry;
+                if (it != resident_.end())
+                {
+                    entry = PageTableEntry(it->second, level);
+                }
+                else if (parent != kInvalidPage)
+                {
+                    entry = page_table_[EntryIndex(
+                        texture, level + 1, PageX(parent), PageY(parent))];
+                }
+
+                SetEntry(EntryIndex(texture, level, x, y), entry);
+            }
+        }
+    }
+}
+
+void VirtualTextureManager::SetEntry(uint32_t index, uint32_t entry)
+{
+    if (page_table_[index] == entry)
+    {
+        return;
+    }
+
+    page_table_[index] = entry;
+    dirty_entries_[0]  = std::min(dirty_entries_[0], index);
+    dirty_entries_[1]  = std::max(dirty_entries_[1], index + 1);
+}
+
+void VirtualTextureManager::MarkTextureDirty(uint32_t texture)
+{
+    dirty_textures_[0] = std::min(dirty_textures_[0], texture);
+    dirty_textures_[1] = std::max(dirty_textures_[1], texture + 1);
+}
+
+uint32_t VirtualTextureManager::AllocateSlot(uint64_t evict_before)
+{
+    if (!free_slots_.empty())
+    {
+        auto slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+
+    if (lru_head_ == kNoSlot || slots_[lru_head_].last_used >= evict_before)
+    {
+        return kNoSlot;
+    }
+
+    auto slot = lru_head_;
+    Evict(slot);
+    return slot;
+}
+
+void VirtualTextureManager::Upload(uint32_t page, uint32_t slot, bool pinned, PageCache& cache)
+{
+    auto& s     = slots_[slot];
+    s.page      = page;
+    s.last_used = update_;
+    s.pinned    = pinned;
+    if (!pinned)
+    {
+        Touch(slot);
+    }
+
+    resident_[page] = slot;
+    cache.UploadPage(page, slot);
+    UpdatePageTable(page);
+    ++upload_count_;
+}
+
+void VirtualTextureManager::Evict(uint32_t slot)
+{
+    auto page = slots_[slot].page;
+    if (!slots_[slot].pinned)
+    {
+        Unlink(slot);
+    }
+
+    slots_[slot] = Slot();
+    resident_.erase(page);
+    UpdatePageTable(page);
+    ++eviction_count_;
+}
+
+void VirtualTextureManager::Touch(uint32_t slot)
+{
+    auto& s     = slots_[slot];
+    s.last_used = update_;
+    if (s.pinned)
+    {
+        return;
+    }
+
+    // Linked slots move to the tail, new ones are appended.
+    if (s.prev != kNoSlot || s.next != kNoSlot || lru_head_ == slot)
+    {
+        Unlink(slot);
+    }
+
+    s.prev = lru_tail_;
+    s.next = kNoSlot;
+    if (lru_tail_ != kNoSlot)
+    {
+        slots_[lru_tail_].next = slot;
+    }
+    else
+    {
+        lru_head_ = slot;
+    }
+    lru_tail_ = slot;
+}
+
+void VirtualTextureManager::Unlink(uint32_t slot)
+{
+    auto& s = slots_[slot];
+    if (s.prev != kNoSlot)
+    {
+        slots_[s.prev].next = s.next;
+    }
+    else
+    {
+        lru_head_ = s.next;
+    }
+
+    if (s.next != kNoSlot)
+    {
+        slots_[s.next].prev = s.prev;
+    }
+    else
+    {
+        lru_tail_ = s.prev;
+    }
+
+    s.prev = kNoSlot;
+    s.next = kNoSlot;
+}
+}  // namespace capsaicin
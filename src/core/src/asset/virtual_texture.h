@@ -0,0 +1,176 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+// Pages of virtual textures are squares of texels of a mip level, stored in the slots of a
+// physical atlas with a border of their neighbours, so that bilinear filtering doesn't read
+// other pages. The mip chain of a texture is paged down to the first level which fits a page.
+constexpr uint32_t kPageTexels         = 120;
+constexpr uint32_t kPageBorder         = 4;
+constexpr uint32_t kPageSlotSize       = kPageTexels + 2 * kPageBorder;
+constexpr uint32_t kMaxPageMips        = 16;
+constexpr uint32_t kMaxPagesAxis       = 256;
+constexpr uint32_t kMaxVirtualTextures = 4095;
+
+// Pages are packed into 32 bits, as written by shaders: texture in the top 12 bits, then mip,
+// page row and page column. The last texture is reserved, so that no page is kInvalidPage.
+constexpr uint32_t kInvalidPage = 0xffffffff;
+
+inline uint32_t PackPage(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y)
+{
+    return (texture << 20) | (mip << 16) | (y << 8) | x;
+}
+
+inline uint32_t PageTexture(uint32_t page)
+{
+    return page >> 20;
+}
+
+inline uint32_t PageMip(uint32_t page)
+{
+    return (page >> 16) & 0xf;
+}
+
+inline uint32_t PageX(uint32_t page)
+{
+    return page & 0xff;
+}
+
+inline uint32_t PageY(uint32_t page)
+{
+    return (page >> 8) & 0xff;
+}
+
+// Page table entries map a page to a slot and the mip of the page in it, which is the page
+// itself or its nearest resident ancestor. Textures whose last mip isn't resident yet have
+// kUnmappedEntry.
+constexpr uint32_t kUnmappedEntry = 0xffffffff;
+
+inline uint32_t PageTableEntry(uint32_t slot, uint32_t mip)
+{
+    return (mip << 24) | slot;
+}
+
+// Virtual texture as read by shaders, its page table lists the pages of each mip row by row,
+// mip 0 first. Textures which aren't set have a zero size.
+struct VirtualTextureDesc
+{
+    uint32_t width             = 0;
+    uint32_t height            = 0;
+    uint32_t mip_count         = 0;
+    uint32_t page_table_offset = 0;
+};
+
+// Page hit by feedback, with the number of feedback entries which hit it.
+struct PageRequest
+{
+    uint32_t page;
+    uint32_t count;
+};
+
+// Reduce feedback entries to the distinct pages they hit, in page order. kInvalidPage
+// entries are skipped.
+void ReducePageFeedback(const uint32_t*           feedback,
+                        std::size_t               count,
+                        std::vector<PageRequest>& requests);
+
+// Physical cache pages are uploaded to, the atlas in TextureSystem.
+class PageCache
+{
+public:
+    virtual ~PageCache() = default;
+
+    // Copy the texels of the page with its border into the slot.
+    virtual void UploadPage(uint32_t page, uint32_t slot) = 0;
+};
+
+// Pages of virtual textures resident in a fixed number of cache slots, and the page table
+// mapping every page to the slot shaders sample it from. Requested pages are loaded
+// coarsest mip first and by the number of requests, evicting the least recently requested
+// pages. The last mip of each texture is pinned, so that every page has a fallback.
+class VirtualTextureManager
+{
+public:
+    VirtualTextureManager(uint32_t slot_count, uint32_t max_uploads_per_update);
+
+    // Set the size of the texture, replacing its pages if it was set before, and upload its
+    // last mip. False if the texture is too large to page or every slot is pinned.
+    bool SetTexture(uint32_t texture, uint32_t width, uint32_t height, PageCache& cache);
+
+    // Touch the requested pages and their ancestors, and upload those which aren't resident
+    // while slots not requested in this update can be evicted. Pages of unknown textures,
+    // mips or positions are ignored, as feedback lags behind texture changes.
+    void Update(const std::vector<PageRequest>& requests, PageCache& cache);
+
+    // Range of page table entries and of textures changed since the last call, empty if
+    // begin isn't less than end.
+    void TakeDirtyPageTable(uint32_t& begin, uint32_t& end);
+    void TakeDirtyTextures(uint32_t& begin, uint32_t& end);
+
+    bool     resident(uint32_t page) const { return resident_.count(page) != 0; }
+    uint32_t slot_count() const { return static_cast<uint32_t>(slots_.size()); }
+    uint32_t resident_count() const { return static_cast<uint32_t>(resident_.size()); }
+    // Pages uploaded and evicted by the last update.
+    uint32_t upload_count() const { return upload_count_; }
+    uint32_t eviction_count() const { return eviction_count_; }
+
+    const std::vector<VirtualTextureDesc>& textures() const { return textures_; }
+    const std::vector<uint32_t>&           page_table() const { return page_table_; }
+
+private:
+    static constexpr uint32_t kNoSlot = 0xffffffff;
+
+    struct Slot
+    {
+        uint32_t page      = kInvalidPage;
+        uint64_t last_used = 0;
+        bool     pinned    = false;
+        // Least recently used list of the unpinned resident slots.
+        uint32_t prev = kNoSlot;
+        uint32_t next = kNoSlot;
+    };
+
+    struct TextureLayout
+    {
+        uint32_t pages_x[kMaxPageMips]    = {};
+        uint32_t pages_y[kMaxPageMips]    = {};
+        uint32_t mip_offset[kMaxPageMips] = {};
+        uint32_t page_count               = 0;
+    };
+
+    bool     IsValid(uint32_t page) const;
+    uint32_t EntryIndex(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y) const;
+    uint32_t Parent(uint32_t page) const;
+    // Entries of the page and of the pages of finer mips within it.
+    void UpdatePageTable(uint32_t page);
+    void SetEntry(uint32_t index, uint32_t entry);
+    void MarkTextureDirty(uint32_t texture);
+
+    // Take a free slot or evict the least recently used one, if it was last used by an
+    // update before the given one.
+    uint32_t AllocateSlot(uint64_t evict_before);
+    void     Upload(uint32_t page, uint32_t slot, bool pinned, PageCache& cache);
+    void     Evict(uint32_t slot);
+    void     Touch(uint32_t slot);
+    void     Unlink(uint32_t slot);
+
+    uint32_t                               max_uploads_per_update_ = 0;
+    uint64_t                               update_                 = 0;
+    std::vector<Slot>                      slots_;
+    std::vector<uint32_t>                  free_slots_;
+    uint32_t                               lru_head_ = kNoSlot;
+    uint32_t                               lru_tail_ = kNoSlot;
+    std::unordered_map<uint32_t, uint32_t> resident_;
+    std::vector<VirtualTextureDesc>        textures_;
+    std::vector<TextureLayout>             layouts_;
+    std::vector<uint32_t>                  page_table_;
+    uint32_t                               dirty_entries_[2]  = {~0u, 0};
+    uint32_t                               dirty_textures_[2] = {~0u, 0};
+    uint32_t                               upload_count_      = 0;
+    uint32_t                               eviction_count_    = 0;
+};
+}  // namespace capsaicin
@@ -22,7 +22,10 @@ void Init()
     info("capsaicin::Init()");
 
     world().RegisterComponent<AssetComponent>();
+    world().RegisterComponent<AssetUnloadComponent>();
     world().RegisterComponent<MeshComponent>();
+    world().RegisterComponent<MeshLODComponent>();
+    world().RegisterComponent<BoundsComponent>();
     world().RegisterComponent<BLASComponent>();
     world().RegisterComponent<TLASComponent>();
     world().RegisterComponent<CameraComponent>();
@@ -43,6 +46,8 @@ void Init()
     world().Precede<TLASSystem, CameraSystem>();
     world().Precede<InputSystem, CameraSystem>();
     world().Precede<InputSystem, TextureSystem>();
+    // Textures requested by loads are decoded and uploaded in the same frame.
+    world().Precede<AssetLoadSystem, TextureSystem>();
 }
 
 void InitRenderSession(void* data)
@@ -62,14 +67,34 @@ void InitRenderSession(void* data)
     world().Precede<GUISystem, RenderSystem>();
 }
 
-void LoadSceneFromOBJ(const std::string& file_name)
+SceneLoad LoadScene(const std::string& file_name)
 {
-    info("capsaicin::LoadSceneFromOBJ({})", file_name);
+    info("capsaicin::LoadScene({})", file_name);
+
+    static uint32_t next_scene_id = 1;
 
     auto  entity = world().CreateEntity().AddComponent<AssetComponent>().Build();
     auto& asset  = world().GetComponent<AssetComponent>(entity);
 
-    asset.file_name = file_name;
+    asset.file_name  = file_name;
+    asset.scene_id   = next_scene_id++;
+    asset.progress   = std::make_shared<LoadProgress>();
+    asset.completion = std::make_shared<std::promise<void>>();
+
+    return {asset.scene_id, asset.progress, asset.completion->get_future().share()};
+}
+
+SceneLoad LoadSceneFromOBJ(const std::string& file_name)
+{
+    return LoadScene(file_name);
+}
+
+void UnloadScene(const SceneLoad& scene)
+{
+    info("capsaicin::UnloadScene({})", scene.id);
+
+    auto entity = world().CreateEntity().AddComponent<AssetUnloadComponent>().Build();
+    world().GetComponent<AssetUnloadComponent>(entity).scene_id = scene.id;
 }
 
 void ProcessInput(void* input)
@@ -0,0 +1,80 @@
+#include "staging_ring.h"
+
+#include "src/dx12/dx12.h"
+
+namespace capsaicin::dx12
+{
+StagingRing::StagingRing(UINT64 capacity) : allocator_(capacity)
+{
+    buffer_ = dx12api().CreateUploadBuffer(capacity);
+
+    // Upload heap buffers may stay mapped while the GPU reads them.
+    ThrowIfFailed(buffer_->Map(0, nullptr, reinterpret_cast<void**>(&mapped_data_)),
+                  "Cannot map staging ring");
+}
+
+StagingRing::~StagingRing()
+{
+    buffer_->Unmap(0, nullptr);
+}
+
+StagingRing::Allocation StagingRing::Allocate(UINT64 size, UINT64 alignment)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Allocation allocation;
+    auto       offset = allocator_.Allocate(size, alignment);
+    if (offset != RingAllocator::kInvalidOffset)
+    {
+        allocation.resource = buffer_.Get();
+        allocation.offset   = offset;
+        allocation.data     = mapped_data_ + offset;
+        return allocation;
+    }
+
+    if (overflow_size_ == 0)
+    {
+        warn("StagingRing: Ring of {} MB is full, staging in dedicated buffers",
+             allocator_.capacity() >> 20);
+    }
+
+    // Dedicated buffers stay mapped until they are released.
+    auto resource = dx12api().CreateUploadBuffer(size);
+    ThrowIfFailed(resource->Map(0, nullptr, reinterpret_cast<void**>(&allocation.data)),
+                  "Cannot map staging buffer");
+
+    allocation.resource = resource.Get();
+    overflow_.push_back({resource, ~0ull});
+    overflow_size_ += size;
+    return allocation;
+}
+
+void StagingRing::Submit(UINT64 fence_value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    allocator_.Submit(fence_value);
+    for (auto& overflow : overflow_)
+    {
+        overflow.fence_value = std::min(overflow.fence_value, fence_value);
+    }
+}
+
+void StagingRing::Retire(UINT64 completed_value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    allocator_.Retire(completed_value);
+
+    auto retired = std::remove_if(overflow_.begin(), overflow_.end(), [&](const Overflow& o) {
+        return o.fence_value <= completed_value;
+    });
+    overflow_.erase(retired, overflow_.end());
+
+    if (overflow_.empty() && overflow_size_ > 0)
+    {
+        info("StagingRing: Released {} MB of dedicated staging buffers", overflow_size_ >> 20);
+        overflow_size_ = 0;
+    }
+}
+}  // namespace capsaicin::dx12
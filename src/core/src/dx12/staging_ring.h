@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mutex>
+
+#include "src/dx12/common.h"
+#include "src/utils/ring_allocator.h"
+
+namespace capsaicin::dx12
+{
+// Persistently mapped upload buffer sub-allocated as a ring, which stages copies to default
+// heap resources. Memory is reused once the fence passes the submission which copied from
+// it, allocations which don't fit get a dedicated upload buffer released the same way.
+class StagingRing
+{
+public:
+    // Alignment of texture footprints, which also suits buffer copies.
+    static constexpr UINT64 kAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+
+    struct Allocation
+    {
+        ID3D12Resource* resource = nullptr;
+        UINT64          offset   = 0;
+        // Mapped memory at the offset, write-combined so it should only be written.
+        uint8_t* data = nullptr;
+    };
+
+    explicit StagingRing(UINT64 capacity);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    Allocation Allocate(UINT64 size, UINT64 alignment = kAlignment);
+    // Allocations since the last call are copied from by the submission signalling the
+    // fence value.
+    void Submit(UINT64 fence_value);
+    // Reuse memory of submissions up to the completed fence value.
+    void Retire(UINT64 completed_value);
+
+private:
+    struct Overflow
+    {
+        ComPtr<ID3D12Resource> resource;
+        UINT64                 fence_value;
+    };
+
+    std::mutex             mutex_;
+    RingAllocator          allocator_;
+    ComPtr<ID3D12Resource> buffer_;
+    uint8_t*               mapped_data_ = nullptr;
+    // Dedicated buffers, with ~0 fence values until submitted.
+    std::vector<Overflow> overflow_;
+    UINT64                overflow_size_ = 0;
+};
+}  // namespace capsaicin::dx12
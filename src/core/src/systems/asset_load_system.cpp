@@ -2,271 +2,1887 @@
 
 #include <DirectXMath.h>
 
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <unordered_set>
+
+#include "src/asset/blas_granularity.h"
+#include "src/asset/gltf_loader.h"
+#include "src/asset/index_codec.h"
+#include "src/asset/mesh_data.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/asset/mesh_optimizer.h"
+#include "src/asset/mesh_simplifier.h"
+#include "src/asset/obj_parser.h"
+#include "src/asset/scene_cache.h"
+#include "src/asset/vertex_layout.h"
+#include "src/asset/vertex_quantization.h"
+#include "src/asset/vertex_weld.h"
 #include "src/common.h"
+#include "src/systems/blas_system.h"
+#include "src/systems/camera_system.h"
 #include "src/systems/render_system.h"
 #include "src/systems/texture_system.h"
-#include "tiny_obj_loader.h"
+#include "src/utils/hash.h"
+#include "src/utils/parallel_for.h"
+
+using namespace std;
+using namespace DirectX;
+
+namespace capsaicin
+{
+namespace
+{
+using Clock = std::chrono::high_resolution_clock;
+
+// Asset data kept alive until all of its geometry is uploaded.
+struct LoadedAsset
+{
+    std::vector<MeshData>       meshes;
+    std::vector<MeshInstance>   instances;
+    std::unique_ptr<SceneCache> cache;
+    std::unique_ptr<GltfScene>  gltf;
+    // Files besides the asset its contents depend on.
+    std::vector<std::string> dependencies;
+};
+
+float ElapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+// Load obj file into a set of unique meshes and their instances. Parsing is done in parallel
+// on the subflow, material loading runs concurrently with vertex welding, followed by
+// instancing, mesh optimization and level of detail generation, and the source is hashed
+// for the scene cache while it is being parsed. Runs outside of the frame, so textures are
+// only named here and resolved on upload.
+void LoadObjFile(AssetComponent&            asset,
+                 std::vector<MeshData>&     meshes,
+                 std::vector<MeshInstance>& instances,
+                 std::vector<std::string>&  material_libs,
+                 SourceInfo&                source,
+                 tf::Subflow&               subflow,
+                 bool                       force_single_mesh = false)
+{
+    ObjData                   obj_data;
+    std::vector<MeshData>     obj_meshes;
+    std::vector<MeshInstance> obj_instances;
+
+    float parse_time = 0.f, weld_time = 0.f, instance_time = 0.f, granularity_time = 0.f,
+          optimize_time = 0.f, lod_time = 0.f, resolve_time = 0.f;
+
+    MeshStats        stats_before, stats_after;
+    GranularityStats granularity_before, granularity_after;
+
+    // Exceptions can't leave worker threads, so they are rethrown after the join.
+    std::exception_ptr parse_error;
+
+    auto parse = subflow.emplace([&](tf::Subflow& sf) {
+        auto start = Clock::now();
+        try
+        {
+            ParseObjFile(asset.file_name, obj_data, sf);
+        }
+        catch (...)
+        {
+            parse_error = std::current_exception();
+        }
+        parse_time = ElapsedMs(start);
+    });
+
+    // Failing to hash the source only disables the cache write.
+    subflow.emplace([&]() {
+        try
+        {
+            source = GetSourceInfo(asset.file_name, true);
+        }
+        catch (...)
+        {
+            source = {};
+        }
+    });
+
+    auto resolve = subflow.emplace([&]() {
+        auto start = Clock::now();
+        LoadObjMaterials(obj_data, "../../../assets/");
+        resolve_time = ElapsedMs(start);
+    });
+
+    auto weld = subflow.emplace([&](tf::Subflow& sf) {
+        auto start = Clock::now();
+        if (!parse_error)
+        {
+            WeldObjShapes(obj_data, obj_meshes, force_single_mesh, sf);
+        }
+        weld_time = ElapsedMs(start);
+    });
+
+    // Instances take the material of their shape.
+    auto instance = subflow.emplace([&](tf::Subflow& sf) {
+        auto start = Clock::now();
+        if (!parse_error)
+        {
+            if (!force_single_mesh)
+            {
+                for (uint32_t i = 0; i < obj_meshes.size(); ++i)
+                {
+                    auto material_id = obj_data.shapes[i].material_id;
+                    if (material_id != -1)
+                    {
+                        obj_meshes[i].texture_name =
+                            obj_data.materials[material_id].diffuse_texname;
+                    }
+                }
+            }
+
+            InstanceMeshes(obj_meshes, obj_instances, sf);
+        }
+        instance_time = ElapsedMs(start);
+    });
+
+    auto granularity = subflow.emplace([&](tf::Subflow& sf) {
+        auto start = Clock::now();
+        if (!parse_error)
+        {
+            granularity_before = AnalyzeGranularity(obj_meshes, obj_instances);
+            OptimizeGranularity(obj_meshes, obj_instances, sf);
+            granularity_after = AnalyzeGranularity(obj_meshes, obj_instances);
+        }
+        granularity_time = ElapsedMs(start);
+    });
+
+    auto optimize = subflow.emplace([&](tf::Subflow& sf) {
+        auto start = Clock::now();
+        if (!parse_error)
+        {
+            OptimizeMeshes(obj_meshes, stats_before, stats_after, sf);
+        }
+        optimize_time = ElapsedMs(start);
+    });
+
+    auto simplify = subflow.emplace([&](tf::Subflow& sf) {
+        auto start = Clock::now();
+        if (!parse_error)
+        {
+            GenerateMeshLods(obj_meshes, sf);
+        }
+        lod_time = ElapsedMs(start);
+    });
+
+    parse.precede(resolve, weld);
+    resolve.precede(instance);
+    weld.precede(instance);
+    instance.precede(granularity);
+    granularity.precede(optimize);
+    optimize.precede(simplify);
+    subflow.join();
+
+    if (parse_error)
+    {
+        std::rethrow_exception(parse_error);
+    }
+
+    info("AssetLoadSystem: {} parsed in {} ms ({} chunks)",
+         asset.file_name,
+         parse_time,
+         obj_data.num_chunks);
+    info("AssetLoadSystem: {} shapes welded in {} ms ({} Mcorners/s)",
+         obj_data.shapes.size(),
+         weld_time,
+         obj_data.indices.size() / (std::max(weld_time, 1e-3f) * 1000.f));
+    info("AssetLoadSystem: {} shapes instanced as {} meshes in {} ms",
+         obj_instances.size(),
+         obj_meshes.size(),
+         instance_time);
+    info("AssetLoadSystem: {} BLASes regrouped as {} in {} ms, triangles per BLAS "
+         "{} / {} / {} -> {} / {} / {} (min / median / max), traversal cost {:.2f} -> {:.2f}",
+         granularity_before.blas_count,
+         granularity_after.blas_count,
+         granularity_time,
+         granularity_before.min_triangles,
+         granularity_before.median_triangles,
+         granularity_before.max_triangles,
+         granularity_after.min_triangles,
+         granularity_after.median_triangles,
+         granularity_after.max_triangles,
+         granularity_before.traversal_cost,
+         granularity_after.traversal_cost);
+    info("AssetLoadSystem: {} meshes optimized in {} ms, ACMR {:.3f} -> {:.3f}, "
+         "ATVR {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}",
+         obj_meshes.size(),
+         optimize_time,
+         stats_before.acmr(),
+         stats_after.acmr(),
+         stats_before.atvr(),
+         stats_after.atvr(),
+         stats_before.overfetch(),
+         stats_after.overfetch());
+    uint64_t lod_count = 0, lod_triangle_count = 0;
+    for (auto& mesh : obj_meshes)
+    {
+        lod_count += mesh.lods.size();
+        for (auto& lod : mesh.lods)
+        {
+            lod_triangle_count += lod.indices.size() / 3;
+        }
+    }
+
+    info("AssetLoadSystem: {} levels of detail with {} triangles generated in {} ms",
+         lod_count,
+         lod_triangle_count,
+         lod_time);
+    info("AssetLoadSystem: {} materials loaded in {} ms",
+         obj_data.materials.size(),
+         resolve_time);
+
+    for (auto& instance : obj_instances)
+    {
+        instance.mesh += static_cast<uint32_t>(meshes.size());
+        instances.push_back(std::move(instance));
+    }
+
+    std::move(obj_meshes.begin(), obj_meshes.end(), std::back_inserter(meshes));
+    material_libs = std::move(obj_data.material_libs);
+}
+
+// Map the scene cache of an obj asset if it is valid, chunked caches are decompressed on
+// the subflow. glTF buffers are mapped and mostly used in place, a cache wouldn't save
+// anything.
+void OpenCache(AssetComponent& asset, LoadedAsset& loaded, tf::Subflow& subflow)
+{
+    if (GltfScene::IsGltfFile(asset.file_name))
+    {
+        return;
+    }
+
+    auto start   = Clock::now();
+    loaded.cache = SceneCache::Open(asset.file_name, "../../../assets/", subflow);
+    if (loaded.cache)
+    {
+        for (auto& lib : loaded.cache->material_libs())
+        {
+            loaded.dependencies.push_back("../../../assets/" + lib);
+        }
+
+        info("AssetLoadSystem: {} mapped from cache in {} ms", asset.file_name, ElapsedMs(start));
+    }
+}
+
+// Map a glTF asset, or load the obj file unless its cache has been opened and write the
+// cache for the next launch.
+void LoadAsset(AssetComponent& asset, LoadedAsset& loaded, tf::Subflow& subflow)
+{
+    auto start = Clock::now();
+
+    if (GltfScene::IsGltfFile(asset.file_name))
+    {
+        loaded.gltf         = GltfScene::Load(asset.file_name, subflow);
+        loaded.dependencies = loaded.gltf->buffer_files();
+        info("AssetLoadSystem: {} mapped in {} ms", asset.file_name, ElapsedMs(start));
+        return;
+    }
+
+    if (loaded.cache)
+    {
+        return;
+    }
+
+    std::vector<std::string> material_libs;
+
+    SourceInfo source;
+    LoadObjFile(asset, loaded.meshes, loaded.instances, material_libs, source, subflow);
+
+    for (auto& lib : material_libs)
+    {
+        loaded.dependencies.push_back("../../../assets/" + lib);
+    }
+
+    if (source.size == 0)
+    {
+        return;
+    }
+
+    start = Clock::now();
+
+    std::vector<SourceInfo> material_lib_sources;
+    for (auto& lib : material_libs)
+    {
+        material_lib_sources.push_back(GetDependencyInfo("../../../assets/" + lib));
+    }
+
+    SceneCache::Write(asset.file_name,
+                      source,
+                      loaded.meshes,
+                      loaded.instances,
+                      material_libs,
+                      material_lib_sources);
+    info("AssetLoadSystem: {} cache written in {} ms", asset.file_name, ElapsedMs(start));
+}
+
+// Views of the meshes and the instances of a loaded asset.
+void GatherMeshes(LoadedAsset&               loaded_asset,
+                  std::vector<MeshView>&     meshes,
+                  std::vector<MeshInstance>& instances)
+{
+    if (loaded_asset.cache)
+    {
+        for (uint32_t i = 0; i < loaded_asset.cache->mesh_count(); ++i)
+        {
+            meshes.push_back(loaded_asset.cache->mesh(i));
+        }
+
+        for (uint32_t i = 0; i < loaded_asset.cache->instance_count(); ++i)
+        {
+            instances.push_back(loaded_asset.cache->instance(i));
+        }
+    }
+    else if (loaded_asset.gltf)
+    {
+        for (uint32_t i = 0; i < loaded_asset.gltf->mesh_count(); ++i)
+        {
+            meshes.push_back(loaded_asset.gltf->mesh(i));
+        }
+
+        for (uint32_t i = 0; i < loaded_asset.gltf->instance_count(); ++i)
+        {
+            instances.push_back(loaded_asset.gltf->instance(i));
+        }
+    }
+    else
+    {
+        for (auto& mesh_data : loaded_asset.meshes)
+        {
+            meshes.push_back(MakeMeshView(mesh_data));
+        }
+
+        instances = std::move(loaded_asset.instances);
+    }
+}
+
+// Content hash of the mesh streams, levels of detail are derived from them.
+uint64_t HashMesh(const MeshView& mesh_data)
+{
+    auto vertex_count = std::size_t(mesh_data.vertex_count);
+    auto hash         = HashBytes(mesh_data.positions, vertex_count * 3 * sizeof(float));
+    hash              = HashBytes(mesh_data.normals, vertex_count * 3 * sizeof(float), hash);
+    hash              = HashBytes(mesh_data.texcoords, vertex_count * 2 * sizeof(float), hash);
+    return HashBytes(mesh_data.indices, mesh_data.index_count * sizeof(uint32_t), hash);
+}
+
+// Vertex streams of a mesh in the storage format.
+struct EncodedVertices
+{
+    std::vector<int16_t>  positions;
+    std::vector<uint32_t> normals;
+    std::vector<uint32_t> texcoords;
+};
+
+void EncodeVertices(const MeshView& mesh_data, const Bounds& bounds, EncodedVertices& encoded)
+{
+    encoded.positions.resize(mesh_data.vertex_count * 4);
+    encoded.normals.resize(mesh_data.vertex_count);
+    encoded.texcoords.resize(mesh_data.vertex_count);
+
+    QuantizePositions(
+        mesh_data.positions, mesh_data.vertex_count, bounds, encoded.positions.data());
+    EncodeNormals(mesh_data.normals, mesh_data.vertex_count, encoded.normals.data());
+    EncodeTexcoords(mesh_data.texcoords, mesh_data.vertex_count, encoded.texcoords.data());
+}
+
+// Maps snorm16 positions back to object space during BLAS builds.
+void GetDequantizationTransform(const Bounds& bounds, float* transform)
+{
+    std::fill(transform, transform + 12, 0.f);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        transform[4 * c + c] = 0.5f * (bounds.max[c] - bounds.min[c]);
+        transform[4 * c + 3] = 0.5f * (bounds.max[c] + bounds.min[c]);
+    }
+}
+
+void Upload(ID3D12GraphicsCommandList* command_list,
+            RenderSystem&              render_system,
+            ID3D12Resource*            pool,
+            UINT64                     offset,
+            const void*                data,
+            UINT64                     size)
+{
+    auto staging = render_system.AllocateStaging(size);
+    std::memcpy(staging.data, data, size);
+    command_list->CopyBufferRegion(pool, offset, staging.resource, staging.offset, size);
+}
+
+// Whether holes take enough of the pool to be worth copying it, see kMaxFragmentation.
+bool IsFragmented(const RangeAllocator& allocator)
+{
+    return allocator.fragmentation() > AssetLoadSystem::kMaxFragmentation &&
+           static_cast<float>(allocator.fragmented()) >
+               static_cast<float>(allocator.capacity()) * AssetLoadSystem::kMinFragmentedShare;
+}
+
+// Buffer of a pool and the size of its elements, all buffers of a pool share its ranges.
+struct PoolBuffer
+{
+    ComPtr<ID3D12Resource>* resource;
+    UINT64                  stride;
+};
+
+std::vector<PoolBuffer> GetVertexBuffers(GeometryStorage& storage)
+{
+    if (storage.interleaved_vertices)
+    {
+        return {{&storage.vertices, storage.vertex_stride}};
+    }
+
+    return {{&storage.vertices, storage.vertex_stride},
+            {&storage.normals, storage.normal_stride},
+            {&storage.texcoords, storage.texcoord_stride}};
+}
+
+std::vector<PoolBuffer> GetIndexBuffers(GeometryStorage& storage)
+{
+    return {{&storage.indices, sizeof(uint32_t)}};
+}
+
+std::vector<PoolBuffer> GetMeshBuffers(GeometryStorage& storage)
+{
+    if (storage.quantized_vertices)
+    {
+        return {{&storage.mesh_descs, sizeof(MeshComponent)},
+                {&storage.transforms, AssetLoadSystem::kTransformSize}};
+    }
+
+    return {{&storage.mesh_descs, sizeof(MeshComponent)}};
+}
+
+// Replace the buffers with new ones of the given capacity, copying the ranges over. Copies
+// between ranges of the same buffer may overlap, a new buffer avoids that. The new buffers
+// are left in the copy destination state.
+void ReallocateBuffers(const std::vector<PoolBuffer>&           buffers,
+                       uint32_t                                 capacity,
+                       D3D12_RESOURCE_STATES                    state,
+                       const std::vector<RangeAllocator::Move>& copies,
+                       ID3D12GraphicsCommandList*               command_list,
+                       RenderSystem&                            render_system)
+{
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    for (auto& buffer : buffers)
+    {
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+            buffer.resource->Get(), state, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    }
+
+    command_list->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+    for (auto& buffer : buffers)
+    {
+        auto new_buffer = dx12api().CreateUAVBuffer(UINT64(capacity) * buffer.stride,
+                                                    D3D12_RESOURCE_STATE_COPY_DEST);
+
+        for (auto& copy : copies)
+        {
+            command_list->CopyBufferRegion(new_buffer.Get(),
+                                           UINT64(copy.to) * buffer.stride,
+                                           buffer.resource->Get(),
+                                           UINT64(copy.from) * buffer.stride,
+                                           UINT64(copy.size) * buffer.stride);
+        }
+
+        render_system.AddAutoreleaseResource(*buffer.resource);
+        *buffer.resource = new_buffer;
+    }
+}
+
+// Allocate a range of the pool, its buffers double when it is full. Buffers are expected in
+// the copy destination state.
+uint32_t AllocateRange(RangeAllocator&                allocator,
+                       const std::vector<PoolBuffer>& buffers,
+                       uint32_t                       size,
+                       ID3D12GraphicsCommandList*     command_list,
+                       RenderSystem&                  render_system)
+{
+    auto offset = allocator.Allocate(size);
+    if (offset != RangeAllocator::kInvalidOffset)
+    {
+        return offset;
+    }
+
+    auto capacity     = allocator.capacity();
+    auto new_capacity = std::max(uint64_t(capacity) * 2, uint64_t(capacity) + std::max(size, 1u));
+
+    if (new_capacity >= RangeAllocator::kInvalidOffset)
+    {
+        error("AssetLoadSystem: Pool size exceeded");
+        throw std::runtime_error("AssetLoadSystem: Pool size exceeded");
+    }
+
+    ReallocateBuffers(buffers,
+                      static_cast<uint32_t>(new_capacity),
+                      D3D12_RESOURCE_STATE_COPY_DEST,
+                      {{0, 0, capacity}},
+                      command_list,
+                      render_system);
+    allocator.Grow(static_cast<uint32_t>(new_capacity));
+
+    info("AssetLoadSystem: Pool grown to {} elements", new_capacity);
+
+    return allocator.Allocate(size);
+}
+
+uint32_t GetIndexStride(const MeshView& mesh_data)
+{
+    return FitsIndex16(mesh_data.vertex_count) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// Index pool words of the mesh, levels of detail follow the full resolution indices in the
+// same range.
+uint32_t GetIndexWordCount(const MeshView& mesh_data)
+{
+    auto index_stride = GetIndexStride(mesh_data);
+    auto index_words  = IndexWordCount(mesh_data.index_count, index_stride);
+    for (uint32_t l = 0; l < mesh_data.lod_count; ++l)
+    {
+        index_words += IndexWordCount(mesh_data.lods[l].index_count, index_stride);
+    }
+    return index_words;
+}
+
+// Upload vertices, indices and levels of detail of the mesh to the pool ranges at the
+// offsets of the mesh component.
+void UploadMesh(const MeshView&            mesh_data,
+                GeometryStorage&           storage,
+                ID3D12GraphicsCommandList* command_list,
+                RenderSystem&              render_system,
+                MeshComponent&             mesh_component,
+                MeshLODComponent&          lod_component,
+                float*                     dequantization)
+{
+    EncodedVertices       encoded;
+    std::vector<uint8_t>  interleaved;
+    std::vector<uint16_t> narrow_indices;
+
+    mesh_component.vertex_count = mesh_data.vertex_count;
+    mesh_component.index_count  = mesh_data.index_count;
+    mesh_component.index_stride = GetIndexStride(mesh_data);
+
+    auto bounds = ComputeBounds(mesh_data.positions, mesh_data.vertex_count);
+    std::copy_n(bounds.min, 3, mesh_component.bounds_min);
+    std::copy_n(bounds.max, 3, mesh_component.bounds_max);
+    mesh_component.bounds_radius =
+        ComputeBoundingRadius(mesh_data.positions, mesh_data.vertex_count, bounds);
+
+    const void* positions = mesh_data.positions;
+    const void* normals   = mesh_data.normals;
+    const void* texcoords = mesh_data.texcoords;
+
+    if (storage.quantized_vertices)
+    {
+        EncodeVertices(mesh_data, bounds, encoded);
+        positions = encoded.positions.data();
+        normals   = encoded.normals.data();
+        texcoords = encoded.texcoords.data();
+
+        GetDequantizationTransform(bounds, dequantization);
+    }
+
+    auto upload = [&](ID3D12Resource* pool, UINT64 offset, const void* data, UINT64 size) {
+        if (size > 0)
+        {
+            Upload(command_list, render_system, pool, offset, data, size);
+        }
+    };
+
+    auto first_vertex = UINT64(mesh_component.first_vertex_offset);
+
+    if (storage.interleaved_vertices)
+    {
+        interleaved.resize(size_t(mesh_data.vertex_count) * storage.vertex_stride);
+        InterleaveVertices(storage.vertex_layout,
+                           positions,
+                           normals,
+                           texcoords,
+                           mesh_data.vertex_count,
+                           interleaved.data());
+        upload(storage.vertices.Get(),
+               first_vertex * storage.vertex_stride,
+               interleaved.data(),
+               interleaved.size());
+    }
+    else
+    {
+        upload(storage.vertices.Get(),
+               first_vertex * storage.position_stride,
+               positions,
+               mesh_data.vertex_count * storage.position_stride);
+        upload(storage.normals.Get(),
+               first_vertex * storage.normal_stride,
+               normals,
+               mesh_data.vertex_count * storage.normal_stride);
+        upload(storage.texcoords.Get(),
+               first_vertex * storage.texcoord_stride,
+               texcoords,
+               mesh_data.vertex_count * storage.texcoord_stride);
+    }
+
+    auto next_word      = mesh_component.first_index_offset;
+    auto upload_indices = [&](const uint32_t* indices, uint32_t index_count) {
+        auto first_word  = next_word;
+        auto index_words = IndexWordCount(index_count, mesh_component.index_stride);
+
+        if (mesh_component.index_stride == sizeof(uint16_t))
+        {
+            narrow_indices.resize(index_words * 2);
+            NarrowIndices(indices, index_count, narrow_indices.data());
+            indices = reinterpret_cast<const uint32_t*>(narrow_indices.data());
+        }
+
+        upload(storage.indices.Get(),
+               UINT64(first_word) * sizeof(uint32_t),
+               indices,
+               UINT64(index_words) * sizeof(uint32_t));
+
+        next_word += index_words;
+        return first_word;
+    };
+
+    auto& full              = lod_component.full;
+    full.first_index_offset = upload_indices(mesh_data.indices, mesh_data.index_count);
+    full.index_count        = mesh_data.index_count;
+
+    lod_component.lod_count = mesh_data.lod_count;
+    for (uint32_t l = 0; l < mesh_data.lod_count; ++l)
+    {
+        auto& lod                = mesh_data.lods[l];
+        auto& level              = lod_component.levels[l];
+        level.first_index_offset = upload_indices(lod.indices, lod.index_count);
+        level.index_count        = lod.index_count;
+        level.error              = lod.error;
+    }
+}
+
+// Upload elements to slots of a pool, a copy per run of consecutive slots. Slots are sorted.
+void UploadSlots(ID3D12GraphicsCommandList*   command_list,
+                 RenderSystem&                render_system,
+                 ID3D12Resource*              pool,
+                 const std::vector<uint32_t>& slots,
+                 const void*                  data,
+                 UINT64                       stride)
+{
+    if (slots.empty())
+    {
+        return;
+    }
+
+    auto staging = render_system.AllocateStaging(slots.size() * stride);
+    std::memcpy(staging.data, data, slots.size() * stride);
+
+    for (std::size_t first = 0, last = 1; first < slots.size(); first = last++)
+    {
+        while (last < slots.size() && slots[last] == slots[last - 1] + 1)
+        {
+            ++last;
+        }
+
+        command_list->CopyBufferRegion(pool,
+                                       UINT64(slots[first]) * stride,
+                                       staging.resource,
+                                       staging.offset + UINT64(first) * stride,
+                                       UINT64(last - first) * stride);
+    }
+}
+
+// Transition all pools between copies and shader reads.
+void TransitionPools(const GeometryStorage&     storage,
+                     ID3D12GraphicsCommandList* command_list,
+                     D3D12_RESOURCE_STATES      before,
+                     D3D12_RESOURCE_STATES      after)
+{
+    std::vector<D3D12_RESOURCE_BARRIER> barriers = {
+        CD3DX12_RESOURCE_BARRIER::Transition(storage.vertices.Get(), before, after),
+        CD3DX12_RESOURCE_BARRIER::Transition(storage.indices.Get(), before, after),
+        CD3DX12_RESOURCE_BARRIER::Transition(storage.normals.Get(), before, after),
+        CD3DX12_RESOURCE_BARRIER::Transition(storage.mesh_descs.Get(), before, after),
+        CD3DX12_RESOURCE_BARRIER::Transition(storage.texcoords.Get(), before, after)};
+
+    if (storage.quantized_vertices)
+    {
+        barriers.push_back(
+            CD3DX12_RESOURCE_BARRIER::Transition(storage.transforms.Get(), before, after));
+    }
+
+    command_list->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+}
+
+Entity CreateMeshEntity()
+{
+    return world()
+        .CreateEntity()
+        .AddComponent<MeshComponent>()
+        .AddComponent<MeshLODComponent>()
+        .AddComponent<BoundsComponent>()
+        .Build();
+}
+
+// World space bounds of an instance from the object space bounds of its geometry.
+BoundsComponent GetInstanceBounds(const MeshComponent& mesh_component)
+{
+    Bounds bounds;
+    std::copy_n(mesh_component.bounds_min, 3, bounds.min);
+    std::copy_n(mesh_component.bounds_max, 3, bounds.max);
+    return TransformBounds(bounds, mesh_component.bounds_radius, mesh_component.transform);
+}
+
+// Point the instance at the indices of the level of detail, 0 for full resolution.
+void SetLod(MeshComponent& mesh_component, const MeshLODComponent& lod_component, uint32_t lod)
+{
+    auto& level = lod == 0 ? lod_component.full : lod_component.levels[lod - 1];
+    mesh_component.first_index_offset = level.first_index_offset;
+    mesh_component.index_count        = level.index_count;
+    mesh_component.lod                = lod;
+}
+
+// Instances of the meshes paged in during a frame, uploaded together once the command list
+// has been opened for them.
+struct PagedUploads
+{
+    bool                       open = false;
+    std::vector<MeshComponent> meshes;
+    std::vector<float>         transforms;
+};
+
+// Bytes of pool space the mesh takes.
+uint64_t GetGeometrySize(const GeometryStorage& storage, const MeshView& mesh_data)
+{
+    auto vertex_size = storage.interleaved_vertices
+                           ? storage.vertex_stride
+                           : storage.position_stride + storage.normal_stride +
+                                 storage.texcoord_stride;
+
+    return uint64_t(mesh_data.vertex_count) * vertex_size +
+           uint64_t(GetIndexWordCount(mesh_data)) * sizeof(uint32_t);
+}
+
+// Position of the camera, the origin until there is one.
+XMFLOAT3 GetEyePosition(ComponentAccess& access, EntityQuery& entity_query)
+{
+    auto& cameras = access.Read<CameraComponent>();
+    auto  entities =
+        entity_query().Filter([&cameras](Entity e) { return cameras.HasComponent(e); }).entities();
+
+    if (entities.empty())
+    {
+        return XMFLOAT3(0.f, 0.f, 0.f);
+    }
+
+    return cameras.GetComponent(entities[0]).camera_data.position;
+}
+
+// Upload descriptors of mesh instances to their slots, with the dequantization transforms
+// BLAS builds find by slot for quantized vertices.
+void UploadInstances(const GeometryStorage&            storage,
+                     ID3D12GraphicsCommandList*        command_list,
+                     RenderSystem&                     render_system,
+                     const std::vector<MeshComponent>& meshes,
+                     const std::vector<float>&         transforms)
+{
+    // Best fit hands out freed slots in any order.
+    std::vector<uint32_t> order(meshes.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return meshes[a].index < meshes[b].index;
+    });
+
+    std::vector<uint32_t>      sorted_slots;
+    std::vector<MeshComponent> sorted_meshes;
+    std::vector<float>         sorted_transforms;
+    for (auto i : order)
+    {
+        sorted_slots.push_back(meshes[i].index);
+        sorted_meshes.push_back(meshes[i]);
+        if (storage.quantized_vertices)
+        {
+            auto first = transforms.cbegin() + 12 * i;
+            sorted_transforms.insert(sorted_transforms.end(), first, first + 12);
+        }
+    }
+
+    UploadSlots(command_list,
+                render_system,
+                storage.mesh_descs.Get(),
+                sorted_slots,
+                sorted_meshes.data(),
+                sizeof(MeshComponent));
+
+    if (storage.quantized_vertices)
+    {
+        UploadSlots(command_list,
+                    render_system,
+                    storage.transforms.Get(),
+                    sorted_slots,
+                    sorted_transforms.data(),
+                    AssetLoadSystem::kTransformSize);
+    }
+}
+}  // namespace
+
+// Background load of an asset and the state of its upload.
+struct AssetLoadSystem::LoadJob
+{
+    AssetComponent    asset;
+    tf::Taskflow      taskflow;
+    std::future<void> loaded;
+    LoadedAsset       loaded_asset;
+    // Exception of a failed load, set before loaded becomes ready.
+    std::exception_ptr load_error;
+    // Reload of a visible scene, which replaces its meshes at once.
+    bool reload = false;
+
+    // Meshes and instances of the loaded asset, with content hashes of the meshes for hot
+    // reload, gathered in the background.
+    std::vector<MeshView>     meshes;
+    std::vector<MeshInstance> instances;
+    std::vector<uint64_t>     hashes;
+    // Object space bounds and bounding radii of the meshes, only computed for paging.
+    std::vector<Bounds> bounds;
+    std::vector<float>  radii;
+    // Set when the first batch starts.
+    bool     started       = false;
+    uint32_t next_instance = 0;
+    // Unload requested while loading, applied once the load is done.
+    bool unload_requested = false;
+
+    // Geometries of the scene the meshes were uploaded to, meshes are uploaded with their
+    // first instance and ~0u until then.
+    std::vector<uint32_t> geometries;
+    // Instances of each mesh, paged in and out with it.
+    std::vector<std::vector<uint32_t>> mesh_instances;
+};
+
+// Pages meshes of a paged scene in and out of the pools. Instances of paged in meshes are
+// collected for a single upload of all scenes, entities of paged out meshes are destroyed
+// after the update, so that it doesn't search the entities of every mesh it pages out.
+class AssetLoadSystem::ScenePool : public ResidencyPool
+{
+public:
+    ScenePool(AssetLoadSystem& system, Scene& scene, PagedUploads* uploads)
+        : system_(system), scene_(scene), uploads_(uploads)
+    {
+    }
+
+    bool MakeResident(uint32_t mesh) override;
+    void Evict(uint32_t mesh) override;
+    // Destroy the entities of the paged out meshes.
+    void RemoveEvicted();
+
+private:
+    AssetLoadSystem& system_;
+    Scene&           scene_;
+    PagedUploads*    uploads_ = nullptr;
+    // Geometry ids of the paged out meshes.
+    std::unordered_set<uint32_t> evicted_;
+};
+
+bool AssetLoadSystem::ScenePool::MakeResident(uint32_t mesh)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto& storage       = system_.storage_;
+    auto& job           = *scene_.paged_job;
+    auto  command_list  = system_.upload_command_list_.Get();
+
+    if (!uploads_->open)
+    {
+        command_list->Reset(render_system.current_frame_command_allocator(), nullptr);
+
+        if (storage.shader_readable)
+        {
+            TransitionPools(storage,
+                            command_list,
+                            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                            D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+
+        uploads_->open = true;
+    }
+
+    auto hash = job.hashes.empty() ? 0 : job.hashes[mesh];
+
+    scene_.mesh_geometries[mesh] = static_cast<uint32_t>(scene_.geometries.size());
+    scene_.geometry_meshes.push_back(mesh);
+    scene_.geometries.push_back(system_.CreateGeometry(job.meshes[mesh], hash, command_list));
+
+    for (auto i : job.mesh_instances[mesh])
+    {
+        system_.CreateInstance(scene_,
+                               scene_.geometries.back(),
+                               job.instances[i],
+                               command_list,
+                               uploads_->meshes,
+                               uploads_->transforms);
+    }
+
+    // Pools grow when they run out of space, so the mesh always fits. Space of meshes
+    // evicted this frame is only freed once frames in flight finished reading it.
+    return true;
+}
+
+void AssetLoadSystem::ScenePool::Evict(uint32_t mesh)
+{
+    auto  index    = scene_.mesh_geometries[mesh];
+    auto& geometry = scene_.geometries[index];
+
+    system_.RetireGeometry(geometry);
+    evicted_.insert(geometry.mesh.geometry);
+
+    // The last geometry takes the place of the paged out one.
+    auto last = static_cast<uint32_t>(scene_.geometries.size() - 1);
+    if (index != last)
+    {
+        scene_.geometries[index]                              = scene_.geometries[last];
+        scene_.geometry_meshes[index]                         = scene_.geometry_meshes[last];
+        scene_.mesh_geometries[scene_.geometry_meshes[index]] = index;
+    }
+
+    scene_.geometries.pop_back();
+    scene_.geometry_meshes.pop_back();
+    scene_.mesh_geometries[mesh] = ~0u;
+}
+
+void AssetLoadSystem::ScenePool::RemoveEvicted()
+{
+    if (evicted_.empty())
+    {
+        return;
+    }
+
+    auto& storage  = system_.storage_;
+    auto& entities = scene_.entities;
+    auto  removed  = std::remove_if(entities.begin(), entities.end(), [&](Entity e) {
+        auto& mesh_component = world().GetComponent<MeshComponent>(e);
+        if (evicted_.find(mesh_component.geometry) == evicted_.cend())
+        {
+            return false;
+        }
+
+        system_.RetireMeshSlot(mesh_component.index);
+        world().DestroyEntity(e);
+        return true;
+    });
+
+    entities.erase(removed, entities.end());
+    evicted_.clear();
+
+    ++storage.version;
+}
+
+// One hardware thread is left to the frame.
+AssetLoadSystem::AssetLoadSystem(const AssetLoadOptions& options)
+    : options_(options), loader_(std::max(std::thread::hardware_concurrency(), 2u) - 1)
+{
+    storage_.vertex_allocator.Grow(kVertexPoolSize);
+    storage_.index_allocator.Grow(kIndexPoolSize);
+    storage_.mesh_allocator.Grow(kMeshPoolSize);
+
+    if (options_.quantize_vertices)
+    {
+        storage_.quantized_vertices = true;
+        storage_.position_stride    = 4 * sizeof(int16_t);
+        storage_.normal_stride      = sizeof(uint32_t);
+        storage_.texcoord_stride    = sizeof(uint32_t);
+        storage_.transforms         = dx12api().CreateUAVBuffer(kMeshPoolSize * kTransformSize,
+                                                        D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+
+    // Separate normal and texcoord pools are only needed without interleaving, a single
+    // element keeps their descriptors valid otherwise.
+    auto attribute_pool_size = kVertexPoolSize;
+    storage_.vertex_stride   = storage_.position_stride;
+
+    if (options_.interleave_vertices)
+    {
+        storage_.interleaved_vertices = true;
+        storage_.vertex_layout        = MakeInterleavedLayout(
+            storage_.position_stride, storage_.normal_stride, storage_.texcoord_stride);
+
+        if (!ValidateVertexLayout(storage_.vertex_layout))
+        {
+            error("AssetLoadSystem: Invalid interleaved vertex layout");
+            throw std::runtime_error("AssetLoadSystem: Invalid interleaved vertex layout");
+        }
+
+        storage_.vertex_stride = storage_.vertex_layout.stride;
+        attribute_pool_size    = 1;
+    }
+
+    storage_.vertices   = dx12api().CreateUAVBuffer(kVertexPoolSize * storage_.vertex_stride,
+                                                  D3D12_RESOURCE_STATE_COPY_DEST);
+    storage_.indices    = dx12api().CreateUAVBuffer(kIndexPoolSize * sizeof(uint32_t),
+                                                 D3D12_RESOURCE_STATE_COPY_DEST);
+    storage_.normals    = dx12api().CreateUAVBuffer(attribute_pool_size * storage_.normal_stride,
+                                                 D3D12_RESOURCE_STATE_COPY_DEST);
+    storage_.texcoords  = dx12api().CreateUAVBuffer(
+        attribute_pool_size * storage_.texcoord_stride, D3D12_RESOURCE_STATE_COPY_DEST);
+    storage_.mesh_descs = dx12api().CreateUAVBuffer(kMeshPoolSize * sizeof(MeshComponent),
+                                                    D3D12_RESOURCE_STATE_COPY_DEST);
+}
+
+
+AssetLoadSystem::~AssetLoadSystem() = default;
+
+void AssetLoadSystem::StartLoad(const AssetComponent& asset, bool reload)
+{
+    auto job    = std::make_unique<LoadJob>();
+    job->asset  = asset;
+    job->reload = reload;
+
+    info("AssetLoadSystem: {} {}", reload ? "Reloading" : "Loading", job->asset.file_name);
+
+    // A reload bypasses the scene cache, which may be as recent as the changed file. The
+    // cache is opened first, so that a parse can still use a subflow if it is invalid.
+    auto open = job->taskflow.emplace([job = job.get()](tf::Subflow& sf) {
+        try
+        {
+            if (!job->reload)
+            {
+                OpenCache(job->asset, job->loaded_asset, sf);
+            }
+        }
+        catch (...)
+        {
+            job->load_error = std::current_exception();
+        }
+    });
+
+    auto load = job->taskflow.emplace([job = job.get()](tf::Subflow& sf) {
+        if (job->load_error)
+        {
+            return;
+        }
+
+        try
+        {
+            LoadAsset(job->asset, job->loaded_asset, sf);
+        }
+        catch (...)
+        {
+            job->load_error = std::current_exception();
+        }
+    });
+
+    // Hashing touches all mesh data, which is too slow for the frame on large scenes.
+    auto gather = job->taskflow.emplace([this, job = job.get()](tf::Subflow& sf) {
+        if (job->load_error)
+        {
+            return;
+        }
+
+        GatherMeshes(job->loaded_asset, job->meshes, job->instances);
+
+        // Paging ranks meshes by their bounds before any of them is uploaded.
+        auto hash       = options_.hot_reload;
+        auto bound      = options_.geometry_budget > 0;
+        auto mesh_count = job->meshes.size();
+        job->hashes.resize(hash ? mesh_count : 0);
+        job->bounds.resize(bound ? mesh_count : 0);
+        job->radii.resize(bound ? mesh_count : 0);
+
+        if (hash || bound)
+        {
+            ParallelFor(sf, static_cast<uint32_t>(mesh_count), [=](uint32_t i) {
+                auto& mesh_data = job->meshes[i];
+                if (hash)
+                {
+                    job->hashes[i] = HashMesh(mesh_data);
+                }
+
+                if (bound)
+                {
+                    job->bounds[i] = ComputeBounds(mesh_data.positions, mesh_data.vertex_count);
+                    job->radii[i]  = ComputeBoundingRadius(
+                        mesh_data.positions, mesh_data.vertex_count, job->bounds[i]);
+                }
+            });
+        }
+    });
+
+    open.precede(load);
+    load.precede(gather);
+
+    job->loaded = loader_.run(job->taskflow);
+    jobs_.push_back(std::move(job));
+}
+
+AssetLoadSystem::Geometry AssetLoadSystem::CreateGeometry(const MeshView&            mesh_data,
+                                                          uint64_t                   hash,
+                                                          ID3D12GraphicsCommandList* command_list)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+
+    Geometry geometry;
+    geometry.mesh.first_vertex_offset = AllocateRange(storage_.vertex_allocator,
+                                                      GetVertexBuffers(storage_),
+                                                      mesh_data.vertex_count,
+                                                      command_list,
+                                                      render_system);
+    geometry.mesh.first_index_offset  = AllocateRange(storage_.index_allocator,
+                                                     GetIndexBuffers(storage_),
+                                                     GetIndexWordCount(mesh_data),
+                                                     command_list,
+                                                     render_system);
+
+    UploadMesh(mesh_data,
+               storage_,
+               command_list,
+               render_system,
+               geometry.mesh,
+               geometry.lods,
+               geometry.dequantization);
+
+    // A new id, so that BLASes of the previous contents aren't shared with it.
+    geometry.mesh.geometry = next_geometry_++;
+    geometry.hash          = hash;
+    return geometry;
+}
+
+void AssetLoadSystem::RetireGeometry(const Geometry& geometry)
+{
+    world().GetSystem<BLASSystem>().ReleaseGeometry(geometry.mesh.geometry);
+
+    // Allocations of this frame are uploaded before it is traced, but earlier frames may
+    // still read the ranges.
+    RetiredRanges ranges;
+    ranges.submission_id       = world().GetSystem<RenderSystem>().submission_id();
+    ranges.first_vertex_offset = geometry.mesh.first_vertex_offset;
+    ranges.first_index_offset  = geometry.mesh.first_index_offset;
+    retired_ranges_.push_back(ranges);
+}
+
+void AssetLoadSystem::RetireMeshSlot(uint32_t slot)
+{
+    RetiredRanges ranges;
+    ranges.submission_id = world().GetSystem<RenderSystem>().submission_id();
+    ranges.mesh_slot     = slot;
+    retired_ranges_.push_back(ranges);
+}
+
+void AssetLoadSystem::FreeRetiredRanges()
+{
+    auto completed = world().GetSystem<RenderSystem>().completed_submission_id();
+    auto retired   = std::find_if(
+        retired_ranges_.begin(), retired_ranges_.end(), [completed](auto& ranges) {
+            return ranges.submission_id > completed;
+        });
+
+    for (auto it = retired_ranges_.begin(); it != retired; ++it)
+    {
+        if (it->first_vertex_offset != RangeAllocator::kInvalidOffset)
+        {
+            storage_.vertex_allocator.Free(it->first_vertex_offset);
+            storage_.index_allocator.Free(it->first_index_offset);
+        }
+
+        if (it->mesh_slot != RangeAllocator::kInvalidOffset)
+        {
+            storage_.mesh_allocator.Free(it->mesh_slot);
+        }
+    }
+
+    retired_ranges_.erase(retired_ranges_.begin(), retired);
+}
+
+uint32_t AssetLoadSystem::ResolveTexture(const std::string& name)
+{
+    if (name.empty())
+    {
+        return ~0u;
+    }
+
+    if (options_.hot_reload && texture_files_.find(name) == texture_files_.cend())
+    {
+        auto& files = texture_files_[name];
+        files       = TextureSystem::GetTextureFiles(name);
+        for (auto& file : files)
+        {
+            watcher_.Watch(file);
+        }
+    }
+
+    return world().GetSystem<TextureSystem>().GetTextureIndex(name);
+}
+
+void AssetLoadSystem::CreateInstance(Scene&                      scene,
+                                     const Geometry&             geometry,
+                                     const MeshInstance&         instance,
+                                     ID3D12GraphicsCommandList*  command_list,
+                                     std::vector<MeshComponent>& meshes,
+                                     std::vector<float>&         transforms)
+{
+    // Textures load on first use, so they spread over the batches as well.
+    auto material_index = ResolveTexture(instance.texture_name);
+
+    auto slot = AllocateRange(storage_.mesh_allocator,
+                              GetMeshBuffers(storage_),
+                              1,
+                              command_list,
+                              world().GetSystem<RenderSystem>());
+
+    auto  entity                  = CreateMeshEntity();
+    auto& mesh_component          = world().GetComponent<MeshComponent>(entity);
+    mesh_component                = geometry.mesh;
+    mesh_component.index          = slot;
+    mesh_component.material_index = material_index;
+    std::copy_n(instance.transform, 12, mesh_component.transform);
+
+    world().GetComponent<MeshLODComponent>(entity) = geometry.lods;
+    world().GetComponent<BoundsComponent>(entity)  = GetInstanceBounds(mesh_component);
+    scene.entities.push_back(entity);
+
+    if (storage_.quantized_vertices)
+    {
+        transforms.insert(transforms.end(), geometry.dequantization, geometry.dequantization + 12);
+    }
+
+    meshes.push_back(mesh_component);
+}
+
+void AssetLoadSystem::UploadBatch(LoadJob& job)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = upload_command_list_.Get();
+    auto& scene         = scenes_[job.asset.scene_id];
+
+    command_list->Reset(render_system.current_frame_command_allocator(), nullptr);
+
+    if (storage_.shader_readable)
+    {
+        TransitionPools(storage_,
+                        command_list,
+                        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                        D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+
+    std::vector<MeshComponent> meshes;
+    std::vector<float>         transforms;
+    uint64_t                   num_triangles = 0;
+
+    while (job.next_instance < job.instances.size() && num_triangles < kUploadBatchTriangles)
+    {
+        auto& instance = job.instances[job.next_instance++];
+
+        if (job.geometries[instance.mesh] == ~0u)
+        {
+            auto hash = job.hashes.empty() ? 0 : job.hashes[instance.mesh];
+
+            job.geometries[instance.mesh] = static_cast<uint32_t>(scene.geometries.size());
+            scene.geometries.push_back(
+                CreateGeometry(job.meshes[instance.mesh], hash, command_list));
+
+            num_triangles += job.meshes[instance.mesh].index_count / 3;
+        }
+
+        CreateInstance(scene,
+                       scene.geometries[job.geometries[instance.mesh]],
+                       instance,
+                       command_list,
+                       meshes,
+                       transforms);
+    }
+
+    UploadInstances(storage_, command_list, render_system, meshes, transforms);
+
+    ++storage_.version;
+
+    TransitionPools(storage_,
+                    command_list,
+                    D3D12_RESOURCE_STATE_COPY_DEST,
+                    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    storage_.shader_readable = true;
+
+    command_list->Close();
+    render_system.PushCommandList(upload_command_list_);
+
+    job.asset.progress->visible_count = job.next_instance;
+
+    info("AssetLoadSystem: {} instances of {} visible",
+         job.next_instance,
+         job.instances.size());
+}
+
+void AssetLoadSystem::ApplyReload(LoadJob& job)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = upload_command_list_.Get();
+    auto& scene         = scenes_[job.asset.scene_id];
+    auto  start         = Clock::now();
+
+    command_list->Reset(render_system.current_frame_command_allocator(), nullptr);
+
+    if (storage_.shader_readable)
+    {
+        TransitionPools(storage_,
+                        command_list,
+                        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                        D3D12_RESOURCE_STATE_COPY_DEST);
+    }
 
-using namespace tinyobj;
-using namespace std;
-using namespace DirectX;
+    auto old_geometries = std::move(scene.geometries);
+    scene.geometries.clear();
+    std::vector<bool> reused(old_geometries.size(), false);
 
-namespace capsaicin
-{
-namespace
-{
-struct MeshData
-{
-    vector<float>    positions;
-    vector<float>    normals;
-    vector<float>    texcoords;
-    vector<uint32_t> indices;
-    std::uint32_t    texture_index = ~0u;
-};
+    std::unordered_multimap<uint64_t, uint32_t> old_hashes;
+    for (uint32_t i = 0; i < old_geometries.size(); ++i)
+    {
+        old_hashes.emplace(old_geometries[i].hash, i);
+    }
 
-// Index comparison operator.
-struct IndexLess
-{
-    bool operator()(index_t const& lhs, index_t const& rhs) const
+    // Unchanged meshes keep their geometry, so their BLASes are kept as well.
+    std::vector<uint32_t> changed;
+    for (uint32_t m = 0; m < job.meshes.size(); ++m)
+    {
+        auto range = old_hashes.equal_range(job.hashes[m]);
+        auto match = std::find_if(
+            range.first, range.second, [&reused](auto& entry) { return !reused[entry.second]; });
+
+        if (match == range.second)
+        {
+            changed.push_back(m);
+            continue;
+        }
+
+        reused[match->second] = true;
+        job.geometries[m]     = static_cast<uint32_t>(scene.geometries.size());
+        scene.geometries.push_back(old_geometries[match->second]);
+    }
+
+    // Changed meshes get new ranges, as frames in flight may still read the replaced ones.
+    for (auto m : changed)
     {
-        return lhs.vertex_index != rhs.vertex_index
-                   ? lhs.vertex_index < rhs.vertex_index
-                   : lhs.normal_index != rhs.normal_index
-                         ? lhs.normal_index < rhs.normal_index
-                         : lhs.texcoord_index != rhs.texcoord_index
-                               ? lhs.texcoord_index < rhs.texcoord_index
-                               : false;
+        job.geometries[m] = static_cast<uint32_t>(scene.geometries.size());
+        scene.geometries.push_back(CreateGeometry(job.meshes[m], job.hashes[m], command_list));
     }
-};
 
-// Load obj file into a single mesh.
-void LoadObjFile(AssetComponent&        asset,
-                 std::vector<MeshData>& meshes,
-                 bool                   force_single_mesh = false)
+    for (uint32_t i = 0; i < old_geometries.size(); ++i)
+    {
+        if (!reused[i])
+        {
+            RetireGeometry(old_geometries[i]);
+        }
+    }
+
+    // Instances keep their entities and slots in order. Entities of another geometry are
+    // recreated, as their BLAS component refers to the previous one.
+    auto old_entities = std::move(scene.entities);
+    scene.entities.clear();
+
+    std::vector<MeshComponent> meshes;
+    std::vector<float>         transforms;
+
+    for (uint32_t i = 0; i < job.instances.size(); ++i)
+    {
+        auto& instance = job.instances[i];
+        auto& geometry = scene.geometries[job.geometries[instance.mesh]];
+        auto  reuse    = i < old_entities.size();
+        auto  entity   = reuse ? old_entities[i] : CreateMeshEntity();
+        auto  slot     = reuse ? world().GetComponent<MeshComponent>(entity).index
+                               : AllocateRange(storage_.mesh_allocator,
+                                               GetMeshBuffers(storage_),
+                                               1,
+                                               command_list,
+                                               render_system);
+
+        // So are entities at a simplified level, their BLAS is that of the level.
+        auto& old_mesh = world().GetComponent<MeshComponent>(entity);
+        if (reuse && (old_mesh.geometry != geometry.mesh.geometry || old_mesh.lod != 0))
+        {
+            world().DestroyEntity(entity);
+            entity = CreateMeshEntity();
+        }
+
+        auto& mesh_component          = world().GetComponent<MeshComponent>(entity);
+        mesh_component                = geometry.mesh;
+        mesh_component.index          = slot;
+        mesh_component.material_index = ResolveTexture(instance.texture_name);
+        std::copy_n(instance.transform, 12, mesh_component.transform);
+
+        world().GetComponent<MeshLODComponent>(entity) = geometry.lods;
+        world().GetComponent<BoundsComponent>(entity)  = GetInstanceBounds(mesh_component);
+        scene.entities.push_back(entity);
+
+        if (storage_.quantized_vertices)
+        {
+            transforms.insert(
+                transforms.end(), geometry.dequantization, geometry.dequantization + 12);
+        }
+
+        meshes.push_back(mesh_component);
+    }
+
+    for (auto i = job.instances.size(); i < old_entities.size(); ++i)
+    {
+        RetireMeshSlot(world().GetComponent<MeshComponent>(old_entities[i]).index);
+        world().DestroyEntity(old_entities[i]);
+    }
+
+    UploadInstances(storage_, command_list, render_system, meshes, transforms);
+
+    ++storage_.version;
+
+    TransitionPools(storage_,
+                    command_list,
+                    D3D12_RESOURCE_STATE_COPY_DEST,
+                    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    storage_.shader_readable = true;
+
+    command_list->Close();
+    render_system.PushCommandList(upload_command_list_);
+
+    info("AssetLoadSystem: {} reloaded in {} ms, {} of {} meshes changed",
+         job.asset.file_name,
+         ElapsedMs(start),
+         changed.size(),
+         job.meshes.size());
+}
+
+void AssetLoadSystem::StartPaging(Scene& scene, std::unique_ptr<LoadJob> job)
 {
-    attrib_t           attrib;
-    vector<shape_t>    shapes;
-    vector<material_t> objmaterials;
+    // Meshes of the previous load are paged out at once, the new ones in over the next
+    // frames, and the scene is visible once the first working set of either load is.
+    if (scene.residency)
+    {
+        ScenePool pool(*this, scene, nullptr);
+        scene.residency->Clear(pool);
+        pool.RemoveEvicted();
+
+        if (!job->asset.completion)
+        {
+            job->asset.completion = scene.paged_job->asset.completion;
+        }
+    }
+
+    scene.residency =
+        std::make_unique<GeometryResidency>(options_.geometry_budget, kPagedBytesPerFrame);
+
+    uint64_t total_size = 0;
+    for (auto& mesh_data : job->meshes)
+    {
+        auto size = GetGeometrySize(storage_, mesh_data);
+        scene.residency->AddMesh(size);
+        total_size += size;
+    }
+
+    job->mesh_instances.assign(job->meshes.size(), {});
+    for (uint32_t i = 0; i < job->instances.size(); ++i)
+    {
+        auto& instance = job->instances[i];
+        job->mesh_instances[instance.mesh].push_back(i);
+        scene.residency->AddInstance(
+            instance.mesh,
+            TransformBounds(
+                job->bounds[instance.mesh], job->radii[instance.mesh], instance.transform));
+    }
+
+    scene.mesh_geometries.assign(job->meshes.size(), ~0u);
+    scene.geometry_meshes.clear();
 
-    string warn;
-    string err;
+    info("AssetLoadSystem: Paging {} MB of geometry of {} in a budget of {} MB",
+         total_size >> 20,
+         job->asset.file_name,
+         options_.geometry_budget >> 20);
 
-    bool ret = LoadObj(
-        &attrib, &shapes, &objmaterials, &warn, &err, asset.file_name.c_str(), "../../../assets/");
+    scene.paged_job = std::move(job);
+}
+
+bool AssetLoadSystem::UpdateResidency(const float* eye)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = upload_command_list_.Get();
 
-    if (!err.empty())
+    PagedUploads uploads;
+    for (auto& entry : scenes_)
     {
-        error(err);
-        throw std::runtime_error(err.c_str());
+        auto& scene = entry.second;
+        if (!scene.residency)
+        {
+            continue;
+        }
+
+        ScenePool pool(*this, scene, &uploads);
+        auto      complete = scene.residency->Update(eye, pool);
+        pool.RemoveEvicted();
+
+        auto& job                         = *scene.paged_job;
+        job.asset.progress->visible_count = static_cast<uint32_t>(scene.entities.size());
+
+        if (complete && job.asset.completion)
+        {
+            info("AssetLoadSystem: {} is visible, {} of {} meshes resident in {} MB",
+                 job.asset.file_name,
+                 scene.residency->resident_count(),
+                 scene.residency->mesh_count(),
+                 scene.residency->resident_size() >> 20);
+            job.asset.completion->set_value();
+            job.asset.completion = nullptr;
+        }
     }
 
-    if (!ret)
+    if (!uploads.open)
     {
-        error("AssetLoadSystem: Couldn't load {}", asset.file_name);
-        throw std::runtime_error("Couldn't load {}" + asset.file_name);
+        return false;
     }
 
-    MeshData                                   mesh_data;
-    map<tinyobj::index_t, uint32_t, IndexLess> index_cache;
+    UploadInstances(storage_, command_list, render_system, uploads.meshes, uploads.transforms);
+
+    ++storage_.version;
 
-    std::vector<uint32_t> texture_indices;
+    TransitionPools(storage_,
+                    command_list,
+                    D3D12_RESOURCE_STATE_COPY_DEST,
+                    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    storage_.shader_readable = true;
+
+    command_list->Close();
+    render_system.PushCommandList(upload_command_list_);
+    return true;
+}
+
+void AssetLoadSystem::UpdateLods(const float* eye)
+{
+    // Descriptors are copied in place, so pools have to be readable already.
+    if (!options_.select_lods || !storage_.shader_readable)
+    {
+        return;
+    }
 
-    if (!force_single_mesh)
+    std::vector<std::pair<uint32_t, MeshComponent>> meshes;
+    for (auto& entry : scenes_)
     {
-        for (uint32_t j = 0; j < objmaterials.size(); ++j)
+        for (auto& e : entry.second.entities)
         {
-            if (!objmaterials[j].diffuse_texname.empty())
+            auto mesh_component = world().GetComponent<MeshComponent>(e);
+            auto lod_component  = world().GetComponent<MeshLODComponent>(e);
+            auto bounds         = world().GetComponent<BoundsComponent>(e);
+
+            float errors[kMaxMeshLods];
+            for (uint32_t l = 0; l < lod_component.lod_count; ++l)
+            {
+                errors[l] = lod_component.levels[l].error;
+            }
+
+            auto select = [&](float max_error) {
+                return SelectMeshLod(errors,
+                                     lod_component.lod_count,
+                                     mesh_component.bounds_radius,
+                                     ProjectedSize(bounds, eye),
+                                     max_error);
+            };
+
+            auto lod = select(kMaxLodError);
+            if (lod > mesh_component.lod)
             {
-                std::string path      = "";
-                std::string full_name = path + objmaterials[j].diffuse_texname;
-                texture_indices.push_back(
-                    world().GetSystem<TextureSystem>().GetTextureIndex(full_name));
+                lod = std::max(mesh_component.lod, select(0.5f * kMaxLodError));
             }
-            else
+
+            if (lod == mesh_component.lod)
             {
-                texture_indices.push_back(~0u);
+                continue;
             }
+
+            // The BLAS component refers to the previous level, so the entity is recreated.
+            SetLod(mesh_component, lod_component, lod);
+            world().DestroyEntity(e);
+            e = CreateMeshEntity();
+            world().GetComponent<MeshComponent>(e)    = mesh_component;
+            world().GetComponent<MeshLODComponent>(e) = lod_component;
+            world().GetComponent<BoundsComponent>(e)  = bounds;
+            meshes.emplace_back(mesh_component.index, mesh_component);
         }
     }
 
-    for (uint32_t shape_index = 0u; shape_index < shapes.size(); ++shape_index)
+    if (meshes.empty())
+    {
+        return;
+    }
+
+    std::sort(meshes.begin(), meshes.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<uint32_t>      slots;
+    std::vector<MeshComponent> mesh_descs;
+    for (auto& mesh : meshes)
+    {
+        slots.push_back(mesh.first);
+        mesh_descs.push_back(mesh.second);
+    }
+
+    // Copies of the frame run before its upload command list, which may grow the pool.
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = render_system.copy_command_list();
+
+    auto barrier =
+        CD3DX12_RESOURCE_BARRIER::Transition(storage_.mesh_descs.Get(),
+                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                             D3D12_RESOURCE_STATE_COPY_DEST);
+    command_list->ResourceBarrier(1, &barrier);
+
+    UploadSlots(command_list,
+                render_system,
+                storage_.mesh_descs.Get(),
+                slots,
+                mesh_descs.data(),
+                sizeof(MeshComponent));
+
+    std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    command_list->ResourceBarrier(1, &barrier);
+
+    ++storage_.version;
+}
+
+void AssetLoadSystem::UnloadScene(Scene& scene)
+{
+    for (auto e : scene.entities)
+    {
+        RetireMeshSlot(world().GetComponent<MeshComponent>(e).index);
+        world().DestroyEntity(e);
+    }
+
+    for (auto& geometry : scene.geometries)
+    {
+        RetireGeometry(geometry);
+    }
+
+    SetSceneFiles(scene, {});
+
+    if (scene.paged_job && scene.paged_job->asset.completion)
     {
-        if (!force_single_mesh)
+        scene.paged_job->asset.completion->set_exception(std::make_exception_ptr(
+            std::runtime_error("AssetLoadSystem: " + scene.paged_job->asset.file_name +
+                               " was unloaded")));
+    }
+
+    ++storage_.version;
+
+    info("AssetLoadSystem: Unloaded {} instances of {} meshes",
+         scene.entities.size(),
+         scene.geometries.size());
+}
+
+void AssetLoadSystem::CompactPools()
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = upload_command_list_.Get();
+
+    command_list->Reset(render_system.current_frame_command_allocator(), nullptr);
+
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+    // Old to new offsets of the moved ranges.
+    auto compact = [&](RangeAllocator& allocator, const std::vector<PoolBuffer>& buffers) {
+        std::unordered_map<uint32_t, uint32_t> offsets;
+
+        auto moves = allocator.Defragment();
+        if (moves.empty())
         {
-            mesh_data = MeshData{};
-            index_cache.clear();
+            return offsets;
         }
 
-        for (uint32_t i = 0u; i < shapes[shape_index].mesh.indices.size(); ++i)
+        // Ranges in front of the first move keep their offsets and are copied at once.
+        auto copies = moves;
+        if (moves.front().to > 0)
         {
-            auto index = shapes[shape_index].mesh.indices[i];
-            auto iter  = index_cache.find(index);
-            if (iter != index_cache.cend())
-            {
-                mesh_data.indices.push_back(iter->second);
-            }
-            else
-            {
-                uint32_t vertex_index = (uint32_t)mesh_data.positions.size() / 3;
-                mesh_data.indices.push_back(vertex_index);
-                index_cache[index] = vertex_index;
+            copies.insert(copies.begin(), RangeAllocator::Move{0, 0, moves.front().to});
+        }
 
-                mesh_data.positions.push_back(attrib.vertices[3 * index.vertex_index]);
-                mesh_data.positions.push_back(attrib.vertices[3 * index.vertex_index + 1]);
-                mesh_data.positions.push_back(attrib.vertices[3 * index.vertex_index + 2]);
+        ReallocateBuffers(buffers,
+                          allocator.capacity(),
+                          D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                          copies,
+                          command_list,
+                          render_system);
 
-                if (index.normal_index != -1)
-                {
-                    mesh_data.normals.push_back(attrib.normals[3 * index.normal_index]);
-                    mesh_data.normals.push_back(attrib.normals[3 * index.normal_index + 1]);
-                    mesh_data.normals.push_back(attrib.normals[3 * index.normal_index + 2]);
-                }
-                else
-                {
-                    mesh_data.normals.push_back(0.f);
-                    mesh_data.normals.push_back(0.f);
-                    mesh_data.normals.push_back(0.f);
-                }
+        for (auto& buffer : buffers)
+        {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+                buffer.resource->Get(),
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+        }
 
-                if (index.texcoord_index != -1)
-                {
-                    mesh_data.texcoords.push_back(attrib.texcoords[2 * index.texcoord_index]);
-                    mesh_data.texcoords.push_back(attrib.texcoords[2 * index.texcoord_index + 1]);
-                }
-                else
-                {
-                    mesh_data.texcoords.push_back(0.f);
-                    mesh_data.texcoords.push_back(0.f);
-                }
+        for (auto& move : moves)
+        {
+            offsets.emplace(move.from, move.to);
+        }
+
+        return offsets;
+    };
+
+    auto vertex_offsets = compact(storage_.vertex_allocator, GetVertexBuffers(storage_));
+    auto index_offsets  = compact(storage_.index_allocator, GetIndexBuffers(storage_));
+
+    barriers.push_back(
+        CD3DX12_RESOURCE_BARRIER::Transition(storage_.mesh_descs.Get(),
+                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                             D3D12_RESOURCE_STATE_COPY_DEST));
+    command_list->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+    // Patch offsets of all meshes, levels of detail move with the indices of their mesh.
+    auto patch = [&](MeshComponent& mesh_component, MeshLODComponent& lod_component) {
+        auto vertex_offset = vertex_offsets.find(mesh_component.first_vertex_offset);
+        if (vertex_offset != vertex_offsets.cend())
+        {
+            mesh_component.first_vertex_offset = vertex_offset->second;
+        }
+
+        // Instances may be at a level of detail, the range starts with the full indices.
+        auto& full         = lod_component.full;
+        auto  index_offset = index_offsets.find(full.first_index_offset);
+        if (index_offset != index_offsets.cend())
+        {
+            auto delta = index_offset->second - full.first_index_offset;
+            for (uint32_t l = 0; l < lod_component.lod_count; ++l)
+            {
+                lod_component.levels[l].first_index_offset += delta;
             }
+            full.first_index_offset += delta;
+            mesh_component.first_index_offset += delta;
         }
+    };
 
-        if (!force_single_mesh)
+    std::vector<std::pair<uint32_t, MeshComponent>> meshes;
+    for (auto& entry : scenes_)
+    {
+        auto& scene = entry.second;
+        for (auto& geometry : scene.geometries)
         {
-            mesh_data.texture_index =
-                (shapes[shape_index].mesh.material_ids.empty() ||
-                 shapes[shape_index].mesh.material_ids[0] == -1)
-                    ? ~0u
-                    : texture_indices[shapes[shape_index].mesh.material_ids[0]];
+            patch(geometry.mesh, geometry.lods);
+        }
 
-            meshes.push_back(mesh_data);
+        for (auto e : scene.entities)
+        {
+            auto& mesh_component = world().GetComponent<MeshComponent>(e);
+            patch(mesh_component, world().GetComponent<MeshLODComponent>(e));
+            meshes.emplace_back(mesh_component.index, mesh_component);
         }
     }
 
-    if (force_single_mesh)
+    std::sort(meshes.begin(), meshes.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<uint32_t>      slots;
+    std::vector<MeshComponent> mesh_descs;
+    for (auto& mesh : meshes)
     {
-        meshes.push_back(mesh_data);
+        slots.push_back(mesh.first);
+        mesh_descs.push_back(mesh.second);
     }
+
+    UploadSlots(command_list,
+                render_system,
+                storage_.mesh_descs.Get(),
+                slots,
+                mesh_descs.data(),
+                sizeof(MeshComponent));
+
+    auto barrier =
+        CD3DX12_RESOURCE_BARRIER::Transition(storage_.mesh_descs.Get(),
+                                             D3D12_RESOURCE_STATE_COPY_DEST,
+                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    command_list->ResourceBarrier(1, &barrier);
+
+    command_list->Close();
+    render_system.PushCommandList(upload_command_list_);
+
+    info("AssetLoadSystem: Compacted pools to {} vertices and {} index words",
+         storage_.vertex_allocator.used(),
+         storage_.index_allocator.used());
 }
 
-void CreateGeometryStorage(std::vector<MeshData>&     mesh_data_array,
-                           GeometryStorage&           storage,
-                           ID3D12GraphicsCommandList* command_list,
-                           RenderSystem&              render_system)
+void AssetLoadSystem::SetSceneFiles(Scene& scene, std::vector<std::string> files)
 {
-    std::vector<MeshComponent> meshes;
+    auto old_files = std::move(scene.files);
+    scene.files    = std::move(files);
 
-    for (auto& mesh_data : mesh_data_array)
-    {
-        auto  entity         = world().CreateEntity().AddComponent<MeshComponent>().Build();
-        auto& mesh_component = world().GetComponent<MeshComponent>(entity);
-        // auto& mesh_component = world().AddComponent<MeshComponent>(mesh_data.entity);
-        mesh_component.first_vertex_offset = storage.vertex_count;
-        mesh_component.first_index_offset  = storage.index_count;
-        mesh_component.vertex_count        = mesh_data.positions.size() / 3;
-        mesh_component.index_count         = mesh_data.indices.size();
-        mesh_component.index               = meshes.size();
-        mesh_component.material_index      = mesh_data.texture_index;
-
-        // Create upload buffers.
-        auto vertex_upload_buffer = dx12api().CreateUploadBuffer(
-            mesh_data.positions.size() * sizeof(float), mesh_data.positions.data());
-        auto index_upload_buffer = dx12api().CreateUploadBuffer(
-            mesh_data.indices.size() * sizeof(uint32_t), mesh_data.indices.data());
-        auto normals_upload_buffer = dx12api().CreateUploadBuffer(
-            mesh_data.normals.size() * sizeof(float), mesh_data.normals.data());
-        auto texcoord_upload_buffer = dx12api().CreateUploadBuffer(
-            mesh_data.texcoords.size() * sizeof(float), mesh_data.texcoords.data());
-
-        render_system.AddAutoreleaseResource(vertex_upload_buffer);
-        render_system.AddAutoreleaseResource(index_upload_buffer);
-        render_system.AddAutoreleaseResource(normals_upload_buffer);
-        render_system.AddAutoreleaseResource(texcoord_upload_buffer);
-
-        // Copy data.
-        command_list->CopyBufferRegion(storage.vertices.Get(),
-                                       mesh_component.first_vertex_offset * sizeof(XMFLOAT3),
-                                       vertex_upload_buffer.Get(),
-                                       0,
-                                       mesh_data.positions.size() * sizeof(float));
-        command_list->CopyBufferRegion(storage.indices.Get(),
-                                       mesh_component.first_index_offset * sizeof(uint32_t),
-                                       index_upload_buffer.Get(),
-                                       0,
-                                       mesh_data.indices.size() * sizeof(uint32_t));
-        command_list->CopyBufferRegion(storage.normals.Get(),
-                                       mesh_component.first_vertex_offset * sizeof(XMFLOAT3),
-                                       normals_upload_buffer.Get(),
-                                       0,
-                                       mesh_data.normals.size() * sizeof(float));
-        command_list->CopyBufferRegion(storage.texcoords.Get(),
-                                       mesh_component.first_vertex_offset * sizeof(XMFLOAT2),
-                                       texcoord_upload_buffer.Get(),
-                                       0,
-                                       mesh_data.texcoords.size() * sizeof(float));
-
-        meshes.push_back(mesh_component);
-        storage.vertex_count += mesh_component.vertex_count;
-        storage.index_count += mesh_component.index_count;
-        ++storage.mesh_count;
+    if (!options_.hot_reload)
+    {
+        return;
     }
 
-    // Upload mesh buffer.
-    auto mesh_upload_buffer =
-        dx12api().CreateUploadBuffer(storage.mesh_count * sizeof(MeshComponent), meshes.data());
-    render_system.AddAutoreleaseResource(mesh_upload_buffer);
-
-    command_list->CopyBufferRegion(storage.mesh_descs.Get(),
-                                   0,
-                                   mesh_upload_buffer.Get(),
-                                   0,
-                                   storage.mesh_count * sizeof(MeshComponent));
+    for (auto& file : scene.files)
+    {
+        watcher_.Watch(file);
+    }
 
-    // Transitions for mesh buffes to non pixel shader resource.
-    D3D12_RESOURCE_BARRIER copy_dest_to_uav[] = {
-        CD3DX12_RESOURCE_BARRIER::Transition(storage.vertices.Get(),
-                                             D3D12_RESOURCE_STATE_COPY_DEST,
-                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-        CD3DX12_RESOURCE_BARRIER::Transition(storage.indices.Get(),
-                                             D3D12_RESOURCE_STATE_COPY_DEST,
-                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-        CD3DX12_RESOURCE_BARRIER::Transition(storage.normals.Get(),
-                                             D3D12_RESOURCE_STATE_COPY_DEST,
-                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-        CD3DX12_RESOURCE_BARRIER::Transition(storage.mesh_descs.Get(),
-                                             D3D12_RESOURCE_STATE_COPY_DEST,
-                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-        CD3DX12_RESOURCE_BARRIER::Transition(storage.texcoords.Get(),
-                                             D3D12_RESOURCE_STATE_COPY_DEST,
-                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)};
+    for (auto& file : old_files)
+    {
+        auto needed = std::any_of(scenes_.cbegin(), scenes_.cend(), [&file](auto& entry) {
+            auto& files = entry.second.files;
+            return std::find(files.cbegin(), files.cend(), file) != files.cend();
+        });
 
-    // Transition to UAV.
-    command_list->ResourceBarrier(ARRAYSIZE(copy_dest_to_uav), copy_dest_to_uav);
+        if (!needed)
+        {
+            watcher_.Unwatch(file);
+        }
+    }
 }
-}  // namespace
 
-AssetLoadSystem::AssetLoadSystem()
+void AssetLoadSystem::PollFiles()
 {
-    storage_.vertices   = dx12api().CreateUAVBuffer(kVertexPoolSize * sizeof(XMFLOAT3),
-                                                  D3D12_RESOURCE_STATE_COPY_DEST);
-    storage_.indices    = dx12api().CreateUAVBuffer(kIndexPoolSize * sizeof(uint32_t),
-                                                 D3D12_RESOURCE_STATE_COPY_DEST);
-    storage_.normals    = dx12api().CreateUAVBuffer(kVertexPoolSize * sizeof(XMFLOAT3),
-                                                 D3D12_RESOURCE_STATE_COPY_DEST);
-    storage_.texcoords  = dx12api().CreateUAVBuffer(kVertexPoolSize * sizeof(XMFLOAT2),
-                                                   D3D12_RESOURCE_STATE_COPY_DEST);
-    storage_.mesh_descs = dx12api().CreateUAVBuffer(kMeshPoolSize * sizeof(MeshComponent),
-                                                    D3D12_RESOURCE_STATE_COPY_DEST);
+    auto& texture_system = world().GetSystem<TextureSystem>();
+
+    for (auto& file : watcher_.Poll())
+    {
+        info("AssetLoadSystem: {} changed", file);
+
+        for (auto& entry : scenes_)
+        {
+            auto& files = entry.second.files;
+            if (std::find(files.cbegin(), files.cend(), file) != files.cend() &&
+                std::find(pending_reloads_.cbegin(), pending_reloads_.cend(), entry.first) ==
+                    pending_reloads_.cend())
+            {
+                pending_reloads_.push_back(entry.first);
+            }
+        }
+
+        // The cooked texture is stale if its source image changed.
+        for (auto& entry : texture_files_)
+        {
+            auto& files = entry.second;
+            if (std::find(files.cbegin(), files.cend(), file) != files.cend())
+            {
+                texture_system.ReloadTexture(entry.first, file == files.back());
+            }
+        }
+    }
+
+    // A reload waits for pending loads of its scene, which may be reloads themselves.
+    for (auto it = pending_reloads_.begin(); it != pending_reloads_.end();)
+    {
+        auto scene_id = *it;
+        auto loading  = std::any_of(jobs_.cbegin(), jobs_.cend(), [scene_id](auto& job) {
+            return job->asset.scene_id == scene_id;
+        });
+
+        if (loading)
+        {
+            ++it;
+            continue;
+        }
+
+        auto scene = scenes_.find(scene_id);
+        if (scene != scenes_.end())
+        {
+            AssetComponent asset;
+            asset.file_name = scene->second.files.front();
+            asset.scene_id  = scene_id;
+            asset.progress  = std::make_shared<LoadProgress>();
+            StartLoad(asset, true);
+        }
+
+        it = pending_reloads_.erase(it);
+    }
 }
 
 void AssetLoadSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow)
@@ -292,38 +1908,178 @@ void AssetLoadSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf
         info("AssetLoadSystem: found {} assets", entities.size());
     }
 
-    if (!entities.empty())
+    // Start loading new assets in the background, each of them spreads its work over the
+    // loader threads.
+    for (auto e : entities)
+    {
+        StartLoad(world().GetComponent<AssetComponent>(e), false);
+        world().DestroyEntity(e);
+    }
+
+    auto& unloads = access.Write<AssetUnloadComponent>();
+    auto  unload_entities =
+        entity_query().Filter([&unloads](Entity e) { return unloads.HasComponent(e); }).entities();
+
+    // Scenes which are still loading are unloaded once their load is done, as their loader
+    // tasks can't be cancelled.
+    for (auto e : unload_entities)
     {
-        // Load asset.
-        std::vector<MeshData> meshes;
-        for (auto e : entities)
+        auto scene_id = world().GetComponent<AssetUnloadComponent>(e).scene_id;
+        auto pending  = std::find_if(jobs_.begin(), jobs_.end(), [scene_id](auto& job) {
+            return job->asset.scene_id == scene_id;
+        });
+
+        if (pending != jobs_.end())
+        {
+            (*pending)->unload_requested = true;
+        }
+        else
         {
-            auto& asset = world().GetComponent<AssetComponent>(e);
+            auto scene = scenes_.find(scene_id);
+            if (scene != scenes_.end())
+            {
+                UnloadScene(scene->second);
+                scenes_.erase(scene);
+            }
+        }
+
+        world().DestroyEntity(e);
+    }
 
-            info("AssetLoadSystem: Loading {}", asset.file_name);
+    if (options_.hot_reload && Clock::now() - last_poll_ >
+                                   std::chrono::milliseconds(kHotReloadIntervalMs))
+    {
+        PollFiles();
+        last_poll_ = Clock::now();
+    }
 
-            LoadObjFile(asset, meshes);
+    FreeRetiredRanges();
 
-            world().DestroyEntity(e);
+    // Levels of detail are switched before pools may grow or move this frame.
+    auto eye = GetEyePosition(access, entity_query);
+    UpdateLods(&eye.x);
+
+    // Unloads and reloads leave holes in the pools. Loads refer to their meshes through the
+    // geometries of their scene, which are patched, so packing may run between batches.
+    // The cooldown keeps pools churned by reloads or paging from being copied every frame,
+    // and retired ranges are freed first, as packing would move them.
+    compaction_frames_ = std::min(compaction_frames_ + 1, kCompactionCooldownFrames);
+    if (compaction_frames_ == kCompactionCooldownFrames && retired_ranges_.empty() &&
+        (IsFragmented(storage_.vertex_allocator) || IsFragmented(storage_.index_allocator)))
+    {
+        CompactPools();
+        compaction_frames_ = 0;
+        return;
+    }
+
+    // Paged scenes follow the camera, paging in takes the upload of the frame like a batch.
+    if (UpdateResidency(&eye.x))
+    {
+        return;
+    }
+
+    // Assets become visible in request order, a batch per frame.
+    if (jobs_.empty() ||
+        jobs_.front()->loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return;
+    }
+
+    auto& job = *jobs_.front();
+
+    if (job.unload_requested)
+    {
+        auto scene = scenes_.find(job.asset.scene_id);
+        if (scene != scenes_.end())
+        {
+            UnloadScene(scene->second);
+            scenes_.erase(scene);
+        }
+
+        info("AssetLoadSystem: Load of {} cancelled", job.asset.file_name);
+        if (job.asset.completion)
+        {
+            job.asset.completion->set_exception(std::make_exception_ptr(
+                std::runtime_error("AssetLoadSystem: " + job.asset.file_name + " was unloaded")));
+        }
+        jobs_.erase(jobs_.begin());
+        return;
+    }
+
+    // A failed reload leaves the scene as it was, so that the next save can fix it.
+    if (job.load_error)
+    {
+        error("AssetLoadSystem: Couldn't load {}", job.asset.file_name);
+        if (job.asset.completion)
+        {
+            job.asset.completion->set_exception(job.load_error);
         }
+        jobs_.erase(jobs_.begin());
+        return;
+    }
 
-        uint32_t num_triangles = 0u;
-        for (auto& m : meshes)
+    if (!job.started)
+    {
+        uint64_t num_triangles = 0;
+        for (auto& instance : job.instances)
         {
-            num_triangles += m.indices.size() / 3;
+            num_triangles += job.meshes[instance.mesh].index_count / 3;
         }
 
         info("AssetLoadSystem: Total triangle count {}", num_triangles);
-        info("AssetLoadSystem: Total instance count {}", meshes.size());
+        info("AssetLoadSystem: Total instance count {} of {} meshes",
+             job.instances.size(),
+             job.meshes.size());
 
-        upload_command_list_->Reset(render_system.current_frame_command_allocator(), nullptr);
+        // Changes made while the files were being read are picked up by the next poll.
+        auto files = job.loaded_asset.dependencies;
+        files.insert(files.begin(), job.asset.file_name);
+        SetSceneFiles(scenes_[job.asset.scene_id], std::move(files));
 
-        info("AssetLoadSystem: Allocating GPU buffers");
+        job.geometries.assign(job.meshes.size(), ~0u);
+        job.asset.progress->instance_count = static_cast<uint32_t>(job.instances.size());
+        job.started                        = true;
+    }
 
-        CreateGeometryStorage(meshes, storage_, upload_command_list_.Get(), render_system);
+    // A reload of a paged scene pages in its new meshes instead.
+    if (options_.geometry_budget > 0)
+    {
+        StartPaging(scenes_[job.asset.scene_id], std::move(jobs_.front()));
+        jobs_.erase(jobs_.begin());
+        return;
+    }
 
-        upload_command_list_->Close();
-        render_system.PushCommandList(upload_command_list_);
+    if (job.reload)
+    {
+        ApplyReload(job);
+        jobs_.erase(jobs_.begin());
+        return;
+    }
+
+    if (job.next_instance < job.instances.size())
+    {
+        UploadBatch(job);
+    }
+
+    if (job.next_instance == job.instances.size())
+    {
+        std::vector<BoundsComponent> bounds;
+        for (auto e : scenes_[job.asset.scene_id].entities)
+        {
+            bounds.push_back(world().GetComponent<BoundsComponent>(e));
+        }
+
+        auto scene_bounds = UnionBounds(bounds);
+        info("AssetLoadSystem: {} is visible, bounds ({}, {}, {}) - ({}, {}, {})",
+             job.asset.file_name,
+             scene_bounds.min[0],
+             scene_bounds.min[1],
+             scene_bounds.min[2],
+             scene_bounds.max[0],
+             scene_bounds.max[1],
+             scene_bounds.max[2]);
+        job.asset.completion->set_value();
+        jobs_.erase(jobs_.begin());
     }
 }
-}  // namespace capsaicin
\ No newline at end of file
+}  // namespace capsaicin
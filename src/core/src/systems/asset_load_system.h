@@ -1,16 +1,57 @@
 #pragma once
 
+#include <unordered_map>
+
+#include "capsaicin.h"
+#include "src/asset/file_watcher.h"
+#include "src/asset/geometry_residency.h"
+#include "src/asset/mesh_bounds.h"
+#include "src/asset/mesh_data.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/asset/vertex_layout.h"
 #include "src/common.h"
 #include "src/dx12/d3dx12.h"
 #include "src/dx12/dx12.h"
+#include "src/utils/range_allocator.h"
 
 using namespace capsaicin::dx12;
 
 namespace capsaicin
 {
+// Request to load an asset, consumed by AssetLoadSystem which reports back through progress
+// and completion.
 struct AssetComponent
 {
-    std::string file_name;
+    std::string                         file_name;
+    uint32_t                            scene_id = 0;
+    std::shared_ptr<LoadProgress>       progress;
+    std::shared_ptr<std::promise<void>> completion;
+};
+
+// Request to unload a scene with all of its meshes, consumed by AssetLoadSystem.
+struct AssetUnloadComponent
+{
+    uint32_t scene_id = 0;
+};
+
+struct AssetLoadOptions
+{
+    // Store positions as snorm16 relative to mesh bounds, octahedral normals and half
+    // texcoords, 16 bytes per vertex instead of 32. Shaders need QUANTIZED_VERTICES.
+    bool quantize_vertices = false;
+    // Store all attributes of a vertex in a single record of the vertex pool, so that
+    // hit shaders touch one cache line per vertex. Shaders need INTERLEAVED_VERTICES.
+    bool interleave_vertices = false;
+    // Watch the files of loaded scenes and their textures and reload them when they change.
+    // Only meshes whose contents changed are uploaded again and get new BLASes.
+    bool hot_reload = true;
+    // Bytes of geometry per scene kept in the pools, 0 for all of it. Meshes of larger
+    // scenes stay in the mapped scene files and are paged in and out as the camera moves,
+    // so that scenes larger than the pools can be loaded.
+    uint64_t geometry_budget = 0;
+    // Trace the simplified levels of detail of distant instances, picked each frame by the
+    // projected size of their error.
+    bool select_lods = true;
 };
 
 struct GeometryStorage
@@ -20,10 +61,32 @@ struct GeometryStorage
     ComPtr<ID3D12Resource> texcoords  = nullptr;
     ComPtr<ID3D12Resource> indices    = nullptr;
     ComPtr<ID3D12Resource> mesh_descs = nullptr;
+    // Per mesh 3x4 dequantization transforms for BLAS builds, quantized vertices only.
+    ComPtr<ID3D12Resource> transforms = nullptr;
 
-    uint32_t mesh_count   = 0;
-    uint32_t vertex_count = 0;
-    uint32_t index_count  = 0;
+    bool     quantized_vertices = false;
+    uint32_t position_stride    = 3 * sizeof(float);
+    uint32_t normal_stride      = 3 * sizeof(float);
+    uint32_t texcoord_stride    = 2 * sizeof(float);
+
+    // Normals and texcoords live in the vertex pool records, their buffers are placeholders.
+    bool         interleaved_vertices = false;
+    VertexLayout vertex_layout;
+    // Stride of the vertex pool, either the position stride or the interleaved record.
+    uint32_t vertex_stride = 3 * sizeof(float);
+
+    // Pools were transitioned for shader reads and need a transition before new copies.
+    bool shader_readable = false;
+
+    // Ranges of the vertex pool (vertices, normals and texcoords alike), the index pool in
+    // 32-bit words and slots of mesh descriptors and transforms. Pools grow when they run
+    // out of space, so their resources may be replaced between frames.
+    RangeAllocator vertex_allocator;
+    RangeAllocator index_allocator;
+    RangeAllocator mesh_allocator;
+
+    // Bumped when mesh entities are added or removed.
+    uint32_t version = 0;
 };
 
 struct MeshComponent
@@ -31,28 +94,196 @@ struct MeshComponent
     uint32_t vertex_count        = 0;
     uint32_t first_vertex_offset = 0;
     uint32_t index_count         = 0;
-    uint32_t first_index_offset  = 0;
+    // Offset in 32-bit words of the index pool, whatever the index stride.
+    uint32_t first_index_offset = 0;
 
     uint32_t index          = 0;
     uint32_t material_index = ~0u;
-    uint32_t padding[2];
+
+    // Object space bounds, quantized positions are relative to them.
+    float bounds_min[3] = {0.f, 0.f, 0.f};
+    float bounds_max[3] = {0.f, 0.f, 0.f};
+
+    // Bytes per index, meshes with at most 65536 vertices use 16-bit indices.
+    uint32_t index_stride = sizeof(uint32_t);
+    // Id of the geometry shared by instances, unlike the offsets it stays the same when the
+    // geometry moves in the pools.
+    uint32_t geometry = 0;
+    // Radius of the object space bounding sphere around the center of the bounds.
+    float bounds_radius = 0.f;
+    // Level of detail the instance traces, 0 for full resolution, which the index range
+    // above refers to.
+    uint32_t lod = 0;
+
+    // Row major 3x4 transform from object to world space, instances of a mesh share its
+    // geometry and BLAS and differ in transform and material.
+    float transform[12] = {1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f};
+};
+
+// Simplified levels of detail of a mesh, their indices follow the full resolution ones in
+// the index pool and have the same stride. Errors are object space distances.
+struct MeshLODComponent
+{
+    struct Level
+    {
+        // Offset in 32-bit words of the index pool, like MeshComponent.
+        uint32_t first_index_offset = 0;
+        uint32_t index_count        = 0;
+        float    error              = 0.f;
+    };
+
+    // Full resolution indices, for instances which switch back to them.
+    Level    full;
+    uint32_t lod_count = 0;
+    Level    levels[kMaxMeshLods];
 };
 
 class AssetLoadSystem : public System
 {
 public:
-    static constexpr uint32_t kVertexPoolSize = 60000000;
-    static constexpr uint32_t kIndexPoolSize  = 60000000;
-    static constexpr uint32_t kMeshPoolSize   = 50000;
-    AssetLoadSystem();
-    ~AssetLoadSystem() override = default;
+    // Initial pool sizes in elements, pools double when they run out of space.
+    static constexpr uint32_t kVertexPoolSize = 4000000;
+    static constexpr uint32_t kIndexPoolSize  = 12000000;
+    static constexpr uint32_t kMeshPoolSize   = 4096;
+    // 3x4 row major float matrix.
+    static constexpr uint32_t kTransformSize = 12 * sizeof(float);
+    // Triangles of new geometry uploaded per frame, a batch holds at least one instance.
+    static constexpr uint32_t kUploadBatchTriangles = 1000000;
+    // Compaction copies whole pools, so they are compacted only when more than
+    // kMaxFragmentation of their free space and kMinFragmentedShare of their capacity are
+    // outside of the largest free range, and at most once per kCompactionCooldownFrames.
+    static constexpr float    kMaxFragmentation         = 0.5f;
+    static constexpr float    kMinFragmentedShare       = 0.125f;
+    static constexpr uint32_t kCompactionCooldownFrames = 120;
+    // Interval between polls of watched files.
+    static constexpr uint32_t kHotReloadIntervalMs = 500;
+    // Largest angle in radians the error of the level of detail of an instance may span
+    // from the eye, about a pixel at 1080p with a 60 degree field of view. Instances switch
+    // to coarser levels at half of it, so that they don't switch back and forth.
+    static constexpr float kMaxLodError = 1e-3f;
+    // Bytes of geometry paged in per frame, at least one mesh is paged in.
+    static constexpr uint64_t kPagedBytesPerFrame = 64ull << 20;
 
+    AssetLoadSystem(const AssetLoadOptions& options = AssetLoadOptions{});
+    ~AssetLoadSystem() override;
+
+    // Start loads of new assets in the background and make a batch of a loaded asset
+    // visible.
     void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override;
 
     GeometryStorage& geometry_storage() { return storage_; }
 
 private:
+    struct LoadJob;
+    class ScenePool;
+
+    // Pool ranges of a mesh, shared by its instances. A reload keeps it for an unchanged
+    // mesh, changed ones get new ranges.
+    struct Geometry
+    {
+        // Components instances start from, MeshComponent::geometry is the id.
+        MeshComponent    mesh;
+        MeshLODComponent lods;
+        float            dequantization[12] = {};
+        // Content hash of the mesh, only computed with hot reload.
+        uint64_t hash = 0;
+    };
+
+    // Pool ranges of a replaced or unloaded mesh, or the mesh slot of a destroyed instance,
+    // which frames in flight may still read. They are freed once the frame they were
+    // released in finished execution, ranges which weren't released are kInvalidOffset.
+    struct RetiredRanges
+    {
+        UINT64   submission_id       = 0;
+        uint32_t first_vertex_offset = RangeAllocator::kInvalidOffset;
+        uint32_t first_index_offset  = RangeAllocator::kInvalidOffset;
+        uint32_t mesh_slot           = RangeAllocator::kInvalidOffset;
+    };
+
+    // Pool ranges and entities of a scene, released together when it is unloaded.
+    struct Scene
+    {
+        // Scene file first, followed by the files it depends on, like material libraries.
+        std::vector<std::string> files;
+        std::vector<Geometry>    geometries;
+        std::vector<Entity>      entities;
+
+        // Load of a paged scene, whose meshes stay mapped. Geometries and entities are those
+        // of its resident meshes only.
+        std::unique_ptr<LoadJob>           paged_job;
+        std::unique_ptr<GeometryResidency> residency;
+        // Geometry of each mesh, ~0u if it isn't resident, and the mesh of each geometry.
+        std::vector<uint32_t> mesh_geometries;
+        std::vector<uint32_t> geometry_meshes;
+    };
+
+    // Start loading the asset in the background.
+    void StartLoad(const AssetComponent& asset, bool reload);
+    // Allocate pool ranges for the mesh and upload it.
+    Geometry CreateGeometry(const MeshView&            mesh_data,
+                            uint64_t                   hash,
+                            ID3D12GraphicsCommandList* command_list);
+    // Release the BLAS of the geometry and free its pool ranges once the current frame
+    // finished execution.
+    void RetireGeometry(const Geometry& geometry);
+    // Free the mesh slot once the current frame finished execution.
+    void RetireMeshSlot(uint32_t slot);
+    // Free retired ranges of frames which finished execution.
+    void FreeRetiredRanges();
+    // Texture index for the name, the texture files are watched with hot reload.
+    uint32_t ResolveTexture(const std::string& name);
+    // Create the mesh entity of an instance of the geometry in a new slot, its descriptor
+    // and dequantization transform are appended for upload.
+    void CreateInstance(Scene&                      scene,
+                        const Geometry&             geometry,
+                        const MeshInstance&         instance,
+                        ID3D12GraphicsCommandList*  command_list,
+                        std::vector<MeshComponent>& meshes,
+                        std::vector<float>&         transforms);
+    // Upload the next batch of instances of the job and create their mesh entities.
+    void UploadBatch(LoadJob& job);
+    // Keep the meshes of the job on disk and page them into the pools of the scene, an
+    // earlier load of the scene is paged out.
+    void StartPaging(Scene& scene, std::unique_ptr<LoadJob> job);
+    // Page meshes of paged scenes in and out for the eye. Returns whether the upload command
+    // list was used.
+    bool UpdateResidency(const float* eye);
+    // Switch instances to the level of detail for the eye, their descriptors are updated
+    // with the other copies of the frame.
+    void UpdateLods(const float* eye);
+    // Replace the meshes and instances of a visible scene with those of its reload at once.
+    void ApplyReload(LoadJob& job);
+    // Destroy the mesh entities of the scene and free its pool ranges, paged scenes stop
+    // paging.
+    void UnloadScene(Scene& scene);
+    // Pack the vertex and index pools and patch the offsets of all meshes.
+    void CompactPools();
+    // Watch the files of the scene, files no other scene needs anymore are unwatched.
+    void SetSceneFiles(Scene& scene, std::vector<std::string> files);
+    // Reload textures whose files changed and queue reloads of scenes whose files changed.
+    void PollFiles();
+
+    AssetLoadOptions                  options_;
     ComPtr<ID3D12GraphicsCommandList> upload_command_list_ = nullptr;
     GeometryStorage                   storage_;
+    // Loads in request order, they are uploaded one after another.
+    std::vector<std::unique_ptr<LoadJob>> jobs_;
+    std::unordered_map<uint32_t, Scene>   scenes_;
+    uint32_t                              next_geometry_ = 0;
+    // Frames since the pools were last compacted, up to the cooldown.
+    uint32_t compaction_frames_ = kCompactionCooldownFrames;
+    // Ranges waiting for frames in flight, in release order.
+    std::vector<RetiredRanges> retired_ranges_;
+
+    FileWatcher watcher_;
+    // Files of textures which have been resolved by name, the cooked one first.
+    std::unordered_map<std::string, std::vector<std::string>> texture_files_;
+    // Changed scenes, reloaded once no load of them is pending.
+    std::vector<uint32_t>                          pending_reloads_;
+    std::chrono::high_resolution_clock::time_point last_poll_;
+
+    // Loads run outside of the frame graph, so that they can span many frames. Declared
+    // after the jobs, so that it waits for their tasks before they are destroyed.
+    tf::Executor loader_;
 };
 }  // namespace capsaicin
@@ -2,6 +2,7 @@
 
 #include <DirectXMath.h>
 
+#include "src/asset/mesh_data.h"
 #include "src/systems/asset_load_system.h"
 #include "src/systems/render_system.h"
 
@@ -11,6 +12,11 @@ namespace capsaicin
 {
 namespace
 {
+uint64_t SharedBLASKey(uint32_t geometry, uint32_t lod)
+{
+    return (uint64_t(geometry) << 8) | lod;
+}
+
 void BuildBLAS(MeshComponent&             gpu_mesh,
                BLASComponent&             blas,
                ID3D12GraphicsCommandList* command_list,
@@ -29,16 +35,28 @@ void BuildBLAS(MeshComponent&             gpu_mesh,
     geometry_desc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
     geometry_desc.Triangles.VertexBuffer.StartAddress =
         geometry_storage.vertices->GetGPUVirtualAddress() +
-        gpu_mesh.first_vertex_offset * sizeof(XMFLOAT3);
-    geometry_desc.Triangles.VertexBuffer.StrideInBytes = 3 * sizeof(float);
+        UINT64(gpu_mesh.first_vertex_offset) * geometry_storage.vertex_stride;
+    geometry_desc.Triangles.VertexBuffer.StrideInBytes = geometry_storage.vertex_stride;
     geometry_desc.Triangles.VertexFormat               = DXGI_FORMAT_R32G32B32_FLOAT;
     geometry_desc.Triangles.VertexCount                = gpu_mesh.vertex_count;
-    geometry_desc.Triangles.IndexBuffer = geometry_storage.indices->GetGPUVirtualAddress() +
-                                          gpu_mesh.first_index_offset * sizeof(uint32_t);
+    geometry_desc.Triangles.IndexBuffer =
+        geometry_storage.indices->GetGPUVirtualAddress() +
+        UINT64(gpu_mesh.first_index_offset) * sizeof(uint32_t);
     geometry_desc.Triangles.IndexCount   = gpu_mesh.index_count;
-    geometry_desc.Triangles.IndexFormat  = DXGI_FORMAT_R32_UINT;
+    geometry_desc.Triangles.IndexFormat  = gpu_mesh.index_stride == sizeof(uint16_t)
+                                               ? DXGI_FORMAT_R16_UINT
+                                               : DXGI_FORMAT_R32_UINT;
     geometry_desc.Triangles.Transform3x4 = 0;
 
+    // Quantized positions are in [-1, 1] and scaled back to the mesh bounds by the transform.
+    if (geometry_storage.quantized_vertices)
+    {
+        geometry_desc.Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+        geometry_desc.Triangles.Transform3x4 =
+            geometry_storage.transforms->GetGPUVirtualAddress() +
+            gpu_mesh.index * AssetLoadSystem::kTransformSize;
+    }
+
     D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS build_input;
     build_input.Type        = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
     build_input.Flags       = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
@@ -66,6 +84,20 @@ void BuildBLAS(MeshComponent&             gpu_mesh,
     cmdlist4->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(blas.blas.Get()));
 }
 }  // namespace
+
+void BLASSystem::ReleaseGeometry(uint32_t geometry)
+{
+    for (uint32_t lod = 0; lod <= kMaxMeshLods; ++lod)
+    {
+        auto it = shared_blases_.find(SharedBLASKey(geometry, lod));
+        if (it != shared_blases_.end())
+        {
+            world().GetSystem<RenderSystem>().AddAutoreleaseResource(it->second);
+            shared_blases_.erase(it);
+        }
+    }
+}
+
 void BLASSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow)
 {
     auto& render_system = world().GetSystem<RenderSystem>();
@@ -97,16 +129,24 @@ void BLASSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf::Sub
     {
         build_command_list_->Reset(render_system.current_frame_command_allocator(), nullptr);
 
-        // Load asset.
+        uint32_t num_built = 0;
         for (auto e : entities)
         {
             auto& gpu_mesh = world().GetComponent<MeshComponent>(e);
             auto& blas     = world().AddComponent<BLASComponent>(e);
 
-            info("BLASSystem: Building BLAS");
-            BuildBLAS(gpu_mesh, blas, build_command_list_.Get(), render_system);
+            auto& shared_blas = shared_blases_[SharedBLASKey(gpu_mesh.geometry, gpu_mesh.lod)];
+            if (!shared_blas)
+            {
+                BuildBLAS(gpu_mesh, blas, build_command_list_.Get(), render_system);
+                shared_blas = blas.blas;
+                ++num_built;
+            }
+            blas.blas = shared_blas;
         }
 
+        info("BLASSystem: Built {} BLASes for {} meshes", num_built, entities.size());
+
         build_command_list_->Close();
         render_system.PushCommandList(build_command_list_);
     }
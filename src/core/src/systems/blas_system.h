@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "src/common.h"
 #include "src/dx12/d3dx12.h"
 #include "src/dx12/dx12.h"
@@ -19,7 +21,14 @@ class BLASSystem : public System
 public:
     void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override;
 
+    // Drop the shared BLASes of an unloaded geometry and its levels of detail, frames in
+    // flight may still trace them.
+    void ReleaseGeometry(uint32_t geometry);
+
 private:
     ComPtr<ID3D12GraphicsCommandList> build_command_list_ = nullptr;
+    // Instances of a mesh share its geometry and a single BLAS per level of detail, also when
+    // they are loaded in different frames. Keyed by geometry and level.
+    std::unordered_map<uint64_t, ComPtr<ID3D12Resource>> shared_blases_;
 };
 }  // namespace capsaicin
\ No newline at end of file
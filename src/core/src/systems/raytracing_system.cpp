@@ -59,6 +59,7 @@ enum
     kGBuffer,
     kOutputDirectLighting,
     kOutputNormalDepthAlbedo,
+    kPageFeedback,
     kNumEntries
 };
 }
@@ -177,6 +178,31 @@ auto GetCamera(ComponentAccess& access, EntityQuery& entity_query)
 
     return cameras.GetComponent(entities[0]);
 }
+
+// Shader defines selecting the vertex storage format of the geometry pools.
+std::vector<std::string> GetGeometryDefines()
+{
+    auto& geometry_storage = world().GetSystem<AssetLoadSystem>().geometry_storage();
+
+    std::vector<std::string> defines;
+    if (geometry_storage.quantized_vertices)
+    {
+        defines.push_back("QUANTIZED_VERTICES");
+    }
+    if (geometry_storage.interleaved_vertices)
+    {
+        defines.push_back("INTERLEAVED_VERTICES");
+    }
+    if (world().GetSystem<TextureSystem>().virtual_textures())
+    {
+        defines.push_back("VIRTUAL_TEXTURES");
+    }
+    if (world().GetSystem<TextureSystem>().streaming())
+    {
+        defines.push_back("TEXTURE_STREAMING");
+    }
+    return defines;
+}
 }  // namespace
 
 RaytracingSystem::RaytracingSystem(const RaytracingOptions& options) : options_(options)
@@ -242,6 +268,7 @@ void RaytracingSystem::Run(ComponentAccess& access, EntityQuery& entity_query, t
     scene_data.normal_buffer    = geometry_storage.normals.Get();
     scene_data.texcoord_buffer  = geometry_storage.texcoords.Get();
     scene_data.mesh_desc_buffer = geometry_storage.mesh_descs.Get();
+    scene_data.texcoord_stride  = geometry_storage.texcoord_stride;
 
     auto scene_data_descriptor_table       = PopulateSceneDataDescriptorTable(scene_data);
     auto scene_textures_descriptor_table   = PopulateSceneTexturesDescriptorTable();
@@ -258,6 +285,7 @@ void RaytracingSystem::Run(ComponentAccess& access, EntityQuery& entity_query, t
     auto output_indirect_descritor_table   = PopulateOutputIndirectDescriptorTable();
     auto output_normal_depth_albedo        = PopulateOutputNormalDepthAlbedo();
     auto prev_gbuffer_descriptor_table     = PopulatePrevGBufferDescriptorTable();
+    auto page_feedback_descriptor_table    = PopulatePageFeedbackDescriptorTable();
 
     // Save previous GBuffer.
     CopyGBuffer();
@@ -276,7 +304,8 @@ void RaytracingSystem::Run(ComponentAccess& access, EntityQuery& entity_query, t
                             internal_descriptor_table,
                             gbuffer_descriptor_table,
                             output_direct_descriptor_table,
-                            output_normal_depth_albedo);
+                            output_normal_depth_albedo,
+                            page_feedback_descriptor_table);
 
     // Do raytracing pass.
     CalculateIndirectLighting(tlas.tlas.Get(),
@@ -348,8 +377,10 @@ void RaytracingSystem::InitInidirectLightingPipeline()
         CD3DX12_DESCRIPTOR_RANGE blue_noise_texture_descriptor_range;
         blue_noise_texture_descriptor_range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
 
-        CD3DX12_DESCRIPTOR_RANGE textures_descriptor_range;
-        textures_descriptor_range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1024, 2);
+        // Scene textures are followed by the page atlas, page table and virtual textures.
+        CD3DX12_DESCRIPTOR_RANGE textures_descriptor_ranges[2];
+        textures_descriptor_ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1024, 2);
+        textures_descriptor_ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 1);
 
         CD3DX12_ROOT_PARAMETER
         root_entries[IndirectLightingRootSignature::kNumEntries] = {};
@@ -362,7 +393,7 @@ void RaytracingSystem::InitInidirectLightingPipeline()
         root_entries[IndirectLightingRootSignature::kBlueNoiseTexture].InitAsDescriptorTable(
             1, &blue_noise_texture_descriptor_range);
         root_entries[IndirectLightingRootSignature::kTextures].InitAsDescriptorTable(
-            1, &textures_descriptor_range);
+            2, textures_descriptor_ranges);
         root_entries[IndirectLightingRootSignature::kSceneData].InitAsDescriptorTable(
             1, &scene_data_descriptor_range);
         root_entries[IndirectLightingRootSignature::kGBuffer].InitAsDescriptorTable(
@@ -381,7 +412,7 @@ void RaytracingSystem::InitInidirectLightingPipeline()
         rt_indirect_root_signature_ = dx12api().CreateRootSignature(desc);
     }
 
-    std::vector<std::string> defines;
+    auto defines = GetGeometryDefines();
     if (options_.lowres_indirect)
     {
         defines.push_back("LOWRES_INDIRECT");
@@ -865,12 +896,16 @@ void RaytracingSystem::InitDirectLightingPipeline()
         output_direct_range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 6);
         CD3DX12_DESCRIPTOR_RANGE output_normal_depth_albedo;
         output_normal_depth_albedo.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 7);
+        CD3DX12_DESCRIPTOR_RANGE page_feedback_range;
+        page_feedback_range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 1);
 
         CD3DX12_DESCRIPTOR_RANGE scene_data_descriptor_range;
         scene_data_descriptor_range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 5, 0);
 
-        CD3DX12_DESCRIPTOR_RANGE textures_descriptor_range;
-        textures_descriptor_range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1024, 2);
+        // Scene textures are followed by the page atlas, page table and virtual textures.
+        CD3DX12_DESCRIPTOR_RANGE textures_descriptor_ranges[2];
+        textures_descriptor_ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1024, 2);
+        textures_descriptor_ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 1);
 
         CD3DX12_ROOT_PARAMETER
         root_entries[DirectLightingRootSignature::kNumEntries] = {};
@@ -881,7 +916,7 @@ void RaytracingSystem::InitDirectLightingPipeline()
         root_entries[DirectLightingRootSignature::kBlueNoiseTexture].InitAsDescriptorTable(
             1, &blue_noise_texture_descriptor_range);
         root_entries[DirectLightingRootSignature::kTextures].InitAsDescriptorTable(
-            1, &textures_descriptor_range);
+            2, textures_descriptor_ranges);
         root_entries[DirectLightingRootSignature::kSceneData].InitAsDescriptorTable(
             1, &scene_data_descriptor_range);
         root_entries[DirectLightingRootSignature::kGBuffer].InitAsDescriptorTable(
@@ -890,6 +925,8 @@ void RaytracingSystem::InitDirectLightingPipeline()
             1, &output_direct_range);
         root_entries[DirectLightingRootSignature::kOutputNormalDepthAlbedo].InitAsDescriptorTable(
             1, &output_normal_depth_albedo);
+        root_entries[DirectLightingRootSignature::kPageFeedback].InitAsDescriptorTable(
+            1, &page_feedback_range);
 
         CD3DX12_STATIC_SAMPLER_DESC sampler_desc(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR);
 
@@ -899,8 +936,10 @@ void RaytracingSystem::InitDirectLightingPipeline()
         rt_direct_root_signature_ = dx12api().CreateRootSignature(desc);
     }
 
+    auto defines = GetGeometryDefines();
+
     auto shader = ShaderCompiler::instance().CompileFromFile(
-        "../../../src/core/shaders/rt_direct_lighting.hlsl", "lib_6_3", "");
+        "../../../src/core/shaders/rt_direct_lighting.hlsl", "lib_6_3", "", defines);
 
     CD3DX12_STATE_OBJECT_DESC pipeline{D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE};
 
@@ -1090,7 +1129,8 @@ void RaytracingSystem::CalculateDirectLighting(ID3D12Resource* scene,
                                                uint32_t        internal_descriptor_table,
                                                uint32_t        gbuffer_descriptor_table,
                                                uint32_t        output_direct_descriptor_table,
-                                               uint32_t        output_normal_depth_descriptor_table)
+                                               uint32_t        output_normal_depth_descriptor_table,
+                                               uint32_t        page_feedback_descriptor_table)
 {
     auto& render_system        = world().GetSystem<RenderSystem>();
     auto  window_width         = render_system.window_width();
@@ -1140,6 +1180,9 @@ void RaytracingSystem::CalculateDirectLighting(ID3D12Resource* scene,
     cmdlist4->SetComputeRootDescriptorTable(
         DirectLightingRootSignature::kOutputNormalDepthAlbedo,
         render_system.GetDescriptorHandleGPU(output_normal_depth_descriptor_table));
+    cmdlist4->SetComputeRootDescriptorTable(
+        DirectLightingRootSignature::kPageFeedback,
+        render_system.GetDescriptorHandleGPU(page_feedback_descriptor_table));
 
     auto shader_record_size =
         align(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
@@ -1638,8 +1681,10 @@ uint32_t RaytracingSystem::PopulateSceneDataDescriptorTable(GPUSceneData& scene_
         &uav_desc,
         render_system.GetDescriptorHandleCPU(base_index + 2));
 
-    uav_desc.Buffer.NumElements = scene_data.texcoord_buffer->GetDesc().Width / sizeof(XMFLOAT2);
-    uav_desc.Buffer.StructureByteStride = sizeof(XMFLOAT2);
+    // Vertex and normal elements are 4 bytes for both float and quantized vertices.
+    uav_desc.Buffer.NumElements =
+        scene_data.texcoord_buffer->GetDesc().Width / scene_data.texcoord_stride;
+    uav_desc.Buffer.StructureByteStride = scene_data.texcoord_stride;
     dx12api().device()->CreateUnorderedAccessView(
         scene_data.texcoord_buffer,
         nullptr,
@@ -1899,26 +1944,85 @@ uint32_t RaytracingSystem::PopulateSceneTexturesDescriptorTable()
 {
     auto& render_system  = world().GetSystem<RenderSystem>();
     auto& texture_system = world().GetSystem<TextureSystem>();
-    auto  base_index     = render_system.AllocateDescriptorRange(1024);
+    auto  base_index     = render_system.AllocateDescriptorRange(1024 + 3);
 
     auto num_textures = texture_system.num_textures();
 
     for (auto i = 0; i < 1024; ++i)
     {
+        // Textures may be block compressed, so views take their format.
+        auto texture = i < num_textures ? texture_system.texture(i) : nullptr;
+        auto format  = texture ? texture->GetDesc().Format : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+        // Views cover the whole mip chain, shaders pick the level by ray cone footprint.
         D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
         srv_desc.ViewDimension                 = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srv_desc.Format                        = DXGI_FORMAT_R8G8B8A8_UNORM;
-        srv_desc.Texture2D.MipLevels           = 1;
+        srv_desc.Format                        = format;
+        srv_desc.Texture2D.MipLevels           = texture ? texture->GetDesc().MipLevels : 1;
         srv_desc.Texture2D.MostDetailedMip     = 0;
         srv_desc.Texture2D.PlaneSlice          = 0;
         srv_desc.Texture2D.ResourceMinLODClamp = 0;
         srv_desc.Shader4ComponentMapping       = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        auto texture = i < num_textures ? texture_system.texture(i) : nullptr;
 
         dx12api().device()->CreateShaderResourceView(
             texture, &srv_desc, render_system.GetDescriptorHandleCPU(base_index + i));
     }
 
+    // Virtual texture views are null without virtual textures.
+    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
+    srv_desc.ViewDimension                 = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srv_desc.Format                        = DXGI_FORMAT_R8G8B8A8_UNORM;
+    srv_desc.Texture2D.MipLevels           = 1;
+    srv_desc.Texture2D.MostDetailedMip     = 0;
+    srv_desc.Texture2D.PlaneSlice          = 0;
+    srv_desc.Texture2D.ResourceMinLODClamp = 0;
+    srv_desc.Shader4ComponentMapping       = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    dx12api().device()->CreateShaderResourceView(
+        texture_system.page_atlas(),
+        &srv_desc,
+        render_system.GetDescriptorHandleCPU(base_index + 1024));
+
+    auto page_table   = texture_system.page_table();
+    auto page_entries = page_table ? page_table->GetDesc().Width / sizeof(uint32_t) : 1;
+
+    srv_desc.ViewDimension              = D3D12_SRV_DIMENSION_BUFFER;
+    srv_desc.Format                     = DXGI_FORMAT_UNKNOWN;
+    srv_desc.Buffer.FirstElement        = 0;
+    srv_desc.Buffer.Flags               = D3D12_BUFFER_SRV_FLAG_NONE;
+    srv_desc.Buffer.NumElements         = static_cast<UINT>(page_entries);
+    srv_desc.Buffer.StructureByteStride = sizeof(uint32_t);
+    dx12api().device()->CreateShaderResourceView(
+        page_table, &srv_desc, render_system.GetDescriptorHandleCPU(base_index + 1025));
+
+    srv_desc.Buffer.NumElements         = kMaxVirtualTextures;
+    srv_desc.Buffer.StructureByteStride = sizeof(VirtualTextureDesc);
+    dx12api().device()->CreateShaderResourceView(
+        texture_system.virtual_texture_descs(),
+        &srv_desc,
+        render_system.GetDescriptorHandleCPU(base_index + 1026));
+
+    return base_index;
+}
+
+uint32_t RaytracingSystem::PopulatePageFeedbackDescriptorTable()
+{
+    auto& render_system  = world().GetSystem<RenderSystem>();
+    auto& texture_system = world().GetSystem<TextureSystem>();
+    auto  base_index     = render_system.AllocateDescriptorRange(1);
+    auto  page_feedback  = texture_system.page_feedback();
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+    uav_desc.ViewDimension               = D3D12_UAV_DIMENSION_BUFFER;
+    uav_desc.Format                      = DXGI_FORMAT_R32_UINT;
+    uav_desc.Buffer.CounterOffsetInBytes = 0;
+    uav_desc.Buffer.FirstElement         = 0;
+    uav_desc.Buffer.Flags                = D3D12_BUFFER_UAV_FLAG_NONE;
+    uav_desc.Buffer.StructureByteStride  = 0;
+    uav_desc.Buffer.NumElements =
+        page_feedback ? page_feedback->GetDesc().Width / sizeof(uint32_t) : 1;
+    dx12api().device()->CreateUnorderedAccessView(
+        page_feedback, nullptr, &uav_desc, render_system.GetDescriptorHandleCPU(base_index));
+
     return base_index;
 }
 
@@ -17,6 +17,7 @@ struct GPUSceneData
     ID3D12Resource* normal_buffer;
     ID3D12Resource* texcoord_buffer;
     ID3D12Resource* mesh_desc_buffer;
+    uint32_t        texcoord_stride;
 };
 
 struct RaytracingOptions
@@ -65,7 +66,8 @@ private:
                                  uint32_t        internal_descriptor_table,
                                  uint32_t        gbuffer_descriptor_table,
                                  uint32_t        output_direct_descriptor_table,
-                                 uint32_t        output_normal_depth_albedo);
+                                 uint32_t        output_normal_depth_albedo,
+                                 uint32_t        page_feedback_descriptor_table);
 
     void CalculateIndirectLighting(ID3D12Resource*          scene,
                                    ID3D12Resource*          camera,
@@ -117,6 +119,7 @@ private:
     uint32_t PopulateOutputDirectDescriptorTable();
     uint32_t PopulateOutputNormalDepthAlbedo();
     uint32_t PopulatePrevGBufferDescriptorTable();
+    uint32_t PopulatePageFeedbackDescriptorTable();
 
     ComPtr<ID3D12GraphicsCommandList> upload_command_list_       = nullptr;
     ComPtr<ID3D12GraphicsCommandList> rt_indirect_command_list_  = nullptr;
@@ -44,6 +44,11 @@ RenderSystem::RenderSystem(HWND hwnd) : hwnd_(hwnd)
     // Create resolve command list.
     query_resolve_command_list_ = dx12api().CreateCommandList(current_frame_command_allocator());
     query_resolve_command_list_->Close();
+
+    // Create staging ring and the command list copying from it.
+    staging_ring_      = std::make_unique<StagingRing>(kStagingRingSize);
+    copy_command_list_ = dx12api().CreateCommandList(current_frame_command_allocator());
+    copy_command_list_->Close();
 }
 
 RenderSystem::~RenderSystem()
@@ -72,17 +77,24 @@ void RenderSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf::S
     ThrowIfFailed(
         dx12api().command_queue()->Signal(frame_submission_fence_.Get(), next_submission_id_++),
         "Cannot signal fence");
+    staging_ring_->Submit(current_gpu_frame_data().submission_id);
 
     // Move to next gpu frame.
     current_gpu_frame_index_ = swapchain_->GetCurrentBackBufferIndex();
 
     // Make sure previous submission for this gpu frame index are finished.
     WaitForGPUFrame(current_gpu_frame_index());
+    staging_ring_->Retire(frame_submission_fence_->GetCompletedValue());
 
     // Advance frame counter.
     ++frame_count_;
 }
 
+UINT64 RenderSystem::completed_submission_id() const
+{
+    return frame_submission_fence_->GetCompletedValue();
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE
 RenderSystem::current_frame_output_descriptor_handle()
 {
@@ -182,7 +194,16 @@ void RenderSystem::ExecuteCommandLists(uint32_t index)
                    command_lists.begin(),
                    [](ComPtr<ID3D12CommandList> cmd_list) { return cmd_list.Get(); });
 
-    dx12api().command_queue()->ExecuteCommandLists(num_command_lists, command_lists.data());
+    // Staged copies go first, so that resources are ready for all other command lists.
+    if (copy_command_list_open_)
+    {
+        copy_command_list_->Close();
+        copy_command_list_open_ = false;
+        command_lists.insert(command_lists.begin(), copy_command_list_.Get());
+    }
+
+    dx12api().command_queue()->ExecuteCommandLists(static_cast<UINT>(command_lists.size()),
+                                                   command_lists.data());
     gpu_frame_data_[index].num_command_lists = 0;
 }
 
@@ -235,6 +256,22 @@ void RenderSystem::AddAutoreleaseResource(ComPtr<ID3D12Resource> resource)
     current_gpu_frame_data().autorelease_pool.push_back(resource);
 }
 
+StagingRing::Allocation RenderSystem::AllocateStaging(UINT64 size, UINT64 alignment)
+{
+    return staging_ring_->Allocate(size, alignment);
+}
+
+ID3D12GraphicsCommandList* RenderSystem::copy_command_list()
+{
+    if (!copy_command_list_open_)
+    {
+        copy_command_list_->Reset(current_frame_command_allocator(), nullptr);
+        copy_command_list_open_ = true;
+    }
+
+    return copy_command_list_.Get();
+}
+
 uint32_t RenderSystem::AllocateDescriptorRange(uint32_t num_descriptors)
 {
     auto idx = current_gpu_frame_data().num_descriptors.fetch_add(num_descriptors);
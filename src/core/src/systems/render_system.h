@@ -4,6 +4,7 @@
 #include "src/dx12/d3dx12.h"
 #include "src/dx12/dx12.h"
 #include "src/dx12/shader_compiler.h"
+#include "src/dx12/staging_ring.h"
 
 using namespace capsaicin::dx12;
 
@@ -22,6 +23,13 @@ public:
     // Add resource to the autorealease pool, it will be freed
     // when all command buffers are finished execution for the current GPU frame.
     void AddAutoreleaseResource(ComPtr<ID3D12Resource> resource);
+    // Allocate staging memory for copies recorded this frame, it is reused once the frame
+    // finished execution.
+    StagingRing::Allocation AllocateStaging(UINT64 size,
+                                            UINT64 alignment = StagingRing::kAlignment);
+    // Command list for copies from staging memory shared by all uploads of the frame, it is
+    // executed before the command lists pushed this frame.
+    ID3D12GraphicsCommandList* copy_command_list();
     // Allocate a descriptor range from the current frame's descriptor heap.
     uint32_t AllocateDescriptorRange(uint32_t num_descriptors);
     // Get CPU or GPU descriptor handle in the current descriptor heap.
@@ -40,6 +48,10 @@ public:
     uint32_t window_height() const { return window_height_; }
     uint32_t current_gpu_frame_index() const { return current_gpu_frame_index_; }
     uint32_t frame_count() const { return frame_count_; }
+    // Fence value the GPU signals once the frame being recorded finished execution, and the
+    // last one it signaled.
+    UINT64 submission_id() const { return next_submission_id_; }
+    UINT64 completed_submission_id() const;
 
     ID3D12CommandAllocator*     current_frame_command_allocator();
     ID3D12DescriptorHeap*       current_frame_descriptor_heap();
@@ -54,6 +66,7 @@ private:
     static constexpr uint32_t kConstantBufferAlignment   = 256;
     static constexpr uint32_t kMaxCommandBuffersPerFrame = 4096;
     static constexpr uint32_t kMaxUAVDescriptorsPerFrame = 4096;
+    static constexpr uint32_t kStagingRingSize           = 128 << 20;
 
     // Initialize rendering into main window.
     void InitWindow();
@@ -106,6 +119,10 @@ private:
 
     // Command list to resolve query heap.
     ComPtr<ID3D12GraphicsCommandList> query_resolve_command_list_ = nullptr;
+    // Staging memory and copies from it.
+    std::unique_ptr<StagingRing>      staging_ring_           = nullptr;
+    ComPtr<ID3D12GraphicsCommandList> copy_command_list_      = nullptr;
+    bool                              copy_command_list_open_ = false;
     // Last timestamp query data.
     std::vector<std::pair<std::string, float>> gpu_timings_;
 
@@ -1,12 +1,325 @@
 #include "texture_system.h"
 
-#include "src/systems/render_system.h"
+#include <cmath>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "src/utils/stb_image.h"
+#include "src/asset/image.h"
+#include "src/systems/render_system.h"
 
 namespace capsaicin
 {
+namespace
+{
+DXGI_FORMAT GetDxgiFormat(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::kBC1:
+        return DXGI_FORMAT_BC1_UNORM;
+    case TextureFormat::kBC7:
+        return DXGI_FORMAT_BC7_UNORM;
+    default:
+        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+// Copies pages of the decoded images with their border into the slots of the atlas, with the
+// copy command list of the frame. Textures wrap, and so do the borders.
+class AtlasUploader : public PageCache
+{
+public:
+    AtlasUploader(ID3D12Resource* atlas, const std::vector<ImageData>& images)
+        : atlas_(atlas), images_(images)
+    {
+    }
+
+    void UploadPage(uint32_t page, uint32_t slot) override
+    {
+        auto& render_system = world().GetSystem<RenderSystem>();
+        auto  command_list  = render_system.copy_command_list();
+
+        if (upload_count_++ == 0)
+        {
+            D3D12_RESOURCE_BARRIER transitions[] = {CD3DX12_RESOURCE_BARRIER::Transition(
+                atlas_,
+                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                D3D12_RESOURCE_STATE_COPY_DEST)};
+            command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+        }
+
+        auto& image  = images_[PageTexture(page)];
+        auto  mip    = PageMip(page);
+        auto  width  = static_cast<int32_t>(MipDimension(image.width, mip));
+        auto  height = static_cast<int32_t>(MipDimension(image.height, mip));
+        auto* texels = image.mips[mip].data();
+
+        auto row_pitch = kPageSlotSize * sizeof(uint32_t);
+        auto staging   = render_system.AllocateStaging(row_pitch * kPageSlotSize,
+                                                     D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        auto x0 = static_cast<int32_t>(PageX(page) * kPageTexels - kPageBorder);
+        auto y0 = static_cast<int32_t>(PageY(page) * kPageTexels - kPageBorder);
+        for (int32_t y = 0; y < static_cast<int32_t>(kPageSlotSize); ++y)
+        {
+            auto  sy  = ((y0 + y) % height + height) % height;
+            auto* dst = staging.data + y * row_pitch;
+            for (int32_t x = 0; x < static_cast<int32_t>(kPageSlotSize); ++x)
+            {
+                auto sx = ((x0 + x) % width + width) % width;
+                std::memcpy(dst + x * 4, texels + (std::size_t(sy) * width + sx) * 4, 4);
+            }
+        }
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+        footprint.Offset             = staging.offset;
+        footprint.Footprint.Format   = DXGI_FORMAT_R8G8B8A8_UNORM;
+        footprint.Footprint.Width    = kPageSlotSize;
+        footprint.Footprint.Height   = kPageSlotSize;
+        footprint.Footprint.Depth    = 1;
+        footprint.Footprint.RowPitch = static_cast<UINT>(row_pitch);
+
+        D3D12_TEXTURE_COPY_LOCATION src_texture_loc;
+        src_texture_loc.Type            = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src_texture_loc.PlacedFootprint = footprint;
+        src_texture_loc.pResource       = staging.resource;
+
+        D3D12_TEXTURE_COPY_LOCATION dst_texture_loc;
+        dst_texture_loc.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst_texture_loc.pResource        = atlas_;
+        dst_texture_loc.SubresourceIndex = 0;
+
+        auto slots_per_row = static_cast<uint32_t>(atlas_->GetDesc().Width) / kPageSlotSize;
+        command_list->CopyTextureRegion(&dst_texture_loc,
+                                        (slot % slots_per_row) * kPageSlotSize,
+                                        (slot / slots_per_row) * kPageSlotSize,
+                                        0,
+                                        &src_texture_loc,
+                                        nullptr);
+    }
+
+    // Return the atlas to shaders if pages were uploaded.
+    void Finish()
+    {
+        if (upload_count_ == 0)
+        {
+            return;
+        }
+
+        D3D12_RESOURCE_BARRIER transitions[] = {
+            CD3DX12_RESOURCE_BARRIER::Transition(atlas_,
+                                                 D3D12_RESOURCE_STATE_COPY_DEST,
+                                                 D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)};
+        world().GetSystem<RenderSystem>().copy_command_list()->ResourceBarrier(
+            ARRAYSIZE(transitions), transitions);
+        upload_count_ = 0;
+    }
+
+private:
+    ID3D12Resource*               atlas_;
+    const std::vector<ImageData>& images_;
+    uint32_t                      upload_count_ = 0;
+};
+
+// Copy a range of elements to a buffer shaders read.
+void UploadBufferRange(ID3D12Resource* buffer, const void* data, UINT64 offset, UINT64 size)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = render_system.copy_command_list();
+    auto  staging       = render_system.AllocateStaging(size);
+    std::memcpy(staging.data, data, size);
+
+    D3D12_RESOURCE_BARRIER transitions[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(buffer,
+                                             D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                             D3D12_RESOURCE_STATE_COPY_DEST)};
+    command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+    command_list->CopyBufferRegion(buffer, offset, staging.resource, staging.offset, size);
+    std::swap(transitions[0].Transition.StateBefore, transitions[0].Transition.StateAfter);
+    command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+}
+
+ComPtr<ID3D12Resource> CreateShaderBuffer(UINT64 size)
+{
+    return dx12api().CreateResource(CD3DX12_RESOURCE_DESC::Buffer(size),
+                                    CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+                                    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+}
+
+// Copy a mip to a level of a texture in the copy dest state.
+void UploadMip(ID3D12Resource* texture, UINT level, const std::vector<uint8_t>& mip)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  texture_desc  = texture->GetDesc();
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    UINT                               row_count   = 0;
+    UINT64                             row_size    = 0;
+    UINT64                             upload_size = 0;
+    dx12api().device()->GetCopyableFootprints(
+        &texture_desc, level, 1, 0, &footprint, &row_count, &row_size, &upload_size);
+
+    auto  staging  = render_system.AllocateStaging(upload_size,
+                                                 D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    auto* data_ptr = mip.data();
+    auto* dst_ptr  = staging.data;
+    for (uint32_t row = 0; row < row_count; ++row)
+    {
+        memcpy(dst_ptr, data_ptr, row_size);
+        data_ptr += row_size;
+        dst_ptr += footprint.Footprint.RowPitch;
+    }
+
+    footprint.Offset = staging.offset;
+    CD3DX12_TEXTURE_COPY_LOCATION src_texture_loc(staging.resource, footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION dst_texture_loc(texture, level);
+    render_system.copy_command_list()->CopyTextureRegion(
+        &dst_texture_loc, 0, 0, 0, &src_texture_loc, nullptr);
+}
+}  // namespace
+
+// Reads mips of cooked textures with the decoder and copies those of source images, which
+// are in memory. Changes of the first mip are recorded and applied once per frame, so that
+// a texture is rebuilt once.
+class TextureSystem::MipStreamer : public TextureStreamingBackend
+{
+public:
+    explicit MipStreamer(TextureSystem& system) : system_(system) {}
+
+    void ReadMip(uint32_t texture, uint32_t mip) override;
+    void SetFirstMip(uint32_t texture, uint32_t first_mip) override;
+
+private:
+    TextureSystem& system_;
+};
+
+void TextureSystem::MipStreamer::ReadMip(uint32_t texture, uint32_t mip)
+{
+    auto& streamed = system_.streamed_[texture];
+    auto  read     = std::make_unique<MipRead>();
+    read->texture  = texture;
+    read->mip      = mip;
+    read->version  = streamed.version;
+
+    if (streamed.file.empty())
+    {
+        read->data = streamed.image.mips[mip];
+        read->read = true;
+
+        std::promise<void> done;
+        done.set_value();
+        read->done = done.get_future();
+    }
+    else
+    {
+        // The file may have been cooked again since, with a different size.
+        ImageData expected;
+        expected.width  = streamed.width;
+        expected.height = streamed.height;
+        expected.format = streamed.format;
+        read->taskflow.emplace([read = read.get(),
+                                expected,
+                                mip_count = streamed.mip_count,
+                                file      = streamed.file]() {
+            ImageData image;
+            read->read = LoadCookedTextureMips(file, {}, read->mip, read->mip, image) &&
+                         image.width == expected.width && image.height == expected.height &&
+                         image.format == expected.format && image.mips.size() == mip_count;
+            if (read->read)
+            {
+                read->data = std::move(image.mips[read->mip]);
+            }
+        });
+        read->done = system_.decoder_.run(read->taskflow);
+    }
+
+    system_.mip_reads_.push_back(std::move(read));
+}
+
+void TextureSystem::MipStreamer::SetFirstMip(uint32_t texture, uint32_t first_mip)
+{
+    auto& streamed      = system_.streamed_[texture];
+    streamed.target_mip = first_mip;
+    if (!streamed.dirty)
+    {
+        streamed.dirty = true;
+        system_.streamed_dirty_.push_back(texture);
+    }
+}
+
+TextureSystem::TextureSystem(const TextureOptions& options) : options_(options)
+{
+}
+
+void TextureSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow)
+{
+    // Requests of the frame are decoded by the worker threads, each on its own.
+    if (!requests_.empty())
+    {
+        auto batch      = std::make_unique<DecodeBatch>();
+        batch->requests = std::move(requests_);
+        requests_.clear();
+
+        // Pages are copied from RGBA8 texels.
+        auto decompress = options_.virtual_textures;
+        auto tail_size  = streaming() ? options_.streaming_tail_size : 0;
+        for (auto& request : batch->requests)
+        {
+            batch->taskflow.emplace([&request, decompress, tail_size]() {
+                if (tail_size > 0)
+                {
+                    DecodeTextureTail(request, tail_size);
+                    return;
+                }
+
+                DecodeTexture(request.name, request.from_source, true, request.image);
+                if (decompress && !DecompressImage(request.image))
+                {
+                    warn("TextureSystem: texture {} is corrupt", request.name);
+                    request.image.width  = 1;
+                    request.image.height = 1;
+                    request.image.format = TextureFormat::kRGBA8;
+                    request.image.mips   = {std::vector<uint8_t>(4, 0)};
+                }
+            });
+        }
+
+        batch->decoded = decoder_.run(batch->taskflow);
+        batches_.push_back(std::move(batch));
+    }
+
+    if (streaming())
+    {
+        if (!residency_)
+        {
+            residency_ =
+                std::make_unique<TextureResidency>(options_.streaming_budget, kMaxMipReads);
+            InitPageFeedback();
+        }
+
+        MipStreamer streamer(*this);
+        UploadDecodedTextures(nullptr);
+        UpdateStreaming(streamer);
+        UpdateStreamedTextures();
+        return;
+    }
+
+    if (!options_.virtual_textures)
+    {
+        UploadDecodedTextures(nullptr);
+        return;
+    }
+
+    if (!pages_)
+    {
+        InitVirtualTextures();
+    }
+
+    AtlasUploader uploader(page_atlas_.Get(), virtual_images_);
+    UploadDecodedTextures(&uploader);
+    UpdatePages(uploader);
+    uploader.Finish();
+    UploadPageTable();
+}
+
 ComPtr<ID3D12Resource> TextureSystem::GetTexture(const std::string& name)
 {
     auto it = cache_.find(name);
@@ -24,96 +337,536 @@ ComPtr<ID3D12Resource> TextureSystem::GetTexture(uint32_t index)
 }
 
 uint32_t TextureSystem::GetTextureIndex(const std::string& name)
+{
+    auto it = cache_.find(name);
+    if (it != cache_.cend())
+    {
+        return it->second;
+    }
+
+    // The index is reserved, so that materials can refer to it before the texture is decoded.
+    auto index   = static_cast<uint32_t>(textures_.size());
+    cache_[name] = index;
+    textures_.push_back(nullptr);
+
+    Request request;
+    request.name  = name;
+    request.index = index;
+    requests_.push_back(std::move(request));
+
+    return index;
+}
+
+void TextureSystem::ReloadTexture(const std::string& name, bool from_source)
 {
     auto it = cache_.find(name);
     if (it == cache_.cend())
     {
-        auto index = LoadTexture(name);
-        return index;
+        return;
     }
 
-    return it->second;
+    // The current texture stays until the new one is decoded.
+    Request request;
+    request.name        = name;
+    request.index       = it->second;
+    request.from_source = from_source;
+    requests_.push_back(std::move(request));
 }
 
-uint32_t TextureSystem::LoadTexture(const std::string& name)
+std::vector<std::string> TextureSystem::GetTextureFiles(const std::string& name)
 {
+    auto full_name = std::string("../../../assets/textures/") + name;
+    return {CookedTextureFileName(full_name), full_name};
+}
+
+void TextureSystem::UploadDecodedTextures(PageCache* page_cache)
+{
+    // Decoded textures are copied by the copy command list shared by all uploads of the frame.
     auto& render_system = world().GetSystem<RenderSystem>();
-    auto  full_name     = std::string("../../../assets/textures/") + name;
+    auto  upload_bytes  = uint64_t(0);
+    while (!batches_.empty() && upload_bytes < kUploadBytesPerFrame)
+    {
+        auto& batch = *batches_.front();
+        if (batch.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            break;
+        }
+
+        for (; batch.next_upload < batch.requests.size() && upload_bytes < kUploadBytesPerFrame;
+             ++batch.next_upload)
+        {
+            auto& request = batch.requests[batch.next_upload];
+
+            // Virtual textures upload their last mip and keep the image for their other pages.
+            if (page_cache)
+            {
+                upload_bytes += kPageSlotSize * kPageSlotSize * 4;
+                if (virtual_images_.size() <= request.index)
+                {
+                    virtual_images_.resize(request.index + 1);
+                }
+
+                auto& image = virtual_images_[request.index];
+                image       = std::move(request.image);
+                if (!pages_->SetTexture(request.index, image.width, image.height, *page_cache))
+                {
+                    warn("TextureSystem: {} can't be paged", request.name);
+                }
+            }
+            else if (residency_)
+            {
+                for (auto mip = request.tail_mip; mip < request.image.mips.size(); ++mip)
+                {
+                    upload_bytes += request.image.mips[mip].size();
+                }
+
+                SetStreamedTexture(request);
+            }
+            else
+            {
+                for (auto& mip : request.image.mips)
+                {
+                    upload_bytes += mip.size();
+                }
+
+                // Frames in flight may still sample the previous texture of a reload.
+                auto& texture = textures_[request.index];
+                if (texture)
+                {
+                    render_system.AddAutoreleaseResource(texture);
+                }
+                texture = UploadTexture(request.image);
+            }
+
+            if (request.from_source)
+            {
+                info("TextureSystem: {} reloaded", request.name);
+            }
+
+            // Free the decoded image, the batch may wait for other frames to upload the rest.
+            request.image = ImageData();
+        }
+
+        if (batch.next_upload == batch.requests.size())
+        {
+            batches_.pop_front();
+        }
+    }
+}
+
+void TextureSystem::SetStreamedTexture(Request& request)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto& image         = request.image;
+
+    std::vector<uint64_t> mip_sizes;
+    for (uint32_t level = 0; level < image.mips.size(); ++level)
+    {
+        mip_sizes.push_back(MipSize(image.format, image.width, image.height, level));
+    }
+
+    if (streamed_.size() <= request.index)
+    {
+        streamed_.resize(request.index + 1);
+    }
+
+    // A reload starts over from the tail, reads of the previous texture are dropped.
+    auto& streamed      = streamed_[request.index];
+    streamed.file       = request.file;
+    streamed.width      = image.width;
+    streamed.height     = image.height;
+    streamed.mip_count  = static_cast<uint32_t>(image.mips.size());
+    streamed.format     = image.format;
+    streamed.first_mip  = request.tail_mip;
+    streamed.target_mip = request.tail_mip;
+    streamed.read_mip.clear();
+    ++streamed.version;
+
+    auto& texture = textures_[request.index];
+    if (texture)
+    {
+        render_system.AddAutoreleaseResource(texture);
+    }
+    texture = UploadTexture(image, request.tail_mip);
+
+    // Finer mips of source images are streamed from memory.
+    streamed.image = ImageData();
+    if (streamed.file.empty())
+    {
+        image.mips.resize(request.tail_mip);
+        streamed.image = std::move(image);
+    }
+
+    residency_->SetTexture(request.index, mip_sizes, request.tail_mip);
+}
+
+uint32_t TextureSystem::LoadTexture(const std::string& name)
+{
+    // Textures the renderer reads directly keep their exact texels.
+    ImageData image;
+    DecodeTexture(name, false, false, image);
+
+    textures_.push_back(UploadTexture(image));
+    cache_[name] = textures_.size() - 1;
 
-    int   res_x, res_y;
-    int   channels;
-    auto* data = stbi_load(full_name.c_str(), &res_x, &res_y, &channels, 4);
+    return textures_.size() - 1;
+}
 
-    uint32_t null_data = 0x00000000;
-    auto*    data_ptr  = data;
+void TextureSystem::DecodeTexture(const std::string& name,
+                                  bool               from_source,
+                                  bool               compressed,
+                                  ImageData&         image)
+{
+    auto files = GetTextureFiles(name);
 
-    if (data_ptr == nullptr)
+    // Prefer the cooked mip chain unless the source changed since it was cooked, decode the
+    // source image and build its mips otherwise.
+    if (!from_source && LoadCookedTexture(files[0], files[1], image) &&
+        (compressed || image.format == TextureFormat::kRGBA8))
     {
-        warn("TextureSystem: texture {} missing", full_name);
-        data_ptr = (stbi_uc*)&null_data;
-        res_x    = 1;
-        res_y    = 1;
-    };
+        return;
+    }
+
+    if (LoadImageFile(files[1], image))
+    {
+        GenerateMips(image);
+        return;
+    }
+
+    warn("TextureSystem: texture {} missing", files[1]);
+    image.width  = 1;
+    image.height = 1;
+    image.format = TextureFormat::kRGBA8;
+    image.mips   = {std::vector<uint8_t>(4, 0)};
+}
+
+void TextureSystem::DecodeTextureTail(Request& request, uint32_t tail_size)
+{
+    auto  files = GetTextureFiles(request.name);
+    auto& image = request.image;
+
+    // The size of the cooked texture is read first to find its tail, checking its source.
+    if (!request.from_source && LoadCookedTextureMips(files[0], files[1], ~0u, 0, image))
+    {
+        request.tail_mip = GetTailMip(image, tail_size);
+        if (LoadCookedTextureMips(files[0], {}, request.tail_mip, ~0u, image))
+        {
+            request.file = files[0];
+            return;
+        }
+    }
+
+    DecodeTexture(request.name, true, true, image);
+    request.tail_mip = GetTailMip(image, tail_size);
+}
+
+ComPtr<ID3D12Resource> TextureSystem::UploadTexture(const ImageData& image, uint32_t first_mip)
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  mip_count     = static_cast<UINT16>(image.mips.size() - first_mip);
 
     // Create texture in default heap.
     CD3DX12_RESOURCE_DESC texture_desc =
-        CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UINT, res_x, res_y);
+        CD3DX12_RESOURCE_DESC::Tex2D(GetDxgiFormat(image.format),
+                                     MipDimension(image.width, first_mip),
+                                     MipDimension(image.height, first_mip),
+                                     1,
+                                     mip_count);
     auto texture = dx12api().CreateResource(texture_desc,
                                             CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
                                             D3D12_RESOURCE_STATE_COPY_DEST);
 
-    D3D12_SUBRESOURCE_FOOTPRINT pitched_desc = {};
-    pitched_desc.Format                      = DXGI_FORMAT_R8G8B8A8_UNORM;
-    pitched_desc.Width                       = res_x;
-    pitched_desc.Height                      = res_y;
-    pitched_desc.Depth                       = 1;
-    pitched_desc.RowPitch = align(res_x * sizeof(DWORD), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+    // Rows of block compressed levels are rows of blocks.
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(mip_count);
+    std::vector<UINT>                               row_counts(mip_count);
+    std::vector<UINT64>                             row_sizes(mip_count);
+    UINT64                                          upload_size = 0;
+    dx12api().device()->GetCopyableFootprints(&texture_desc,
+                                              0,
+                                              mip_count,
+                                              0,
+                                              footprints.data(),
+                                              row_counts.data(),
+                                              row_sizes.data(),
+                                              &upload_size);
 
-    auto upload_buffer = dx12api().CreateUploadBuffer(pitched_desc.Height * pitched_desc.RowPitch);
-    render_system.AddAutoreleaseResource(upload_buffer);
+    // Copies are batched with the other uploads of the frame.
+    auto staging      = render_system.AllocateStaging(upload_size);
+    auto command_list = render_system.copy_command_list();
 
-    char* mapped_data = nullptr;
-    upload_buffer->Map(0, nullptr, (void**)&mapped_data);
-    for (auto row = 0; row < res_y; ++row)
+    for (UINT16 level = 0; level < mip_count; ++level)
     {
-        memcpy(mapped_data, data_ptr, res_x * sizeof(DWORD));
-        data_ptr += res_x * sizeof(DWORD);
-        mapped_data += pitched_desc.RowPitch;
-    }
-    upload_buffer->Unmap(0, nullptr);
-
-    stbi_image_free(data);
+        auto* data_ptr = image.mips[first_mip + level].data();
+        auto* dst_ptr  = staging.data + footprints[level].Offset;
 
-    D3D12_TEXTURE_COPY_LOCATION src_texture_loc;
-    src_texture_loc.Type                      = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    src_texture_loc.PlacedFootprint.Offset    = 0;
-    src_texture_loc.PlacedFootprint.Footprint = pitched_desc;
-    src_texture_loc.pResource                 = upload_buffer.Get();
+        for (uint32_t row = 0; row < row_counts[level]; ++row)
+        {
+            memcpy(dst_ptr, data_ptr, row_sizes[level]);
+            data_ptr += row_sizes[level];
+            dst_ptr += footprints[level].Footprint.RowPitch;
+        }
 
-    D3D12_TEXTURE_COPY_LOCATION dst_texture_loc;
-    dst_texture_loc.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-    dst_texture_loc.pResource        = texture.Get();
-    dst_texture_loc.SubresourceIndex = 0;
+        D3D12_TEXTURE_COPY_LOCATION src_texture_loc;
+        src_texture_loc.Type            = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src_texture_loc.PlacedFootprint = footprints[level];
+        src_texture_loc.pResource       = staging.resource;
+        src_texture_loc.PlacedFootprint.Offset += staging.offset;
 
-    D3D12_BOX copy_box{0, 0, 0, res_x, res_y, 1};
+        D3D12_TEXTURE_COPY_LOCATION dst_texture_loc;
+        dst_texture_loc.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst_texture_loc.pResource        = texture.Get();
+        dst_texture_loc.SubresourceIndex = level;
 
-    auto command_allocator = render_system.current_frame_command_allocator();
-    auto command_list      = dx12api().CreateCommandList(command_allocator);
+        command_list->CopyTextureRegion(&dst_texture_loc, 0, 0, 0, &src_texture_loc, nullptr);
+    }
 
-    command_list->CopyTextureRegion(&dst_texture_loc, 0, 0, 0, &src_texture_loc, &copy_box);
     D3D12_RESOURCE_BARRIER transitions[] = {
-        // Backbuffer transition to render target.
         CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
                                              D3D12_RESOURCE_STATE_COPY_DEST,
                                              D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)};
     command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
-    command_list->Close();
 
-    render_system.PushCommandList(command_list.Get());
+    return texture;
+}
 
-    textures_.push_back(texture);
-    cache_[name] = textures_.size() - 1;
+void TextureSystem::InitVirtualTextures()
+{
+    pages_ = std::make_unique<VirtualTextureManager>(options_.page_cache_slots,
+                                                     kPageUploadsPerFrame);
 
-    return textures_.size() - 1;
+    // Slots fill a square atlas row by row.
+    auto slots_per_row = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(options_.page_cache_slots))));
+    auto atlas_size = slots_per_row * kPageSlotSize;
+    info("TextureSystem: {} page cache slots in a {}x{} atlas",
+         options_.page_cache_slots,
+         atlas_size,
+         atlas_size);
+
+    page_atlas_ = dx12api().CreateResource(
+        CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, atlas_size, atlas_size, 1, 1),
+        CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    virtual_texture_descs_ = CreateShaderBuffer(kMaxVirtualTextures * sizeof(VirtualTextureDesc));
+
+    // Shaders read descs past the last texture, which have a zero size.
+    std::vector<VirtualTextureDesc> descs(kMaxVirtualTextures);
+    UploadBufferRange(virtual_texture_descs_.Get(),
+                      descs.data(),
+                      0,
+                      descs.size() * sizeof(VirtualTextureDesc));
+
+    InitPageFeedback();
+}
+
+void TextureSystem::UpdatePages(PageCache& page_cache)
+{
+    ReadPageFeedback();
+    pages_->Update(page_requests_, page_cache);
+    CopyPageFeedback();
+}
+
+void TextureSystem::UploadPageTable()
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto& page_table    = pages_->page_table();
+
+    uint32_t begin = 0, end = 0;
+    pages_->TakeDirtyPageTable(begin, end);
+
+    // The page table doubles when it is full and is copied whole.
+    auto capacity = page_table_ ? page_table_->GetDesc().Width / sizeof(uint32_t) : 0;
+    if (page_table.size() > capacity)
+    {
+        if (page_table_)
+        {
+            render_system.AddAutoreleaseResource(page_table_);
+        }
+
+        capacity    = std::max<UINT64>(capacity * 2, std::max<UINT64>(page_table.size(), 4096));
+        page_table_ = CreateShaderBuffer(capacity * sizeof(uint32_t));
+        begin       = 0;
+        end         = static_cast<uint32_t>(page_table.size());
+    }
+
+    if (begin < end)
+    {
+        UploadBufferRange(page_table_.Get(),
+                          page_table.data() + begin,
+                          UINT64(begin) * sizeof(uint32_t),
+                          UINT64(end - begin) * sizeof(uint32_t));
+    }
+
+    pages_->TakeDirtyTextures(begin, end);
+    if (begin < end)
+    {
+        UploadBufferRange(virtual_texture_descs_.Get(),
+                          pages_->textures().data() + begin,
+                          UINT64(begin) * sizeof(VirtualTextureDesc),
+                          UINT64(end - begin) * sizeof(VirtualTextureDesc));
+    }
+}
+
+void TextureSystem::InitPageFeedback()
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+
+    auto tiles_x = (render_system.window_width() + kFeedbackTileSize - 1) / kFeedbackTileSize;
+    auto tiles_y = (render_system.window_height() + kFeedbackTileSize - 1) / kFeedbackTileSize;
+    page_feedback_size_ = tiles_x * tiles_y;
+    page_feedback_      = dx12api().CreateUAVBuffer(page_feedback_size_ * sizeof(uint32_t),
+                                               D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    // Nothing is requested until the first feedback is read back.
+    for (auto& readback : page_feedback_readback_)
+    {
+        readback = dx12api().CreateReadbackBuffer(page_feedback_size_ * sizeof(uint32_t));
+
+        uint32_t* feedback = nullptr;
+        readback->Map(0, nullptr, (void**)&feedback);
+        std::fill(feedback, feedback + page_feedback_size_, kInvalidPage);
+        readback->Unmap(0, nullptr);
+    }
+}
+
+void TextureSystem::ReadPageFeedback()
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto& readback      = page_feedback_readback_[render_system.current_gpu_frame_index()];
+
+    uint32_t* feedback = nullptr;
+    readback->Map(0, nullptr, (void**)&feedback);
+    ReducePageFeedback(feedback, page_feedback_size_, page_requests_);
+    readback->Unmap(0, nullptr);
+}
+
+void TextureSystem::CopyPageFeedback()
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto& readback      = page_feedback_readback_[render_system.current_gpu_frame_index()];
+
+    // The copy goes before this frame's shaders overwrite the feedback.
+    auto command_list = render_system.copy_command_list();
+
+    D3D12_RESOURCE_BARRIER transitions[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(page_feedback_.Get(),
+                                             D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                             D3D12_RESOURCE_STATE_COPY_SOURCE)};
+    command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+    command_list->CopyBufferRegion(
+        readback.Get(), 0, page_feedback_.Get(), 0, page_feedback_size_ * sizeof(uint32_t));
+    std::swap(transitions[0].Transition.StateBefore, transitions[0].Transition.StateAfter);
+    command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+}
+
+void TextureSystem::UpdateStreaming(MipStreamer& streamer)
+{
+    ReadPageFeedback();
+
+    mip_requests_.clear();
+    for (auto& request : page_requests_)
+    {
+        auto texture = FeedbackTexture(request.page);
+        if (!residency_->streamed(texture))
+        {
+            continue;
+        }
+
+        auto& streamed = streamed_[texture];
+        auto  mip =
+            FeedbackMip(request.page, streamed.width, streamed.height, streamed.mip_count);
+        mip_requests_.push_back({texture, mip, request.count});
+    }
+
+    residency_->Update(mip_requests_, streamer);
+    CopyPageFeedback();
+
+    // Reads complete in any order, those of reloaded textures are dropped.
+    for (auto it = mip_reads_.begin(); it != mip_reads_.end();)
+    {
+        auto& read = **it;
+        if (read.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        auto& streamed = streamed_[read.texture];
+        if (read.version == streamed.version)
+        {
+            if (!read.read)
+            {
+                warn("TextureSystem: mip {} of {} can't be read", read.mip, streamed.file);
+            }
+
+            streamed.read_mip = std::move(read.data);
+            residency_->MipRead(read.texture, read.mip, read.read, streamer);
+        }
+
+        it = mip_reads_.erase(it);
+    }
+}
+
+void TextureSystem::UpdateStreamedTextures()
+{
+    auto& render_system = world().GetSystem<RenderSystem>();
+    auto  command_list  = render_system.copy_command_list();
+
+    for (auto index : streamed_dirty_)
+    {
+        auto& streamed = streamed_[index];
+        streamed.dirty = false;
+        if (streamed.target_mip == streamed.first_mip)
+        {
+            continue;
+        }
+
+        // Mips resident in the previous texture are copied from it, the mip read last from
+        // memory.
+        auto& texture      = textures_[index];
+        auto  texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(
+            texture->GetDesc().Format,
+            MipDimension(streamed.width, streamed.target_mip),
+            MipDimension(streamed.height, streamed.target_mip),
+            1,
+            static_cast<UINT16>(streamed.mip_count - streamed.target_mip));
+        auto resident = dx12api().CreateResource(texture_desc,
+                                                 CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+                                                 D3D12_RESOURCE_STATE_COPY_DEST);
+
+        D3D12_RESOURCE_BARRIER transitions[] = {
+            CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+                                                 D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                                 D3D12_RESOURCE_STATE_COPY_SOURCE)};
+        command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+
+        for (auto mip = streamed.target_mip; mip < streamed.mip_count; ++mip)
+        {
+            auto level = mip - streamed.target_mip;
+            if (mip < streamed.first_mip)
+            {
+                UploadMip(resident.Get(), level, streamed.read_mip);
+                continue;
+            }
+
+            CD3DX12_TEXTURE_COPY_LOCATION src_texture_loc(texture.Get(), mip - streamed.first_mip);
+            CD3DX12_TEXTURE_COPY_LOCATION dst_texture_loc(resident.Get(), level);
+            command_list->CopyTextureRegion(&dst_texture_loc, 0, 0, 0, &src_texture_loc, nullptr);
+        }
+
+        transitions[0] =
+            CD3DX12_RESOURCE_BARRIER::Transition(resident.Get(),
+                                                 D3D12_RESOURCE_STATE_COPY_DEST,
+                                                 D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        command_list->ResourceBarrier(ARRAYSIZE(transitions), transitions);
+
+        // Frames in flight may still sample the previous texture.
+        render_system.AddAutoreleaseResource(texture);
+        texture            = resident;
+        streamed.first_mip = streamed.target_mip;
+        streamed.read_mip  = std::vector<uint8_t>();
+    }
+
+    streamed_dirty_.clear();
 }
-}  // namespace capsaicin
\ No newline at end of file
+}  // namespace capsaicin
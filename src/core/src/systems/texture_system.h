@@ -2,31 +2,208 @@
 
 #include <DirectXMath.h>
 
+#include <deque>
+#include <future>
+#include <unordered_map>
+
+#include "src/asset/image.h"
+#include "src/asset/texture_residency.h"
+#include "src/asset/virtual_texture.h"
 #include "src/common.h"
 #include "src/dx12/d3dx12.h"
 #include "src/dx12/dx12.h"
+#include "src/systems/render_system.h"
 
 using namespace capsaicin::dx12;
 using namespace DirectX;
 
 namespace capsaicin
 {
+struct TextureOptions
+{
+    // Page material textures through a fixed cache of pages instead of keeping each of them
+    // resident, the pages are picked by feedback of the pages primary hits sample. Shaders
+    // need VIRTUAL_TEXTURES. Decoded textures stay in system memory.
+    bool virtual_textures = false;
+    // Slots of the page cache atlas, 1024 slots take 64 MB.
+    uint32_t page_cache_slots = 1024;
+
+    // Keep only the tails of material textures resident and stream their finer mips into a
+    // budget by feedback of the LOD primary hits sample at, evicting the least recently
+    // requested mips. Shaders need TEXTURE_STREAMING. Ignored with virtual textures.
+    bool streaming = false;
+    // Bytes of the resident mips of streamed textures, tails included.
+    uint64_t streaming_budget = 256ull << 20;
+    // Mips with neither side over the tail size stay resident.
+    uint32_t streaming_tail_size = 128;
+};
+
 class TextureSystem : public System
 {
 public:
-    TextureSystem() = default;
-    void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override {}
+    TextureSystem(const TextureOptions& options = TextureOptions{});
+    // Start decoding the textures requested since the last frame and upload decoded ones.
+    void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override;
 
+    // Load the texture at once if it hasn't been requested before.
     ComPtr<ID3D12Resource> GetTexture(const std::string& name);
     ComPtr<ID3D12Resource> GetTexture(uint32_t index);
-    uint32_t               GetTextureIndex(const std::string& name);
+    // Index of the texture, which is assigned at once. The texture is decoded in the
+    // background and its index has no resource until it is uploaded.
+    uint32_t GetTextureIndex(const std::string& name);
+    // Load the texture again into the same index, if it has been loaded before. A cooked
+    // texture is preferred unless its source image changed, as it is stale then.
+    void ReloadTexture(const std::string& name, bool from_source);
+    // Files the texture may be loaded from, the cooked one first.
+    static std::vector<std::string> GetTextureFiles(const std::string& name);
 
     size_t          num_textures() const { return textures_.size(); }
     ID3D12Resource* texture(uint32_t index) { return textures_[index].Get(); }
 
+    // Material textures are virtual textures of the same index, see virtual_texture.h. The
+    // page cache atlas, the page table and the virtual textures are sampled by shaders, and
+    // primary hits write the pages they sample to the feedback buffer, one pixel of each
+    // feedback tile per frame. Resources are null without virtual textures.
+    bool            virtual_textures() const { return options_.virtual_textures; }
+    ID3D12Resource* page_atlas() { return page_atlas_.Get(); }
+    ID3D12Resource* page_table() { return page_table_.Get(); }
+    ID3D12Resource* virtual_texture_descs() { return virtual_texture_descs_.Get(); }
+    // Streamed textures write the LOD they sample at to the feedback buffer instead, their
+    // texture has the resident mips only. The residency is null without streaming.
+    bool streaming() const { return options_.streaming && !options_.virtual_textures; }
+    const TextureResidency* texture_residency() const { return residency_.get(); }
+    ID3D12Resource*         page_feedback() { return page_feedback_.Get(); }
+
+    // Limit of the decoded texture bytes uploaded per frame, at least one texture is.
+    static constexpr uint64_t kUploadBytesPerFrame = 64ull << 20;
+    // Pages uploaded to the page cache per frame.
+    static constexpr uint32_t kPageUploadsPerFrame = 64;
+    static constexpr uint32_t kFeedbackTileSize    = 4;
+    // Mips of streamed textures read at once.
+    static constexpr uint32_t kMaxMipReads = 8;
+
 private:
-    uint32_t                                  LoadTexture(const std::string& name);
+    // Texture decoded in the background.
+    struct Request
+    {
+        std::string name;
+        uint32_t    index       = 0;
+        bool        from_source = false;
+        ImageData   image;
+        // Streamed textures decode their tail, finer mips are read from the cooked file or
+        // kept in the image if it's decoded from source.
+        std::string file;
+        uint32_t    tail_mip = 0;
+    };
+
+    // Requests of a frame, decoded concurrently and uploaded in order once all are done.
+    struct DecodeBatch
+    {
+        tf::Taskflow         taskflow;
+        std::future<void>    decoded;
+        std::vector<Request> requests;
+        size_t               next_upload = 0;
+    };
+
+    // Streamed texture, the texture resource holds mips from first_mip on and is rebuilt
+    // with mips from target_mip on at the end of the frame.
+    struct StreamedTexture
+    {
+        std::string   file;
+        ImageData     image;
+        uint32_t      width      = 0;
+        uint32_t      height     = 0;
+        uint32_t      mip_count  = 0;
+        TextureFormat format     = TextureFormat::kRGBA8;
+        uint32_t      first_mip  = 0;
+        uint32_t      target_mip = 0;
+        bool          dirty      = false;
+        // Reads of earlier versions of the texture are dropped.
+        uint32_t version = 0;
+        // Mip read last, until it's copied to the texture.
+        std::vector<uint8_t> read_mip;
+    };
+
+    // Mip of a streamed texture read in the background.
+    struct MipRead
+    {
+        tf::Taskflow         taskflow;
+        std::future<void>    done;
+        uint32_t             texture = 0;
+        uint32_t             mip     = 0;
+        uint32_t             version = 0;
+        bool                 read    = false;
+        std::vector<uint8_t> data;
+    };
+
+    class MipStreamer;
+
+    // Upload decoded textures in request order, or set them as virtual textures and upload
+    // their last mip to the page cache.
+    void UploadDecodedTextures(PageCache* page_cache);
+    // Upload the tail of a streamed texture and start streaming it.
+    void     SetStreamedTexture(Request& request);
+    uint32_t LoadTexture(const std::string& name);
+    // Decode the cooked texture or its source image with a generated mip chain, a black texel
+    // if both are missing. Block compressed cooked textures are skipped unless compressed.
+    static void DecodeTexture(const std::string& name,
+                              bool               from_source,
+                              bool               compressed,
+                              ImageData&         image);
+    // Decode the tail of the cooked texture, or the source image with a generated mip chain.
+    static void DecodeTextureTail(Request& request, uint32_t tail_size);
+    // Record the copy of the image from the mip on to a new texture into the copy command list
+    // of the frame.
+    ComPtr<ID3D12Resource> UploadTexture(const ImageData& image, uint32_t first_mip = 0);
+
+    void InitVirtualTextures();
+    // Page in the pages requested by the feedback of an earlier frame and read back the
+    // feedback of the last frame.
+    void UpdatePages(PageCache& page_cache);
+    // Copy the page table and virtual textures changed by this frame.
+    void UploadPageTable();
+
+    // Feedback buffer of the pages or LODs primary hits sample, with a readback per frame.
+    void InitPageFeedback();
+    // Reduce the feedback of the frame which last used the readback of this frame.
+    void ReadPageFeedback();
+    // Copy the feedback of the last frame to the readback of this frame.
+    void CopyPageFeedback();
+
+    // Read and evict mips of streamed textures by the feedback of an earlier frame.
+    void UpdateStreaming(MipStreamer& streamer);
+    // Rebuild the streamed textures whose first mip changed this frame.
+    void UpdateStreamedTextures();
+
+    TextureOptions options_;
+
     std::vector<ComPtr<ID3D12Resource>>       textures_;
     std::unordered_map<std::string, uint32_t> cache_;
+    // Requested since the last frame.
+    std::vector<Request> requests_;
+    // Uploaded in request order, so that a reload is never replaced by an older decode.
+    std::deque<std::unique_ptr<DecodeBatch>> batches_;
+
+    // Virtual textures, decoded RGBA8 images by texture index which pages are copied from.
+    std::unique_ptr<VirtualTextureManager> pages_;
+    std::vector<ImageData>                 virtual_images_;
+    std::vector<PageRequest>               page_requests_;
+    ComPtr<ID3D12Resource>                 page_atlas_            = nullptr;
+    ComPtr<ID3D12Resource>                 page_table_            = nullptr;
+    ComPtr<ID3D12Resource>                 virtual_texture_descs_ = nullptr;
+    ComPtr<ID3D12Resource>                 page_feedback_         = nullptr;
+    uint32_t                               page_feedback_size_    = 0;
+    // Feedback is read back once the frame which copied it has finished.
+    ComPtr<ID3D12Resource> page_feedback_readback_[RenderSystem::num_gpu_frames_in_flight()];
+
+    // Streamed textures by texture index, with reads in flight in the order they started.
+    std::unique_ptr<TextureResidency>     residency_;
+    std::vector<StreamedTexture>          streamed_;
+    std::vector<uint32_t>                 streamed_dirty_;
+    std::vector<std::unique_ptr<MipRead>> mip_reads_;
+    std::vector<MipRequest>               mip_requests_;
+
+    // Declared after the batches, so that it waits for their tasks before they are destroyed.
+    tf::Executor decoder_;
 };
-}  // namespace capsaicin
\ No newline at end of file
+}  // namespace capsaicin
@@ -49,10 +49,9 @@ void BuildTLAS(const EntitySet::EntityStorage& entities,
         instance_descs[instance_index].InstanceID                          = mesh.index;
         instance_descs[instance_index].InstanceMask                        = 0xff;
 
-        memset(&instance_descs[instance_index].Transform[0][0], 0, 12 * sizeof(float));
-        instance_descs[instance_index].Transform[0][0] = 1.f;
-        instance_descs[instance_index].Transform[1][1] = 1.f;
-        instance_descs[instance_index].Transform[2][2] = 1.f;
+        memcpy(&instance_descs[instance_index].Transform[0][0],
+               mesh.transform,
+               sizeof(mesh.transform));
 
         ++instance_index;
     }
@@ -108,14 +107,25 @@ void TLASSystem::Run(ComponentAccess& access, EntityQuery& entity_query, tf::Sub
 
     auto& tlas = world().GetComponent<TLASComponent>(entities[0]);
 
-    if (!tlas.built)
+    auto& geometry_storage = world().GetSystem<AssetLoadSystem>().geometry_storage();
+
+    // Rebuild when meshes were added or removed, background loads add them over several
+    // frames.
+    if (!tlas.built || tlas.version != geometry_storage.version)
     {
         build_command_list_->Reset(render_system.current_frame_command_allocator(), nullptr);
 
-        info("TLASSystem: Building TLAS");
+        // Frames in flight may still trace the previous TLAS.
+        if (tlas.tlas)
+        {
+            render_system.AddAutoreleaseResource(tlas.tlas);
+        }
+
+        info("TLASSystem: Building TLAS with {} instances", entities_with_blas.size());
         BuildTLAS(entities_with_blas, tlas, build_command_list_.Get(), render_system);
 
-        tlas.built = true;
+        tlas.built   = true;
+        tlas.version = geometry_storage.version;
         build_command_list_->Close();
         render_system.PushCommandList(build_command_list_.Get());
     }
@@ -14,6 +14,9 @@ struct TLASComponent
     // TLAS resource.
     ComPtr<ID3D12Resource> tlas  = nullptr;
     bool                   built = false;
+    // Geometry storage version the TLAS was built for, it is rebuilt when meshes are added
+    // or removed.
+    uint32_t version = 0;
 };
 
 class TLASSystem : public System
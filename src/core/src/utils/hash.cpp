@@ -0,0 +1,111 @@
+#include "hash.h"
+
+#include <cstring>
+
+namespace capsaicin
+{
+namespace
+{
+constexpr std::uint64_t kPrime1 = 11400714785074694791ull;
+constexpr std::uint64_t kPrime2 = 14029467366897019727ull;
+constexpr std::uint64_t kPrime3 = 1609587929392839161ull;
+constexpr std::uint64_t kPrime4 = 9650029242287828579ull;
+constexpr std::uint64_t kPrime5 = 2870177450012600261ull;
+
+std::uint64_t Rotl(std::uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+std::uint64_t Read64(const unsigned char* p)
+{
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint32_t Read32(const unsigned char* p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint64_t Round(std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * kPrime2;
+    acc = Rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+std::uint64_t MergeRound(std::uint64_t acc, std::uint64_t value)
+{
+    acc ^= Round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+}  // namespace
+
+std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed)
+{
+    auto p   = static_cast<const unsigned char*>(data);
+    auto end = p + size;
+
+    std::uint64_t h = 0;
+
+    if (size >= 32)
+    {
+        std::uint64_t v1 = seed + kPrime1 + kPrime2;
+        std::uint64_t v2 = seed + kPrime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - kPrime1;
+
+        auto limit = end - 32;
+        do
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    }
+    else
+    {
+        h = seed + kPrime5;
+    }
+
+    h += size;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * kPrime1 + kPrime4;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= static_cast<std::uint64_t>(Read32(p)) * kPrime1;
+        h = Rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+    {
+        h ^= *p * kPrime5;
+        h = Rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+}  // namespace capsaicin
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace capsaicin
+{
+// 64-bit xxHash (XXH64) of a memory block.
+std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed = 0);
+}  // namespace capsaicin
@@ -0,0 +1,376 @@
+#include "json.h"
+
+#include <charconv>
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+namespace
+{
+// Deeper documents are rejected rather than overflowing the stack.
+constexpr uint32_t kMaxDepth = 256;
+
+class JsonParser
+{
+public:
+    JsonParser(const char* data, std::size_t size) : begin_(data), p_(data), end_(data + size)
+    {
+    }
+
+    JsonValue ParseDocument()
+    {
+        JsonValue value;
+        SkipSpaces();
+        ParseValue(value, 0);
+        SkipSpaces();
+
+        if (p_ != end_)
+        {
+            Fail("Unexpected characters after the document");
+        }
+
+        return value;
+    }
+
+private:
+    [[noreturn]] void Fail(const char* what)
+    {
+        error("Json: {} at offset {}", what, p_ - begin_);
+        throw std::runtime_error(std::string("Json: ") + what);
+    }
+
+    void SkipSpaces()
+    {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+        {
+            ++p_;
+        }
+    }
+
+    bool Consume(char c)
+    {
+        if (p_ < end_ && *p_ == c)
+        {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c)
+    {
+        if (!Consume(c))
+        {
+            Fail(p_ == end_ ? "Unexpected end of the document" : "Unexpected character");
+        }
+    }
+
+    void ParseLiteral(const char* literal)
+    {
+        for (; *literal != '\0'; ++literal)
+        {
+            Expect(*literal);
+        }
+    }
+
+    void ParseValue(JsonValue& value, uint32_t depth)
+    {
+        if (depth > kMaxDepth)
+        {
+            Fail("Document nested too deep");
+        }
+
+        if (p_ == end_)
+        {
+            Fail("Unexpected end of the document");
+        }
+
+        switch (*p_)
+        {
+        case '{':
+            ParseObject(value, depth);
+            break;
+        case '[':
+            ParseArray(value, depth);
+            break;
+        case '"':
+            value.type = JsonValue::Type::kString;
+            ParseString(value.string);
+            break;
+        case 't':
+            ParseLiteral("true");
+            value.type    = JsonValue::Type::kBool;
+            value.boolean = true;
+            break;
+        case 'f':
+            ParseLiteral("false");
+            value.type = JsonValue::Type::kBool;
+            break;
+        case 'n':
+            ParseLiteral("null");
+            break;
+        default:
+            ParseNumber(value);
+            break;
+        }
+    }
+
+    void ParseObject(JsonValue& value, uint32_t depth)
+    {
+        value.type = JsonValue::Type::kObject;
+        Expect('{');
+        SkipSpaces();
+
+        if (Consume('}'))
+        {
+            return;
+        }
+
+        do
+        {
+            SkipSpaces();
+            std::string key;
+            ParseString(key);
+            SkipSpaces();
+            Expect(':');
+            SkipSpaces();
+
+            value.object.emplace_back(std::move(key), JsonValue{});
+            ParseValue(value.object.back().second, depth + 1);
+            SkipSpaces();
+        } while (Consume(','));
+
+        Expect('}');
+    }
+
+    void ParseArray(JsonValue& value, uint32_t depth)
+    {
+        value.type = JsonValue::Type::kArray;
+        Expect('[');
+        SkipSpaces();
+
+        if (Consume(']'))
+        {
+            return;
+        }
+
+        do
+        {
+            SkipSpaces();
+            value.array.emplace_back();
+            ParseValue(value.array.back(), depth + 1);
+            SkipSpaces();
+        } while (Consume(','));
+
+        Expect(']');
+    }
+
+    uint32_t ParseHex4()
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < 4; ++i, ++p_)
+        {
+            if (p_ == end_)
+            {
+                Fail("Unexpected end of the document");
+            }
+
+            auto c = *p_;
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+            {
+                value |= static_cast<uint32_t>(c - '0');
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                value |= static_cast<uint32_t>(c - 'a' + 10);
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                value |= static_cast<uint32_t>(c - 'A' + 10);
+            }
+            else
+            {
+                Fail("Invalid unicode escape");
+            }
+        }
+        return value;
+    }
+
+    // Code point of a \u escape, surrogate pairs span two escapes.
+    uint32_t ParseCodePoint()
+    {
+        auto code_point = ParseHex4();
+
+        if (code_point >= 0xdc00 && code_point <= 0xdfff)
+        {
+            Fail("Unpaired surrogate");
+        }
+
+        if (code_point >= 0xd800 && code_point <= 0xdbff)
+        {
+            Expect('\\');
+            Expect('u');
+
+            auto low = ParseHex4();
+            if (low < 0xdc00 || low > 0xdfff)
+            {
+                Fail("Unpaired surrogate");
+            }
+
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        }
+
+        return code_point;
+    }
+
+    static void AppendUtf8(std::string& string, uint32_t code_point)
+    {
+        if (code_point < 0x80)
+        {
+            string.push_back(static_cast<char>(code_point));
+        }
+        else if (code_point < 0x800)
+        {
+            string.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+            string.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+        }
+        else if (code_point < 0x10000)
+        {
+            string.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+            string.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+            string.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+        }
+        else
+        {
+            string.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+            string.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+            string.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+            string.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+        }
+    }
+
+    void ParseString(std::string& string)
+    {
+        Expect('"');
+
+        for (;;)
+        {
+            if (p_ == end_)
+            {
+                Fail("Unterminated string");
+            }
+
+            auto c = *p_++;
+            if (c == '"')
+            {
+                return;
+            }
+
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                Fail("Control character in string");
+            }
+
+            if (c != '\\')
+            {
+                string.push_back(c);
+                continue;
+            }
+
+            if (p_ == end_)
+            {
+                Fail("Unterminated string");
+            }
+
+            switch (*p_++)
+            {
+            case '"':
+                string.push_back('"');
+                break;
+            case '\\':
+                string.push_back('\\');
+                break;
+            case '/':
+                string.push_back('/');
+                break;
+            case 'b':
+                string.push_back('\b');
+                break;
+            case 'f':
+                string.push_back('\f');
+                break;
+            case 'n':
+                string.push_back('\n');
+                break;
+            case 'r':
+                string.push_back('\r');
+                break;
+            case 't':
+                string.push_back('\t');
+                break;
+            case 'u':
+                AppendUtf8(string, ParseCodePoint());
+                break;
+            default:
+                --p_;
+                Fail("Invalid escape");
+            }
+        }
+    }
+
+    void ParseNumber(JsonValue& value)
+    {
+        // from_chars is locale independent, unlike strtod.
+        auto result = std::from_chars(p_, end_, value.number);
+        if (result.ec != std::errc())
+        {
+            Fail("Invalid value");
+        }
+
+        value.type = JsonValue::Type::kNumber;
+        p_         = result.ptr;
+    }
+
+    const char* begin_;
+    const char* p_;
+    const char* end_;
+};
+}  // namespace
+
+const JsonValue* JsonValue::Find(const std::string& key) const
+{
+    for (auto& member : object)
+    {
+        if (member.first == key)
+        {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+double JsonValue::GetNumber(const std::string& key, double fallback) const
+{
+    auto member = Find(key);
+    return member && member->is_number() ? member->number : fallback;
+}
+
+bool JsonValue::GetBool(const std::string& key, bool fallback) const
+{
+    auto member = Find(key);
+    return member && member->type == Type::kBool ? member->boolean : fallback;
+}
+
+std::string JsonValue::GetString(const std::string& key, const std::string& fallback) const
+{
+    auto member = Find(key);
+    return member && member->is_string() ? member->string : fallback;
+}
+
+JsonValue ParseJson(const char* data, std::size_t size)
+{
+    return JsonParser(data, size).ParseDocument();
+}
+}  // namespace capsaicin
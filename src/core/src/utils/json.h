@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace capsaicin
+{
+// Value of a parsed JSON document. Objects keep their members in document order and are
+// searched linearly, which suits the small objects of asset formats.
+struct JsonValue
+{
+    enum class Type
+    {
+        kNull,
+        kBool,
+        kNumber,
+        kString,
+        kArray,
+        kObject
+    };
+
+    Type                                           type    = Type::kNull;
+    bool                                           boolean = false;
+    double                                         number  = 0.0;
+    std::string                                    string;
+    std::vector<JsonValue>                         array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    bool is_number() const { return type == Type::kNumber; }
+    bool is_string() const { return type == Type::kString; }
+    bool is_array() const { return type == Type::kArray; }
+    bool is_object() const { return type == Type::kObject; }
+
+    // Member of an object, nullptr if this is not an object or has no such member.
+    const JsonValue* Find(const std::string& key) const;
+    // Member of an object, the fallback if it is missing or of another type.
+    double      GetNumber(const std::string& key, double fallback) const;
+    bool        GetBool(const std::string& key, bool fallback) const;
+    std::string GetString(const std::string& key, const std::string& fallback = "") const;
+};
+
+// Parse a UTF-8 JSON document, throws std::runtime_error on the first syntax error.
+JsonValue ParseJson(const char* data, std::size_t size);
+}  // namespace capsaicin
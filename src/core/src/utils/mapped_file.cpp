@@ -0,0 +1,128 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& file_name)
+{
+    file_ = CreateFileA(file_name.c_str(),
+                        GENERIC_READ,
+                        FILE_SHARE_READ,
+                        nullptr,
+                        OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                        nullptr);
+
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        file_ = nullptr;
+        error("MappedFile: Couldn't open {}", file_name);
+        throw std::runtime_error("MappedFile: Couldn't open " + file_name);
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_, &file_size);
+    size_ = static_cast<std::size_t>(file_size.QuadPart);
+
+    // Empty files can't be mapped, leave data_ null.
+    if (size_ == 0)
+    {
+        return;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr)
+    {
+        CloseHandle(file_);
+        error("MappedFile: Couldn't map {}", file_name);
+        throw std::runtime_error("MappedFile: Couldn't map " + file_name);
+    }
+
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr)
+    {
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+        error("MappedFile: Couldn't map {}", file_name);
+        throw std::runtime_error("MappedFile: Couldn't map " + file_name);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+    }
+    if (file_)
+    {
+        CloseHandle(file_);
+    }
+}
+#else
+MappedFile::MappedFile(const std::string& file_name)
+{
+    fd_ = open(file_name.c_str(), O_RDONLY);
+
+    if (fd_ == -1)
+    {
+        error("MappedFile: Couldn't open {}", file_name);
+        throw std::runtime_error("MappedFile: Couldn't open " + file_name);
+    }
+
+    struct stat file_stat;
+    fstat(fd_, &file_stat);
+    size_ = static_cast<std::size_t>(file_stat.st_size);
+
+    // Empty files can't be mapped, leave data_ null.
+    if (size_ == 0)
+    {
+        return;
+    }
+
+    auto ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (ptr == MAP_FAILED)
+    {
+        close(fd_);
+        error("MappedFile: Couldn't map {}", file_name);
+        throw std::runtime_error("MappedFile: Couldn't map " + file_name);
+    }
+
+    madvise(ptr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(ptr);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    if (fd_ != -1)
+    {
+        close(fd_);
+    }
+}
+#endif
+}  // namespace capsaicin
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "yecs/yecs.h"
+
+namespace capsaicin
+{
+// Spawn count tasks on the subflow, calling f(i) for each index, and join it.
+// The subflow should belong to a dynamic task, so it can be joined explicitly.
+template <typename F>
+void ParallelFor(tf::Subflow& subflow, std::uint32_t count, F&& f)
+{
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        subflow.emplace([i, &f]() { f(i); });
+    }
+
+    subflow.join();
+}
+}  // namespace capsaicin
@@ -0,0 +1,155 @@
+#include "range_allocator.h"
+
+#include "src/common.h"
+
+namespace capsaicin
+{
+RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+    Grow(capacity);
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+    size = std::max(size, 1u);
+
+    auto it = free_by_size_.lower_bound({size, 0});
+    if (it == free_by_size_.end())
+    {
+        return kInvalidOffset;
+    }
+
+    auto offset = it->second;
+    auto free   = free_.find(offset);
+    auto remain = free->second - size;
+
+    RemoveFree(free);
+    if (remain > 0)
+    {
+        AddFree(offset + size, remain);
+    }
+
+    allocated_.emplace(offset, size);
+    used_ += size;
+    return offset;
+}
+
+void RangeAllocator::Free(uint32_t offset)
+{
+    auto it = allocated_.find(offset);
+    if (it == allocated_.end())
+    {
+        error("RangeAllocator: Invalid free of offset {}", offset);
+        throw std::runtime_error("RangeAllocator: Invalid free");
+    }
+
+    auto size = it->second;
+    allocated_.erase(it);
+    used_ -= size;
+
+    // Merge with the free ranges right after and before.
+    auto next = free_.find(offset + size);
+    if (next != free_.end())
+    {
+        size += next->second;
+        RemoveFree(next);
+    }
+
+    auto prev = free_.lower_bound(offset);
+    if (prev != free_.begin())
+    {
+        --prev;
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            RemoveFree(prev);
+        }
+    }
+
+    AddFree(offset, size);
+}
+
+void RangeAllocator::Grow(uint32_t capacity)
+{
+    if (capacity <= capacity_)
+    {
+        return;
+    }
+
+    auto offset = capacity_;
+    auto size   = capacity - capacity_;
+    capacity_   = capacity;
+
+    // Extend a free range at the end of the pool.
+    if (!free_.empty())
+    {
+        auto last = std::prev(free_.end());
+        if (last->first + last->second == offset)
+        {
+            offset = last->first;
+            size += last->second;
+            RemoveFree(last);
+        }
+    }
+
+    AddFree(offset, size);
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::Defragment()
+{
+    std::vector<Move>            moves;
+    std::map<uint32_t, uint32_t> packed;
+
+    // Destinations never pass their sources, so earlier moves don't overwrite later ones.
+    uint32_t offset = 0;
+    for (auto& allocation : allocated_)
+    {
+        if (allocation.first != offset)
+        {
+            moves.push_back({allocation.first, offset, allocation.second});
+        }
+        packed.emplace_hint(packed.end(), offset, allocation.second);
+        offset += allocation.second;
+    }
+
+    allocated_ = std::move(packed);
+    free_.clear();
+    free_by_size_.clear();
+
+    if (offset < capacity_)
+    {
+        AddFree(offset, capacity_ - offset);
+    }
+
+    return moves;
+}
+
+uint32_t RangeAllocator::largest_free() const
+{
+    return free_by_size_.empty() ? 0 : free_by_size_.rbegin()->first;
+}
+
+uint32_t RangeAllocator::fragmented() const
+{
+    return capacity_ - used_ - largest_free();
+}
+
+float RangeAllocator::fragmentation() const
+{
+    auto free = capacity_ - used_;
+    return free == 0 ? 0.f : static_cast<float>(fragmented()) / static_cast<float>(free);
+}
+
+void RangeAllocator::AddFree(uint32_t offset, uint32_t size)
+{
+    free_.emplace(offset, size);
+    free_by_size_.emplace(size, offset);
+}
+
+void RangeAllocator::RemoveFree(std::map<uint32_t, uint32_t>::iterator it)
+{
+    free_by_size_.erase({it->second, it->first});
+    free_.erase(it);
+}
+}  // namespace capsaicin
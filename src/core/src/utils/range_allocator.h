@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace capsaicin
+{
+// Best fit allocator of ranges in a linear pool, used to sub-allocate GPU buffers. Free
+// ranges are coalesced with their neighbours, offsets and sizes are in pool elements.
+class RangeAllocator
+{
+public:
+    static constexpr uint32_t kInvalidOffset = ~0u;
+
+    // Allocation which moved from one offset to another during defragmentation.
+    struct Move
+    {
+        uint32_t from;
+        uint32_t to;
+        uint32_t size;
+    };
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    // Smallest free range which fits, kInvalidOffset if there is none. Empty ranges still
+    // take an element, so that every allocation has its own offset.
+    uint32_t Allocate(uint32_t size);
+    // Free an allocation returned by Allocate.
+    void Free(uint32_t offset);
+    // Extend the pool, allocations keep their offsets.
+    void Grow(uint32_t capacity);
+    // Pack allocations to the front of the pool keeping their order, moves are listed in
+    // offset order so that they can be applied one after another.
+    std::vector<Move> Defragment();
+
+    uint32_t capacity() const { return capacity_; }
+    uint32_t used() const { return used_; }
+    uint32_t largest_free() const;
+    // Free space outside of the largest free range.
+    uint32_t fragmented() const;
+    // Share of the free space outside of the largest free range, 0 if free space is in
+    // one piece.
+    float fragmentation() const;
+
+private:
+    void AddFree(uint32_t offset, uint32_t size);
+    void RemoveFree(std::map<uint32_t, uint32_t>::iterator it);
+
+    uint32_t capacity_ = 0;
+    uint32_t used_     = 0;
+    // Offset to size of allocated and free ranges, free ranges are also sorted by size.
+    std::map<uint32_t, uint32_t>            allocated_;
+    std::map<uint32_t, uint32_t>            free_;
+    std::set<std::pair<uint32_t, uint32_t>> free_by_size_;
+};
+}  // namespace capsaicin
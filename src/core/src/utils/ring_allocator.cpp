@@ -0,0 +1,56 @@
+#include "ring_allocator.h"
+
+namespace capsaicin
+{
+RingAllocator::RingAllocator(uint64_t capacity) : capacity_(capacity)
+{
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    if (size > capacity_ || capacity_ == 0)
+    {
+        return kInvalidOffset;
+    }
+
+    // An empty ring starts over, so that large allocations don't skip its end.
+    if (head_ == tail_ && submissions_.empty())
+    {
+        head_ = tail_ = 0;
+    }
+
+    auto start = (head_ + alignment - 1) & ~(alignment - 1);
+
+    // Skip the rest of the ring if the allocation would wrap around its end.
+    if (start % capacity_ + size > capacity_)
+    {
+        start = (start / capacity_ + 1) * capacity_;
+    }
+
+    if (start + size - tail_ > capacity_)
+    {
+        return kInvalidOffset;
+    }
+
+    head_ = start + size;
+    return start % capacity_;
+}
+
+void RingAllocator::Submit(uint64_t fence_value)
+{
+    auto last_head = submissions_.empty() ? tail_ : submissions_.back().head;
+    if (head_ != last_head)
+    {
+        submissions_.push_back({fence_value, head_});
+    }
+}
+
+void RingAllocator::Retire(uint64_t completed_value)
+{
+    while (!submissions_.empty() && submissions_.front().fence_value <= completed_value)
+    {
+        tail_ = submissions_.front().head;
+        submissions_.pop_front();
+    }
+}
+}  // namespace capsaicin
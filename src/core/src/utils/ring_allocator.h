@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+namespace capsaicin
+{
+// Allocator of a ring buffer whose allocations are freed in order, once the GPU passed the
+// fence value of the submission consuming them. Offsets and sizes are in bytes.
+class RingAllocator
+{
+public:
+    static constexpr uint64_t kInvalidOffset = ~0ull;
+
+    // Capacity should be a multiple of the largest alignment allocations use.
+    explicit RingAllocator(uint64_t capacity = 0);
+
+    // Offset of size bytes aligned to a power of two, kInvalidOffset if they don't fit until
+    // earlier submissions retire. Allocations never wrap around the end of the ring.
+    uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+    // Allocations since the last call are consumed by the submission signalling the fence
+    // value, which increases from call to call.
+    void Submit(uint64_t fence_value);
+    // Free allocations of submissions up to the completed fence value.
+    void Retire(uint64_t completed_value);
+
+    uint64_t capacity() const { return capacity_; }
+    uint64_t used() const { return head_ - tail_; }
+    uint32_t pending_submissions() const { return static_cast<uint32_t>(submissions_.size()); }
+
+private:
+    struct Submission
+    {
+        uint64_t fence_value;
+        uint64_t head;
+    };
+
+    uint64_t capacity_ = 0;
+    // Running byte positions of the end and the start of live allocations, offsets are
+    // these modulo the capacity.
+    uint64_t               head_ = 0;
+    uint64_t               tail_ = 0;
+    std::deque<Submission> submissions_;
+};
+}  // namespace capsaicin
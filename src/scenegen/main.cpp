@@ -0,0 +1,874 @@
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "src/asset/image.h"
+#include "src/asset/mesh_instancing.h"
+#include "src/asset/mesh_optimizer.h"
+#include "src/asset/mesh_simplifier.h"
+#include "src/asset/scene_cache.h"
+#include "src/common.h"
+#include "src/utils/hash.h"
+#include "src/utils/parallel_for.h"
+
+using namespace std;
+using namespace capsaicin;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr const char* kManifestFileName = "scenegen_manifest.txt";
+constexpr const char* kTextureDir       = "textures";
+// Generated textures live in a directory of their own under the texture directory.
+constexpr const char* kTexturePrefix = "scenegen";
+// Distance between instance centers at average density, meshes fit in a sphere of radius 1.2
+// and are scaled by at most 1.5.
+constexpr float kSpacing = 4.f;
+// Instances per cluster of the clustered distribution.
+constexpr uint32_t kClusterSize = 64;
+// Waves displacing the sphere meshes.
+constexpr uint32_t kWaveCount     = 3;
+constexpr float    kWaveAmplitude = 0.07f;
+// Checker cells per texture side.
+constexpr uint32_t kCheckerCells = 8;
+// OBJ output is written in blocks of about this size.
+constexpr std::size_t kWriteBlockSize = 1 << 20;
+
+constexpr float kPi = 3.14159265358979f;
+
+// Streams of random numbers derived from the seed, so that the meshes of a seed are the same
+// whatever the instance count or distribution of the scene.
+constexpr uint64_t kLayoutStream  = 1;
+constexpr uint64_t kMeshStream    = 2;
+constexpr uint64_t kTextureStream = 3;
+
+enum class Distribution
+{
+    kUniform,
+    kGrid,
+    kClustered
+};
+
+enum class Format
+{
+    kObj,
+    kCache
+};
+
+// Parameters of a generated scene.
+struct SceneParams
+{
+    uint32_t instances = 1000;
+    // Unique meshes, instances cycle through them.
+    uint32_t     meshes       = 100;
+    uint32_t     triangles    = 1000;
+    uint32_t     textures     = 0;
+    Distribution distribution = Distribution::kUniform;
+    uint64_t     seed         = 1;
+};
+
+// Every parameter takes a list of values and a scene is generated for each combination.
+struct GenOptions
+{
+    fs::path                  output_dir;
+    std::vector<uint32_t>     instances     = {1000};
+    std::vector<uint32_t>     meshes        = {100};
+    std::vector<uint32_t>     triangles     = {1000};
+    std::vector<uint32_t>     textures      = {0};
+    std::vector<Distribution> distributions = {Distribution::kUniform};
+    std::vector<uint64_t>     seeds         = {1};
+    uint32_t                  texture_size  = 256;
+    Format                    format        = Format::kObj;
+    uint32_t                  num_threads   = 0;
+};
+
+// Generated scene, one line of the manifest.
+struct GeneratedScene
+{
+    SceneParams params;
+    std::string name;
+    // Triangles per mesh after rounding to the mesh topology.
+    uint32_t mesh_triangles = 0;
+    uint64_t size           = 0;
+    bool     failed         = false;
+};
+
+// SplitMix64, so that scenes don't depend on the distributions of the standard library,
+// which differ between implementations.
+class Random
+{
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t Next()
+    {
+        auto z = (state_ += 0x9e3779b97f4a7c15ull);
+        z      = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z      = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [min, max).
+    float Uniform(float min = 0.f, float max = 1.f)
+    {
+        return min + (max - min) * static_cast<float>(Next() >> 40) * (1.f / (1 << 24));
+    }
+
+    // Standard normal, Box-Muller.
+    float Normal()
+    {
+        auto u = std::max(Uniform(), 1e-7f);
+        return std::sqrt(-2.f * std::log(u)) * std::cos(2.f * kPi * Uniform());
+    }
+
+private:
+    uint64_t state_;
+};
+
+uint64_t StreamSeed(uint64_t seed, uint64_t stream, uint64_t index = 0)
+{
+    uint64_t key[] = {stream, index};
+    return HashBytes(key, sizeof(key), seed);
+}
+
+const char* DistributionName(Distribution distribution)
+{
+    switch (distribution)
+    {
+    case Distribution::kGrid:
+        return "grid";
+    case Distribution::kClustered:
+        return "clustered";
+    default:
+        return "uniform";
+    }
+}
+
+// Quads per cube face side for about the given number of triangles.
+uint32_t GetFaceResolution(uint32_t triangles)
+{
+    auto side = std::sqrt(static_cast<float>(triangles) / 12.f);
+    return std::max(1u, static_cast<uint32_t>(std::lround(side)));
+}
+
+std::string GetTextureName(uint64_t seed, uint32_t texture)
+{
+    return fmt::format("{}/s{}_{}.png", kTexturePrefix, seed, texture);
+}
+
+std::string GetSceneName(const SceneParams& params)
+{
+    return fmt::format("scenegen_i{}_m{}_t{}_x{}_{}_s{}.obj",
+                       params.instances,
+                       params.meshes,
+                       params.triangles,
+                       params.textures,
+                       DistributionName(params.distribution),
+                       params.seed);
+}
+
+// Cube sphere of 6 faces of n x n quads, displaced by a few random waves, so that meshes
+// differ in shape and aren't transformed copies of each other.
+MeshData GenerateMesh(uint32_t triangles, uint64_t seed)
+{
+    struct Wave
+    {
+        float direction[3];
+        float frequency;
+        float phase;
+    };
+
+    Random random(seed);
+    Wave   waves[kWaveCount];
+    for (auto& wave : waves)
+    {
+        auto length = 0.f;
+        while (length < 1e-3f)
+        {
+            for (auto& d : wave.direction)
+            {
+                d = random.Uniform(-1.f, 1.f);
+            }
+            length = std::sqrt(wave.direction[0] * wave.direction[0] +
+                               wave.direction[1] * wave.direction[1] +
+                               wave.direction[2] * wave.direction[2]);
+        }
+
+        for (auto& d : wave.direction)
+        {
+            d /= length;
+        }
+
+        wave.frequency = random.Uniform(1.f, 4.f);
+        wave.phase     = random.Uniform(0.f, 2.f * kPi);
+    }
+
+    MeshData mesh;
+    auto     n = GetFaceResolution(triangles);
+
+    // Faces are numbered +x, -x, +y, -y, +z, -z, the u and v axes follow the face axis
+    // cyclically, so that all faces wind outwards.
+    for (uint32_t face = 0; face < 6; ++face)
+    {
+        auto axis   = face / 2;
+        auto sign   = face % 2 ? -1.f : 1.f;
+        auto u_axis = (axis + 1) % 3;
+        auto v_axis = (axis + 2) % 3;
+        auto base   = static_cast<uint32_t>(mesh.positions.size() / 3);
+
+        for (uint32_t j = 0; j <= n; ++j)
+        {
+            for (uint32_t i = 0; i <= n; ++i)
+            {
+                float p[3];
+                p[axis]   = sign;
+                p[u_axis] = sign * (2.f * static_cast<float>(i) / static_cast<float>(n) - 1.f);
+                p[v_axis] = 2.f * static_cast<float>(j) / static_cast<float>(n) - 1.f;
+
+                auto length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                auto radius = 1.f;
+                for (auto& wave : waves)
+                {
+                    auto d = (p[0] * wave.direction[0] + p[1] * wave.direction[1] +
+                              p[2] * wave.direction[2]) /
+                             length;
+                    radius += kWaveAmplitude * std::sin(wave.frequency * d + wave.phase);
+                }
+
+                for (auto c : p)
+                {
+                    mesh.positions.push_back(c / length * radius);
+                }
+
+                mesh.texcoords.push_back(static_cast<float>(i) / static_cast<float>(n));
+                mesh.texcoords.push_back(static_cast<float>(j) / static_cast<float>(n));
+            }
+        }
+
+        for (uint32_t j = 0; j < n; ++j)
+        {
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                auto a = base + j * (n + 1) + i;
+                auto b = a + 1;
+                auto c = a + n + 1;
+                auto d = c + 1;
+                mesh.indices.insert(mesh.indices.end(), {a, b, d, a, d, c});
+            }
+        }
+    }
+
+    // Area weighted vertex normals, seams get the normals of their face.
+    mesh.normals.assign(mesh.positions.size(), 0.f);
+    for (std::size_t t = 0; t < mesh.indices.size(); t += 3)
+    {
+        auto p0 = &mesh.positions[3 * mesh.indices[t]];
+        auto p1 = &mesh.positions[3 * mesh.indices[t + 1]];
+        auto p2 = &mesh.positions[3 * mesh.indices[t + 2]];
+
+        float e1[] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float normal[] = {e1[1] * e2[2] - e1[2] * e2[1],
+                          e1[2] * e2[0] - e1[0] * e2[2],
+                          e1[0] * e2[1] - e1[1] * e2[0]};
+
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                mesh.normals[3 * mesh.indices[t + k] + c] += normal[c];
+            }
+        }
+    }
+
+    for (std::size_t v = 0; v < mesh.normals.size(); v += 3)
+    {
+        auto normal = &mesh.normals[v];
+        auto length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                                normal[2] * normal[2]);
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            normal[c] /= length;
+        }
+    }
+
+    return mesh;
+}
+
+// Place the instances at the density of kSpacing, rotated about the y axis and uniformly
+// scaled, so that the loader can find them again in an OBJ file.
+std::vector<MeshInstance> PlaceInstances(const SceneParams& params)
+{
+    Random random(StreamSeed(params.seed, kLayoutStream));
+
+    auto extent = kSpacing * std::cbrt(static_cast<float>(params.instances));
+
+    uint32_t grid_size = 1;
+    while (grid_size * grid_size * grid_size < params.instances)
+    {
+        ++grid_size;
+    }
+
+    std::vector<float> cluster_centers;
+    if (params.distribution == Distribution::kClustered)
+    {
+        auto cluster_count = (params.instances + kClusterSize - 1) / kClusterSize;
+        for (uint32_t i = 0; i < 3 * cluster_count; ++i)
+        {
+            cluster_centers.push_back(random.Uniform(-0.5f, 0.5f) * extent);
+        }
+    }
+
+    // Clusters are as dense as the uniform distribution is on average.
+    auto cluster_sigma = 0.5f * kSpacing * std::cbrt(static_cast<float>(kClusterSize));
+
+    std::vector<MeshInstance> instances(params.instances);
+    for (uint32_t i = 0; i < params.instances; ++i)
+    {
+        auto& instance = instances[i];
+        instance.mesh  = i % params.meshes;
+
+        if (params.textures > 0)
+        {
+            instance.texture_index = static_cast<uint32_t>(random.Next() % params.textures);
+            instance.texture_name  = GetTextureName(params.seed, instance.texture_index);
+        }
+
+        float position[3];
+        switch (params.distribution)
+        {
+        case Distribution::kGrid:
+            position[0] = kSpacing * static_cast<float>(i % grid_size);
+            position[1] = kSpacing * static_cast<float>(i / grid_size % grid_size);
+            position[2] = kSpacing * static_cast<float>(i / (grid_size * grid_size));
+            break;
+        case Distribution::kClustered:
+        {
+            auto center = &cluster_centers[3 * (i / kClusterSize)];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                position[c] = center[c] + cluster_sigma * random.Normal();
+            }
+            break;
+        }
+        default:
+            for (auto& c : position)
+            {
+                c = random.Uniform(-0.5f, 0.5f) * extent;
+            }
+            break;
+        }
+
+        auto angle = random.Uniform(0.f, 2.f * kPi);
+        auto scale = random.Uniform(0.5f, 1.5f);
+        auto cos_a = scale * std::cos(angle);
+        auto sin_a = scale * std::sin(angle);
+
+        auto& m = instance.transform;
+        m[0]    = cos_a;
+        m[2]    = sin_a;
+        m[3]    = position[0];
+        m[5]    = scale;
+        m[7]    = position[1];
+        m[8]    = -sin_a;
+        m[10]   = cos_a;
+        m[11]   = position[2];
+    }
+
+    return instances;
+}
+
+// Checkerboard of two random colors with its mip chain.
+void GenerateTexture(const GenOptions& options, uint64_t seed, uint32_t texture)
+{
+    Random random(StreamSeed(seed, kTextureStream, texture));
+
+    uint8_t colors[2][4];
+    for (auto& color : colors)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            color[c] = static_cast<uint8_t>(random.Next() & 0xff);
+        }
+        color[3] = 255;
+    }
+
+    ImageData image;
+    image.width  = options.texture_size;
+    image.height = options.texture_size;
+    image.mips.resize(1);
+
+    auto& texels    = image.mips[0];
+    auto  cell_size = std::max(options.texture_size / kCheckerCells, 1u);
+    texels.resize(std::size_t(image.width) * image.height * 4);
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            auto& color = colors[(x / cell_size + y / cell_size) % 2];
+            std::copy_n(color, 4, &texels[(std::size_t(y) * image.width + x) * 4]);
+        }
+    }
+
+    GenerateMips(image);
+
+    auto file_name = options.output_dir / kTextureDir / GetTextureName(seed, texture);
+    fs::create_directories(file_name.parent_path());
+    // Generated textures have no source image.
+    WriteCookedTexture(CookedTextureFileName(file_name.string()), SourceInfo(), image);
+}
+
+// Material library with a material per texture, or a single untextured material.
+void WriteMaterials(const fs::path& file_name, const SceneParams& params)
+{
+    std::ofstream out(file_name, std::ios::trunc);
+    if (params.textures == 0)
+    {
+        out << "newmtl default\nKd 0.8 0.8 0.8\n";
+    }
+
+    for (uint32_t t = 0; t < params.textures; ++t)
+    {
+        out << "newmtl texture_" << t << "\nKd 0.8 0.8 0.8\nmap_Kd "
+            << GetTextureName(params.seed, t) << '\n';
+    }
+
+    if (!out)
+    {
+        error("scenegen: Couldn't write {}", file_name.string());
+        throw std::runtime_error("scenegen: Couldn't write " + file_name.string());
+    }
+}
+
+// Instances are written as transformed copies, an object each, which the loader turns back
+// into instances of the unique meshes. The material library is named relative to the assets
+// directory, like the output directory is.
+void WriteObj(const fs::path&                  file_name,
+              const SceneParams&               params,
+              const std::vector<MeshData>&     meshes,
+              const std::vector<MeshInstance>& instances)
+{
+    auto mtl_name = fs::path(file_name).replace_extension(".mtl");
+    WriteMaterials(mtl_name, params);
+
+    std::ofstream out(file_name, std::ios::trunc | std::ios::binary);
+
+    fmt::memory_buffer buffer;
+    auto               flush = [&]() {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    fmt::format_to(std::back_inserter(buffer), "mtllib {}\n", mtl_name.filename().string());
+
+    uint32_t first_vertex = 1;
+    for (uint32_t i = 0; i < instances.size(); ++i)
+    {
+        auto& instance = instances[i];
+        auto& mesh     = meshes[instance.mesh];
+        auto& m        = instance.transform;
+        auto  scale    = std::sqrt(m[0] * m[0] + m[4] * m[4] + m[8] * m[8]);
+
+        auto material = instance.texture_index == ~0u
+                            ? std::string("default")
+                            : fmt::format("texture_{}", instance.texture_index);
+
+        fmt::format_to(std::back_inserter(buffer), "o instance_{}\nusemtl {}\n", i, material);
+
+        auto vertex_count = static_cast<uint32_t>(mesh.positions.size() / 3);
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            auto p = &mesh.positions[3 * v];
+            fmt::format_to(std::back_inserter(buffer),
+                           "v {} {} {}\n",
+                           m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3],
+                           m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7],
+                           m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11]);
+        }
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            auto n = &mesh.normals[3 * v];
+            fmt::format_to(std::back_inserter(buffer),
+                           "vn {} {} {}\n",
+                           (m[0] * n[0] + m[1] * n[1] + m[2] * n[2]) / scale,
+                           (m[4] * n[0] + m[5] * n[1] + m[6] * n[2]) / scale,
+                           (m[8] * n[0] + m[9] * n[1] + m[10] * n[2]) / scale);
+        }
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+        {
+            fmt::format_to(std::back_inserter(buffer),
+                           "vt {} {}\n",
+                           mesh.texcoords[2 * v],
+                           mesh.texcoords[2 * v + 1]);
+        }
+
+        for (std::size_t t = 0; t < mesh.indices.size(); t += 3)
+        {
+            auto a = first_vertex + mesh.indices[t];
+            auto b = first_vertex + mesh.indices[t + 1];
+            auto c = first_vertex + mesh.indices[t + 2];
+            fmt::format_to(
+                std::back_inserter(buffer), "f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2}\n", a, b, c);
+
+            if (buffer.size() > kWriteBlockSize)
+            {
+                flush();
+            }
+        }
+
+        first_vertex += vertex_count;
+    }
+
+    flush();
+
+    if (!out)
+    {
+        error("scenegen: Couldn't write {}", file_name.string());
+        throw std::runtime_error("scenegen: Couldn't write " + file_name.string());
+    }
+}
+
+// Generate the unique meshes and place their instances, caches get the levels of detail and
+// vertex order of a cooked scene.
+void GenerateScene(const GenOptions& options, GeneratedScene& generated, tf::Subflow& subflow)
+{
+    auto& params = generated.params;
+
+    std::vector<MeshData> meshes(params.meshes);
+    MeshStats             stats_before, stats_after;
+
+    auto generate = subflow.emplace([&](tf::Subflow& sf) {
+        ParallelFor(sf, params.meshes, [&](uint32_t i) {
+            meshes[i] = GenerateMesh(params.triangles, StreamSeed(params.seed, kMeshStream, i));
+        });
+    });
+    auto optimize = subflow.emplace([&](tf::Subflow& sf) {
+        if (options.format == Format::kCache)
+        {
+            OptimizeMeshes(meshes, stats_before, stats_after, sf);
+        }
+    });
+    auto simplify = subflow.emplace([&](tf::Subflow& sf) {
+        if (options.format == Format::kCache)
+        {
+            GenerateMeshLods(meshes, sf);
+        }
+    });
+
+    generate.precede(optimize);
+    optimize.precede(simplify);
+    subflow.join();
+
+    auto instances           = PlaceInstances(params);
+    auto file_name           = options.output_dir / generated.name;
+    auto face_resolution     = GetFaceResolution(params.triangles);
+    generated.mesh_triangles = 12 * face_resolution * face_resolution;
+
+    // Caches without their source are loaded as is, under the name of the source.
+    if (options.format == Format::kCache)
+    {
+        SourceInfo source;
+        source.hash = HashBytes(generated.name.data(), generated.name.size());
+
+        SceneCache::Write(file_name.string(), source, meshes, instances, {}, {});
+        generated.size = fs::file_size(SceneCache::CacheFileName(file_name.string()));
+    }
+    else
+    {
+        WriteObj(file_name, params, meshes, instances);
+        generated.size = fs::file_size(file_name);
+    }
+}
+
+void WriteManifest(const GenOptions& options, const std::vector<GeneratedScene>& scenes)
+{
+    auto file_name = (options.output_dir / kManifestFileName).string();
+
+    std::ofstream out(file_name, std::ios::trunc);
+    out << "# capsaicin generated scenes v1\n";
+    out << "# scene <file> <instances> <meshes> <triangles per mesh> <textures> <distribution> "
+           "<seed> <total triangles> <bytes>\n";
+
+    for (auto& scene : scenes)
+    {
+        if (!scene.failed)
+        {
+            auto& params = scene.params;
+            out << fmt::format("scene {} {} {} {} {} {} {} {} {}\n",
+                               scene.name,
+                               params.instances,
+                               params.meshes,
+                               scene.mesh_triangles,
+                               params.textures,
+                               DistributionName(params.distribution),
+                               params.seed,
+                               uint64_t(scene.mesh_triangles) * params.instances,
+                               scene.size);
+        }
+    }
+
+    if (!out)
+    {
+        error("scenegen: Couldn't write {}", file_name);
+        throw std::runtime_error("scenegen: Couldn't write " + file_name);
+    }
+}
+
+// Comma separated list of values.
+template <typename T, typename F>
+bool ParseList(const std::string& arg, std::vector<T>& values, F&& parse)
+{
+    values.clear();
+
+    std::size_t start = 0;
+    while (start <= arg.size())
+    {
+        auto end = std::min(arg.find(',', start), arg.size());
+        T    value;
+        if (!parse(arg.substr(start, end - start), value))
+        {
+            return false;
+        }
+
+        values.push_back(value);
+        start = end + 1;
+    }
+
+    return !values.empty();
+}
+
+template <typename T>
+bool ParseNumbers(const std::string& arg, std::vector<T>& values, T min_value)
+{
+    return ParseList(arg, values, [min_value](const std::string& s, T& value) {
+        try
+        {
+            std::size_t length = 0;
+            value              = static_cast<T>(std::stoull(s, &length));
+            return length == s.size() && value >= min_value;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    });
+}
+
+bool ParseDistributions(const std::string& arg, std::vector<Distribution>& values)
+{
+    return ParseList(arg, values, [](const std::string& s, Distribution& value) {
+        for (auto d : {Distribution::kUniform, Distribution::kGrid, Distribution::kClustered})
+        {
+            if (s == DistributionName(d))
+            {
+                value = d;
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+bool ParseOptions(int argc, char** argv, GenOptions& options)
+{
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg   = argv[i];
+        auto        value = i + 1 < argc ? std::string(argv[i + 1]) : std::string();
+        auto        valid = true;
+
+        if (arg == "-n" || arg == "--instances")
+        {
+            valid = ParseNumbers(value, options.instances, 1u);
+        }
+        else if (arg == "-m" || arg == "--meshes")
+        {
+            valid = ParseNumbers(value, options.meshes, 1u);
+        }
+        else if (arg == "-t" || arg == "--triangles")
+        {
+            valid = ParseNumbers(value, options.triangles, 1u);
+        }
+        else if (arg == "-x" || arg == "--textures")
+        {
+            valid = ParseNumbers(value, options.textures, 0u);
+        }
+        else if (arg == "-d" || arg == "--distribution")
+        {
+            valid = ParseDistributions(value, options.distributions);
+        }
+        else if (arg == "-s" || arg == "--seed")
+        {
+            valid = ParseNumbers(value, options.seeds, uint64_t(0));
+        }
+        else if (arg == "--texture-size")
+        {
+            std::vector<uint32_t> sizes;
+            valid                = ParseNumbers(value, sizes, 1u) && sizes.size() == 1;
+            options.texture_size = valid ? sizes[0] : 0;
+        }
+        else if (arg == "-j" || arg == "--threads")
+        {
+            std::vector<uint32_t> threads;
+            valid               = ParseNumbers(value, threads, 0u) && threads.size() == 1;
+            options.num_threads = valid ? threads[0] : 0;
+        }
+        else if (arg == "--cache")
+        {
+            options.format = Format::kCache;
+            continue;
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            positional.push_back(arg);
+            continue;
+        }
+
+        if (!valid || i + 1 >= argc)
+        {
+            return false;
+        }
+        ++i;
+    }
+
+    if (positional.size() != 1)
+    {
+        return false;
+    }
+
+    options.output_dir = positional[0];
+    return true;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    GenOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: scenegen <output dir> [-n <instances>] [-m <unique meshes>]\n"
+                     "       [-t <triangles per mesh>] [-x <textures>]\n"
+                     "       [-d uniform|grid|clustered] [-s <seed>] [--texture-size <size>]\n"
+                     "       [--cache] [-j <threads>]\n"
+                     "Parameters but the texture size take comma separated lists, a scene is\n"
+                     "generated for each combination.\n";
+        return 1;
+    }
+
+    if (options.num_threads == 0)
+    {
+        options.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    try
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<GeneratedScene> scenes;
+        for (auto seed : options.seeds)
+        {
+            for (auto distribution : options.distributions)
+            {
+                for (auto instances : options.instances)
+                {
+                    for (auto meshes : options.meshes)
+                    {
+                        for (auto triangles : options.triangles)
+                        {
+                            for (auto textures : options.textures)
+                            {
+                                GeneratedScene scene;
+                                scene.params.instances    = instances;
+                                scene.params.meshes       = std::min(meshes, instances);
+                                scene.params.triangles    = triangles;
+                                scene.params.textures     = textures;
+                                scene.params.distribution = distribution;
+                                scene.params.seed         = seed;
+                                scene.name                = GetSceneName(scene.params);
+                                scenes.push_back(scene);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        auto max_textures =
+            *std::max_element(options.textures.cbegin(), options.textures.cend());
+
+        info("scenegen: {} scenes, {} textures per seed, {} threads",
+             scenes.size(),
+             max_textures,
+             options.num_threads);
+
+        fs::create_directories(options.output_dir);
+
+        tf::Executor executor(options.num_threads);
+        tf::Taskflow taskflow;
+
+        // Scenes of a seed share its textures, which are needed for all of them.
+        std::atomic<bool> textures_failed = false;
+        for (auto seed : options.seeds)
+        {
+            for (uint32_t t = 0; t < max_textures; ++t)
+            {
+                taskflow.emplace([&options, &textures_failed, seed, t]() {
+                    try
+                    {
+                        GenerateTexture(options, seed, t);
+                    }
+                    catch (std::exception& e)
+                    {
+                        error("scenegen: Texture {} failed: {}", GetTextureName(seed, t), e.what());
+                        textures_failed = true;
+                    }
+                });
+            }
+        }
+
+        for (auto& scene : scenes)
+        {
+            taskflow.emplace([&options, &scene](tf::Subflow& subflow) {
+                try
+                {
+                    info("scenegen: Generating {}", scene.name);
+                    GenerateScene(options, scene, subflow);
+                }
+                catch (std::exception& e)
+                {
+                    error("scenegen: {} failed: {}", scene.name, e.what());
+                    scene.failed = true;
+                }
+            });
+        }
+
+        executor.run(taskflow).wait();
+
+        WriteManifest(options, scenes);
+
+        auto num_failed = std::count_if(
+            scenes.cbegin(), scenes.cend(), [](const GeneratedScene& s) { return s.failed; });
+
+        info("scenegen: Done in {} s, {} failed",
+             std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start)
+                 .count(),
+             num_failed);
+
+        return num_failed == 0 && !textures_failed ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        error("scenegen: {}", e.what());
+        return 1;
+    }
+}
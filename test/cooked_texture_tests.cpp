@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+#include "src/asset/image.h"
+
+using namespace capsaicin;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Source file and a cooked 2x2 texture recording it, in a scratch directory.
+class CookedTextureFixture
+{
+public:
+    CookedTextureFixture()
+    {
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+        WriteSource("source");
+
+        image_.width  = 2;
+        image_.height = 2;
+        image_.mips   = {std::vector<uint8_t>(16, 128)};
+        GenerateMips(image_);
+
+        WriteCookedTexture(cooked_.string(), GetSourceInfo(source_.string(), true), image_);
+    }
+
+    ~CookedTextureFixture() { fs::remove_all(dir_); }
+
+    void WriteSource(const std::string& contents) const
+    {
+        std::ofstream(source_, std::ios::binary | std::ios::trunc) << contents;
+    }
+
+    bool Load(const std::string& source_file_name) const
+    {
+        ImageData image;
+        return LoadCookedTexture(cooked_.string(), source_file_name, image) &&
+               image.mips == image_.mips;
+    }
+
+    const fs::path dir_    = fs::temp_directory_path() / "capsaicin_cooked_texture_tests";
+    const fs::path source_ = dir_ / "texture.png";
+    const fs::path cooked_ = dir_ / "texture.png.ctex";
+    ImageData      image_;
+};
+}  // namespace
+
+TEST_CASE_METHOD(CookedTextureFixture, "Cooked textures load while their source is unchanged",
+                 "[cooked_texture]")
+{
+    REQUIRE(Load(source_.string()));
+
+    // Touching the source keeps the texture.
+    fs::last_write_time(source_, fs::last_write_time(source_) + std::chrono::hours(1));
+    REQUIRE(Load(source_.string()));
+}
+
+TEST_CASE_METHOD(CookedTextureFixture, "Cooked textures are stale once their source changes",
+                 "[cooked_texture]")
+{
+    WriteSource("changed");
+    REQUIRE_FALSE(Load(source_.string()));
+
+    // Reads without a source and textures without one next to them aren't checked.
+    REQUIRE(Load({}));
+    fs::remove(source_);
+    REQUIRE(Load(source_.string()));
+}
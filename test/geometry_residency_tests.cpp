@@ -0,0 +1,165 @@
+#include <catch2/catch.hpp>
+
+#include <set>
+
+#include "src/asset/geometry_residency.h"
+
+using namespace capsaicin;
+
+namespace
+{
+// Pool which records the meshes paged in and out, and refuses a number of uploads as if it
+// were too fragmented for them.
+class MockPool : public ResidencyPool
+{
+public:
+    bool MakeResident(uint32_t mesh) override
+    {
+        if (refusals > 0)
+        {
+            --refusals;
+            return false;
+        }
+
+        loads.push_back(mesh);
+        resident.insert(mesh);
+        return true;
+    }
+
+    void Evict(uint32_t mesh) override
+    {
+        evictions.push_back(mesh);
+        resident.erase(mesh);
+    }
+
+    uint32_t              refusals = 0;
+    std::vector<uint32_t> loads;
+    std::vector<uint32_t> evictions;
+    std::set<uint32_t>    resident;
+};
+
+constexpr uint64_t kMeshSize = 100;
+
+// Meshes with an instance each, 10 units apart along x from x = 10.
+void AddRow(GeometryResidency& residency, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        BoundsComponent bounds;
+        bounds.center[0] = 10.f * static_cast<float>(i + 1);
+        bounds.radius    = 1.f;
+        residency.AddInstance(residency.AddMesh(kMeshSize), bounds);
+    }
+}
+
+// Residency and the pool agree on the resident meshes, which fit the budget.
+void CheckConsistent(const GeometryResidency& residency, const MockPool& pool)
+{
+    uint64_t size = 0;
+    for (uint32_t m = 0; m < residency.mesh_count(); ++m)
+    {
+        REQUIRE(residency.resident(m) == (pool.resident.count(m) > 0));
+        size += residency.resident(m) ? kMeshSize : 0;
+    }
+
+    REQUIRE(residency.resident_count() == pool.resident.size());
+    REQUIRE(residency.resident_size() == size);
+    REQUIRE(residency.resident_size() <= residency.budget());
+}
+
+const float kNear[3] = {0.f, 0.f, 0.f};
+const float kFar[3]  = {60.f, 0.f, 0.f};
+}  // namespace
+
+TEST_CASE("Nearest meshes within the budget are paged in", "[geometry_residency]")
+{
+    GeometryResidency residency(300, 1000);
+    MockPool          pool;
+    AddRow(residency, 6);
+
+    REQUIRE(residency.Update(kNear, pool));
+    REQUIRE(pool.loads == std::vector<uint32_t>{0, 1, 2});
+    REQUIRE(pool.evictions.empty());
+    CheckConsistent(residency, pool);
+
+    // A resident working set needs no uploads.
+    REQUIRE(residency.Update(kNear, pool));
+    REQUIRE(pool.loads.size() == 3);
+}
+
+TEST_CASE("Lowest ranked meshes are evicted for new ones", "[geometry_residency]")
+{
+    GeometryResidency residency(300, 1000);
+    MockPool          pool;
+    AddRow(residency, 6);
+    REQUIRE(residency.Update(kNear, pool));
+
+    REQUIRE(residency.Update(kFar, pool));
+    REQUIRE(pool.loads == std::vector<uint32_t>{0, 1, 2, 5, 4, 3});
+    REQUIRE(pool.evictions == std::vector<uint32_t>{0, 1, 2});
+    CheckConsistent(residency, pool);
+}
+
+TEST_CASE("Loads are spread over updates", "[geometry_residency]")
+{
+    GeometryResidency residency(300, 100);
+    MockPool          pool;
+    AddRow(residency, 6);
+
+    REQUIRE_FALSE(residency.Update(kNear, pool));
+    REQUIRE(pool.loads == std::vector<uint32_t>{0});
+    REQUIRE_FALSE(residency.Update(kNear, pool));
+    REQUIRE(residency.Update(kNear, pool));
+    REQUIRE(pool.loads == std::vector<uint32_t>{0, 1, 2});
+
+    // Meshes which left the working set stay resident until their space is needed.
+    REQUIRE_FALSE(residency.Update(kFar, pool));
+    REQUIRE(pool.evictions == std::vector<uint32_t>{0});
+    REQUIRE(residency.resident(1));
+    REQUIRE(residency.resident(2));
+    CheckConsistent(residency, pool);
+}
+
+TEST_CASE("Meshes are evicted until a fragmented pool takes the upload", "[geometry_residency]")
+{
+    GeometryResidency residency(300, 1000);
+    MockPool          pool;
+    AddRow(residency, 6);
+    REQUIRE(residency.Update(kNear, pool));
+
+    pool.refusals = 1;
+    REQUIRE(residency.Update(kFar, pool));
+    REQUIRE(pool.evictions == std::vector<uint32_t>{0, 1, 2});
+    REQUIRE(pool.loads == std::vector<uint32_t>{0, 1, 2, 5, 4, 3});
+    CheckConsistent(residency, pool);
+}
+
+TEST_CASE("A pool without space for the working set stops the update", "[geometry_residency]")
+{
+    GeometryResidency residency(300, 1000);
+    MockPool          pool;
+    AddRow(residency, 6);
+
+    pool.refusals = 1;
+    REQUIRE_FALSE(residency.Update(kNear, pool));
+    REQUIRE(pool.loads.empty());
+    CheckConsistent(residency, pool);
+
+    // The next update tries again.
+    REQUIRE(residency.Update(kNear, pool));
+    CheckConsistent(residency, pool);
+}
+
+TEST_CASE("Clearing evicts all resident meshes", "[geometry_residency]")
+{
+    GeometryResidency residency(300, 1000);
+    MockPool          pool;
+    AddRow(residency, 6);
+    REQUIRE(residency.Update(kNear, pool));
+
+    residency.Clear(pool);
+    REQUIRE(pool.resident.empty());
+    REQUIRE(residency.resident_count() == 0);
+    REQUIRE(residency.resident_size() == 0);
+    CheckConsistent(residency, pool);
+}
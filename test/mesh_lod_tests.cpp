@@ -0,0 +1,93 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <limits>
+
+#include "src/asset/mesh_simplifier.h"
+
+using namespace capsaicin;
+
+namespace
+{
+// Height field of size x size quads over the unit square, with gentle waves so that
+// simplification has a cost.
+MeshData MakeGrid(uint32_t size)
+{
+    MeshData mesh;
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+        {
+            auto u = static_cast<float>(x) / static_cast<float>(size);
+            auto v = static_cast<float>(y) / static_cast<float>(size);
+            mesh.positions.insert(mesh.positions.end(),
+                                  {u, v, 0.05f * std::sin(6.f * u) * std::cos(4.f * v)});
+        }
+    }
+
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            auto i = y * (size + 1) + x;
+            mesh.indices.insert(mesh.indices.end(),
+                                {i, i + 1, i + size + 1, i + 1, i + size + 2, i + size + 1});
+        }
+    }
+    return mesh;
+}
+
+const float kErrors[3] = {0.01f, 0.02f, 0.04f};
+}  // namespace
+
+TEST_CASE("Dense meshes get the maximum number of levels of detail", "[mesh_lod]")
+{
+    auto mesh = MakeGrid(64);
+    GenerateMeshLods(mesh);
+
+    REQUIRE(mesh.lods.size() == kMaxMeshLods);
+
+    auto previous_count = mesh.indices.size();
+    auto previous_error = 0.f;
+    for (auto& lod : mesh.lods)
+    {
+        REQUIRE(lod.indices.size() % 3 == 0);
+        REQUIRE(static_cast<float>(lod.indices.size()) <=
+                0.75f * static_cast<float>(previous_count));
+        REQUIRE(lod.error >= previous_error);
+        previous_count = lod.indices.size();
+        previous_error = lod.error;
+    }
+}
+
+TEST_CASE("Small meshes get no levels of detail", "[mesh_lod]")
+{
+    auto mesh = MakeGrid(4);
+    GenerateMeshLods(mesh);
+
+    REQUIRE(mesh.lods.empty());
+}
+
+TEST_CASE("The coarsest level within the projected error is selected", "[mesh_lod]")
+{
+    // Errors project to 1/100 of their size.
+    REQUIRE(SelectMeshLod(kErrors, 3, 1.f, 0.01f, 1e-4f) == 1);
+    REQUIRE(SelectMeshLod(kErrors, 3, 1.f, 0.01f, 2e-4f) == 2);
+    REQUIRE(SelectMeshLod(kErrors, 3, 1.f, 0.01f, 1.f) == 3);
+    REQUIRE(SelectMeshLod(kErrors, 3, 1.f, 0.01f, 5e-5f) == 0);
+
+    // Scaled instances project their radius, the ratio to the object space radius scales the
+    // errors.
+    REQUIRE(SelectMeshLod(kErrors, 3, 2.f, 0.01f, 1e-4f) == 2);
+
+    // Only the given levels are selected.
+    REQUIRE(SelectMeshLod(kErrors, 1, 1.f, 0.01f, 1.f) == 1);
+    REQUIRE(SelectMeshLod(kErrors, 0, 1.f, 0.01f, 1.f) == 0);
+}
+
+TEST_CASE("Instances around the eye or without bounds keep full resolution", "[mesh_lod]")
+{
+    auto inside = std::numeric_limits<float>::infinity();
+    REQUIRE(SelectMeshLod(kErrors, 3, 1.f, inside, 1.f) == 0);
+    REQUIRE(SelectMeshLod(kErrors, 3, 0.f, 0.01f, 1.f) == 0);
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+
+#include "src/asset/obj_parser.h"
+
+using namespace capsaicin;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Scene file in a scratch directory, parsed on a single thread.
+class ObjParserFixture
+{
+public:
+    ObjParserFixture()
+    {
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+    }
+
+    ~ObjParserFixture() { fs::remove_all(dir_); }
+
+    void Parse(const std::string& contents, ObjData& obj_data) const
+    {
+        std::ofstream(scene_, std::ios::binary | std::ios::trunc) << contents;
+
+        // Errors are rethrown once the taskflow finished.
+        std::exception_ptr exception;
+
+        tf::Executor executor(1);
+        tf::Taskflow taskflow;
+        taskflow.emplace([&](tf::Subflow& subflow) {
+            try
+            {
+                ParseObjFile(scene_.string(), obj_data, subflow);
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+        });
+        executor.run(taskflow).wait();
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    const fs::path dir_   = fs::temp_directory_path() / "capsaicin_obj_parser_tests";
+    const fs::path scene_ = dir_ / "scene.obj";
+};
+
+const std::string kVertices = "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\n";
+}  // namespace
+
+TEST_CASE_METHOD(ObjParserFixture, "Omitted attributes are marked missing", "[obj_parser]")
+{
+    ObjData obj_data;
+    Parse(kVertices + "f 1//1 2 -1//-1\n", obj_data);
+
+    REQUIRE(obj_data.indices.size() == 3);
+    REQUIRE(obj_data.indices[0].normal_index == 0);
+    REQUIRE(obj_data.indices[1].normal_index == -1);
+    REQUIRE(obj_data.indices[1].texcoord_index == -1);
+    REQUIRE(obj_data.indices[2].vertex_index == 2);
+    REQUIRE(obj_data.indices[2].normal_index == 0);
+}
+
+TEST_CASE_METHOD(ObjParserFixture, "Relative indices before the first attribute are rejected",
+                 "[obj_parser]")
+{
+    ObjData obj_data;
+
+    SECTION("Resolved to -1")
+    {
+        REQUIRE_THROWS_WITH(Parse(kVertices + "f 1//-2 2//1 3//1\n", obj_data),
+                            Catch::Contains("face index out of range"));
+    }
+
+    SECTION("Resolved below -1")
+    {
+        REQUIRE_THROWS_WITH(Parse(kVertices + "f -5 2 3\n", obj_data),
+                            Catch::Contains("face index out of range"));
+    }
+}
@@ -0,0 +1,124 @@
+#include <catch2/catch.hpp>
+
+#include "src/utils/range_allocator.h"
+
+using namespace capsaicin;
+
+TEST_CASE("Ranges are allocated from the smallest free range which fits", "[range_allocator]")
+{
+    RangeAllocator allocator(100);
+
+    REQUIRE(allocator.Allocate(10) == 0);
+    REQUIRE(allocator.Allocate(30) == 10);
+    REQUIRE(allocator.Allocate(10) == 40);
+    REQUIRE(allocator.Allocate(20) == 50);
+    REQUIRE(allocator.Allocate(10) == 70);
+
+    // Free ranges of 30 at 10, 20 at 50 and 20 at 80.
+    allocator.Free(10);
+    allocator.Free(50);
+    REQUIRE(allocator.used() == 30);
+    REQUIRE(allocator.largest_free() == 30);
+
+    // Ties take the lowest offset.
+    REQUIRE(allocator.Allocate(15) == 50);
+    REQUIRE(allocator.Allocate(25) == 10);
+    REQUIRE(allocator.Allocate(20) == 80);
+    REQUIRE(allocator.Allocate(10) == RangeAllocator::kInvalidOffset);
+}
+
+TEST_CASE("Empty ranges get their own offsets", "[range_allocator]")
+{
+    RangeAllocator allocator(2);
+
+    REQUIRE(allocator.Allocate(0) == 0);
+    REQUIRE(allocator.Allocate(0) == 1);
+    REQUIRE(allocator.Allocate(0) == RangeAllocator::kInvalidOffset);
+}
+
+TEST_CASE("Freed ranges merge with both neighbours", "[range_allocator]")
+{
+    RangeAllocator allocator(30);
+    REQUIRE(allocator.Allocate(10) == 0);
+    REQUIRE(allocator.Allocate(10) == 10);
+    REQUIRE(allocator.Allocate(10) == 20);
+
+    allocator.Free(0);
+    allocator.Free(20);
+    REQUIRE(allocator.largest_free() == 10);
+    REQUIRE(allocator.fragmented() == 10);
+    REQUIRE(allocator.fragmentation() == 0.5f);
+
+    allocator.Free(10);
+    REQUIRE(allocator.used() == 0);
+    REQUIRE(allocator.largest_free() == 30);
+    REQUIRE(allocator.fragmentation() == 0.f);
+    REQUIRE(allocator.Allocate(30) == 0);
+}
+
+TEST_CASE("Freeing an unknown offset throws", "[range_allocator]")
+{
+    RangeAllocator allocator(30);
+    REQUIRE(allocator.Allocate(10) == 0);
+
+    REQUIRE_THROWS(allocator.Free(5));
+    allocator.Free(0);
+    REQUIRE_THROWS(allocator.Free(0));
+}
+
+TEST_CASE("Growing keeps offsets and extends the last free range", "[range_allocator]")
+{
+    RangeAllocator allocator(20);
+    REQUIRE(allocator.Allocate(10) == 0);
+    REQUIRE(allocator.Allocate(20) == RangeAllocator::kInvalidOffset);
+
+    allocator.Grow(40);
+    REQUIRE(allocator.capacity() == 40);
+    REQUIRE(allocator.largest_free() == 30);
+    REQUIRE(allocator.Allocate(30) == 10);
+
+    // Smaller capacities are ignored.
+    allocator.Grow(10);
+    REQUIRE(allocator.capacity() == 40);
+
+    allocator.Free(0);
+    allocator.Free(10);
+    REQUIRE(allocator.largest_free() == 40);
+}
+
+TEST_CASE("Defragmenting packs ranges in order", "[range_allocator]")
+{
+    RangeAllocator allocator(100);
+    REQUIRE(allocator.Allocate(10) == 0);
+    REQUIRE(allocator.Allocate(20) == 10);
+    REQUIRE(allocator.Allocate(10) == 30);
+    REQUIRE(allocator.Allocate(30) == 40);
+    REQUIRE(allocator.Allocate(10) == 70);
+
+    allocator.Free(0);
+    allocator.Free(30);
+
+    auto moves = allocator.Defragment();
+    REQUIRE(moves.size() == 3);
+    REQUIRE(moves[0].from == 10);
+    REQUIRE(moves[0].to == 0);
+    REQUIRE(moves[0].size == 20);
+    REQUIRE(moves[1].from == 40);
+    REQUIRE(moves[1].to == 20);
+    REQUIRE(moves[1].size == 30);
+    REQUIRE(moves[2].from == 70);
+    REQUIRE(moves[2].to == 50);
+    REQUIRE(moves[2].size == 10);
+
+    REQUIRE(allocator.used() == 60);
+    REQUIRE(allocator.largest_free() == 40);
+    REQUIRE(allocator.fragmentation() == 0.f);
+
+    // Ranges are known by their new offsets only.
+    REQUIRE_THROWS(allocator.Free(40));
+    allocator.Free(20);
+    REQUIRE(allocator.Allocate(30) == 20);
+
+    // A packed pool has nothing to move.
+    REQUIRE(allocator.Defragment().empty());
+}
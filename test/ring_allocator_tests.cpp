@@ -0,0 +1,86 @@
+#include <catch2/catch.hpp>
+
+#include "src/utils/ring_allocator.h"
+
+using namespace capsaicin;
+
+TEST_CASE("Ring allocations are aligned and consecutive", "[ring_allocator]")
+{
+    RingAllocator ring(1024);
+
+    REQUIRE(ring.Allocate(100) == 0);
+    REQUIRE(ring.Allocate(16, 256) == 256);
+    REQUIRE(ring.Allocate(10) == 272);
+    REQUIRE(ring.used() == 282);
+}
+
+TEST_CASE("Ring allocations don't wrap around the end", "[ring_allocator]")
+{
+    RingAllocator ring(1024);
+
+    REQUIRE(ring.Allocate(600) == 0);
+    ring.Submit(1);
+    REQUIRE(ring.Allocate(300) == 600);
+    ring.Submit(2);
+    ring.Retire(1);
+
+    // The rest of the ring after 900 is skipped for the start, which the first frame freed.
+    REQUIRE(ring.Allocate(200) == 0);
+    REQUIRE(ring.used() == 1024 - 600 + 200);
+}
+
+TEST_CASE("Ring space is reused once its fence retires", "[ring_allocator]")
+{
+    RingAllocator ring(1024);
+
+    REQUIRE(ring.Allocate(512) == 0);
+    ring.Submit(1);
+    REQUIRE(ring.Allocate(512) == 512);
+    ring.Submit(2);
+    REQUIRE(ring.pending_submissions() == 2);
+
+    // Full until the GPU passes the first fence.
+    REQUIRE(ring.Allocate(1) == RingAllocator::kInvalidOffset);
+    ring.Retire(0);
+    REQUIRE(ring.Allocate(1) == RingAllocator::kInvalidOffset);
+
+    ring.Retire(1);
+    REQUIRE(ring.pending_submissions() == 1);
+    REQUIRE(ring.Allocate(256) == 0);
+    ring.Submit(3);
+
+    // Retiring a later fence frees all earlier submissions.
+    ring.Retire(3);
+    REQUIRE(ring.pending_submissions() == 0);
+    REQUIRE(ring.used() == 0);
+}
+
+TEST_CASE("Submissions without allocations are not tracked", "[ring_allocator]")
+{
+    RingAllocator ring(1024);
+
+    ring.Submit(1);
+    REQUIRE(ring.pending_submissions() == 0);
+
+    REQUIRE(ring.Allocate(64) == 0);
+    ring.Submit(2);
+    ring.Submit(3);
+    REQUIRE(ring.pending_submissions() == 1);
+}
+
+TEST_CASE("Oversize ring allocations fail", "[ring_allocator]")
+{
+    RingAllocator ring(1024);
+
+    REQUIRE(ring.Allocate(1025) == RingAllocator::kInvalidOffset);
+    REQUIRE(ring.used() == 0);
+
+    // An empty ring fits the whole capacity from its start, wherever the last allocation ended.
+    REQUIRE(ring.Allocate(100) == 0);
+    ring.Submit(1);
+    ring.Retire(1);
+    REQUIRE(ring.Allocate(1024) == 0);
+
+    RingAllocator empty;
+    REQUIRE(empty.Allocate(1) == RingAllocator::kInvalidOffset);
+}
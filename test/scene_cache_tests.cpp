@@ -0,0 +1,127 @@
+#include <catch2/catch.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+#include "src/asset/scene_cache.h"
+
+using namespace capsaicin;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Scene file and material library in a scratch directory, with a cache for a single triangle.
+class SceneCacheFixture
+{
+public:
+    SceneCacheFixture()
+    {
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+        WriteFile(scene_, "mtllib scene.mtl\n");
+        WriteFile(library_, "newmtl a\n");
+    }
+
+    ~SceneCacheFixture() { fs::remove_all(dir_); }
+
+    static void WriteFile(const fs::path& path, const std::string& contents)
+    {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+    }
+
+    void WriteCache(std::vector<uint32_t> indices, bool compress_indices = false)
+    {
+        MeshData mesh;
+        mesh.positions = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f, 0.f};
+        mesh.normals   = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 0.f, 0.f, 1.f};
+        mesh.texcoords = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f};
+        mesh.indices   = std::move(indices);
+
+        SceneCache::Write(scene_.string(),
+                          GetSourceInfo(scene_.string(), true),
+                          {mesh},
+                          {MeshInstance()},
+                          {"scene.mtl"},
+                          {GetDependencyInfo(library_.string())},
+                          compress_indices);
+    }
+
+    std::unique_ptr<SceneCache> Open() const
+    {
+        std::unique_ptr<SceneCache> cache;
+
+        tf::Executor executor(1);
+        tf::Taskflow taskflow;
+        taskflow.emplace([&](tf::Subflow& subflow) {
+            cache = SceneCache::Open(scene_.string(), (dir_ / "").string(), subflow);
+        });
+        executor.run(taskflow).wait();
+
+        return cache;
+    }
+
+    const fs::path dir_     = fs::temp_directory_path() / "capsaicin_scene_cache_tests";
+    const fs::path scene_   = dir_ / "scene.obj";
+    const fs::path library_ = dir_ / "scene.mtl";
+};
+}  // namespace
+
+TEST_CASE_METHOD(SceneCacheFixture, "Scene caches are opened while sources are unchanged",
+                 "[scene_cache]")
+{
+    WriteCache({0, 1, 2});
+
+    auto cache = Open();
+    REQUIRE(cache);
+    REQUIRE(cache->mesh_count() == 1);
+    REQUIRE(cache->mesh(0).indices[2] == 2);
+    REQUIRE(cache->material_libs() == std::vector<std::string>{"scene.mtl"});
+}
+
+TEST_CASE_METHOD(SceneCacheFixture, "Scene caches are stale once a material library changes",
+                 "[scene_cache]")
+{
+    WriteCache({0, 1, 2});
+
+    SECTION("Changed library")
+    {
+        WriteFile(library_, "newmtl b\n");
+        REQUIRE_FALSE(Open());
+    }
+
+    SECTION("Removed library")
+    {
+        fs::remove(library_);
+        REQUIRE_FALSE(Open());
+    }
+}
+
+TEST_CASE_METHOD(SceneCacheFixture, "Touched sources are only hashed once", "[scene_cache]")
+{
+    WriteCache({0, 1, 2});
+
+    // Touching the sources without changing them keeps the cache, and records their times.
+    auto scene_time   = fs::last_write_time(scene_) + std::chrono::hours(1);
+    auto library_time = fs::last_write_time(library_) + std::chrono::hours(1);
+    fs::last_write_time(scene_, scene_time);
+    fs::last_write_time(library_, library_time);
+    REQUIRE(Open());
+
+    // Contents of the same size with recorded times aren't hashed, so they pass for unchanged.
+    WriteFile(library_, "newmtl b\n");
+    fs::last_write_time(library_, library_time);
+    REQUIRE(Open());
+}
+
+TEST_CASE_METHOD(SceneCacheFixture, "Scene caches with indices out of range are rejected",
+                 "[scene_cache]")
+{
+    auto compress_indices = GENERATE(false, true);
+
+    WriteCache({0, 1, 3}, compress_indices);
+    REQUIRE_FALSE(Open());
+
+    WriteCache({0, 1, 2}, compress_indices);
+    REQUIRE(Open());
+}
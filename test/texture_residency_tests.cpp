@@ -0,0 +1,185 @@
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <numeric>
+
+#include "src/asset/texture_residency.h"
+
+using namespace capsaicin;
+
+namespace
+{
+// Backend which keeps reads in flight until they are completed, and records every change of
+// the first resident mip in order.
+class FakeBackend : public TextureStreamingBackend
+{
+public:
+    void ReadMip(uint32_t texture, uint32_t mip) override { reads.emplace_back(texture, mip); }
+
+    void SetFirstMip(uint32_t texture, uint32_t first_mip) override
+    {
+        first_mips.emplace_back(texture, first_mip);
+    }
+
+    // Complete all reads in flight in the order they started.
+    void CompleteReads(TextureResidency& residency, bool read = true)
+    {
+        auto pending = std::move(reads);
+        reads.clear();
+        for (auto& r : pending)
+        {
+            residency.MipRead(r.first, r.second, read, *this);
+        }
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> reads;
+    std::vector<std::pair<uint32_t, uint32_t>> first_mips;
+};
+
+// Mips of 256, 64, 16 and 4 bytes, or 128 bytes for mip 1 of a large texture, with the last
+// two mips as the tail.
+constexpr uint32_t kTailMip      = 2;
+constexpr uint64_t kTailSize     = 20;
+constexpr uint64_t kMipSize      = 64;
+constexpr uint64_t kLargeMipSize = 128;
+
+void AddTexture(TextureResidency& residency, uint32_t texture, bool large = false)
+{
+    residency.SetTexture(texture, {256, large ? kLargeMipSize : kMipSize, 16, 4}, kTailMip);
+}
+
+// Tails stay resident, and resident mips and reads in flight fit the budget.
+void CheckResidency(const TextureResidency& residency)
+{
+    uint64_t resident_size = 0;
+    for (uint32_t texture = 0; texture < residency.texture_count(); ++texture)
+    {
+        auto& t = residency.texture(texture);
+        REQUIRE(t.first_mip <= t.tail_mip);
+        resident_size +=
+            std::accumulate(t.mip_sizes.begin() + t.first_mip, t.mip_sizes.end(), uint64_t(0));
+    }
+
+    REQUIRE(residency.resident_size() == resident_size);
+    REQUIRE(residency.resident_size() + residency.read_size() <= residency.budget());
+}
+}  // namespace
+
+TEST_CASE("Textures stream finer mips one at a time", "[texture_residency]")
+{
+    TextureResidency residency(1000, 4);
+    FakeBackend      backend;
+    AddTexture(residency, 0);
+    REQUIRE(residency.resident_size() == kTailSize);
+
+    residency.Update({{0, 0, 1}}, backend);
+    REQUIRE(backend.reads == std::vector<std::pair<uint32_t, uint32_t>>{{0, 1}});
+    REQUIRE(residency.read_size() == kMipSize);
+
+    // A read in flight holds back the next one.
+    residency.Update({{0, 0, 1}}, backend);
+    REQUIRE(residency.started_read_count() == 0);
+
+    backend.CompleteReads(residency);
+    REQUIRE(residency.texture(0).first_mip == 1);
+    REQUIRE(backend.first_mips == std::vector<std::pair<uint32_t, uint32_t>>{{0, 1}});
+
+    residency.Update({{0, 0, 1}}, backend);
+    backend.CompleteReads(residency);
+    REQUIRE(residency.texture(0).first_mip == 0);
+    CheckResidency(residency);
+}
+
+TEST_CASE("Least recently requested mips are evicted first", "[texture_residency]")
+{
+    TextureResidency residency(3 * kTailSize + 2 * kMipSize, 4);
+    FakeBackend      backend;
+    AddTexture(residency, 0);
+    AddTexture(residency, 1);
+    AddTexture(residency, 2);
+
+    residency.Update({{0, 1, 1}, {1, 1, 1}}, backend);
+    backend.CompleteReads(residency);
+    residency.Update({{1, 1, 1}}, backend);
+    REQUIRE(residency.eviction_count() == 0);
+
+    residency.Update({{2, 1, 1}}, backend);
+    REQUIRE(residency.eviction_count() == 1);
+    REQUIRE(residency.texture(0).first_mip == kTailMip);
+    REQUIRE(residency.texture(1).first_mip == 1);
+    REQUIRE(backend.first_mips.back() == std::make_pair(0u, kTailMip));
+    CheckResidency(residency);
+}
+
+TEST_CASE("Ties evict the largest mip", "[texture_residency]")
+{
+    TextureResidency residency(3 * kTailSize + kMipSize + kLargeMipSize, 4);
+    FakeBackend      backend;
+    AddTexture(residency, 0);
+    AddTexture(residency, 1, true);
+    AddTexture(residency, 2);
+
+    residency.Update({{0, 1, 1}, {1, 1, 1}}, backend);
+    backend.CompleteReads(residency);
+
+    // Evicting the large mip alone makes room.
+    residency.Update({{2, 1, 1}}, backend);
+    REQUIRE(residency.eviction_count() == 1);
+    REQUIRE(residency.texture(0).first_mip == 1);
+    REQUIRE(residency.texture(1).first_mip == kTailMip);
+    CheckResidency(residency);
+}
+
+TEST_CASE("Mips requested by the update and tails are never evicted", "[texture_residency]")
+{
+    TextureResidency residency(2 * kTailSize + kMipSize, 4);
+    FakeBackend      backend;
+    AddTexture(residency, 0);
+    AddTexture(residency, 1);
+
+    residency.Update({{0, 1, 1}}, backend);
+    backend.CompleteReads(residency);
+
+    // The resident mip is requested as well, so the read waits.
+    residency.Update({{0, 1, 1}, {1, 1, 1}}, backend);
+    REQUIRE(residency.started_read_count() == 0);
+    REQUIRE(residency.eviction_count() == 0);
+
+    // Mips are streamed and evicted under pressure, but the budget and tails hold.
+    for (uint32_t i = 0; i < 32; ++i)
+    {
+        residency.Update({{i % 2, i % 3, 1 + i % 5}}, backend);
+        CheckResidency(residency);
+        if (i % 3 != 0)
+        {
+            backend.CompleteReads(residency);
+            CheckResidency(residency);
+        }
+    }
+
+    // Nothing but tails fits a budget of tails.
+    TextureResidency tails(2 * kTailSize, 4);
+    AddTexture(tails, 0);
+    AddTexture(tails, 1);
+    tails.Update({{0, 0, 1}, {1, 0, 1}}, backend);
+    REQUIRE(tails.started_read_count() == 0);
+    REQUIRE(tails.eviction_count() == 0);
+    CheckResidency(tails);
+}
+
+TEST_CASE("Failed reads stop streaming the texture", "[texture_residency]")
+{
+    TextureResidency residency(1000, 4);
+    FakeBackend      backend;
+    AddTexture(residency, 0);
+
+    residency.Update({{0, 0, 1}}, backend);
+    backend.CompleteReads(residency, false);
+    REQUIRE(residency.texture(0).failed);
+    REQUIRE(residency.read_size() == 0);
+
+    residency.Update({{0, 0, 1}}, backend);
+    REQUIRE(residency.started_read_count() == 0);
+    REQUIRE(residency.texture(0).first_mip == kTailMip);
+    CheckResidency(residency);
+}
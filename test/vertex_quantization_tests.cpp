@@ -0,0 +1,123 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <random>
+
+#include "src/asset/vertex_quantization.h"
+
+using namespace capsaicin;
+
+namespace
+{
+// Odd counts exercise the scalar tails of the SIMD loops.
+constexpr uint32_t kCount = 1001;
+
+std::vector<float> RandomFloats(uint32_t count, float low, float high, uint32_t seed)
+{
+    std::mt19937                          rng(seed);
+    std::uniform_real_distribution<float> distribution(low, high);
+
+    std::vector<float> values(count);
+    for (auto& value : values)
+    {
+        value = distribution(rng);
+    }
+    return values;
+}
+}  // namespace
+
+TEST_CASE("Quantized positions are within extent / 65535 of the source", "[vertex_quantization]")
+{
+    auto positions = RandomFloats(3 * kCount, -50.f, 200.f, 1);
+    // Flat bounds quantize to their center.
+    for (uint32_t i = 0; i < kCount; ++i)
+    {
+        positions[3 * i + 2] = 7.f;
+    }
+
+    auto bounds = ComputeBounds(positions.data(), kCount);
+
+    std::vector<int16_t> quantized(4 * kCount);
+    std::vector<float>   dequantized(3 * kCount);
+    QuantizePositions(positions.data(), kCount, bounds, quantized.data());
+    DequantizePositions(quantized.data(), kCount, bounds, dequantized.data());
+
+    for (uint32_t i = 0; i < kCount; ++i)
+    {
+        REQUIRE(quantized[4 * i + 3] == 0);
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            auto extent = bounds.max[c] - bounds.min[c];
+            REQUIRE(std::abs(dequantized[3 * i + c] - positions[3 * i + c]) <= extent / 65535.f);
+        }
+    }
+}
+
+TEST_CASE("Octahedral normals are within 1e-4 radians of the source", "[vertex_quantization]")
+{
+    auto normals = RandomFloats(3 * kCount, -1.f, 1.f, 2);
+
+    // Axes and octahedron edges, where the lower hemisphere wraps.
+    const float kEdges[][3] = {{1.f, 0.f, 0.f},
+                               {0.f, -1.f, 0.f},
+                               {0.f, 0.f, -1.f},
+                               {0.70710678f, 0.f, -0.70710678f},
+                               {0.f, -0.70710678f, -0.70710678f},
+                               {0.57735027f, -0.57735027f, -0.57735027f}};
+    for (uint32_t i = 0; i < std::size(kEdges); ++i)
+    {
+        std::copy_n(kEdges[i], 3, &normals[3 * i]);
+    }
+
+    for (uint32_t i = 0; i < kCount; ++i)
+    {
+        auto n      = &normals[3 * i];
+        auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            n[c] /= length;
+        }
+    }
+
+    std::vector<uint32_t> encoded(kCount);
+    std::vector<float>    decoded(3 * kCount);
+    EncodeNormals(normals.data(), kCount, encoded.data());
+    DecodeNormals(encoded.data(), kCount, decoded.data());
+
+    for (uint32_t i = 0; i < kCount; ++i)
+    {
+        // The angle from the cross and dot products stays accurate for small angles.
+        double a[3], b[3];
+        std::copy_n(&normals[3 * i], 3, a);
+        std::copy_n(&decoded[3 * i], 3, b);
+
+        double cross[3] = {a[1] * b[2] - a[2] * b[1],
+                           a[2] * b[0] - a[0] * b[2],
+                           a[0] * b[1] - a[1] * b[0]};
+        auto   angle    = std::atan2(
+            std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]),
+            a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+        REQUIRE(angle < 1e-4);
+    }
+}
+
+TEST_CASE("Half texcoords are within 2^-11 relative error of the source", "[vertex_quantization]")
+{
+    auto texcoords = RandomFloats(2 * kCount, -4.f, 4.f, 3);
+    // Tiled texcoords reach far out of the unit square.
+    texcoords[0] = 1000.f;
+    texcoords[1] = -0.001f;
+
+    std::vector<uint32_t> encoded(kCount);
+    std::vector<float>    decoded(2 * kCount);
+    EncodeTexcoords(texcoords.data(), kCount, encoded.data());
+    DecodeTexcoords(encoded.data(), kCount, decoded.data());
+
+    // Below the normal half range the error is that of the smallest subnormal step instead.
+    const auto kMinNormal = std::ldexp(1.f, -14);
+    for (uint32_t i = 0; i < 2 * kCount; ++i)
+    {
+        auto error = std::abs(decoded[i] - texcoords[i]);
+        REQUIRE(error <= std::max(std::abs(texcoords[i]), kMinNormal) * std::ldexp(1.f, -11));
+    }
+}
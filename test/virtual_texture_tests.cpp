@@ -0,0 +1,212 @@
+#include <catch2/catch.hpp>
+
+#include <map>
+
+#include "src/asset/virtual_texture.h"
+
+using namespace capsaicin;
+
+namespace
+{
+// Cache which records the pages uploaded and the last page uploaded to each slot.
+class MockCache : public PageCache
+{
+public:
+    void UploadPage(uint32_t page, uint32_t slot) override
+    {
+        uploads.push_back(page);
+        slots[slot] = page;
+    }
+
+    uint32_t SlotOf(uint32_t page) const
+    {
+        for (auto& slot : slots)
+        {
+            if (slot.second == page)
+            {
+                return slot.first;
+            }
+        }
+        return ~0u;
+    }
+
+    std::vector<uint32_t>        uploads;
+    std::map<uint32_t, uint32_t> slots;
+};
+
+// Texture 0 of 480x480 texels, whose mips are 4x4, 2x2 and 1x1 pages.
+constexpr uint32_t kSize         = 4 * kPageTexels;
+constexpr uint32_t kMipCount     = 3;
+constexpr uint32_t kMipPages[3]  = {4, 2, 1};
+constexpr uint32_t kMipOffset[3] = {0, 16, 20};
+
+uint32_t Page(uint32_t mip, uint32_t x, uint32_t y)
+{
+    return PackPage(0, mip, x, y);
+}
+
+// Every entry maps its page to the slot of the page itself or of its nearest resident
+// ancestor, which holds that page in the cache.
+void CheckPageTable(const VirtualTextureManager& manager, const MockCache& cache)
+{
+    auto offset = manager.textures()[0].page_table_offset;
+    for (uint32_t mip = 0; mip < kMipCount; ++mip)
+    {
+        for (uint32_t y = 0; y < kMipPages[mip]; ++y)
+        {
+            for (uint32_t x = 0; x < kMipPages[mip]; ++x)
+            {
+                auto expected = kUnmappedEntry;
+                for (auto level = mip; level < kMipCount; ++level)
+                {
+                    auto page = Page(level, x >> (level - mip), y >> (level - mip));
+                    if (manager.resident(page))
+                    {
+                        expected = PageTableEntry(cache.SlotOf(page), level);
+                        break;
+                    }
+                }
+
+                auto index = offset + kMipOffset[mip] + y * kMipPages[mip] + x;
+                REQUIRE(manager.page_table()[index] == expected);
+            }
+        }
+    }
+}
+}  // namespace
+
+TEST_CASE("Feedback is reduced to distinct pages in page order", "[virtual_texture]")
+{
+    std::vector<uint32_t> feedback = {Page(1, 1, 0),
+                                      Page(1, 1, 0),
+                                      kInvalidPage,
+                                      Page(0, 2, 3),
+                                      Page(1, 1, 0),
+                                      Page(0, 0, 0),
+                                      kInvalidPage,
+                                      Page(0, 2, 3)};
+
+    std::vector<PageRequest> requests;
+    ReducePageFeedback(feedback.data(), feedback.size(), requests);
+
+    REQUIRE(requests.size() == 3);
+    REQUIRE(requests[0].page == Page(0, 0, 0));
+    REQUIRE(requests[0].count == 1);
+    REQUIRE(requests[1].page == Page(0, 2, 3));
+    REQUIRE(requests[1].count == 2);
+    REQUIRE(requests[2].page == Page(1, 1, 0));
+    REQUIRE(requests[2].count == 3);
+}
+
+TEST_CASE("Pages fall back to their last mip until they are resident", "[virtual_texture]")
+{
+    VirtualTextureManager manager(8, 64);
+    MockCache             cache;
+
+    REQUIRE(manager.SetTexture(0, kSize, kSize, cache));
+    REQUIRE(manager.textures()[0].mip_count == kMipCount);
+    REQUIRE(cache.uploads == std::vector<uint32_t>{Page(2, 0, 0)});
+    CheckPageTable(manager, cache);
+
+    uint32_t begin = 0;
+    uint32_t end   = 0;
+    manager.TakeDirtyPageTable(begin, end);
+    REQUIRE(begin == 0);
+    REQUIRE(end == 21);
+    manager.TakeDirtyTextures(begin, end);
+    REQUIRE(begin == 0);
+    REQUIRE(end == 1);
+
+    // Ancestors are loaded before the requested page.
+    manager.Update({{Page(0, 3, 1), 1}}, cache);
+    REQUIRE(cache.uploads == std::vector<uint32_t>{Page(2, 0, 0), Page(1, 1, 0), Page(0, 3, 1)});
+    CheckPageTable(manager, cache);
+
+    manager.TakeDirtyPageTable(begin, end);
+    REQUIRE(begin >= kMipOffset[0]);
+    REQUIRE(end <= kMipOffset[2]);
+
+    manager.Update({{Page(0, 0, 2), 1}, {Page(1, 0, 1), 4}}, cache);
+    CheckPageTable(manager, cache);
+}
+
+TEST_CASE("Least recently requested pages are evicted", "[virtual_texture]")
+{
+    // The last mip takes one slot, the mip 1 pages share the other three.
+    VirtualTextureManager manager(4, 64);
+    MockCache             cache;
+    REQUIRE(manager.SetTexture(0, kSize, kSize, cache));
+
+    manager.Update({{Page(1, 0, 0), 1}, {Page(1, 1, 0), 1}, {Page(1, 0, 1), 1}}, cache);
+    REQUIRE(manager.upload_count() == 3);
+    REQUIRE(manager.resident_count() == 4);
+
+    // Requests move pages to the back of the eviction order.
+    manager.Update({{Page(1, 0, 0), 1}}, cache);
+    manager.Update({{Page(1, 1, 1), 1}}, cache);
+    REQUIRE(manager.eviction_count() == 1);
+    REQUIRE_FALSE(manager.resident(Page(1, 1, 0)));
+    REQUIRE(manager.resident(Page(1, 0, 0)));
+    REQUIRE(manager.resident(Page(1, 0, 1)));
+    CheckPageTable(manager, cache);
+
+    manager.Update({{Page(1, 1, 0), 1}}, cache);
+    REQUIRE_FALSE(manager.resident(Page(1, 0, 1)));
+    REQUIRE(manager.resident(Page(1, 1, 0)));
+    CheckPageTable(manager, cache);
+
+    // Pages requested by the same update aren't evicted for each other, and the last mip
+    // stays pinned.
+    std::vector<PageRequest> requests = {
+        {Page(1, 0, 0), 1}, {Page(1, 1, 0), 1}, {Page(1, 0, 1), 1}, {Page(1, 1, 1), 1}};
+    manager.Update(requests, cache);
+    REQUIRE(manager.upload_count() == 0);
+    REQUIRE(manager.eviction_count() == 0);
+    REQUIRE_FALSE(manager.resident(Page(1, 0, 1)));
+    REQUIRE(manager.resident(Page(2, 0, 0)));
+    CheckPageTable(manager, cache);
+}
+
+TEST_CASE("Uploads per update are limited, coarse and most requested pages first",
+          "[virtual_texture]")
+{
+    VirtualTextureManager manager(8, 2);
+    MockCache             cache;
+    REQUIRE(manager.SetTexture(0, kSize, kSize, cache));
+
+    std::vector<PageRequest> requests = {{Page(0, 0, 0), 1}, {Page(1, 1, 1), 5}};
+    manager.Update(requests, cache);
+    REQUIRE(manager.upload_count() == 2);
+    REQUIRE(cache.uploads == std::vector<uint32_t>{Page(2, 0, 0), Page(1, 1, 1), Page(1, 0, 0)});
+    CheckPageTable(manager, cache);
+
+    manager.Update(requests, cache);
+    REQUIRE(manager.upload_count() == 1);
+    REQUIRE(cache.uploads.back() == Page(0, 0, 0));
+    CheckPageTable(manager, cache);
+
+    manager.Update(requests, cache);
+    REQUIRE(manager.upload_count() == 0);
+}
+
+TEST_CASE("Textures which fail to fit keep their page table entries", "[virtual_texture]")
+{
+    VirtualTextureManager manager(8, 64);
+    MockCache             cache;
+    REQUIRE(manager.SetTexture(0, kSize, kSize, cache));
+    auto size = manager.page_table().size();
+
+    // Too many pages per axis unmaps the texture.
+    REQUIRE_FALSE(manager.SetTexture(0, (kMaxPagesAxis + 1) * kPageTexels, kSize, cache));
+    REQUIRE(manager.textures()[0].mip_count == 0);
+    REQUIRE_FALSE(manager.resident(Page(2, 0, 0)));
+
+    // Sizes which fit again reuse the entries, however often loading failed in between.
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        REQUIRE_FALSE(manager.SetTexture(0, (kMaxPagesAxis + 1) * kPageTexels, kSize, cache));
+        REQUIRE(manager.SetTexture(0, kSize, kSize, cache));
+        REQUIRE(manager.page_table().size() == size);
+        CheckPageTable(manager, cache);
+    }
+}